@@ -0,0 +1,149 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "shader.h"
+
+#include <iostream>
+
+// histogram bins; bin 0 collects the black pixels, the others split [MinLogLuminance, MaxLogLuminance] evenly
+#define AUTO_EXPOSURE_BINS 64
+// every AUTO_EXPOSURE_SAMPLE_STRIDE-th pixel in x and y goes into the histogram
+#define AUTO_EXPOSURE_SAMPLE_STRIDE 4
+
+// Histogram based automatic exposure, entirely on the GPU (there are no compute shaders on a 3.3 context, so the
+// histogram is built by scattering points):
+//   1. one GL_POINT per sampled pixel of the HDR image lands on the bin of its log2 luminance in a 64x1 R32F target,
+//      where additive blending counts them (histogram.vs / histogram.fs)
+//   2. a 1x1 pass averages the bins between the LowPercent and HighPercent percentiles, so a few very dark or very
+//      bright pixels don't swing the exposure, and moves last frame's adapted luminance towards it (exposure.fs)
+// The adapted luminance stays in a 1x1 texture the tone mapping shader reads; nothing is read back to the CPU.
+class AutoExposure
+{
+public:
+    float MinLogLuminance = -8.0f;
+    float MaxLogLuminance = 8.0f;
+    float LowPercent = 0.1f;
+    float HighPercent = 0.9f;
+    // adaptation rates per second; eyes adjust faster to bright than to dark
+    float SpeedUp = 3.0f;
+    float SpeedDown = 1.0f;
+
+    AutoExposure(unsigned int width, unsigned int height) : width(width), height(height)
+    {
+        columns = (width + AUTO_EXPOSURE_SAMPLE_STRIDE - 1) / AUTO_EXPOSURE_SAMPLE_STRIDE;
+        rows = (height + AUTO_EXPOSURE_SAMPLE_STRIDE - 1) / AUTO_EXPOSURE_SAMPLE_STRIDE;
+        histogramTexture = createTarget(histogramFBO, AUTO_EXPOSURE_BINS);
+        // cleared to 0, which the exposure pass takes as "no history yet"
+        float zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (unsigned int i = 0; i < 2; i++)
+        {
+            luminanceTextures[i] = createTarget(luminanceFBOs[i], 1);
+            glClearBufferfv(GL_COLOR, 0, zero);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        // the histogram points read everything from gl_VertexID, but core profile still needs a VAO to draw
+        glGenVertexArrays(1, &pointVAO);
+        float quadVertices[] = {
+            // positions   // texCoords
+            -1.0f, 1.0f, 0.0f, 1.0f,
+            -1.0f, -1.0f, 0.0f, 0.0f,
+            1.0f, 1.0f, 1.0f, 1.0f,
+            1.0f, -1.0f, 1.0f, 0.0f};
+        unsigned int quadVBO;
+        glGenVertexArrays(1, &quadVAO);
+        glGenBuffers(1, &quadVBO);
+        glBindVertexArray(quadVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)(2 * sizeof(float)));
+        glBindVertexArray(0);
+    }
+
+    // builds the histogram of hdrTexture (width x height) and adapts the luminance; leaves framebuffer 0 bound with a
+    // width x height viewport
+    void Update(Shader &histogramShader, Shader &exposureShader, unsigned int hdrTexture, float deltaTime)
+    {
+        float logRange = MaxLogLuminance - MinLogLuminance;
+        glDisable(GL_DEPTH_TEST);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, hdrTexture);
+        glBindFramebuffer(GL_FRAMEBUFFER, histogramFBO);
+        glViewport(0, 0, AUTO_EXPOSURE_BINS, 1);
+        float zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        glClearBufferfv(GL_COLOR, 0, zero);
+        histogramShader.use();
+        histogramShader.setInt("hdrBuffer", 0);
+        histogramShader.setInt("sampleStride", AUTO_EXPOSURE_SAMPLE_STRIDE);
+        histogramShader.setInt("columns", columns);
+        histogramShader.setInt("bins", AUTO_EXPOSURE_BINS);
+        histogramShader.setFloat("minLogLuminance", MinLogLuminance);
+        histogramShader.setFloat("inverseLogLuminanceRange", 1.0f / logRange);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glBindVertexArray(pointVAO);
+        glDrawArrays(GL_POINTS, 0, columns * rows);
+        glDisable(GL_BLEND);
+
+        // read last frame's luminance, write this frame's into the other texture
+        glBindFramebuffer(GL_FRAMEBUFFER, luminanceFBOs[1 - current]);
+        glViewport(0, 0, 1, 1);
+        exposureShader.use();
+        exposureShader.setInt("histogram", 0);
+        exposureShader.setInt("previousLuminance", 1);
+        exposureShader.setFloat("minLogLuminance", MinLogLuminance);
+        exposureShader.setFloat("logLuminanceRange", logRange);
+        exposureShader.setFloat("lowPercent", LowPercent);
+        exposureShader.setFloat("highPercent", HighPercent);
+        exposureShader.setFloat("speedUp", SpeedUp);
+        exposureShader.setFloat("speedDown", SpeedDown);
+        exposureShader.setFloat("deltaTime", deltaTime);
+        glBindTexture(GL_TEXTURE_2D, histogramTexture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, luminanceTextures[current]);
+        glBindVertexArray(quadVAO);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+        current = 1 - current;
+
+        glEnable(GL_DEPTH_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, width, height);
+    }
+
+    // 1x1 R32F texture with the adapted average luminance; the tone mapping shader derives its exposure from it
+    unsigned int GetLuminanceTexture() const
+    {
+        return luminanceTextures[current];
+    }
+
+private:
+    unsigned int width, height;
+    unsigned int columns, rows;
+    unsigned int histogramFBO, histogramTexture;
+    unsigned int luminanceFBOs[2], luminanceTextures[2];
+    unsigned int current = 0;
+    unsigned int pointVAO, quadVAO;
+
+    // width x 1 R32F target attached to a new framebuffer, which is left bound
+    unsigned int createTarget(unsigned int &fbo, unsigned int targetWidth)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, targetWidth, 1, 0, GL_RED, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: auto exposure framebuffer is not complete!" << std::endl;
+        return texture;
+    }
+};
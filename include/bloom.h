@@ -0,0 +1,133 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "shader.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// upper limit of the mip chain length
+#define BLOOM_MAX_MIPS 8
+
+// Progressive downsample / upsample bloom (Jimenez 2014, "Next generation post processing in Call of Duty: Advanced
+// Warfare"). The source is filtered down a chain of half resolution targets with a 13 tap filter, then filtered back
+// up with a 3x3 tent, each level blended into the one above it:
+//   mip[i - 1] = mix(mip[i - 1], tent(mip[i]), Scatter)
+// The chain covers a large radius in a handful of passes whose total size is a third of the source, so the cost stays
+// roughly constant; Scatter moves energy to the wider levels, which is how the radius is adjusted. The blend weights
+// sum to one, so the bloom keeps the brightness of the source. The shaders are bloom_downsample.fs and
+// bloom_upsample.fs with a vertex shader taking the position at location 0 and the uv at location 1.
+class Bloom
+{
+public:
+    // share of every level handed on from the smaller level below it: 0 keeps only the first (narrowest) level, 1 only
+    // the smallest (widest) one
+    float Scatter = 0.7f;
+
+    Bloom(unsigned int width, unsigned int height, unsigned int mipCount = 6) : width(width), height(height)
+    {
+        unsigned int w = width, h = height;
+        for (unsigned int i = 0; i < std::min<unsigned int>(mipCount, BLOOM_MAX_MIPS) && w > 1 && h > 1; i++)
+        {
+            w /= 2;
+            h /= 2;
+            Mip mip = {0, 0, w, h};
+            glGenTextures(1, &mip.texture);
+            glBindTexture(GL_TEXTURE_2D, mip.texture);
+            // 4 bytes per pixel instead of 8; bloom has no use for alpha or the extra precision
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, w, h, 0, GL_RGB, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glGenFramebuffers(1, &mip.FBO);
+            glBindFramebuffer(GL_FRAMEBUFFER, mip.FBO);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mip.texture, 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "ERROR::FRAMEBUFFER:: bloom framebuffer is not complete!" << std::endl;
+            mips.push_back(mip);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        float quadVertices[] = {
+            // positions   // texCoords
+            -1.0f, 1.0f, 0.0f, 1.0f,
+            -1.0f, -1.0f, 0.0f, 0.0f,
+            1.0f, 1.0f, 1.0f, 1.0f,
+            1.0f, -1.0f, 1.0f, 0.0f};
+        unsigned int quadVBO;
+        glGenVertexArrays(1, &quadVAO);
+        glGenBuffers(1, &quadVBO);
+        glBindVertexArray(quadVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)(2 * sizeof(float)));
+        glBindVertexArray(0);
+    }
+
+    // blooms sourceTexture (width x height) and returns the half resolution result texture. Leaves framebuffer 0 bound
+    // with a width x height viewport.
+    unsigned int Render(Shader &downsampleShader, Shader &upsampleShader, unsigned int sourceTexture)
+    {
+        if (mips.empty())
+            return sourceTexture;
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(quadVAO);
+        glActiveTexture(GL_TEXTURE0);
+        downsampleShader.use();
+        downsampleShader.setInt("image", 0);
+        for (unsigned int i = 0; i < mips.size(); i++)
+        {
+            bindMip(i);
+            downsampleShader.setBool("firstPass", i == 0);
+            glBindTexture(GL_TEXTURE_2D, i == 0 ? sourceTexture : mips[i - 1].texture);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+
+        upsampleShader.use();
+        upsampleShader.setInt("image", 0);
+        glEnable(GL_BLEND);
+        glBlendColor(0.0f, 0.0f, 0.0f, Scatter);
+        glBlendFunc(GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA);
+        for (unsigned int i = static_cast<unsigned int>(mips.size()) - 1; i > 0; i--)
+        {
+            bindMip(i - 1);
+            glBindTexture(GL_TEXTURE_2D, mips[i].texture);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+        glDisable(GL_BLEND);
+        glBindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, width, height);
+        return mips[0].texture;
+    }
+
+    unsigned int GetMipCount() const
+    {
+        return static_cast<unsigned int>(mips.size());
+    }
+
+private:
+    struct Mip
+    {
+        unsigned int texture;
+        unsigned int FBO;
+        unsigned int width, height;
+    };
+
+    unsigned int width, height;
+    std::vector<Mip> mips;
+    unsigned int quadVAO;
+
+    void bindMip(unsigned int i)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, mips[i].FBO);
+        glViewport(0, 0, mips[i].width, mips[i].height);
+    }
+};
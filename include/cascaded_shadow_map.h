@@ -0,0 +1,283 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+// upper limit of the cascade count; the shaders declare their arrays with this size
+#define SHADOW_MAX_CASCADES 4
+
+// Cascaded shadow maps for a directional light. The view frustum up to ShadowDistance is split into CascadeCount slices
+// (a blend of logarithmic and uniform splits, SplitLambda = 1 is fully logarithmic) and every slice gets its own
+// orthographic shadow map, one layer of a depth texture array:
+//   csm.Update(view, fovy, aspect, near, lightDirection);
+//   for every cascade i: csm.BeginCascade(i); draw the casters for which csm.Intersects(i, min, max) holds
+//   csm.End(); csm.Bind(shader, unit);
+// Every cascade is fit to the bounding sphere of its slice, so its size doesn't change when the camera turns, and its
+// position is snapped to whole shadow texels, so the shadow edges don't shimmer when the camera moves. Depth clamping
+// is on while the cascades are drawn: casters between the light and a cascade's near plane are flattened onto it
+// instead of being clipped, which lets the cascade depth range stay tight.
+// With CacheStatic the static casters are drawn separately into a second depth array of twice the cascade size. The
+// light view doesn't follow the camera, so a cascade is a whole-texel window of a fixed light space grid, and its cache
+// is a larger window of the same grid with the same depth range. Since the cache reaches half a cascade past it on
+// every side, it holds the cascade until the camera has moved about that far; only then, or when the light turns, the
+// cascade size changes or InvalidateStatic() is called because a static caster moved, is it redrawn around the cascade.
+// BeginCascade starts each cascade from a copy of its window of the cache and only the dynamic casters are drawn on top:
+//   csm.CacheStatic = true; csm.Update(...);
+//   if (csm.BeginStaticCascade(i)) draw with csm.StaticMatrices[i] the static casters for which
+//   csm.IntersectsStatic(i, min, max) holds; csm.BeginCascade(i); draw the dynamic casters
+// The shader picks the first cascade whose split is beyond the fragment's view depth:
+//   uniform sampler2DArray shadowMap; uniform int cascadeCount;
+//   uniform mat4 lightSpaceMatrices[4]; uniform float cascadeSplits[4]; uniform float cascadeTexelSizes[4];
+class CascadedShadowMap
+{
+public:
+    unsigned int FBO;
+    unsigned int DepthArray;
+    bool CacheStatic = false;
+    unsigned int StaticFBO;
+    unsigned int StaticDepthArray;
+    // light space matrix of each cascade's static cache, for drawing the static casters
+    glm::mat4 StaticMatrices[SHADOW_MAX_CASCADES];
+    unsigned int Resolution;
+    unsigned int CascadeCount;
+    float ShadowDistance = 50.0f;
+    float SplitLambda = 0.75f;
+    // how far behind a cascade (towards the light) casters are still taken into account
+    float CasterDistance = 20.0f;
+    glm::mat4 LightSpaceMatrices[SHADOW_MAX_CASCADES];
+    // view depth at which each cascade ends
+    float CascadeSplits[SHADOW_MAX_CASCADES];
+    // world space size of one shadow texel in each cascade, for the normal offset in the shader
+    float CascadeTexelSizes[SHADOW_MAX_CASCADES];
+
+    CascadedShadowMap(unsigned int resolution = 512, unsigned int cascadeCount = SHADOW_MAX_CASCADES)
+        : Resolution(resolution), CascadeCount(std::min<unsigned int>(cascadeCount, SHADOW_MAX_CASCADES))
+    {
+        DepthArray = createDepthArray(FBO, Resolution);
+        StaticDepthArray = createDepthArray(StaticFBO, 2 * Resolution);
+        InvalidateStatic();
+    }
+
+    // fits the cascades to the camera; lightDirection points from the light into the scene. With CacheStatic it also
+    // moves the static caches that no longer hold their cascade.
+    void Update(const glm::mat4 &view, float fovy, float aspect, float near, const glm::vec3 &lightDirection)
+    {
+        glm::mat4 inverseView = glm::inverse(view);
+        glm::vec3 direction = glm::normalize(lightDirection);
+        glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        // the same for every cascade and every camera position, so all of them snap to one texel grid per cascade size
+        glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), direction, up);
+        float tanY = std::tan(fovy * 0.5f), tanX = tanY * aspect;
+        float far = ShadowDistance;
+        float sliceNear = near;
+        for (unsigned int i = 0; i < CascadeCount; i++)
+        {
+            float t = static_cast<float>(i + 1) / CascadeCount;
+            float logSplit = near * std::pow(far / near, t);
+            float uniformSplit = near + (far - near) * t;
+            float sliceFar = SplitLambda * logSplit + (1.0f - SplitLambda) * uniformSplit;
+            CascadeSplits[i] = sliceFar;
+
+            // bounding sphere of the slice in view space; it only depends on the projection, so turning the camera
+            // doesn't change the cascade size
+            glm::vec3 corners[8];
+            for (unsigned int c = 0; c < 8; c++)
+            {
+                float z = c < 4 ? sliceNear : sliceFar;
+                corners[c] = glm::vec3((c & 1 ? 1.0f : -1.0f) * tanX * z, (c & 2 ? 1.0f : -1.0f) * tanY * z, -z);
+            }
+            glm::vec3 center(0.0f);
+            for (unsigned int c = 0; c < 8; c++)
+                center += corners[c] / 8.0f;
+            float radius = 0.0f;
+            for (unsigned int c = 0; c < 8; c++)
+                radius = std::max(radius, glm::length(corners[c] - center));
+            // quantized so float noise can't change the texel size from frame to frame
+            radius = std::ceil(radius * 16.0f) / 16.0f;
+            glm::vec3 lightCenter = glm::vec3(lightView * inverseView * glm::vec4(center, 1.0f));
+
+            // the cascade starts on a whole texel, so the shadow edges don't shimmer when the camera moves, and reaches
+            // CasterDistance towards the light
+            float texelSize = 2.0f * radius / Resolution;
+            int size = static_cast<int>(Resolution);
+            int originX = static_cast<int>(std::floor((lightCenter.x - radius) / texelSize + 0.5f));
+            int originY = static_cast<int>(std::floor((lightCenter.y - radius) / texelSize + 0.5f));
+            float depthNear = -lightCenter.z - radius - CasterDistance;
+            float depthFar = -lightCenter.z + radius;
+            if (CacheStatic)
+            {
+                StaticCache &cache = staticCaches[i];
+                bool inside = cache.Direction == direction && cache.TexelSize == texelSize &&
+                              originX >= cache.OriginX && originX + size <= cache.OriginX + 2 * size &&
+                              originY >= cache.OriginY && originY + size <= cache.OriginY + 2 * size &&
+                              depthNear >= cache.Near && depthFar <= cache.Far;
+                if (!inside)
+                {
+                    // centered on the cascade, with half a cascade of room on every side and in depth
+                    cache.Valid = false;
+                    cache.Direction = direction;
+                    cache.TexelSize = texelSize;
+                    cache.OriginX = originX - size / 2;
+                    cache.OriginY = originY - size / 2;
+                    cache.Near = depthNear - radius;
+                    cache.Far = depthFar + radius;
+                    StaticMatrices[i] = glm::ortho(cache.OriginX * texelSize, (cache.OriginX + 2 * size) * texelSize,
+                                                   cache.OriginY * texelSize, (cache.OriginY + 2 * size) * texelSize,
+                                                   cache.Near, cache.Far) * lightView;
+                }
+                // the cascade takes the cache's depth range so the copied depths mean the same in both
+                depthNear = cache.Near;
+                depthFar = cache.Far;
+                cascadeOffsets[i][0] = originX - cache.OriginX;
+                cascadeOffsets[i][1] = originY - cache.OriginY;
+            }
+            LightSpaceMatrices[i] = glm::ortho(originX * texelSize, (originX + size) * texelSize,
+                                               originY * texelSize, (originY + size) * texelSize, depthNear, depthFar) * lightView;
+            CascadeTexelSizes[i] = texelSize;
+            sliceNear = sliceFar;
+        }
+    }
+
+    // binds the static cache of cascade i for drawing and returns true when it's stale, in which case the caller
+    // draws the static casters with StaticMatrices[i]; returns false without binding anything when the cache still
+    // holds this cascade
+    bool BeginStaticCascade(unsigned int i)
+    {
+        if (staticCaches[i].Valid)
+            return false;
+        bindLayer(StaticFBO, StaticDepthArray, i, 2 * Resolution);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        staticCaches[i].Valid = true;
+        return true;
+    }
+
+    // binds cascade i for drawing, cleared or, with CacheStatic, holding the static casters; the caller restores the
+    // viewport when all cascades are done
+    void BeginCascade(unsigned int i)
+    {
+        bindLayer(FBO, DepthArray, i, Resolution);
+        if (!CacheStatic)
+        {
+            glClear(GL_DEPTH_BUFFER_BIT);
+            return;
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, StaticFBO);
+        glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, StaticDepthArray, 0, i);
+        int x = cascadeOffsets[i][0], y = cascadeOffsets[i][1];
+        int size = static_cast<int>(Resolution);
+        glBlitFramebuffer(x, y, x + size, y + size, 0, 0, size, size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+    }
+
+    // the static casters changed, every cascade's cache is redrawn on the next BeginStaticCascade
+    void InvalidateStatic()
+    {
+        for (unsigned int i = 0; i < SHADOW_MAX_CASCADES; i++)
+            staticCaches[i].Valid = false;
+    }
+
+    void End()
+    {
+        glDisable(GL_DEPTH_CLAMP);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // whether a caster with this world space bounding box can throw a shadow into cascade i. Only the sides and the
+    // far end of the cascade cull; anything towards the light still casts.
+    bool Intersects(unsigned int i, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) const
+    {
+        return intersects(LightSpaceMatrices[i], boundsMin, boundsMax);
+    }
+
+    // the same for the static cache of cascade i
+    bool IntersectsStatic(unsigned int i, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) const
+    {
+        return intersects(StaticMatrices[i], boundsMin, boundsMax);
+    }
+
+    // binds the depth array to unit and sets the cascade uniforms
+    void Bind(Shader &shader, unsigned int unit)
+    {
+        shader.setInt("shadowMap", unit);
+        shader.setInt("cascadeCount", CascadeCount);
+        for (unsigned int i = 0; i < CascadeCount; i++)
+        {
+            shader.setMat4("lightSpaceMatrices[" + std::to_string(i) + "]", LightSpaceMatrices[i]);
+            shader.setFloat("cascadeSplits[" + std::to_string(i) + "]", CascadeSplits[i]);
+            shader.setFloat("cascadeTexelSizes[" + std::to_string(i) + "]", CascadeTexelSizes[i]);
+        }
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, DepthArray);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+private:
+    // the light space window of a static cache: its first texel on the grid of its texel size and its depth range
+    struct StaticCache
+    {
+        bool Valid = false;
+        glm::vec3 Direction = glm::vec3(0.0f);
+        float TexelSize = 0.0f;
+        int OriginX = 0, OriginY = 0;
+        float Near = 0.0f, Far = 0.0f;
+    };
+    StaticCache staticCaches[SHADOW_MAX_CASCADES];
+    // where each cascade's window starts in its static cache, in texels
+    int cascadeOffsets[SHADOW_MAX_CASCADES][2] = {};
+
+    bool intersects(const glm::mat4 &lightSpaceMatrix, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) const
+    {
+        glm::vec3 lo(1e30f), hi(-1e30f);
+        for (unsigned int c = 0; c < 8; c++)
+        {
+            glm::vec3 corner(c & 1 ? boundsMax.x : boundsMin.x, c & 2 ? boundsMax.y : boundsMin.y, c & 4 ? boundsMax.z : boundsMin.z);
+            // orthographic, so no divide
+            glm::vec3 p = glm::vec3(lightSpaceMatrix * glm::vec4(corner, 1.0f));
+            lo = glm::vec3(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+            hi = glm::vec3(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+        }
+        return hi.x >= -1.0f && lo.x <= 1.0f && hi.y >= -1.0f && lo.y <= 1.0f && lo.z <= 1.0f;
+    }
+
+    // size x size x CascadeCount depth array attached to a new framebuffer
+    unsigned int createDepthArray(unsigned int &fbo, unsigned int size)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, size, size, CascadeCount, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        float borderColor[] = {1.0f, 1.0f, 1.0f, 1.0f};
+        glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: cascaded shadow map framebuffer is not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return texture;
+    }
+
+    void bindLayer(unsigned int fbo, unsigned int texture, unsigned int i, unsigned int size)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, size, size);
+        glEnable(GL_DEPTH_CLAMP);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, i);
+    }
+};
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// upper limit of BlurRadius; wider blurs come from the mips instead
+#define EVSM_MAX_BLUR_RADIUS 8
+
+// Exponential variance shadow maps (Lauritzen and McCool 2008, "Layered variance shadow maps"): a filterable copy of
+// a depth texture array such as CascadedShadowMap's. Every layer is turned into the moments of two exponentially
+// warped depths
+//   d = depth * 2 - 1, p = exp(PositiveExponent * d), n = -exp(-NegativeExponent * d), stored as (p, p^2, n, n^2)
+// in an RGBA16F array, blurred with a separable gaussian and mip-mapped. Soft shadows then cost one trilinear fetch per
+// pixel whatever the blur radius, and the shader bounds the lit fraction with Chebyshev's inequality on both warps:
+//   evsm.Invalidate(layer) for every layer whose depth was redrawn; evsm.Filter(blurShader, depthArray); evsm.Bind(shader, unit);
+// Filter only rebuilds the invalidated layers, so a frame that redrew no depth costs nothing; a changed blur radius
+// or exponent invalidates every layer.
+//   uniform sampler2DArray momentMap; uniform vec2 evsmExponents;
+// The blur shader (evsm_blur.fs, with a vertex shader taking the position at location 0 and the uv at location 1)
+// warps the depth while blurring horizontally, then blurs the moments vertically into the array layer. Half floats
+// bound the exponents: p^2 must stay below 65504, so exp(2 * 5.54) is the most.
+class EvsmShadowMap
+{
+public:
+    unsigned int MomentArray;
+    unsigned int Resolution;
+    unsigned int Layers;
+    float PositiveExponent = 5.0f;
+    float NegativeExponent = 5.0f;
+    // gaussian radius in texels of the blur before mip-mapping, at most EVSM_MAX_BLUR_RADIUS
+    int BlurRadius = 2;
+
+    EvsmShadowMap(unsigned int resolution, unsigned int layers) : Resolution(resolution), Layers(layers), stale(layers, true)
+    {
+        glGenTextures(1, &MomentArray);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, MomentArray);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA16F, Resolution, Resolution, Layers, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glGenFramebuffers(1, &momentFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, momentFBO);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, MomentArray, 0, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: EVSM moment framebuffer is not complete!" << std::endl;
+
+        // the horizontally blurred moments of one layer
+        glGenTextures(1, &blurTexture);
+        glBindTexture(GL_TEXTURE_2D, blurTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, Resolution, Resolution, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glGenFramebuffers(1, &blurFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, blurFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, blurTexture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: EVSM blur framebuffer is not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        float quadVertices[] = {
+            // positions   // texCoords
+            -1.0f, 1.0f, 0.0f, 1.0f,
+            -1.0f, -1.0f, 0.0f, 0.0f,
+            1.0f, 1.0f, 1.0f, 1.0f,
+            1.0f, -1.0f, 1.0f, 0.0f};
+        unsigned int quadVBO;
+        glGenVertexArrays(1, &quadVAO);
+        glGenBuffers(1, &quadVBO);
+        glBindVertexArray(quadVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)(2 * sizeof(float)));
+        glBindVertexArray(0);
+    }
+
+    // the depth of a layer, or of every layer, was redrawn
+    void Invalidate(unsigned int layer)
+    {
+        if (layer < Layers)
+            stale[layer] = true;
+    }
+    void Invalidate()
+    {
+        std::fill(stale.begin(), stale.end(), true);
+    }
+
+    // rebuilds the moments of the invalidated layers of depthArray (Resolution x Resolution x Layers) and the mips and
+    // returns how many layers that was. Leaves framebuffer 0 bound when it draws; the caller restores the viewport.
+    unsigned int Filter(Shader &blurShader, unsigned int depthArray)
+    {
+        int radius = std::min(std::max(BlurRadius, 0), EVSM_MAX_BLUR_RADIUS);
+        glm::vec2 exponents(PositiveExponent, NegativeExponent);
+        if (radius != filteredRadius || exponents != filteredExponents)
+            Invalidate();
+        filteredRadius = radius;
+        filteredExponents = exponents;
+        unsigned int filtered = static_cast<unsigned int>(std::count(stale.begin(), stale.end(), true));
+        if (filtered == 0)
+            return 0;
+        glDisable(GL_DEPTH_TEST);
+        glViewport(0, 0, Resolution, Resolution);
+        glBindVertexArray(quadVAO);
+        blurShader.use();
+        blurShader.setInt("depthMap", 0);
+        blurShader.setInt("moments", 1);
+        blurShader.setInt("radius", radius);
+        blurShader.setVec2("exponents", exponents);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, depthArray);
+        for (unsigned int i = 0; i < Layers; i++)
+        {
+            if (!stale[i])
+                continue;
+            stale[i] = false;
+            // depth -> warped moments, blurred along x
+            glBindFramebuffer(GL_FRAMEBUFFER, blurFBO);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            blurShader.setBool("firstPass", true);
+            blurShader.setInt("layer", i);
+            blurShader.setVec2("direction", glm::vec2(1.0f / Resolution, 0.0f));
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+            // blurred along y into the layer
+            glBindFramebuffer(GL_FRAMEBUFFER, momentFBO);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, MomentArray, 0, i);
+            glBindTexture(GL_TEXTURE_2D, blurTexture);
+            blurShader.setBool("firstPass", false);
+            blurShader.setVec2("direction", glm::vec2(0.0f, 1.0f / Resolution));
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, MomentArray);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        // outside the map reads as the moments of the far plane, i.e. lit
+        float p = std::exp(PositiveExponent), n = -std::exp(-NegativeExponent);
+        float borderColor[] = {p, p * p, n, n * n};
+        glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        glBindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return filtered;
+    }
+
+    // binds the moment array to unit and sets the exponents the shader warps its depth with
+    void Bind(Shader &shader, unsigned int unit)
+    {
+        shader.setInt("momentMap", unit);
+        shader.setVec2("evsmExponents", glm::vec2(PositiveExponent, NegativeExponent));
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, MomentArray);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+private:
+    unsigned int momentFBO;
+    unsigned int blurFBO, blurTexture;
+    unsigned int quadVAO;
+    // layers whose moments don't match their depth, and the settings the others were filtered with
+    std::vector<bool> stale;
+    int filteredRadius = -1;
+    glm::vec2 filteredExponents = glm::vec2(0.0f);
+};
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "light_buffer.h"
+#include "random.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// screen tile size in pixels
+#define FORWARD_PLUS_TILE 16
+// the light list of a tile is a bit mask stored in two RGBA32UI texels, 8 * 32 bits
+#define FORWARD_PLUS_MAX_LIGHTS 256
+
+// Forward+ (tiled forward) light culling. A depth pre-pass is rendered into an own depth texture, then two tiny
+// full-screen passes at one fragment per 16x16 pixel tile do the culling on the GPU (a 3.3 context has no compute
+// shaders):
+//   tile depth  reduces the depth of every tile to its min and max view depth (RG32F)
+//   tile cull   tests every light sphere against the view space box of the tile between those depths and writes the
+//               tile's light list as a bit mask into two RGBA32UI targets, bit i set = light i touches the tile
+// The pre-pass depth is then blitted into the target framebuffer, so the forward pass shades with GL_LEQUAL and
+// every pixel is shaded once. The forward shader finds its tile from gl_FragCoord and only walks the set bits.
+// Lights go into a buffer texture, two texels per light: position and radius, color.
+//
+// Transparent surfaces aren't in the pre-pass, so the cull pass writes a second pair of masks covering each tile from
+// the near plane to its opaque max depth; bind those for blended draws. With a multisampled target pass its sample
+// count: the pre-pass is then multisampled too (the blit needs matching counts) and the tile depth range covers every
+// sample, so edge samples are lit like the pixel centers.
+//
+// The shaders are shared: include/shaders/forward_plus_tile.vs with forward_plus_tile_depth.fs and
+// forward_plus_tile_cull.fs for the two tile passes, forward_plus_prepass.fs for the pre-pass, and the forward shader
+// includes include/shaders/forward_plus.glsl for the uniforms and the tile's light mask. Per frame:
+//   forwardPlus.SetLights(positions, colors, radii);
+//   forwardPlus.BeginDepthPrepass(); ... draw the opaque scene with the pre-pass shader ...
+//   forwardPlus.CullLights(tileDepthShader, tileCullShader, view, projection);
+//   forwardPlus.Bind(shader, unit); ... draw the opaque scene with the lighting shader ...
+//   forwardPlus.Bind(shader, unit, true); ... draw the transparent surfaces back to front ...
+class ForwardPlus
+{
+public:
+    unsigned int DepthTexture;
+    unsigned int TilesX, TilesY;
+    unsigned int LightCount = 0;
+
+    // samples must match the framebuffer CullLights blits the depth into
+    ForwardPlus(unsigned int width, unsigned int height, unsigned int samples = 1) : width(width), height(height), samples(std::max(samples, 1u))
+    {
+        TilesX = (width + FORWARD_PLUS_TILE - 1) / FORWARD_PLUS_TILE;
+        TilesY = (height + FORWARD_PLUS_TILE - 1) / FORWARD_PLUS_TILE;
+
+        // depth pre-pass target; same format and sample count as the target framebuffer so it can be blitted there
+        glGenFramebuffers(1, &depthFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, depthFBO);
+        glGenTextures(1, &DepthTexture);
+        if (this->samples > 1)
+        {
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, DepthTexture);
+            glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, this->samples, GL_DEPTH24_STENCIL8, width, height, GL_TRUE);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D_MULTISAMPLE, DepthTexture, 0);
+        }
+        else
+        {
+            glBindTexture(GL_TEXTURE_2D, DepthTexture);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, DepthTexture, 0);
+        }
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        checkFramebuffer("depth pre-pass");
+
+        glGenFramebuffers(1, &tileDepthFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, tileDepthFBO);
+        tileDepthTexture = createTileTarget(GL_RG32F, GL_RG, GL_FLOAT, GL_COLOR_ATTACHMENT0);
+        checkFramebuffer("tile depth");
+
+        glGenFramebuffers(1, &lightMaskFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, lightMaskFBO);
+        lightMaskTextures[0] = createTileTarget(GL_RGBA32UI, GL_RGBA_INTEGER, GL_UNSIGNED_INT, GL_COLOR_ATTACHMENT0);
+        lightMaskTextures[1] = createTileTarget(GL_RGBA32UI, GL_RGBA_INTEGER, GL_UNSIGNED_INT, GL_COLOR_ATTACHMENT1);
+        lightMaskTextures[2] = createTileTarget(GL_RGBA32UI, GL_RGBA_INTEGER, GL_UNSIGNED_INT, GL_COLOR_ATTACHMENT2);
+        lightMaskTextures[3] = createTileTarget(GL_RGBA32UI, GL_RGBA_INTEGER, GL_UNSIGNED_INT, GL_COLOR_ATTACHMENT3);
+        unsigned int attachments[4] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3};
+        glDrawBuffers(4, attachments);
+        checkFramebuffer("light mask");
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glGenBuffers(1, &lightDataBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, lightDataBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+        glGenTextures(1, &lightDataTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, lightDataTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, lightDataBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        float quadVertices[] = {
+            -1.0f, 1.0f,
+            -1.0f, -1.0f,
+            1.0f, -1.0f,
+
+            -1.0f, 1.0f,
+            1.0f, -1.0f,
+            1.0f, 1.0f};
+        unsigned int quadVBO;
+        glGenVertexArrays(1, &quadVAO);
+        glGenBuffers(1, &quadVBO);
+        glBindVertexArray(quadVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
+        glBindVertexArray(0);
+    }
+
+    // uploads the point lights that changed since the last call; radius is the distance at which a light stops
+    // contributing. Lights past FORWARD_PLUS_MAX_LIGHTS are dropped.
+    void SetLights(const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &colors, const std::vector<float> &radii)
+    {
+        LightCount = static_cast<unsigned int>(std::min<size_t>(positions.size(), FORWARD_PLUS_MAX_LIGHTS));
+        lightData.resize(std::max(LightCount, 1u) * 2);
+        for (unsigned int i = 0; i < LightCount; i++)
+        {
+            lightData[i * 2] = glm::vec4(positions[i], radii[i]);
+            lightData[i * 2 + 1] = glm::vec4(colors[i], 0.0f);
+        }
+        lightUploader.Upload(GL_TEXTURE_BUFFER, lightDataBuffer, lightData);
+    }
+
+    // binds the pre-pass target; draw the opaque geometry after this, the color writes are masked off
+    void BeginDepthPrepass()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, depthFBO);
+        glViewport(0, 0, width, height);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    // builds the per tile light lists from the pre-pass depth, then copies the depth into targetFBO and leaves it bound
+    // with GL_LEQUAL, ready for the forward pass. targetFBO must be cleared before, its depth is overwritten.
+    void CullLights(Shader &tileDepthShader, Shader &tileCullShader, const glm::mat4 &view, const glm::mat4 &projection, unsigned int targetFBO = 0)
+    {
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDisable(GL_DEPTH_TEST);
+        glViewport(0, 0, TilesX, TilesY);
+        glBindVertexArray(quadVAO);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, tileDepthFBO);
+        tileDepthShader.use();
+        tileDepthShader.setInt("depthTexture", 0);
+        tileDepthShader.setInt("depthTextureMS", 1);
+        tileDepthShader.setInt("sampleCount", samples);
+        tileDepthShader.setInt("tileSize", FORWARD_PLUS_TILE);
+        tileDepthShader.setMat4("projection", projection);
+        glActiveTexture(samples > 1 ? GL_TEXTURE1 : GL_TEXTURE0);
+        glBindTexture(samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D, DepthTexture);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, lightMaskFBO);
+        tileCullShader.use();
+        tileCullShader.setInt("tileDepth", 0);
+        tileCullShader.setInt("lightData", 1);
+        tileCullShader.setInt("lightCount", LightCount);
+        tileCullShader.setMat4("view", view);
+        tileCullShader.setVec2("projectionScale", projection[0][0], projection[1][1]);
+        tileCullShader.setVec2("tileScale", static_cast<float>(FORWARD_PLUS_TILE) / width, static_cast<float>(FORWARD_PLUS_TILE) / height);
+        // view depth of the near and far plane, where the window depth is 0 and 1
+        tileCullShader.setVec2("clipDepth", projection[3][2] / (projection[2][2] - 1.0f), projection[3][2] / (projection[2][2] + 1.0f));
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, tileDepthTexture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_BUFFER, lightDataTexture);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        glActiveTexture(GL_TEXTURE0);
+        glBindVertexArray(0);
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, depthFBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFBO);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+        glViewport(0, 0, width, height);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LEQUAL);
+    }
+
+    // binds the light data to firstUnit and the two tile masks to firstUnit + 1, firstUnit + 2 and sets the uniforms
+    // the forward shader needs to walk its tile's lights; transparent selects the masks that reach in front of the
+    // opaque depth
+    void Bind(Shader &shader, unsigned int firstUnit, bool transparent = false)
+    {
+        unsigned int *masks = &lightMaskTextures[transparent ? 2 : 0];
+        shader.setInt("lightData", firstUnit);
+        shader.setInt("lightMask0", firstUnit + 1);
+        shader.setInt("lightMask1", firstUnit + 2);
+        shader.setInt("tileLightCount", LightCount);
+        shader.setInt("tileSize", FORWARD_PLUS_TILE);
+        glActiveTexture(GL_TEXTURE0 + firstUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, lightDataTexture);
+        glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+        glBindTexture(GL_TEXTURE_2D, masks[0]);
+        glActiveTexture(GL_TEXTURE0 + firstUnit + 2);
+        glBindTexture(GL_TEXTURE_2D, masks[1]);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+private:
+    unsigned int width, height, samples;
+    unsigned int depthFBO, tileDepthFBO, lightMaskFBO;
+    unsigned int tileDepthTexture;
+    // opaque masks, then transparent masks
+    unsigned int lightMaskTextures[4];
+    unsigned int lightDataBuffer, lightDataTexture;
+    unsigned int quadVAO;
+    std::vector<glm::vec4> lightData;
+    LightDataUploader lightUploader;
+
+    unsigned int createTileTarget(GLint internalFormat, GLenum format, GLenum type, GLenum attachment)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, TilesX, TilesY, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+        return texture;
+    }
+
+    static void checkFramebuffer(const char *name)
+    {
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: forward+ " << name << " framebuffer is not complete!" << std::endl;
+    }
+};
+
+// The many small lights of the forward+ samples: scattered over a box and colored from a fixed seed, each one drifting
+// on a small loop around its base position so the tile lists change every frame.
+//   DriftingLights lights(256, seed, boxMin, boxMax, 0.5f, 1.0f);
+//   lights.SetRadii(2.5f, 4.0f);                              // or SetAttenuationRadii(linear, quadratic)
+//   lights.Update(time, amplitude, speed);
+//   forwardPlus.SetLights(lights.Positions, lights.Colors, lights.Radii);
+class DriftingLights
+{
+public:
+    std::vector<glm::vec3> Positions;
+    std::vector<glm::vec3> Colors;
+    std::vector<float> Radii;
+
+    // every color channel is uniform in [colorMin, colorMax]
+    DriftingLights(unsigned int count, uint64_t seed, const glm::vec3 &boxMin, const glm::vec3 &boxMax, float colorMin, float colorMax)
+        : Positions(count), Colors(count), Radii(count), random(seed), basePositions(count)
+    {
+        for (unsigned int i = 0; i < count; i++)
+        {
+            uint32_t bits[4];
+            random.Generate(i, 0, bits);
+            basePositions[i] = boxMin + glm::vec3(Philox::Uniform(bits[0]), Philox::Uniform(bits[1]), Philox::Uniform(bits[2])) * (boxMax - boxMin);
+            random.Generate(i, 1, bits);
+            Colors[i] = colorMin + glm::vec3(Philox::Uniform(bits[0]), Philox::Uniform(bits[1]), Philox::Uniform(bits[2])) * (colorMax - colorMin);
+        }
+        Positions = basePositions;
+    }
+
+    // random radii in [minRadius, maxRadius], for shaders whose falloff reaches zero at the radius
+    void SetRadii(float minRadius, float maxRadius)
+    {
+        for (unsigned int i = 0; i < Radii.size(); i++)
+        {
+            uint32_t bits[4];
+            random.Generate(i, 0, bits);
+            Radii[i] = minRadius + Philox::Uniform(bits[3]) * (maxRadius - minRadius);
+        }
+    }
+
+    // the distance at which 1 / (1 + linear d + quadratic d^2) times the brightest channel drops below 5/256
+    void SetAttenuationRadii(float linear, float quadratic)
+    {
+        for (unsigned int i = 0; i < Radii.size(); i++)
+        {
+            float maxBrightness = std::max(std::max(Colors[i].x, Colors[i].y), Colors[i].z);
+            Radii[i] = (-linear + std::sqrt(linear * linear - 4.0f * quadratic * (1.0f - (256.0f / 5.0f) * maxBrightness))) / (2.0f * quadratic);
+        }
+    }
+
+    // moves every light along (sin, sin, cos) of its own phase, scaled per axis by amplitude
+    void Update(float time, const glm::vec3 &amplitude, float speed)
+    {
+        for (unsigned int i = 0; i < Positions.size(); i++)
+        {
+            float phase = time * speed + i * 0.37f;
+            Positions[i] = basePositions[i] + glm::vec3(std::sin(phase), std::sin(phase * 1.3f), std::cos(phase)) * amplitude;
+        }
+    }
+
+private:
+    Philox random;
+    std::vector<glm::vec3> basePositions;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// number of queries in flight per timer; results are read this many frames late so the CPU never waits for them
+#define GPU_TIMER_QUERIES 4
+
+// GPU time of one pass per frame, measured with GL_TIME_ELAPSED queries (core since 3.3). Time elapsed queries can't
+// be nested, so timed passes must not overlap.
+//   timer.Begin(); ... draw the pass ... timer.End();
+//   float ms = timer.GetMilliseconds();
+class GpuTimer
+{
+public:
+    GpuTimer()
+    {
+        glGenQueries(GPU_TIMER_QUERIES, queries);
+    }
+
+    void Begin()
+    {
+        glBeginQuery(GL_TIME_ELAPSED, queries[frame % GPU_TIMER_QUERIES]);
+    }
+    void End()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        frame++;
+        // the next query to be reused is the oldest one in flight
+        if (frame < GPU_TIMER_QUERIES)
+            return;
+        unsigned int oldest = queries[frame % GPU_TIMER_QUERIES];
+        GLint available = 0;
+        glGetQueryObjectiv(oldest, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(oldest, GL_QUERY_RESULT, &nanoseconds);
+        // smooth over a few frames so the number is readable
+        float sample = static_cast<float>(nanoseconds) / 1000000.0f;
+        milliseconds = milliseconds == 0.0f ? sample : milliseconds * 0.9f + sample * 0.1f;
+    }
+
+    float GetMilliseconds() const
+    {
+        return milliseconds;
+    }
+
+private:
+    unsigned int queries[GPU_TIMER_QUERIES];
+    unsigned int frame = 0;
+    float milliseconds = 0.0f;
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#include <immintrin.h>
+#define HALF_FLOAT_F16C 1
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// IEEE 754 binary16 conversions for texel data that is uploaded or read back as GL_HALF_FLOAT. The scalar versions
+// round to nearest even like the hardware does (after Fabian Giesen's float_to_half_fast3_rtne); with F16C the array
+// versions convert 8 values per instruction.
+inline uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = bits & 0x80000000u;
+    bits ^= sign;
+    uint16_t half;
+    // 65536 and above, inf and nan: all exponent bits set
+    if (bits >= 143u << 23)
+        half = bits > 0x7f800000u ? 0x7e00 : 0x7c00;
+    // below the smallest normal half: let a float add round the mantissa into place
+    else if (bits < 113u << 23)
+    {
+        const uint32_t magicBits = 126u << 23;
+        float magic, shifted;
+        std::memcpy(&magic, &magicBits, sizeof(magic));
+        std::memcpy(&shifted, &bits, sizeof(shifted));
+        shifted += magic;
+        std::memcpy(&bits, &shifted, sizeof(bits));
+        half = static_cast<uint16_t>(bits - magicBits);
+    }
+    else
+    {
+        uint32_t odd = (bits >> 13) & 1u;
+        // rebias the exponent from 127 to 15 and round to nearest even
+        bits += (static_cast<uint32_t>(15 - 127) << 23) + 0xfffu + odd;
+        half = static_cast<uint16_t>(bits >> 13);
+    }
+    return static_cast<uint16_t>(half | (sign >> 16));
+}
+
+inline float HalfToFloat(uint16_t half)
+{
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1fu;
+    uint32_t mantissa = half & 0x3ffu;
+    uint32_t bits;
+    if (exponent == 0)
+    {
+        // zero or denormal: mantissa * 2^-24
+        float value = mantissa * (1.0f / 16777216.0f);
+        std::memcpy(&bits, &value, sizeof(bits));
+        bits |= sign;
+    }
+    else if (exponent == 31)
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    else
+        bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline void FloatsToHalves(const float *in, uint16_t *out, size_t count)
+{
+    size_t i = 0;
+#if defined(HALF_FLOAT_F16C)
+    for (; i + 8 <= count; i += 8)
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+#endif
+    for (; i < count; i++)
+        out[i] = FloatToHalf(in[i]);
+}
+
+inline void HalvesToFloats(const uint16_t *in, float *out, size_t count)
+{
+    size_t i = 0;
+#if defined(HALF_FLOAT_F16C)
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i))));
+#endif
+    for (; i < count; i++)
+        out[i] = HalfToFloat(in[i]);
+}
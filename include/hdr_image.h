@@ -0,0 +1,289 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "half_float.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// what HdrImage turns the RGBE texels into
+enum HdrFormat
+{
+    // 3 floats, for the CPU
+    HDR_FLOAT,
+    // 3 half floats, uploaded to GL_RGB16F as GL_HALF_FLOAT
+    HDR_HALF_FLOAT,
+    // one 32 bit word, uploaded to GL_RGB9_E5 as GL_UNSIGNED_INT_5_9_9_9_REV; RGBE's 8 bit mantissas and shared exponent
+    // fit without loss in the range it covers
+    HDR_RGB9_E5
+};
+
+// Radiance .hdr (32-bit_rle_rgbe) loader that decodes straight to the format the texture is created with, so the driver
+// doesn't convert on upload and no full float copy of the image is ever made:
+//   HdrImage image; if (image.Load(path, HDR_HALF_FLOAT, &jobs)) hdrTexture = image.CreateTexture();
+// The file is read whole in one go. Run length encoded scanlines have no fixed size, so one pass over the run headers
+// finds where each starts, then the scanlines are decoded and converted on the job system. With AVX2 the RGB9E5
+// conversion packs 8 texels at a time; half floats are converted 8 at a time with F16C.
+class HdrImage
+{
+public:
+    int Width = 0;
+    int Height = 0;
+    HdrFormat Format = HDR_HALF_FLOAT;
+    // Width x Height texels of GetTexelSize() bytes, rows bottom to top when loaded with flipVertically like
+    // stbi_set_flip_vertically_on_load(true)
+    std::vector<unsigned char> Pixels;
+
+    bool Load(const std::string &path, HdrFormat format, JobSystem *jobs = nullptr, bool flipVertically = true)
+    {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in)
+        {
+            std::cout << "HDR image: can't read " << path << std::endl;
+            return false;
+        }
+        std::vector<unsigned char> file(static_cast<size_t>(in.tellg()));
+        in.seekg(0);
+        if (!in.read(reinterpret_cast<char *>(file.data()), file.size()))
+        {
+            std::cout << "HDR image: can't read " << path << std::endl;
+            return false;
+        }
+        const unsigned char *p = file.data(), *end = file.data() + file.size();
+        int width, height;
+        if (!parseHeader(p, end, width, height))
+        {
+            std::cout << "HDR image: " << path << " is not a -Y +X 32-bit_rle_rgbe Radiance file" << std::endl;
+            return false;
+        }
+        std::vector<const unsigned char *> scanlines(height);
+        for (int y = 0; y < height && p; y++)
+        {
+            scanlines[y] = p;
+            p = skipScanline(p, end, width);
+        }
+        if (!p)
+        {
+            std::cout << "HDR image: " << path << " is damaged" << std::endl;
+            return false;
+        }
+
+        Width = width;
+        Height = height;
+        Format = format;
+        Pixels.resize(static_cast<size_t>(width) * height * GetTexelSize());
+        // 2^(e - 136): the exponent is biased by 128 and the mantissas are 8 bit fractions
+        float scales[256];
+        scales[0] = 0.0f;
+        for (int e = 1; e < 256; e++)
+            scales[e] = std::ldexp(1.0f, e - 136);
+        auto decodeRows = [&](unsigned int begin, unsigned int stop)
+        {
+            std::vector<unsigned char> rgbe(static_cast<size_t>(width) * 4);
+            std::vector<float> floats(format == HDR_HALF_FLOAT ? static_cast<size_t>(width) * 3 : 0);
+            for (unsigned int row = begin; row < stop; row++)
+            {
+                decodeScanline(scanlines[row], end, width, rgbe.data());
+                size_t target = flipVertically ? height - 1 - row : row;
+                unsigned char *out = &Pixels[target * width * GetTexelSize()];
+                if (format == HDR_RGB9_E5)
+                    toRgb9e5(rgbe.data(), width, reinterpret_cast<uint32_t *>(out));
+                else if (format == HDR_HALF_FLOAT)
+                {
+                    toFloats(rgbe.data(), width, scales, floats.data());
+                    FloatsToHalves(floats.data(), reinterpret_cast<uint16_t *>(out), floats.size());
+                }
+                else
+                    toFloats(rgbe.data(), width, scales, reinterpret_cast<float *>(out));
+            }
+        };
+        if (jobs)
+            jobs->ParallelFor(0, height, 16, decodeRows);
+        else
+            decodeRows(0, height);
+        return true;
+    }
+
+    unsigned int GetTexelSize() const
+    {
+        return Format == HDR_FLOAT ? 12u : Format == HDR_HALF_FLOAT ? 6u : 4u;
+    }
+
+    // the texels of an HDR_FLOAT image
+    const float *GetFloats() const
+    {
+        return reinterpret_cast<const float *>(Pixels.data());
+    }
+
+    // a clamped, linearly filtered 2D texture without mips, the way the IBL samples sample the panorama
+    unsigned int CreateTexture() const
+    {
+        GLenum internalFormat = Format == HDR_FLOAT ? GL_RGB32F : Format == HDR_HALF_FLOAT ? GL_RGB16F : GL_RGB9_E5;
+        GLenum type = Format == HDR_FLOAT ? GL_FLOAT : Format == HDR_HALF_FLOAT ? GL_HALF_FLOAT : GL_UNSIGNED_INT_5_9_9_9_REV;
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        // rows of half floats are only 2 byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, Width, Height, 0, GL_RGB, type, Pixels.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texture;
+    }
+
+private:
+    // reads the line at p up to (not including) its newline and moves p past it
+    static bool readLine(const unsigned char *&p, const unsigned char *end, std::string &line)
+    {
+        const unsigned char *newline = std::find(p, end, static_cast<unsigned char>('\n'));
+        if (newline == end)
+            return false;
+        line.assign(reinterpret_cast<const char *>(p), newline - p);
+        p = newline + 1;
+        return true;
+    }
+
+    // the "#?" magic, header lines up to an empty one and the resolution; leaves p at the first scanline
+    static bool parseHeader(const unsigned char *&p, const unsigned char *end, int &width, int &height)
+    {
+        std::string line;
+        if (!readLine(p, end, line) || line.compare(0, 2, "#?") != 0)
+            return false;
+        while (readLine(p, end, line) && !line.empty())
+            if (line.compare(0, 7, "FORMAT=") == 0 && line != "FORMAT=32-bit_rle_rgbe")
+                return false;
+        // only the standard orientation, top row first
+        char yAxis[3], xAxis[3];
+        return readLine(p, end, line) && std::sscanf(line.c_str(), "%2s %d %2s %d", yAxis, &height, xAxis, &width) == 4 &&
+               std::strcmp(yAxis, "-Y") == 0 && std::strcmp(xAxis, "+X") == 0 && width > 0 && height > 0 && width < 65536 && height < 65536;
+    }
+
+    // new style run length encoding: 2, 2, width, then every channel separately as runs and literal spans
+    static bool isRunLength(const unsigned char *p, const unsigned char *end, int width)
+    {
+        return width >= 8 && width < 32768 && end - p >= 4 && p[0] == 2 && p[1] == 2 && ((p[2] << 8) | p[3]) == width;
+    }
+
+    // the start of the next scanline, nullptr if this one runs past the end of the file or is malformed
+    static const unsigned char *skipScanline(const unsigned char *p, const unsigned char *end, int width)
+    {
+        if (!isRunLength(p, end, width))
+            return end - p >= 4 * width ? p + 4 * width : nullptr;
+        p += 4;
+        for (int c = 0; c < 4; c++)
+            for (int x = 0; x < width;)
+            {
+                if (p >= end)
+                    return nullptr;
+                int count = *p++;
+                if (count > 128)
+                {
+                    count -= 128;
+                    p++;
+                }
+                else
+                    p += count;
+                if (count == 0 || x + count > width || p > end)
+                    return nullptr;
+                x += count;
+            }
+        return p;
+    }
+
+    // only called on scanlines skipScanline accepted
+    static void decodeScanline(const unsigned char *p, const unsigned char *end, int width, unsigned char *rgbe)
+    {
+        if (!isRunLength(p, end, width))
+        {
+            std::memcpy(rgbe, p, static_cast<size_t>(width) * 4);
+            return;
+        }
+        p += 4;
+        for (int c = 0; c < 4; c++)
+            for (int x = 0; x < width;)
+            {
+                int count = *p++;
+                if (count > 128)
+                {
+                    count -= 128;
+                    unsigned char value = *p++;
+                    for (int i = 0; i < count; i++)
+                        rgbe[(x + i) * 4 + c] = value;
+                }
+                else
+                    for (int i = 0; i < count; i++)
+                        rgbe[(x + i) * 4 + c] = *p++;
+                x += count;
+            }
+    }
+
+    static void toFloats(const unsigned char *rgbe, int width, const float scales[256], float *out)
+    {
+        for (int x = 0; x < width; x++, rgbe += 4, out += 3)
+        {
+            float scale = scales[rgbe[3]];
+            out[0] = rgbe[0] * scale;
+            out[1] = rgbe[1] * scale;
+            out[2] = rgbe[2] * scale;
+        }
+    }
+
+    // m * 2^(e - 136) == 2m * 2^((e - 113) - 24): doubled mantissas and the exponent rebiased from 128 to 15. Below
+    // the exponent range the mantissas are shifted down instead; above it they are shifted up and every channel
+    // saturates on its own at 511 * 2^7.
+    static void toRgb9e5(const unsigned char *rgbe, int width, uint32_t *out)
+    {
+        int x = 0;
+#if defined(__AVX2__)
+        const __m256i byteMask = _mm256_set1_epi32(0xff), zero = _mm256_setzero_si256();
+        const __m256i bias = _mm256_set1_epi32(113), maxExponent = _mm256_set1_epi32(31), maxMantissa = _mm256_set1_epi32(511);
+        const __m256i maxUpShift = _mm256_set1_epi32(9);
+        for (; x + 8 <= width; x += 8)
+        {
+            __m256i texels = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rgbe + x * 4));
+            __m256i exponent = _mm256_sub_epi32(_mm256_srli_epi32(texels, 24), bias);
+            // shifts of 32 or more give 0, which is what a zero exponent byte needs
+            __m256i downShift = _mm256_max_epi32(_mm256_sub_epi32(zero, exponent), zero);
+            __m256i upShift = _mm256_min_epi32(_mm256_max_epi32(_mm256_sub_epi32(exponent, maxExponent), zero), maxUpShift);
+            __m256i packed = _mm256_slli_epi32(_mm256_min_epi32(_mm256_max_epi32(exponent, zero), maxExponent), 27);
+            for (int c = 0; c < 3; c++)
+            {
+                __m256i mantissa = _mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(texels, 8 * c), byteMask), 1);
+                mantissa = _mm256_min_epi32(_mm256_sllv_epi32(_mm256_srlv_epi32(mantissa, downShift), upShift), maxMantissa);
+                packed = _mm256_or_si256(packed, _mm256_slli_epi32(mantissa, 9 * c));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + x), packed);
+        }
+#endif
+        for (; x < width; x++)
+        {
+            const unsigned char *texel = rgbe + x * 4;
+            int exponent = texel[3] - 113;
+            int downShift = std::max(-exponent, 0), upShift = std::min(std::max(exponent - 31, 0), 9);
+            uint32_t packed = static_cast<uint32_t>(std::min(std::max(exponent, 0), 31)) << 27;
+            for (int c = 0; c < 3; c++)
+            {
+                uint32_t mantissa = downShift < 32 ? (texel[c] * 2u) >> downShift : 0u;
+                packed |= std::min(mantissa << upShift, 511u) << (9 * c);
+            }
+            out[x] = packed;
+        }
+    }
+};
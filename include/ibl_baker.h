@@ -0,0 +1,464 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "half_float.h"
+#include "ibl_cache.h"
+#include "job_system.h"
+#include "spherical_harmonics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// importance samples per texel, SAMPLE_COUNT in prefilter.fs and brdf.fs
+#define IBL_BAKER_SAMPLE_COUNT 1024
+
+// The specular IBL capture passes on the CPU, for baking an environment where there is no GPU, e.g. on a build
+// machine. Every pass computes what its shader does, so the result matches the GL bake up to half float rounding and
+// filtering at the cube edges:
+//   CaptureEnvironment  equirectangular_to_cubemap.fs, bilinear, then a 2x2 box filtered mip chain like glGenerateMipmap
+//   ProjectIrradiance   SphericalHarmonics::Project of the IrradianceSourceLevel mip
+//   PrefilterEnvironment prefilter.fs: GGX importance sampling, every sample read from the environment mip its pdf
+//                       selects; levels past PrefilterMips are box filtered from the last one
+//   IntegrateBrdf       brdf.fs
+// The sample directions, weights and mip levels only depend on the roughness, so they are generated once per level and
+// only rotated into every texel's frame. Rows are spread over the job system; with AVX2 the rotation and cube face
+// selection of the prefilter and all of the BRDF integration run 8 samples at a time.
+//   IblBaker baker(cache, jobs); baker.CaptureEnvironment(hdr, width, height, channels); ...
+//   cache.Save(baker.GetEnvironment(), baker.Irradiance, baker.GetPrefilter(), baker.GetBrdfLUT());
+class IblBaker
+{
+public:
+    // RGB texels of every mip level, the six faces in cube map face order, each face's rows bottom to top
+    std::vector<std::vector<float>> Environment;
+    SphericalHarmonics Irradiance;
+    std::vector<std::vector<float>> Prefilter;
+    // RG, rows bottom to top: x is NdotV, y is the roughness
+    std::vector<float> BrdfLUT;
+
+    // takes the bake sizes from the cache the result is meant for
+    IblBaker(const IblCache &cache, JobSystem &jobs)
+        : environmentSize(cache.EnvironmentSize), irradianceSourceLevel(cache.IrradianceSourceLevel),
+          prefilterSize(cache.PrefilterSize), prefilterMips(cache.PrefilterMips), brdfSize(cache.BrdfSize), jobs(jobs)
+    {
+    }
+
+    // equirect holds width x height texels of channels floats, rows bottom to top (HdrImage::Load with flipVertically)
+    void CaptureEnvironment(const float *equirect, int width, int height, int channels)
+    {
+        Environment.assign(1, std::vector<float>(6 * 3 * environmentSize * environmentSize));
+        const unsigned int size = environmentSize;
+        jobs.ParallelFor(0, 6 * size, 8, [&](unsigned int begin, unsigned int end)
+                         {
+            for (unsigned int row = begin; row < end; row++)
+            {
+                unsigned int face = row / size, y = row % size;
+                float t = (y + 0.5f) / size * 2.0f - 1.0f;
+                float *texel = &Environment[0][(face * size + y) * size * 3];
+                for (unsigned int x = 0; x < size; x++, texel += 3)
+                {
+                    float s = (x + 0.5f) / size * 2.0f - 1.0f;
+                    glm::vec3 v = glm::normalize(SphericalHarmonics::FaceAxis(face, 0) + s * SphericalHarmonics::FaceAxis(face, 1) + t * SphericalHarmonics::FaceAxis(face, 2));
+                    // SampleSphericalMap, with the shader's constants
+                    float u = std::atan2(v.z, v.x) * 0.1591f + 0.5f;
+                    float w = std::asin(v.y) * 0.3183f + 0.5f;
+                    sampleBilinear(equirect, width, height, channels, u, w, texel);
+                }
+            } });
+        buildMips(Environment, size, 0);
+    }
+
+    void ProjectIrradiance()
+    {
+        unsigned int level = std::min(irradianceSourceLevel, static_cast<unsigned int>(Environment.size()) - 1);
+        unsigned int size = std::max(environmentSize >> level, 1u);
+        // Project wants every face as a red, a green and a blue plane
+        std::vector<float> planes(Environment[level].size());
+        for (unsigned int face = 0; face < 6; face++)
+            for (unsigned int i = 0; i < size * size; i++)
+                for (unsigned int c = 0; c < 3; c++)
+                    planes[(face * 3 + c) * size * size + i] = Environment[level][(face * size * size + i) * 3 + c];
+        Irradiance.Project(planes.data(), size, &jobs);
+    }
+
+    void PrefilterEnvironment()
+    {
+        Prefilter.assign(1, std::vector<float>());
+        for (unsigned int mip = 0; mip < prefilterMips; mip++)
+        {
+            const unsigned int size = std::max(prefilterSize >> mip, 1u);
+            if (mip > 0)
+                Prefilter.push_back(std::vector<float>());
+            Prefilter[mip].resize(6 * 3 * size * size);
+            float roughness = prefilterMips > 1 ? static_cast<float>(mip) / (prefilterMips - 1) : 0.0f;
+            PrefilterSamples samples = generatePrefilterSamples(roughness);
+            jobs.ParallelFor(0, 6 * size, 1, [&](unsigned int begin, unsigned int end)
+                             {
+                for (unsigned int row = begin; row < end; row++)
+                {
+                    unsigned int face = row / size, y = row % size;
+                    float t = (y + 0.5f) / size * 2.0f - 1.0f;
+                    float *texel = &Prefilter[mip][(face * size + y) * size * 3];
+                    for (unsigned int x = 0; x < size; x++, texel += 3)
+                    {
+                        float s = (x + 0.5f) / size * 2.0f - 1.0f;
+                        glm::vec3 n = glm::normalize(SphericalHarmonics::FaceAxis(face, 0) + s * SphericalHarmonics::FaceAxis(face, 1) + t * SphericalHarmonics::FaceAxis(face, 2));
+                        glm::vec3 color = prefilterTexel(samples, n);
+                        texel[0] = color.x;
+                        texel[1] = color.y;
+                        texel[2] = color.z;
+                    }
+                } });
+        }
+        // the GL bake never renders these levels, they only complete the mip chain
+        buildMips(Prefilter, prefilterSize, prefilterMips - 1);
+    }
+
+    void IntegrateBrdf()
+    {
+        const unsigned int size = brdfSize;
+        BrdfLUT.resize(2 * size * size);
+        // Hammersley points, the sample's phi only matters through the x of its halfway vector in tangent space
+        std::vector<float> xiY(IBL_BAKER_SAMPLE_COUNT), sinPhi(IBL_BAKER_SAMPLE_COUNT);
+        for (unsigned int i = 0; i < IBL_BAKER_SAMPLE_COUNT; i++)
+        {
+            xiY[i] = radicalInverse(i);
+            sinPhi[i] = std::sin(2.0f * PI * i / IBL_BAKER_SAMPLE_COUNT);
+        }
+        jobs.ParallelFor(0, size, 4, [&](unsigned int begin, unsigned int end)
+                         {
+            for (unsigned int y = begin; y < end; y++)
+                for (unsigned int x = 0; x < size; x++)
+                    integrateBrdfTexel((x + 0.5f) / size, (y + 0.5f) / size, xiY.data(), sinPhi.data(), &BrdfLUT[(y * size + x) * 2]); });
+    }
+
+    // the results as the half float textures the cache stores
+    IblTexture GetEnvironment() const
+    {
+        return pack(Environment, true, 3, environmentSize);
+    }
+    IblTexture GetPrefilter() const
+    {
+        return pack(Prefilter, true, 3, prefilterSize);
+    }
+    IblTexture GetBrdfLUT() const
+    {
+        return pack(std::vector<std::vector<float>>(1, BrdfLUT), false, 2, brdfSize);
+    }
+
+private:
+    // importance samples of one roughness in the tangent frame of the normal, padded with zero weights to a multiple
+    // of 8. Only samples above the horizon are kept; their cosine is the weight.
+    struct PrefilterSamples
+    {
+        std::vector<float> X, Y, Z;
+        std::vector<float> Weight;
+        std::vector<float> Lod;
+    };
+
+    static constexpr float PI = 3.14159265359f;
+
+    unsigned int environmentSize;
+    unsigned int irradianceSourceLevel;
+    unsigned int prefilterSize;
+    unsigned int prefilterMips;
+    unsigned int brdfSize;
+    JobSystem &jobs;
+
+    // RadicalInverse_VdC
+    static float radicalInverse(uint32_t bits)
+    {
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return static_cast<float>(bits) * 2.3283064365386963e-10f;
+    }
+
+    // GL_LINEAR with GL_CLAMP_TO_EDGE at (u, v) in [0, 1]
+    static void sampleBilinear(const float *image, int width, int height, int channels, float u, float v, float *out)
+    {
+        float x = u * width - 0.5f, y = v * height - 0.5f;
+        float x0f = std::floor(x), y0f = std::floor(y);
+        float fx = x - x0f, fy = y - y0f;
+        int x0 = std::min(std::max(static_cast<int>(x0f), 0), width - 1), x1 = std::min(std::max(static_cast<int>(x0f) + 1, 0), width - 1);
+        int y0 = std::min(std::max(static_cast<int>(y0f), 0), height - 1), y1 = std::min(std::max(static_cast<int>(y0f) + 1, 0), height - 1);
+        const float *p00 = image + (static_cast<size_t>(y0) * width + x0) * channels, *p10 = image + (static_cast<size_t>(y0) * width + x1) * channels;
+        const float *p01 = image + (static_cast<size_t>(y1) * width + x0) * channels, *p11 = image + (static_cast<size_t>(y1) * width + x1) * channels;
+        for (int c = 0; c < 3; c++)
+        {
+            int i = std::min(c, channels - 1);
+            float bottom = p00[i] + (p10[i] - p00[i]) * fx;
+            float top = p01[i] + (p11[i] - p01[i]) * fx;
+            out[c] = bottom + (top - bottom) * fy;
+        }
+    }
+
+    // fills levels past first with 2x2 box filtered copies down to 1x1
+    static void buildMips(std::vector<std::vector<float>> &levels, unsigned int size, unsigned int first)
+    {
+        levels.resize(first + 1);
+        unsigned int sourceSize = std::max(size >> first, 1u);
+        while (sourceSize > 1)
+        {
+            unsigned int targetSize = sourceSize / 2;
+            const std::vector<float> &source = levels.back();
+            std::vector<float> target(6 * 3 * targetSize * targetSize);
+            for (unsigned int face = 0; face < 6; face++)
+                for (unsigned int y = 0; y < targetSize; y++)
+                    for (unsigned int x = 0; x < targetSize; x++)
+                        for (unsigned int c = 0; c < 3; c++)
+                        {
+                            const float *row0 = &source[((face * sourceSize + 2 * y) * sourceSize + 2 * x) * 3 + c];
+                            const float *row1 = row0 + sourceSize * 3;
+                            target[((face * targetSize + y) * targetSize + x) * 3 + c] = 0.25f * (row0[0] + row0[3] + row1[0] + row1[3]);
+                        }
+            levels.push_back(std::move(target));
+            sourceSize = targetSize;
+        }
+    }
+
+    // the face and [0, 1] coordinates a direction hits, by the major axis rules of the GL spec
+    static void cubeCoordinates(float x, float y, float z, unsigned int &face, float &s, float &t)
+    {
+        float ax = std::fabs(x), ay = std::fabs(y), az = std::fabs(z);
+        float major, sc, tc;
+        if (ax >= ay && ax >= az)
+        {
+            face = x > 0.0f ? 0 : 1;
+            major = ax;
+            sc = x > 0.0f ? -z : z;
+            tc = -y;
+        }
+        else if (ay >= az)
+        {
+            face = y > 0.0f ? 2 : 3;
+            major = ay;
+            sc = x;
+            tc = y > 0.0f ? z : -z;
+        }
+        else
+        {
+            face = z > 0.0f ? 4 : 5;
+            major = az;
+            sc = z > 0.0f ? x : -x;
+            tc = -y;
+        }
+        s = 0.5f * (sc / major + 1.0f);
+        t = 0.5f * (tc / major + 1.0f);
+    }
+
+    // textureLod on the environment: bilinear within a face (clamped to its edges) and linear between mips
+    glm::vec3 sampleEnvironment(unsigned int face, float s, float t, float lod) const
+    {
+        lod = std::min(std::max(lod, 0.0f), static_cast<float>(Environment.size() - 1));
+        unsigned int level = static_cast<unsigned int>(lod);
+        float blend = lod - level;
+        glm::vec3 color = sampleFace(level, face, s, t);
+        if (blend > 0.0f && level + 1 < Environment.size())
+            color += (sampleFace(level + 1, face, s, t) - color) * blend;
+        return color;
+    }
+
+    glm::vec3 sampleFace(unsigned int level, unsigned int face, float s, float t) const
+    {
+        int size = static_cast<int>(std::max(environmentSize >> level, 1u));
+        glm::vec3 color;
+        sampleBilinear(&Environment[level][static_cast<size_t>(face) * size * size * 3], size, size, 3, s, t, &color.x);
+        return color;
+    }
+
+    PrefilterSamples generatePrefilterSamples(float roughness) const
+    {
+        PrefilterSamples samples;
+        // a perfect mirror reads the environment once, all of the shader's samples are the normal
+        unsigned int count = roughness == 0.0f ? 1u : IBL_BAKER_SAMPLE_COUNT;
+        float a = roughness * roughness;
+        float a2 = a * a;
+        float saTexel = 4.0f * PI / (6.0f * environmentSize * environmentSize);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            float phi = 2.0f * PI * i / IBL_BAKER_SAMPLE_COUNT;
+            float xiY = radicalInverse(i);
+            float cosTheta = std::sqrt((1.0f - xiY) / (1.0f + (a2 - 1.0f) * xiY));
+            float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+            // H in tangent space; V = N = (0, 0, 1), so L = 2 * H.z * H - N
+            glm::vec3 h(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+            glm::vec3 l = 2.0f * h.z * h - glm::vec3(0.0f, 0.0f, 1.0f);
+            if (l.z <= 0.0f)
+                continue;
+            // DistributionGGX * NdotH / (4 * HdotV) with NdotH == HdotV
+            float denominator = h.z * h.z * (a2 - 1.0f) + 1.0f;
+            float pdf = a2 / (PI * denominator * denominator) / 4.0f + 0.0001f;
+            float saSample = 1.0f / (IBL_BAKER_SAMPLE_COUNT * pdf + 0.0001f);
+            samples.X.push_back(l.x);
+            samples.Y.push_back(l.y);
+            samples.Z.push_back(l.z);
+            samples.Weight.push_back(l.z);
+            samples.Lod.push_back(roughness == 0.0f ? 0.0f : 0.5f * std::log2(saSample / saTexel));
+        }
+        while (samples.Weight.size() % 8 != 0)
+        {
+            samples.X.push_back(0.0f);
+            samples.Y.push_back(0.0f);
+            samples.Z.push_back(1.0f);
+            samples.Weight.push_back(0.0f);
+            samples.Lod.push_back(0.0f);
+        }
+        return samples;
+    }
+
+    glm::vec3 prefilterTexel(const PrefilterSamples &samples, const glm::vec3 &n) const
+    {
+        glm::vec3 up = std::fabs(n.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+        glm::vec3 tangent = glm::normalize(glm::cross(up, n));
+        glm::vec3 bitangent = glm::cross(n, tangent);
+        glm::vec3 color(0.0f);
+        float totalWeight = 0.0f;
+        unsigned int count = static_cast<unsigned int>(samples.Weight.size());
+#if defined(__AVX2__)
+        const __m256 tx = _mm256_set1_ps(tangent.x), ty = _mm256_set1_ps(tangent.y), tz = _mm256_set1_ps(tangent.z);
+        const __m256 bx = _mm256_set1_ps(bitangent.x), by = _mm256_set1_ps(bitangent.y), bz = _mm256_set1_ps(bitangent.z);
+        const __m256 nx = _mm256_set1_ps(n.x), ny = _mm256_set1_ps(n.y), nz = _mm256_set1_ps(n.z);
+        const __m256 zero = _mm256_setzero_ps(), half = _mm256_set1_ps(0.5f), one = _mm256_set1_ps(1.0f);
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        for (unsigned int i = 0; i < count; i += 8)
+        {
+            __m256 lx = _mm256_loadu_ps(&samples.X[i]), ly = _mm256_loadu_ps(&samples.Y[i]), lz = _mm256_loadu_ps(&samples.Z[i]);
+            // tangent * L.x + bitangent * L.y + N * L.z
+            __m256 x = _mm256_fmadd_ps(tx, lx, _mm256_fmadd_ps(bx, ly, _mm256_mul_ps(nx, lz)));
+            __m256 y = _mm256_fmadd_ps(ty, lx, _mm256_fmadd_ps(by, ly, _mm256_mul_ps(ny, lz)));
+            __m256 z = _mm256_fmadd_ps(tz, lx, _mm256_fmadd_ps(bz, ly, _mm256_mul_ps(nz, lz)));
+            __m256 ax = _mm256_andnot_ps(signMask, x), ay = _mm256_andnot_ps(signMask, y), az = _mm256_andnot_ps(signMask, z);
+            __m256 xMajor = _mm256_and_ps(_mm256_cmp_ps(ax, ay, _CMP_GE_OQ), _mm256_cmp_ps(ax, az, _CMP_GE_OQ));
+            __m256 yMajor = _mm256_andnot_ps(xMajor, _mm256_cmp_ps(ay, az, _CMP_GE_OQ));
+            __m256 xPositive = _mm256_cmp_ps(x, zero, _CMP_GT_OQ), yPositive = _mm256_cmp_ps(y, zero, _CMP_GT_OQ), zPositive = _mm256_cmp_ps(z, zero, _CMP_GT_OQ);
+            __m256 major = _mm256_blendv_ps(_mm256_blendv_ps(az, ay, yMajor), ax, xMajor);
+            // z major: s = +-x, t = -y; y major: s = x, t = +-z; x major: s = -+z, t = -y
+            __m256 sc = _mm256_blendv_ps(_mm256_blendv_ps(_mm256_xor_ps(x, _mm256_andnot_ps(zPositive, signMask)), x, yMajor),
+                                         _mm256_xor_ps(z, _mm256_and_ps(xPositive, signMask)), xMajor);
+            __m256 tc = _mm256_blendv_ps(_mm256_xor_ps(y, signMask), _mm256_xor_ps(z, _mm256_andnot_ps(yPositive, signMask)), yMajor);
+            __m256 face = _mm256_blendv_ps(_mm256_blendv_ps(_mm256_set1_ps(5.0f), _mm256_set1_ps(3.0f), yMajor), _mm256_set1_ps(1.0f), xMajor);
+            // the positive face of every axis is the one before the negative
+            face = _mm256_sub_ps(face, _mm256_and_ps(_mm256_blendv_ps(_mm256_blendv_ps(zPositive, yPositive, yMajor), xPositive, xMajor), one));
+            __m256 invMajor = _mm256_div_ps(half, major);
+            alignas(32) float s[8], t[8], faces[8];
+            _mm256_store_ps(s, _mm256_fmadd_ps(sc, invMajor, half));
+            _mm256_store_ps(t, _mm256_fmadd_ps(tc, invMajor, half));
+            _mm256_store_ps(faces, face);
+            for (unsigned int lane = 0; lane < 8; lane++)
+            {
+                float weight = samples.Weight[i + lane];
+                if (weight <= 0.0f)
+                    continue;
+                color += sampleEnvironment(static_cast<unsigned int>(faces[lane]), s[lane], t[lane], samples.Lod[i + lane]) * weight;
+                totalWeight += weight;
+            }
+        }
+#else
+        for (unsigned int i = 0; i < count; i++)
+        {
+            float weight = samples.Weight[i];
+            if (weight <= 0.0f)
+                continue;
+            glm::vec3 l = tangent * samples.X[i] + bitangent * samples.Y[i] + n * samples.Z[i];
+            unsigned int face;
+            float s, t;
+            cubeCoordinates(l.x, l.y, l.z, face, s, t);
+            color += sampleEnvironment(face, s, t, samples.Lod[i]) * weight;
+            totalWeight += weight;
+        }
+#endif
+        return color / totalWeight;
+    }
+
+    // IntegrateBRDF for one texel. The shader's tangent frame for N = (0, 0, 1) turns the sample's tangent space H
+    // (cos phi, sin phi) * sinTheta into (sin phi, -cos phi) * sinTheta, and V lies in the xz plane, so only H.x and
+    // H.z matter.
+    static void integrateBrdfTexel(float NdotV, float roughness, const float *xiY, const float *sinPhi, float out[2])
+    {
+        float a = roughness * roughness;
+        float a2 = a * a;
+        float k = a / 2.0f;
+        float vx = std::sqrt(1.0f - NdotV * NdotV), vz = NdotV;
+        float ggxV = NdotV / (NdotV * (1.0f - k) + k);
+        float A = 0.0f, B = 0.0f;
+        unsigned int i = 0;
+#if defined(__AVX2__)
+        const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f);
+        const __m256 a2m1 = _mm256_set1_ps(a2 - 1.0f), kk = _mm256_set1_ps(k), oneMinusK = _mm256_set1_ps(1.0f - k);
+        const __m256 Vx = _mm256_set1_ps(vx), Vz = _mm256_set1_ps(vz), ggxVOverNdotV = _mm256_set1_ps(ggxV / NdotV);
+        __m256 sumA = zero, sumB = zero;
+        for (; i + 8 <= IBL_BAKER_SAMPLE_COUNT; i += 8)
+        {
+            __m256 y = _mm256_loadu_ps(xiY + i);
+            __m256 cosTheta = _mm256_sqrt_ps(_mm256_div_ps(_mm256_sub_ps(one, y), _mm256_fmadd_ps(a2m1, y, one)));
+            __m256 sinTheta = _mm256_sqrt_ps(_mm256_max_ps(_mm256_fnmadd_ps(cosTheta, cosTheta, one), zero));
+            __m256 hx = _mm256_mul_ps(_mm256_loadu_ps(sinPhi + i), sinTheta), hz = cosTheta;
+            __m256 VdotH = _mm256_fmadd_ps(Vx, hx, _mm256_mul_ps(Vz, hz));
+            __m256 NdotL = _mm256_fmsub_ps(_mm256_mul_ps(two, VdotH), hz, Vz);
+            __m256 mask = _mm256_cmp_ps(NdotL, zero, _CMP_GT_OQ);
+            VdotH = _mm256_max_ps(VdotH, zero);
+            __m256 NdotH = _mm256_max_ps(hz, zero);
+            __m256 ggxL = _mm256_div_ps(NdotL, _mm256_fmadd_ps(NdotL, oneMinusK, kk));
+            // G * VdotH / (NdotH * NdotV)
+            __m256 GVis = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(ggxL, ggxVOverNdotV), VdotH), NdotH);
+            GVis = _mm256_and_ps(GVis, mask);
+            __m256 f = _mm256_sub_ps(one, VdotH);
+            __m256 f2 = _mm256_mul_ps(f, f);
+            __m256 Fc = _mm256_mul_ps(_mm256_mul_ps(f2, f2), f);
+            sumA = _mm256_fmadd_ps(_mm256_sub_ps(one, Fc), GVis, sumA);
+            sumB = _mm256_fmadd_ps(Fc, GVis, sumB);
+        }
+        alignas(32) float lanesA[8], lanesB[8];
+        _mm256_store_ps(lanesA, sumA);
+        _mm256_store_ps(lanesB, sumB);
+        for (unsigned int lane = 0; lane < 8; lane++)
+        {
+            A += lanesA[lane];
+            B += lanesB[lane];
+        }
+#endif
+        for (; i < IBL_BAKER_SAMPLE_COUNT; i++)
+        {
+            float cosTheta = std::sqrt((1.0f - xiY[i]) / (1.0f + (a2 - 1.0f) * xiY[i]));
+            float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+            float hx = sinPhi[i] * sinTheta, hz = cosTheta;
+            float VdotH = vx * hx + vz * hz;
+            float NdotL = 2.0f * VdotH * hz - vz;
+            if (NdotL <= 0.0f)
+                continue;
+            VdotH = std::max(VdotH, 0.0f);
+            float NdotH = std::max(hz, 0.0f);
+            float G = ggxV * NdotL / (NdotL * (1.0f - k) + k);
+            float GVis = G * VdotH / (NdotH * NdotV);
+            float f = 1.0f - VdotH;
+            float Fc = f * f * f * f * f;
+            A += (1.0f - Fc) * GVis;
+            B += Fc * GVis;
+        }
+        out[0] = A / IBL_BAKER_SAMPLE_COUNT;
+        out[1] = B / IBL_BAKER_SAMPLE_COUNT;
+    }
+
+    static IblTexture pack(const std::vector<std::vector<float>> &levels, bool cube, unsigned int channels, unsigned int size)
+    {
+        IblTexture texture;
+        texture.Cube = cube;
+        texture.Channels = channels;
+        texture.Size = size;
+        texture.Levels = static_cast<unsigned int>(levels.size());
+        texture.Texels.resize(texture.GetTexelCount());
+        // the faces of a level are contiguous in both layouts
+        for (unsigned int level = 0; level < texture.Levels; level++)
+            FloatsToHalves(levels[level].data(), texture.GetFace(level, 0), levels[level].size());
+        return texture;
+    }
+};
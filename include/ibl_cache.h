@@ -0,0 +1,321 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "spherical_harmonics.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// "IBLC"
+#define IBL_CACHE_MAGIC 0x434c4249u
+// bump when the bake changes in a way the hashed shaders and sizes don't show
+#define IBL_CACHE_VERSION 3
+
+// what baked a cache file: the GL passes of a sample or a tool such as IBL_Baker
+enum IblOrigin
+{
+    IBL_ORIGIN_GPU,
+    IBL_ORIGIN_CPU
+};
+
+// one baked texture as the cache stores it: every level's faces, largest level first, in cube map face order, each
+// face's rows bottom to top as half floats
+struct IblTexture
+{
+    bool Cube = false;
+    unsigned int Channels = 0;
+    unsigned int Size = 0;
+    unsigned int Levels = 0;
+    std::vector<uint16_t> Texels;
+
+    unsigned int GetFaceCount() const
+    {
+        return Cube ? 6u : 1u;
+    }
+    unsigned int GetLevelSize(unsigned int level) const
+    {
+        return std::max(Size >> level, 1u);
+    }
+    size_t GetTexelCount() const
+    {
+        size_t count = 0;
+        for (unsigned int level = 0; level < Levels; level++)
+            count += static_cast<size_t>(GetLevelSize(level)) * GetLevelSize(level) * Channels * GetFaceCount();
+        return count;
+    }
+    // the first half float of a face of a level
+    uint16_t *GetFace(unsigned int level, unsigned int face)
+    {
+        return Texels.data() + getOffset(level, face);
+    }
+    const uint16_t *GetFace(unsigned int level, unsigned int face) const
+    {
+        return Texels.data() + getOffset(level, face);
+    }
+
+    static unsigned int GetFullMipCount(unsigned int size)
+    {
+        unsigned int levels = 1;
+        while (size > 1)
+        {
+            size /= 2;
+            levels++;
+        }
+        return levels;
+    }
+
+private:
+    size_t getOffset(unsigned int level, unsigned int face) const
+    {
+        size_t offset = 0;
+        for (unsigned int i = 0; i < level; i++)
+            offset += static_cast<size_t>(GetLevelSize(i)) * GetLevelSize(i) * Channels * GetFaceCount();
+        return offset + static_cast<size_t>(GetLevelSize(level)) * GetLevelSize(level) * Channels * face;
+    }
+};
+
+// Binary cache of the baked IBL data: the environment cubemap, the spherical harmonics of its irradiance, the prefiltered
+// cubemap and the BRDF LUT, every mip level of the textures stored as the half floats they hold. The file sits next to the HDR image (<hdr>.ibl)
+// and is keyed by a 64 bit FNV-1a hash of the HDR file's bytes, of the bake shaders passed to AddFile and of the bake
+// sizes, so a different environment, shader or size bakes again and overwrites it:
+//   IblCache cache(hdrPath); cache.AddFile(bakeShaderPath); ...
+//   if (!cache.Load()) { decode the HDR and bake at cache.EnvironmentSize etc.; cache.Save(env, irradianceSH, prefilter, brdf); }
+// A hit costs one file read and the texture uploads; neither the HDR decode nor any capture pass runs. Read and the
+// IblTexture overload of Save only touch the texels, so a tool without a GL context can bake the file instead.
+class IblCache
+{
+public:
+    // filled by Load
+    unsigned int EnvCubemap = 0;
+    SphericalHarmonics Irradiance;
+    unsigned int PrefilterMap = 0;
+    unsigned int BrdfLUT = 0;
+    // bake sizes, part of the key
+    unsigned int EnvironmentSize = 512;
+    // mip of the environment cubemap the irradiance is projected from, 64x64 at the default size
+    unsigned int IrradianceSourceLevel = 3;
+    unsigned int PrefilterSize = 128;
+    // prefiltered roughness levels; the texture itself has the full mip chain
+    unsigned int PrefilterMips = 5;
+    unsigned int BrdfSize = 512;
+
+    IblCache(const std::string &hdrPath) : path(hdrPath + ".ibl")
+    {
+        if (!AddFile(hdrPath))
+            std::cout << "IBL cache: can't read " << hdrPath << std::endl;
+    }
+
+    // folds the contents of a file the bake depends on into the key; false if it can't be read
+    bool AddFile(const std::string &file)
+    {
+        std::ifstream in(file, std::ios::binary);
+        if (!in)
+            return false;
+        std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        hash = fnv1a(hash, bytes.data(), bytes.size());
+        return true;
+    }
+
+    // creates the three textures and fills Irradiance from the cache file; false, with nothing created, when there is no file or it was
+    // baked from something else
+    bool Load()
+    {
+        IblTexture environment, prefilter, brdf;
+        if (!Read(environment, Irradiance, prefilter, brdf))
+            return false;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        EnvCubemap = uploadTexture(environment);
+        PrefilterMap = uploadTexture(prefilter);
+        BrdfLUT = uploadTexture(brdf);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        return true;
+    }
+
+    // the cache file's contents without creating any textures, for tools that run without a GL context; origin, if
+    // given, receives what baked the file
+    bool Read(IblTexture &environment, SphericalHarmonics &irradiance, IblTexture &prefilter, IblTexture &brdf,
+              IblOrigin *origin = nullptr) const
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
+        FileHeader header;
+        if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) || header.Magic != IBL_CACHE_MAGIC ||
+            header.Version != IBL_CACHE_VERSION || header.Key != GetKey())
+            return false;
+        float coefficients[27];
+        bool loaded = static_cast<bool>(in.read(reinterpret_cast<char *>(coefficients), sizeof(coefficients)));
+        loaded = loaded && readTexture(in, environment) && readTexture(in, prefilter) && readTexture(in, brdf);
+        if (!loaded)
+        {
+            std::cout << "IBL cache: " << path << " is damaged, baking again" << std::endl;
+            return false;
+        }
+        for (unsigned int i = 0; i < 9; i++)
+            irradiance.Coefficients[i] = glm::vec3(coefficients[i * 3], coefficients[i * 3 + 1], coefficients[i * 3 + 2]);
+        if (origin)
+            *origin = header.Origin == IBL_ORIGIN_CPU ? IBL_ORIGIN_CPU : IBL_ORIGIN_GPU;
+        return true;
+    }
+
+    // reads the baked textures back and writes them with the irradiance under the current key; the environment and
+    // prefiltered cubemaps are expected to have full mip chains
+    bool Save(unsigned int envCubemap, const SphericalHarmonics &irradiance, unsigned int prefilterMap, unsigned int brdfLUT)
+    {
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        IblTexture environment = downloadTexture(envCubemap, true, 3, EnvironmentSize, true);
+        IblTexture prefilter = downloadTexture(prefilterMap, true, 3, PrefilterSize, true);
+        IblTexture brdf = downloadTexture(brdfLUT, false, 2, BrdfSize, false);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        return Save(environment, irradiance, prefilter, brdf, IBL_ORIGIN_GPU);
+    }
+
+    // writes textures baked elsewhere, e.g. on the CPU, under the current key
+    bool Save(const IblTexture &environment, const SphericalHarmonics &irradiance, const IblTexture &prefilter, const IblTexture &brdf,
+              IblOrigin origin = IBL_ORIGIN_CPU)
+    {
+        // written aside and moved into place, so an interrupted save never leaves a file that looks valid
+        std::string temporary = path + ".tmp";
+        std::ofstream out(temporary, std::ios::binary);
+        if (!out)
+        {
+            std::cout << "IBL cache: can't write " << temporary << std::endl;
+            return false;
+        }
+        FileHeader header = {IBL_CACHE_MAGIC, IBL_CACHE_VERSION, GetKey(), static_cast<uint32_t>(origin), 0};
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        float coefficients[27];
+        for (unsigned int i = 0; i < 9; i++)
+            for (unsigned int c = 0; c < 3; c++)
+                coefficients[i * 3 + c] = irradiance.Coefficients[i][c];
+        out.write(reinterpret_cast<const char *>(coefficients), sizeof(coefficients));
+        writeTexture(out, environment);
+        writeTexture(out, prefilter);
+        writeTexture(out, brdf);
+        out.close();
+        if (!out)
+        {
+            std::remove(temporary.c_str());
+            std::cout << "IBL cache: can't write " << temporary << std::endl;
+            return false;
+        }
+        std::remove(path.c_str());
+        return std::rename(temporary.c_str(), path.c_str()) == 0;
+    }
+
+    // hash of the added files, the sizes and the cache version
+    uint64_t GetKey() const
+    {
+        uint32_t parameters[6] = {IBL_CACHE_VERSION, EnvironmentSize, IrradianceSourceLevel, PrefilterSize, PrefilterMips, BrdfSize};
+        return fnv1a(hash, parameters, sizeof(parameters));
+    }
+
+    const std::string &GetPath() const
+    {
+        return path;
+    }
+
+private:
+    struct FileHeader
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        uint64_t Key;
+        uint32_t Origin;
+        uint32_t Reserved;
+    };
+    // the file header is followed by the 9 RGB irradiance coefficients, then every texture: this header followed by
+    // every level's faces, largest level first, in cube map face order
+    struct TextureHeader
+    {
+        uint32_t Cube;
+        uint32_t Channels;
+        uint32_t Size;
+        uint32_t Levels;
+    };
+
+    std::string path;
+    uint64_t hash = 14695981039346656037ull;
+
+    static uint64_t fnv1a(uint64_t hash, const void *data, size_t size)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    static void writeTexture(std::ofstream &out, const IblTexture &texture)
+    {
+        TextureHeader header = {texture.Cube ? 1u : 0u, texture.Channels, texture.Size, texture.Levels};
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(texture.Texels.data()), texture.Texels.size() * sizeof(uint16_t));
+    }
+
+    static bool readTexture(std::ifstream &in, IblTexture &texture)
+    {
+        TextureHeader header;
+        if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) || (header.Channels != 2 && header.Channels != 3) ||
+            header.Size == 0 || header.Size > 16384 || header.Levels == 0 || header.Levels > IblTexture::GetFullMipCount(header.Size))
+            return false;
+        texture.Cube = header.Cube != 0;
+        texture.Channels = header.Channels;
+        texture.Size = header.Size;
+        texture.Levels = header.Levels;
+        texture.Texels.resize(texture.GetTexelCount());
+        return static_cast<bool>(in.read(reinterpret_cast<char *>(texture.Texels.data()), texture.Texels.size() * sizeof(uint16_t)));
+    }
+
+    static IblTexture downloadTexture(unsigned int texture, bool cube, unsigned int channels, unsigned int size, bool mipmapped)
+    {
+        IblTexture result;
+        result.Cube = cube;
+        result.Channels = channels;
+        result.Size = size;
+        result.Levels = mipmapped ? IblTexture::GetFullMipCount(size) : 1u;
+        result.Texels.resize(result.GetTexelCount());
+        GLenum target = cube ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+        GLenum format = channels == 3 ? GL_RGB : GL_RG;
+        glBindTexture(target, texture);
+        for (unsigned int level = 0; level < result.Levels; level++)
+            for (unsigned int face = 0; face < result.GetFaceCount(); face++)
+                glGetTexImage(cube ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D, level, format, GL_HALF_FLOAT, result.GetFace(level, face));
+        glBindTexture(target, 0);
+        return result;
+    }
+
+    static unsigned int uploadTexture(const IblTexture &texture)
+    {
+        GLenum target = texture.Cube ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+        GLenum internalFormat = texture.Channels == 3 ? GL_RGB16F : GL_RG16F;
+        GLenum format = texture.Channels == 3 ? GL_RGB : GL_RG;
+        unsigned int id;
+        glGenTextures(1, &id);
+        glBindTexture(target, id);
+        for (unsigned int level = 0; level < texture.Levels; level++)
+        {
+            unsigned int levelSize = texture.GetLevelSize(level);
+            for (unsigned int face = 0; face < texture.GetFaceCount(); face++)
+                glTexImage2D(texture.Cube ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D, level, internalFormat, levelSize, levelSize, 0, format, GL_HALF_FLOAT, texture.GetFace(level, face));
+        }
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        if (texture.Cube)
+            glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, texture.Levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, texture.Levels - 1);
+        glBindTexture(target, 0);
+        return id;
+    }
+};
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+// number of copies of the instance data; the CPU writes one while the GPU may still read the other two
+#define INSTANCE_BUFFER_REGIONS 3
+
+// Compact instance transform: 24 bytes instead of the 64 of a mat4. Position and a uniform scale are kept as floats,
+// the rotation is a unit quaternion quantized to four 16 bit snorm values. The vertex shader rebuilds the transform:
+//   worldPos = PositionScale.xyz + rotate(Rotation, aPos * PositionScale.w)
+struct CompactInstance
+{
+    glm::vec4 PositionScale;
+    short Rotation[4]; // x, y, z, w
+
+    static CompactInstance Encode(const glm::vec3 &position, const glm::quat &rotation, float scale)
+    {
+        CompactInstance instance;
+        instance.PositionScale = glm::vec4(position, scale);
+        glm::quat q = glm::normalize(rotation);
+        const float components[4] = {q.x, q.y, q.z, q.w};
+        for (int i = 0; i < 4; i++)
+            instance.Rotation[i] = static_cast<short>(std::lround(glm::clamp(components[i], -1.0f, 1.0f) * 32767.0f));
+        return instance;
+    }
+};
+
+// Streaming per-instance vertex data. The buffer holds three regions of `capacity` instances each and cycles through
+// them every frame, so the CPU never writes memory a frame in flight is still reading: each region is protected by a
+// fence. With GL 4.4 / ARB_buffer_storage the buffer is mapped once, persistently; otherwise every region is mapped
+// unsynchronized at the start of a frame. Either way the mapped pointer can be written by any thread between Begin()
+// and Flush(), and only the ranges passed to MarkDirty() are flushed.
+//
+// Per frame:
+//   glm::mat4 *data = instances.Begin<glm::mat4>();
+//   ... write data[i], instances.MarkDirty(first, count) ...
+//   instances.Flush();      // also points every attached VAO at this frame's region
+//   glDrawElementsInstanced(...);
+//   instances.End();
+class InstanceBuffer
+{
+public:
+    unsigned int ID;
+    // instances per region and size of one instance in bytes
+    unsigned int Capacity;
+    unsigned int Stride;
+
+    InstanceBuffer(unsigned int capacity, unsigned int stride) : Capacity(capacity), Stride(stride)
+    {
+        regionSize = static_cast<GLsizeiptr>(capacity) * stride;
+        glGenBuffers(1, &ID);
+        glBindBuffer(GL_ARRAY_BUFFER, ID);
+#if defined(GL_MAP_PERSISTENT_BIT)
+        // glad leaves the pointer empty when the driver doesn't expose buffer storage
+        if (glBufferStorage)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_FLUSH_EXPLICIT_BIT;
+            glBufferStorage(GL_ARRAY_BUFFER, regionSize * INSTANCE_BUFFER_REGIONS, NULL, flags);
+            persistentData = static_cast<char *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, regionSize * INSTANCE_BUFFER_REGIONS, flags));
+        }
+#endif
+        if (!persistentData)
+            glBufferData(GL_ARRAY_BUFFER, regionSize * INSTANCE_BUFFER_REGIONS, NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        for (unsigned int i = 0; i < INSTANCE_BUFFER_REGIONS; i++)
+            fences[i] = 0;
+    }
+
+    // describes one per-instance attribute; offset is in bytes inside an instance
+    void AddAttribute(unsigned int location, int size, GLenum type, unsigned int offset, bool normalized = false, bool integer = false)
+    {
+        Attribute attribute = {location, size, type, offset, normalized, integer};
+        attributes.push_back(attribute);
+    }
+    // a mat4 takes four consecutive vec4 attribute locations
+    void AddMat4Attribute(unsigned int location, unsigned int offset = 0)
+    {
+        for (unsigned int i = 0; i < 4; i++)
+            AddAttribute(location + i, 4, GL_FLOAT, offset + i * sizeof(glm::vec4));
+    }
+
+    // position/scale as a vec4 at location, the snorm quaternion as a normalized vec4 at location + 1
+    void AddCompactInstanceAttributes(unsigned int location, unsigned int offset = 0)
+    {
+        AddAttribute(location, 4, GL_FLOAT, offset + offsetof(CompactInstance, PositionScale));
+        AddAttribute(location + 1, 4, GL_SHORT, offset + offsetof(CompactInstance, Rotation), true);
+    }
+
+    // the instance attributes are added to the given VAO(s) and re-pointed at the current region by every Flush()
+    void Attach(unsigned int VAO)
+    {
+        vaos.push_back(VAO);
+        bindAttributes(VAO);
+    }
+    void Attach(const vector<Mesh> &meshes)
+    {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            Attach(meshes[i].VAO);
+    }
+
+    // disables this buffer's attribute locations in the attached VAOs, for when another buffer that feeds fewer locations
+    // is drawn with them; the next Flush() enables them again
+    void DisableAttributes()
+    {
+        for (unsigned int i = 0; i < vaos.size(); i++)
+        {
+            glBindVertexArray(vaos[i]);
+            for (unsigned int j = 0; j < attributes.size(); j++)
+                glDisableVertexAttribArray(attributes[j].Location);
+        }
+        glBindVertexArray(0);
+    }
+
+    // waits until the GPU is done with this frame's region and returns the memory to write the instances into
+    void *Begin()
+    {
+        waitForRegion(region);
+        if (persistentData)
+        {
+            current = persistentData + region * regionSize;
+        }
+        else
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, ID);
+            current = static_cast<char *>(glMapBufferRange(GL_ARRAY_BUFFER, region * regionSize, regionSize, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_FLUSH_EXPLICIT_BIT));
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        return current;
+    }
+    template <typename T>
+    T *Begin()
+    {
+        return static_cast<T *>(Begin());
+    }
+
+    // records instances [first, first + count) as written this frame; may be called from any thread
+    void MarkDirty(unsigned int first, unsigned int count)
+    {
+        std::lock_guard<std::mutex> lock(dirtyMutex);
+        dirtyRanges.push_back(Range{first, first + count});
+    }
+
+    // flushes the written ranges to the GPU and points the attached VAOs at this frame's region
+    void Flush()
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, ID);
+        // merge overlapping and adjacent ranges so every byte is flushed once
+        std::sort(dirtyRanges.begin(), dirtyRanges.end(), [](const Range &a, const Range &b)
+                  { return a.Begin < b.Begin; });
+        for (unsigned int i = 0; i < dirtyRanges.size();)
+        {
+            Range merged = dirtyRanges[i++];
+            while (i < dirtyRanges.size() && dirtyRanges[i].Begin <= merged.End)
+                merged.End = std::max(merged.End, dirtyRanges[i++].End);
+            // a persistent mapping covers the whole buffer, a per-frame mapping only the current region
+            GLintptr offset = static_cast<GLintptr>(merged.Begin) * Stride + (persistentData ? region * regionSize : 0);
+            glFlushMappedBufferRange(GL_ARRAY_BUFFER, offset, static_cast<GLsizeiptr>(merged.End - merged.Begin) * Stride);
+        }
+        dirtyRanges.clear();
+        if (!persistentData)
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        for (unsigned int i = 0; i < vaos.size(); i++)
+            bindAttributes(vaos[i]);
+    }
+
+    // call after the last draw reading this frame's instances
+    void End()
+    {
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        region = (region + 1) % INSTANCE_BUFFER_REGIONS;
+        current = nullptr;
+    }
+
+    // copies static instance data into every region, e.g. at startup
+    void Fill(const void *data, unsigned int count)
+    {
+        for (unsigned int i = 0; i < INSTANCE_BUFFER_REGIONS; i++)
+        {
+            std::memcpy(Begin(), data, static_cast<size_t>(count) * Stride);
+            MarkDirty(0, count);
+            Flush();
+            End();
+        }
+    }
+
+private:
+    struct Attribute
+    {
+        unsigned int Location;
+        int Size;
+        GLenum Type;
+        unsigned int Offset;
+        bool Normalized;
+        bool Integer;
+    };
+    struct Range
+    {
+        unsigned int Begin, End;
+    };
+
+    GLsizeiptr regionSize;
+    unsigned int region = 0;
+    char *persistentData = nullptr;
+    char *current = nullptr;
+    GLsync fences[INSTANCE_BUFFER_REGIONS];
+    std::vector<Attribute> attributes;
+    std::vector<unsigned int> vaos;
+    std::vector<Range> dirtyRanges;
+    std::mutex dirtyMutex;
+
+    void waitForRegion(unsigned int index)
+    {
+        if (!fences[index])
+            return;
+        GLenum result = glClientWaitSync(fences[index], 0, 0);
+        while (result == GL_TIMEOUT_EXPIRED)
+            result = glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1ms
+        glDeleteSync(fences[index]);
+        fences[index] = 0;
+    }
+
+    // generalizes the hand written glVertexAttribPointer/glVertexAttribDivisor setup of the instancing sample
+    void bindAttributes(unsigned int VAO)
+    {
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, ID);
+        for (unsigned int i = 0; i < attributes.size(); i++)
+        {
+            const Attribute &a = attributes[i];
+            const void *offset = reinterpret_cast<const void *>(static_cast<size_t>(region * regionSize + a.Offset));
+            glEnableVertexAttribArray(a.Location);
+            if (a.Integer)
+                glVertexAttribIPointer(a.Location, a.Size, a.Type, Stride, offset);
+            else
+                glVertexAttribPointer(a.Location, a.Size, a.Type, a.Normalized ? GL_TRUE : GL_FALSE, Stride, offset);
+            glVertexAttribDivisor(a.Location, 1);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+// size of the ring of jobs every thread allocates from (power of two); jobs still in flight when the ring comes
+// around are skipped and the pool grows by single jobs
+#define MAX_JOBS_PER_THREAD 4096
+
+// a unit of work. A job is finished once its own function and all of its children have run.
+struct Job
+{
+    std::function<void()> Function;
+    Job *Parent;
+    std::atomic<int> UnfinishedJobs{0};
+};
+
+// Small job system for frame preparation: one worker thread per core, each with its own deque. A thread pushes and
+// pops jobs at the back of its own deque, idle threads steal from the front of someone else's. The thread that creates
+// the JobSystem becomes thread 0 and executes jobs while it waits, so GL submission stays on that thread. Any other
+// thread, including the workers of another job system, shares one extra deque and job pool, so every call works from
+// every thread.
+class JobSystem
+{
+public:
+    // a workerCount of 0 starts one worker per hardware thread besides the calling thread
+    JobSystem(unsigned int workerCount = 0)
+    {
+        if (workerCount == 0)
+            workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+        threadCount = workerCount + 1;
+        // the extra slot is shared by the threads that don't belong to this job system
+        queues = std::vector<WorkQueue>(threadCount + 1);
+        pools = std::vector<JobPool>(threadCount + 1);
+        for (unsigned int i = 0; i <= threadCount; i++)
+            pools[i].Jobs = new Job[MAX_JOBS_PER_THREAD];
+        creator = std::this_thread::get_id();
+        threadSlot() = {this, 0};
+        for (unsigned int i = 1; i < threadCount; i++)
+            workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+    }
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            running = false;
+        }
+        wakeUp.notify_all();
+        for (unsigned int i = 0; i < workers.size(); i++)
+            workers[i].join();
+        // a job system created later at the same address mustn't take this thread for one of its own
+        if (threadSlot().Owner == this)
+            threadSlot() = {nullptr, 0};
+        for (unsigned int i = 0; i <= threadCount; i++)
+            delete[] pools[i].Jobs;
+    }
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    // creates a job that isn't scheduled yet; hand it to Run()
+    Job *CreateJob(std::function<void()> function)
+    {
+        return allocateJob(std::move(function), nullptr);
+    }
+    // creates a job that its parent waits for. Children have to be created before the parent is run.
+    Job *CreateChildJob(Job *parent, std::function<void()> function)
+    {
+        parent->UnfinishedJobs++;
+        return allocateJob(std::move(function), parent);
+    }
+
+    // schedules a job on the calling thread's deque
+    void Run(Job *job)
+    {
+        queues[threadIndex()].Push(job);
+        wakeUp.notify_one();
+    }
+
+    // executes other jobs until the given job (and its children) are finished
+    void Wait(const Job *job)
+    {
+        while (job->UnfinishedJobs.load(std::memory_order_acquire) > 0)
+        {
+            Job *next = getJob();
+            if (next)
+                execute(next);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    // splits [begin, end) into chunks of at most grainSize elements and calls function(chunkBegin, chunkEnd) for each
+    // chunk on any thread. Returns once every chunk is done.
+    void ParallelFor(unsigned int begin, unsigned int end, unsigned int grainSize, const std::function<void(unsigned int, unsigned int)> &function)
+    {
+        if (begin >= end)
+            return;
+        // keep the number of chunks well below the size of the job pool
+        grainSize = std::max(grainSize, (end - begin + MAX_JOBS_PER_THREAD / 2 - 1) / (MAX_JOBS_PER_THREAD / 2));
+        grainSize = std::max(1u, grainSize);
+        if (end - begin <= grainSize)
+        {
+            function(begin, end);
+            return;
+        }
+        Job *root = CreateJob(nullptr);
+        for (unsigned int start = begin; start < end; start += grainSize)
+        {
+            unsigned int stop = std::min(end, start + grainSize);
+            Run(CreateChildJob(root, [&function, start, stop]()
+                               { function(start, stop); }));
+        }
+        Run(root);
+        Wait(root);
+    }
+
+    unsigned int GetThreadCount() const
+    {
+        return threadCount;
+    }
+
+private:
+    // deque of one thread; the owner works at the back, thieves take from the front
+    struct WorkQueue
+    {
+        std::deque<Job *> Jobs;
+        std::mutex Mutex;
+
+        void Push(Job *job)
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            Jobs.push_back(job);
+        }
+        Job *Pop()
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            if (Jobs.empty())
+                return nullptr;
+            Job *job = Jobs.back();
+            Jobs.pop_back();
+            return job;
+        }
+        Job *Steal()
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            if (Jobs.empty())
+                return nullptr;
+            Job *job = Jobs.front();
+            Jobs.pop_front();
+            return job;
+        }
+    };
+    // ring buffer of jobs owned by one thread, plus the jobs it grew by. The mutex is only locked for the pool the
+    // other threads share.
+    struct JobPool
+    {
+        Job *Jobs = nullptr;
+        unsigned int Allocated = 0;
+        std::vector<std::unique_ptr<Job>> Overflow;
+        std::mutex Mutex;
+    };
+
+    unsigned int threadCount;
+    std::vector<WorkQueue> queues;
+    std::vector<JobPool> pools;
+    std::vector<std::thread> workers;
+    std::atomic<bool> running{true};
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    std::thread::id creator;
+
+    // the job system a thread works for and its index there
+    struct ThreadSlot
+    {
+        const JobSystem *Owner;
+        unsigned int Index;
+    };
+    static ThreadSlot &threadSlot()
+    {
+        static thread_local ThreadSlot slot = {nullptr, 0};
+        return slot;
+    }
+    // index of the calling thread in this job system; threadCount for a thread that isn't one of its own
+    unsigned int threadIndex() const
+    {
+        const ThreadSlot &slot = threadSlot();
+        if (slot.Owner == this)
+            return slot.Index;
+        // the creating thread keeps index 0 even after it has created another job system
+        if (std::this_thread::get_id() == creator)
+            return 0;
+        return threadCount;
+    }
+
+    Job *allocateJob(std::function<void()> function, Job *parent)
+    {
+        unsigned int index = threadIndex();
+        JobPool &pool = pools[index];
+        std::unique_lock<std::mutex> lock(pool.Mutex, std::defer_lock);
+        if (index == threadCount)
+            lock.lock();
+        Job *job = &pool.Jobs[pool.Allocated++ & (MAX_JOBS_PER_THREAD - 1)];
+        if (job->UnfinishedJobs.load(std::memory_order_acquire) != 0)
+        {
+            // the ring came around to a job that is still in flight; it can't be waited for, its parent may not have
+            // been run yet. Take a finished job from the overflow or grow it.
+            job = nullptr;
+            for (unsigned int i = 0; i < pool.Overflow.size() && !job; i++)
+                if (pool.Overflow[i]->UnfinishedJobs.load(std::memory_order_acquire) == 0)
+                    job = pool.Overflow[i].get();
+            if (!job)
+            {
+                pool.Overflow.push_back(std::make_unique<Job>());
+                job = pool.Overflow.back().get();
+            }
+        }
+        job->Function = std::move(function);
+        job->Parent = parent;
+        job->UnfinishedJobs.store(1, std::memory_order_relaxed);
+        return job;
+    }
+
+    Job *getJob()
+    {
+        unsigned int index = threadIndex();
+        Job *job = queues[index].Pop();
+        if (job)
+            return job;
+        // our own deque is empty, try to steal from the other threads starting at a random one
+        static thread_local std::minstd_rand random(index + 1);
+        unsigned int start = random() % (threadCount + 1);
+        for (unsigned int i = 0; i <= threadCount; i++)
+        {
+            unsigned int victim = (start + i) % (threadCount + 1);
+            if (victim == index)
+                continue;
+            job = queues[victim].Steal();
+            if (job)
+                return job;
+        }
+        return nullptr;
+    }
+
+    void execute(Job *job)
+    {
+        if (job->Function)
+            job->Function();
+        finish(job);
+    }
+
+    void finish(Job *job)
+    {
+        // read the parent first, a finished job can be reused by its pool right away
+        Job *parent = job->Parent;
+        if (job->UnfinishedJobs.fetch_sub(1, std::memory_order_acq_rel) == 1 && parent)
+            finish(parent);
+    }
+
+    void workerLoop(unsigned int index)
+    {
+        threadSlot() = {this, index};
+        while (running)
+        {
+            Job *job = getJob();
+            if (job)
+            {
+                execute(job);
+                continue;
+            }
+            // nothing to do: sleep until new work is pushed (the timeout covers a missed notification)
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            if (running)
+                wakeUp.wait_for(lock, std::chrono::milliseconds(1));
+        }
+    }
+};
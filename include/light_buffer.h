@@ -0,0 +1,220 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// lights per buffer; the shaders declare the same array size. 16 + 256 * 32 bytes stays below the 16KB uniform block
+// size every 3.3 implementation supports.
+#define LIGHT_BUFFER_CAPACITY 256
+// uniform buffer binding point of the light block
+#define LIGHT_BUFFER_BINDING 0
+// dirty lights closer together than this are uploaded with one call, including the clean ones in between
+#define LIGHT_BUFFER_MERGE_GAP 4
+
+// one light in std140 layout: two vec4s, 32 bytes
+struct GpuLight
+{
+    glm::vec4 PositionRadius; // world position, radius of influence (0 = unbounded)
+    glm::vec4 Color;          // rgb radiance, a unused
+};
+
+// Point lights in a uniform buffer object. Lights are referenced by the id Add() returns and the shader indexes the
+// block with that id:
+//   struct Light{ vec4 PositionRadius; vec4 Color; };
+//   layout(std140) uniform Lights{ int lightCount; Light lights[256]; };
+// Setters only mark a light dirty when its value really changes; Upload() then sends the dirty lights as a few
+// merged glBufferSubData ranges and does nothing at all for a frame in which no light changed.
+class LightBuffer
+{
+public:
+    unsigned int UBO;
+
+    LightBuffer(unsigned int binding = LIGHT_BUFFER_BINDING) : binding(binding)
+    {
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, LIGHTS_OFFSET + LIGHT_BUFFER_CAPACITY * sizeof(GpuLight), NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(int), &count);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, UBO);
+        lights.reserve(LIGHT_BUFFER_CAPACITY);
+        dirty.reserve(LIGHT_BUFFER_CAPACITY);
+    }
+
+    // returns the id of the new light, or -1 when the buffer is full
+    int Add(const glm::vec3 &position, const glm::vec3 &color, float radius = 0.0f)
+    {
+        if (lights.size() >= LIGHT_BUFFER_CAPACITY)
+            return -1;
+        GpuLight light = {glm::vec4(position, radius), glm::vec4(color, 0.0f)};
+        lights.push_back(light);
+        dirty.push_back(false);
+        count = static_cast<int>(lights.size());
+        countDirty = true;
+        markDirty(count - 1);
+        return count - 1;
+    }
+
+    void SetPosition(unsigned int id, const glm::vec3 &position)
+    {
+        set(id, lights[id].PositionRadius, glm::vec4(position, lights[id].PositionRadius.w));
+    }
+    void SetColor(unsigned int id, const glm::vec3 &color)
+    {
+        set(id, lights[id].Color, glm::vec4(color, 0.0f));
+    }
+    void SetRadius(unsigned int id, float radius)
+    {
+        set(id, lights[id].PositionRadius, glm::vec4(glm::vec3(lights[id].PositionRadius), radius));
+    }
+
+    const GpuLight &Get(unsigned int id) const
+    {
+        return lights[id];
+    }
+    unsigned int GetCount() const
+    {
+        return static_cast<unsigned int>(lights.size());
+    }
+    // glBufferSubData calls made by the last Upload()
+    unsigned int GetUploadedRanges() const
+    {
+        return uploadedRanges;
+    }
+
+    // sends the changed lights to the GPU; call once per frame before drawing
+    void Upload()
+    {
+        uploadedRanges = 0;
+        if (!countDirty && firstDirty == NONE)
+            return;
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        if (countDirty)
+        {
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(int), &count);
+            countDirty = false;
+            uploadedRanges++;
+        }
+        // walk only the span that has dirty lights, merging runs separated by small clean gaps
+        unsigned int i = firstDirty, last = lastDirty;
+        while (i != NONE && i <= last)
+        {
+            if (!dirty[i])
+            {
+                i++;
+                continue;
+            }
+            unsigned int begin = i, end = i + 1;
+            for (unsigned int j = end; j <= last && j < end + LIGHT_BUFFER_MERGE_GAP; j++)
+                if (dirty[j])
+                    end = j + 1;
+            for (unsigned int j = begin; j < end; j++)
+                dirty[j] = false;
+            glBufferSubData(GL_UNIFORM_BUFFER, LIGHTS_OFFSET + begin * sizeof(GpuLight), (end - begin) * sizeof(GpuLight), &lights[begin]);
+            uploadedRanges++;
+            i = end;
+        }
+        firstDirty = lastDirty = NONE;
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    // connects the shader's Lights block to this buffer's binding point
+    void Bind(Shader &shader, const char *blockName = "Lights")
+    {
+        unsigned int index = glGetUniformBlockIndex(shader.ID, blockName);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(shader.ID, index, binding);
+    }
+
+private:
+    static const unsigned int NONE = 0xFFFFFFFFu;
+    // std140: the int count takes the first 16 bytes, the struct array starts at the next vec4
+    static const unsigned int LIGHTS_OFFSET = 16;
+
+    unsigned int binding;
+    std::vector<GpuLight> lights;
+    std::vector<bool> dirty;
+    int count = 0;
+    bool countDirty = false;
+    unsigned int firstDirty = NONE, lastDirty = NONE;
+    unsigned int uploadedRanges = 0;
+
+    void set(unsigned int id, glm::vec4 &field, const glm::vec4 &value)
+    {
+        if (field == value)
+            return;
+        field = value;
+        markDirty(id);
+    }
+
+    void markDirty(unsigned int id)
+    {
+        if (dirty[id])
+            return;
+        dirty[id] = true;
+        firstDirty = firstDirty == NONE ? id : std::min(firstDirty, id);
+        lastDirty = lastDirty == NONE ? id : std::max(lastDirty, id);
+    }
+};
+
+// Keeps a texture buffer of lights (two vec4 texels per light) equal to an array on the CPU without sending all of it
+// every frame: the array is compared with what the buffer holds and only the changed lights go up, as glBufferSubData
+// ranges merged like in LightBuffer. The storage is only reallocated when the lights outgrow it, then everything is
+// sent once.
+//   uploader.Upload(GL_TEXTURE_BUFFER, buffer, lightData);
+class LightDataUploader
+{
+public:
+    // returns the number of glBufferSubData calls made
+    unsigned int Upload(GLenum target, unsigned int buffer, const std::vector<glm::vec4> &data)
+    {
+        unsigned int lightCount = static_cast<unsigned int>(data.size() / 2);
+        unsigned int ranges = 0;
+        glBindBuffer(target, buffer);
+        if (lightCount > capacity)
+        {
+            capacity = std::max(lightCount, capacity * 2);
+            glBufferData(target, capacity * 2 * sizeof(glm::vec4), NULL, GL_DYNAMIC_DRAW);
+            glBufferSubData(target, 0, data.size() * sizeof(glm::vec4), &data[0]);
+            uploaded = data;
+            glBindBuffer(target, 0);
+            return 1;
+        }
+        // lights past the end of the previous upload are always new
+        uploaded.resize(data.size(), glm::vec4(NAN));
+        unsigned int i = 0;
+        while (i < lightCount)
+        {
+            if (!changed(data, i))
+            {
+                i++;
+                continue;
+            }
+            unsigned int begin = i, end = i + 1;
+            for (unsigned int j = end; j < lightCount && j < end + LIGHT_BUFFER_MERGE_GAP; j++)
+                if (changed(data, j))
+                    end = j + 1;
+            std::copy(data.begin() + begin * 2, data.begin() + end * 2, uploaded.begin() + begin * 2);
+            glBufferSubData(target, begin * 2 * sizeof(glm::vec4), (end - begin) * 2 * sizeof(glm::vec4), &data[begin * 2]);
+            ranges++;
+            i = end;
+        }
+        glBindBuffer(target, 0);
+        return ranges;
+    }
+
+private:
+    unsigned int capacity = 0;
+    std::vector<glm::vec4> uploaded;
+
+    bool changed(const std::vector<glm::vec4> &data, unsigned int light) const
+    {
+        return data[light * 2] != uploaded[light * 2] || data[light * 2 + 1] != uploaded[light * 2 + 1];
+    }
+};
\ No newline at end of file
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+#include "light_buffer.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// cluster grid: screen tiles in x and y, exponential depth slices in z
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+
+// Clustered light assignment. The view frustum is split into CLUSTER_X * CLUSTER_Y * CLUSTER_Z clusters; every frame
+// the point lights (spheres of influence) are assigned to the clusters they touch on the job system, one depth slice
+// per job, and the result is uploaded into three buffer textures:
+//   lightData     (RGBA32F) two texels per light: position and radius, color
+//   clusterGrid   (RG32UI)  per cluster the offset and count of its lights in clusterLights
+//   clusterLights (R16UI)   light indices, grouped by cluster
+// A fragment finds its cluster from gl_FragCoord and its view depth:
+//   slice = floor(log(depth / near) * sliceScale), cluster = x + CLUSTER_X * (y + CLUSTER_Y * slice)
+// Bind() sets the samplers and uniforms the shader needs for that. The buffers grow with the lights, up to 65536 lights
+// (the R16UI indices) and GL_MAX_TEXTURE_BUFFER_SIZE light references; what doesn't fit is dropped and reported once
+// on the console, and GetDroppedCount() has the references the last update dropped.
+class LightClusters
+{
+public:
+    LightClusters(unsigned int screenWidth, unsigned int screenHeight, float near, float far) : screenWidth(screenWidth), screenHeight(screenHeight), near(near), far(far)
+    {
+        for (unsigned int k = 0; k <= CLUSTER_Z; k++)
+            sliceDepths[k] = near * std::pow(far / near, static_cast<float>(k) / CLUSTER_Z);
+        lightDataTexture = createBufferTexture(lightDataBuffer, GL_RGBA32F);
+        gridTexture = createBufferTexture(gridBuffer, GL_RG32UI);
+        indexTexture = createBufferTexture(indexBuffer, GL_R16UI);
+        GLint maxTexels = 65536;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        maxIndices = static_cast<unsigned int>(maxTexels);
+        clusterLists.resize(CLUSTER_X * CLUSTER_Y * CLUSTER_Z);
+        grid.resize(CLUSTER_X * CLUSTER_Y * CLUSTER_Z * 2);
+    }
+
+    // assigns the lights to the clusters of this view and uploads everything; radius is the distance at which a light
+    // stops contributing
+    void Update(const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &colors, const std::vector<float> &radii,
+                const glm::mat4 &view, const glm::mat4 &projection, JobSystem &jobs)
+    {
+        this->view = view;
+        LightCount = static_cast<unsigned int>(std::min<size_t>(positions.size(), 65536));
+        if (LightCount < positions.size() && !lightOverflowReported)
+        {
+            std::cout << "LightClusters: " << positions.size() << " lights, only the first 65536 are assigned" << std::endl;
+            lightOverflowReported = true;
+        }
+        lightData.resize(LightCount * 2);
+        viewLights.resize(LightCount);
+        for (unsigned int i = 0; i < LightCount; i++)
+        {
+            lightData[i * 2] = glm::vec4(positions[i], radii[i]);
+            lightData[i * 2 + 1] = glm::vec4(colors[i], 0.0f);
+            glm::vec3 p = glm::vec3(view * glm::vec4(positions[i], 1.0f));
+            // depth is positive in front of the camera
+            viewLights[i] = glm::vec4(p.x, p.y, -p.z, radii[i]);
+        }
+        float scaleX = projection[0][0], scaleY = projection[1][1];
+        jobs.ParallelFor(0, CLUSTER_Z, 1, [&](unsigned int begin, unsigned int end)
+                         {
+                             for (unsigned int k = begin; k < end; k++)
+                                 assignSlice(k, scaleX, scaleY);
+                         });
+
+        // compact the per cluster lists into one index array
+        indices.clear();
+        droppedCount = 0;
+        for (unsigned int c = 0; c < clusterLists.size(); c++)
+        {
+            unsigned int count = static_cast<unsigned int>(std::min<size_t>(clusterLists[c].size(), maxIndices - indices.size()));
+            grid[c * 2] = static_cast<unsigned int>(indices.size());
+            grid[c * 2 + 1] = count;
+            indices.insert(indices.end(), clusterLists[c].begin(), clusterLists[c].begin() + count);
+            droppedCount += static_cast<unsigned int>(clusterLists[c].size()) - count;
+        }
+        if (droppedCount && !indexOverflowReported)
+        {
+            std::cout << "LightClusters: " << droppedCount << " light references past the " << maxIndices
+                      << " texel limit of a buffer texture were dropped" << std::endl;
+            indexOverflowReported = true;
+        }
+        if (indices.empty())
+            indices.push_back(0);
+        // only the lights that changed since the last update are sent; the cluster lists depend on the view and are
+        // rebuilt every frame
+        lightUploader.Upload(GL_TEXTURE_BUFFER, lightDataBuffer, lightData);
+        upload(gridBuffer, &grid[0], grid.size() * sizeof(unsigned int));
+        upload(indexBuffer, &indices[0], indices.size() * sizeof(unsigned short));
+    }
+
+    // binds the buffer textures to firstUnit .. firstUnit + 2 and sets the cluster uniforms
+    void Bind(Shader &shader, unsigned int firstUnit)
+    {
+        shader.setInt("lightData", firstUnit);
+        shader.setInt("clusterGrid", firstUnit + 1);
+        shader.setInt("clusterLights", firstUnit + 2);
+        shader.setInt("lightCount", LightCount);
+        shader.setMat4("clusterView", view);
+        shader.setFloat("clusterNear", near);
+        shader.setFloat("clusterSliceScale", CLUSTER_Z / std::log(far / near));
+        shader.setVec2("clusterTileSize", static_cast<float>(screenWidth) / CLUSTER_X, static_cast<float>(screenHeight) / CLUSTER_Y);
+        unsigned int textures[3] = {lightDataTexture, gridTexture, indexTexture};
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // total number of light references in the clusters of the last update
+    unsigned int GetIndexCount() const
+    {
+        return static_cast<unsigned int>(indices.size());
+    }
+    // light references that didn't fit the index buffer texture in the last update
+    unsigned int GetDroppedCount() const
+    {
+        return droppedCount;
+    }
+
+    unsigned int LightCount = 0;
+
+private:
+    unsigned int screenWidth, screenHeight;
+    float near, far;
+    float sliceDepths[CLUSTER_Z + 1];
+    unsigned int maxIndices;
+    unsigned int droppedCount = 0;
+    bool lightOverflowReported = false;
+    bool indexOverflowReported = false;
+    glm::mat4 view = glm::mat4(1.0f);
+    unsigned int lightDataBuffer, gridBuffer, indexBuffer;
+    unsigned int lightDataTexture, gridTexture, indexTexture;
+    std::vector<glm::vec4> lightData;
+    LightDataUploader lightUploader;
+    std::vector<glm::vec4> viewLights;
+    std::vector<std::vector<unsigned short>> clusterLists;
+    std::vector<unsigned int> grid;
+    std::vector<unsigned short> indices;
+
+    unsigned int createBufferTexture(unsigned int &buffer, GLenum format)
+    {
+        unsigned int texture;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        return texture;
+    }
+
+    void upload(unsigned int buffer, const void *data, size_t size)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        // orphan the old storage so the upload doesn't wait for last frame's lighting pass
+        glBufferData(GL_TEXTURE_BUFFER, size, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // fills the light lists of every cluster in depth slice k; slices are independent so they run in parallel
+    void assignSlice(unsigned int k, float scaleX, float scaleY)
+    {
+        float zNear = sliceDepths[k], zFar = sliceDepths[k + 1];
+        unsigned int sliceBase = k * CLUSTER_X * CLUSTER_Y;
+        for (unsigned int c = 0; c < CLUSTER_X * CLUSTER_Y; c++)
+            clusterLists[sliceBase + c].clear();
+        for (unsigned int i = 0; i < LightCount; i++)
+        {
+            const glm::vec4 &l = viewLights[i];
+            float za = std::max(zNear, l.z - l.w), zb = std::min(zFar, l.z + l.w);
+            if (za > zb)
+                continue;
+            // conservative tile range: the NDC extent of the light's bounding box over the overlapping depth range
+            float minX = std::min((l.x - l.w) / za, (l.x - l.w) / zb) * scaleX;
+            float maxX = std::max((l.x + l.w) / za, (l.x + l.w) / zb) * scaleX;
+            float minY = std::min((l.y - l.w) / za, (l.y - l.w) / zb) * scaleY;
+            float maxY = std::max((l.y + l.w) / za, (l.y + l.w) / zb) * scaleY;
+            if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+                continue;
+            int x0 = tileIndex(minX, CLUSTER_X), x1 = tileIndex(maxX, CLUSTER_X);
+            int y0 = tileIndex(minY, CLUSTER_Y), y1 = tileIndex(maxY, CLUSTER_Y);
+            for (int y = y0; y <= y1; y++)
+            {
+                // view space bounds of the cluster: the tile's frustum between the two slice depths
+                float ndcY0 = -1.0f + 2.0f * y / CLUSTER_Y, ndcY1 = -1.0f + 2.0f * (y + 1) / CLUSTER_Y;
+                float boxY0 = std::min(ndcY0 * zNear, ndcY0 * zFar) / scaleY, boxY1 = std::max(ndcY1 * zNear, ndcY1 * zFar) / scaleY;
+                float dy = l.y - glm::clamp(l.y, boxY0, boxY1);
+                float dz = l.z - glm::clamp(l.z, zNear, zFar);
+                for (int x = x0; x <= x1; x++)
+                {
+                    float ndcX0 = -1.0f + 2.0f * x / CLUSTER_X, ndcX1 = -1.0f + 2.0f * (x + 1) / CLUSTER_X;
+                    float boxX0 = std::min(ndcX0 * zNear, ndcX0 * zFar) / scaleX, boxX1 = std::max(ndcX1 * zNear, ndcX1 * zFar) / scaleX;
+                    float dx = l.x - glm::clamp(l.x, boxX0, boxX1);
+                    if (dx * dx + dy * dy + dz * dz <= l.w * l.w)
+                        clusterLists[sliceBase + y * CLUSTER_X + x].push_back(static_cast<unsigned short>(i));
+                }
+            }
+        }
+    }
+
+    static int tileIndex(float ndc, int tiles)
+    {
+        return glm::clamp(static_cast<int>(std::floor((ndc * 0.5f + 0.5f) * tiles)), 0, tiles - 1);
+    }
+};
@@ -9,6 +9,7 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include "job_system.h"
 #include "mesh.h"
 #include "shader.h"
 
@@ -20,7 +21,18 @@
 #include <vector>
 using namespace std;
 
+// an image file decoded by stb_image that has no GL texture yet
+struct TextureImage
+{
+    unsigned char *Data = nullptr;
+    int Width = 0;
+    int Height = 0;
+    int Components = 0;
+};
+
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+TextureImage DecodeTextureFile(const char *path, const string &directory);
+unsigned int UploadTextureImage(TextureImage &image, const char *path);
 
 class Model
 {
@@ -31,10 +43,11 @@ public:
     string directory;
     bool gammaCorrection;
 
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // constructor, expects a filepath to a 3D model. With a job system the meshes are converted and the textures are
+    // decoded on its threads; the GL objects are still created on the calling thread.
+    Model(string const &path, bool gamma = false, JobSystem *jobs = nullptr) : gammaCorrection(gamma)
     {
-        loadModel(path);
+        loadModel(path, jobs);
     }
 
     // draws the model, and thus all its meshes
@@ -45,8 +58,16 @@ public:
     }
 
 private:
+    // a mesh's data before its GL objects exist; the textures are indices into textures_loaded
+    struct MeshData
+    {
+        vector<Vertex> vertices;
+        vector<unsigned int> indices;
+        vector<unsigned int> textures;
+    };
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    void loadModel(string const &path, JobSystem *jobs)
     {
         // read file via ASSIMP
         Assimp::Importer importer;
@@ -61,33 +82,74 @@ private:
         directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        vector<aiMesh *> sceneMeshes;
+        processNode(scene->mRootNode, scene, sceneMeshes);
+
+        // the texture list is built in order so every path is decoded once, then the decoding and the vertex
+        // conversion run in parallel; only the uploads below need the GL context
+        vector<MeshData> meshData(sceneMeshes.size());
+        for (unsigned int i = 0; i < sceneMeshes.size(); i++)
+            meshData[i].textures = loadMaterialTextures(scene->mMaterials[sceneMeshes[i]->mMaterialIndex]);
+        vector<TextureImage> images(textures_loaded.size());
+        unsigned int imageCount = static_cast<unsigned int>(images.size());
+        forEach(jobs, imageCount + static_cast<unsigned int>(sceneMeshes.size()), [&](unsigned int i)
+                {
+            if (i < imageCount)
+                images[i] = DecodeTextureFile(textures_loaded[i].path.c_str(), directory);
+            else
+                processMesh(sceneMeshes[i - imageCount], meshData[i - imageCount]); });
+        for (unsigned int i = 0; i < imageCount; i++)
+            textures_loaded[i].id = UploadTextureImage(images[i], textures_loaded[i].path.c_str());
+
+        // create the mesh objects from the extracted mesh data
+        for (unsigned int i = 0; i < meshData.size(); i++)
+        {
+            vector<Texture> textures;
+            for (unsigned int texture : meshData[i].textures)
+                textures.push_back(textures_loaded[texture]);
+            meshes.push_back(Mesh(meshData[i].vertices, meshData[i].indices, textures));
+        }
     }
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // calls function(i) for every i below count, on the job system's threads if there is one
+    static void forEach(JobSystem *jobs, unsigned int count, const std::function<void(unsigned int)> &function)
+    {
+        if (!jobs)
+        {
+            for (unsigned int i = 0; i < count; i++)
+                function(i);
+            return;
+        }
+        jobs->ParallelFor(0, count, 1, [&function](unsigned int begin, unsigned int end)
+                          {
+            for (unsigned int i = begin; i < end; i++)
+                function(i); });
+    }
+
+    // collects the meshes of a node in a recursive fashion: each individual mesh located at the node, then those of its children nodes (if any).
+    void processNode(aiNode *node, const aiScene *scene, vector<aiMesh *> &sceneMeshes)
     {
         // process each mesh located at the current node
         for (unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            sceneMeshes.push_back(scene->mMeshes[node->mMeshes[i]]);
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for (unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, sceneMeshes);
         }
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // fills the vertices and indices of a mesh; touches nothing but data, so meshes can be processed in parallel
+    void processMesh(aiMesh *mesh, MeshData &data)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vertices.reserve(mesh->mNumVertices);
 
         // walk through each of the mesh's vertices
         for (unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -140,8 +202,12 @@ private:
             for (unsigned int j = 0; j < face.mNumIndices; j++)
                 indices.push_back(face.mIndices[j]);
         }
-        // process materials
-        aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
+    }
+
+    // the textures of a material as indices into textures_loaded
+    vector<unsigned int> loadMaterialTextures(aiMaterial *material)
+    {
+        vector<unsigned int> textures;
         // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
         // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER.
         // Same applies to other texture as the following list summarizes:
@@ -150,27 +216,20 @@ private:
         // normal: texture_normalN
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", textures);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", textures);
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", textures);
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", textures);
+        return textures;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // checks all material textures of a given type and adds the ones that aren't known yet to textures_loaded, without
+    // a GL texture until loadModel uploads it. the indices of the textures are appended to textures.
+    void loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName, vector<unsigned int> &textures)
     {
-        vector<Texture> textures;
         for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
@@ -181,7 +240,7 @@ private:
             {
                 if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
                 {
-                    textures.push_back(textures_loaded[j]);
+                    textures.push_back(j);
                     skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
                     break;
                 }
@@ -189,27 +248,42 @@ private:
             if (!skip)
             { // if texture hasn't been loaded already, load it
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                texture.id = 0;
                 texture.type = typeName;
                 texture.path = str.C_Str();
-                textures.push_back(texture);
+                textures.push_back(static_cast<unsigned int>(textures_loaded.size()));
                 textures_loaded.push_back(texture); // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
             }
         }
-        return textures;
     }
 };
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+{
+    TextureImage image = DecodeTextureFile(path, directory);
+    return UploadTextureImage(image, path);
+}
+
+// only reads the file, so it may run on any thread
+TextureImage DecodeTextureFile(const char *path, const string &directory)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
 
+    TextureImage image;
+    image.Data = stbi_load(filename.c_str(), &image.Width, &image.Height, &image.Components, 0);
+    return image;
+}
+
+// creates the texture on the calling thread's GL context and frees the decoded data
+unsigned int UploadTextureImage(TextureImage &image, const char *path)
+{
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    int width = image.Width, height = image.Height, nrComponents = image.Components;
+    unsigned char *data = image.Data;
+    image.Data = nullptr;
     if (data)
     {
         GLenum format;
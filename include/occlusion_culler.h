@@ -0,0 +1,682 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+#include "mesh.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// the depth buffer is split in 8x8 pixel tiles, every tile keeps the farthest depth of its pixels (the hierarchical depth)
+#define OCCLUSION_TILE_SIZE 8
+
+// axis aligned bounding box, used as the conservative test volume of a draw
+struct AABB
+{
+    glm::vec3 Min;
+    glm::vec3 Max;
+};
+
+// computes the object space bounding box of a list of meshes (e.g. Model::meshes)
+inline AABB ComputeAABB(const vector<Mesh> &meshes)
+{
+    AABB box;
+    box.Min = glm::vec3(1e30f);
+    box.Max = glm::vec3(-1e30f);
+    for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        for (unsigned int j = 0; j < meshes[i].vertices.size(); j++)
+        {
+            box.Min = glm::min(box.Min, meshes[i].vertices[j].Position);
+            box.Max = glm::max(box.Max, meshes[i].vertices[j].Position);
+        }
+    }
+    return box;
+}
+
+// a cheap stand-in for a mesh in the occlusion pass, built by SimplifyOccluder
+struct OccluderMesh
+{
+    std::vector<glm::vec3> Positions;
+    std::vector<unsigned int> Indices;
+};
+
+// builds an occluder that never covers more than the meshes it stands in for. The bounding box is cut into
+// resolution^3 cells and every cell a triangle passes through is marked as surface; the marking is conservative, the
+// triangles are split until they fit in a cell and the cells of their bounding boxes are marked. A cell without
+// surface lies either completely inside or completely outside the mesh, and it counts as inside when the rays through
+// its center along x, y and z all cross the surface an odd number of times before reaching it. The occluder is the
+// boundary of the inside cells, merged into rectangles per slice: a solid within the closed mesh, so wherever it covers
+// a pixel the mesh covers it too, and closer to the camera. Thin parts have no inside cells and are left out. Requiring
+// all three axes to agree keeps small holes in a mesh that isn't closed from letting outside cells in.
+inline OccluderMesh SimplifyOccluder(const vector<Mesh> &meshes, unsigned int resolution = 16)
+{
+    OccluderMesh occluder;
+    AABB box = ComputeAABB(meshes);
+    const int n = static_cast<int>(resolution);
+    glm::vec3 cellSize = glm::max(box.Max - box.Min, glm::vec3(1e-6f)) / static_cast<float>(resolution);
+    std::vector<unsigned char> surface(static_cast<size_t>(n) * n * n, 0);
+    // per axis and row of cells along it (row index v * n + u, with u and v the next two axes): where the surface
+    // crosses the line through the row's cell centers, in cells
+    std::vector<std::vector<float>> crossings[3];
+    for (int axis = 0; axis < 3; axis++)
+        crossings[axis].resize(static_cast<size_t>(n) * n);
+    struct Triangle
+    {
+        glm::vec3 A, B, C;
+    };
+    std::vector<Triangle> pieces;
+    for (unsigned int m = 0; m < meshes.size(); m++)
+    {
+        const Mesh &mesh = meshes[m];
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            // in cells from the box corner
+            Triangle triangle = {(mesh.vertices[mesh.indices[i]].Position - box.Min) / cellSize,
+                                 (mesh.vertices[mesh.indices[i + 1]].Position - box.Min) / cellSize,
+                                 (mesh.vertices[mesh.indices[i + 2]].Position - box.Min) / cellSize};
+            for (int axis = 0; axis < 3; axis++)
+            {
+                int u = (axis + 1) % 3, v = (axis + 2) % 3;
+                const glm::vec3 &a = triangle.A, &b = triangle.B, &c = triangle.C;
+                float area = (b[u] - a[u]) * (c[v] - a[v]) - (c[u] - a[u]) * (b[v] - a[v]);
+                if (area == 0.0f)
+                    continue;
+                int u0 = std::max(0, static_cast<int>(std::ceil(std::min(a[u], std::min(b[u], c[u])) - 0.5f)));
+                int u1 = std::min(n - 1, static_cast<int>(std::floor(std::max(a[u], std::max(b[u], c[u])) - 0.5f)));
+                int v0 = std::max(0, static_cast<int>(std::ceil(std::min(a[v], std::min(b[v], c[v])) - 0.5f)));
+                int v1 = std::min(n - 1, static_cast<int>(std::floor(std::max(a[v], std::max(b[v], c[v])) - 0.5f)));
+                for (int row = v0; row <= v1; row++)
+                    for (int column = u0; column <= u1; column++)
+                    {
+                        float pu = column + 0.5f, pv = row + 0.5f;
+                        float w1 = ((pu - a[u]) * (c[v] - a[v]) - (c[u] - a[u]) * (pv - a[v])) / area;
+                        float w2 = ((b[u] - a[u]) * (pv - a[v]) - (pu - a[u]) * (b[v] - a[v])) / area;
+                        if (w1 >= 0.0f && w2 >= 0.0f && w1 + w2 <= 1.0f)
+                            crossings[axis][row * n + column].push_back(a[axis] + w1 * (b[axis] - a[axis]) + w2 * (c[axis] - a[axis]));
+                    }
+            }
+            pieces.push_back(triangle);
+            while (!pieces.empty())
+            {
+                Triangle piece = pieces.back();
+                pieces.pop_back();
+                glm::vec3 low = glm::min(piece.A, glm::min(piece.B, piece.C)), high = glm::max(piece.A, glm::max(piece.B, piece.C));
+                glm::vec3 extent = high - low;
+                if (std::max(extent.x, std::max(extent.y, extent.z)) > 1.0f)
+                {
+                    // split the longest edge
+                    float ab = glm::length(piece.B - piece.A), bc = glm::length(piece.C - piece.B), ca = glm::length(piece.A - piece.C);
+                    if (ab >= bc && ab >= ca)
+                    {
+                        glm::vec3 middle = (piece.A + piece.B) * 0.5f;
+                        pieces.push_back({piece.A, middle, piece.C});
+                        pieces.push_back({middle, piece.B, piece.C});
+                    }
+                    else if (bc >= ca)
+                    {
+                        glm::vec3 middle = (piece.B + piece.C) * 0.5f;
+                        pieces.push_back({piece.A, piece.B, middle});
+                        pieces.push_back({piece.A, middle, piece.C});
+                    }
+                    else
+                    {
+                        glm::vec3 middle = (piece.C + piece.A) * 0.5f;
+                        pieces.push_back({piece.A, piece.B, middle});
+                        pieces.push_back({middle, piece.B, piece.C});
+                    }
+                    continue;
+                }
+                glm::ivec3 first = glm::clamp(glm::ivec3(glm::floor(low)), glm::ivec3(0), glm::ivec3(n - 1));
+                glm::ivec3 last = glm::clamp(glm::ivec3(glm::floor(high)), glm::ivec3(0), glm::ivec3(n - 1));
+                for (int z = first.z; z <= last.z; z++)
+                    for (int y = first.y; y <= last.y; y++)
+                        for (int x = first.x; x <= last.x; x++)
+                            surface[(z * n + y) * n + x] = 1;
+            }
+        }
+    }
+    for (int axis = 0; axis < 3; axis++)
+        for (size_t row = 0; row < crossings[axis].size(); row++)
+            std::sort(crossings[axis][row].begin(), crossings[axis][row].end());
+
+    std::vector<unsigned char> inside(surface.size(), 0);
+    for (int z = 0; z < n; z++)
+        for (int y = 0; y < n; y++)
+            for (int x = 0; x < n; x++)
+            {
+                int cell = (z * n + y) * n + x;
+                if (surface[cell])
+                    continue;
+                int coordinates[3] = {x, y, z};
+                bool odd = true;
+                for (int axis = 0; axis < 3 && odd; axis++)
+                {
+                    const std::vector<float> &row = crossings[axis][coordinates[(axis + 2) % 3] * n + coordinates[(axis + 1) % 3]];
+                    size_t before = std::lower_bound(row.begin(), row.end(), coordinates[axis] + 0.5f) - row.begin();
+                    odd = (before & 1) != 0;
+                }
+                inside[cell] = odd ? 1 : 0;
+            }
+
+    // the faces between inside cells and the rest, merged greedily into rectangles within every slice
+    auto isInside = [&](int x, int y, int z)
+    {
+        return x >= 0 && y >= 0 && z >= 0 && x < n && y < n && z < n && inside[(z * n + y) * n + x];
+    };
+    std::vector<unsigned char> mask(static_cast<size_t>(n) * n);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        for (int side = 0; side < 2; side++)
+            for (int slice = 0; slice < n; slice++)
+            {
+                for (int row = 0; row < n; row++)
+                    for (int column = 0; column < n; column++)
+                    {
+                        glm::ivec3 cell, neighbour;
+                        cell[axis] = slice;
+                        cell[u] = column;
+                        cell[v] = row;
+                        neighbour = cell;
+                        neighbour[axis] += side ? 1 : -1;
+                        mask[row * n + column] = isInside(cell.x, cell.y, cell.z) && !isInside(neighbour.x, neighbour.y, neighbour.z);
+                    }
+                for (int row = 0; row < n; row++)
+                    for (int column = 0; column < n;)
+                    {
+                        if (!mask[row * n + column])
+                        {
+                            column++;
+                            continue;
+                        }
+                        int width = 1, height = 1;
+                        while (column + width < n && mask[row * n + column + width])
+                            width++;
+                        for (bool grow = true; grow && row + height < n; height += grow ? 1 : 0)
+                            for (int i = 0; i < width && grow; i++)
+                                grow = mask[(row + height) * n + column + i] != 0;
+                        for (int j = 0; j < height; j++)
+                            for (int i = 0; i < width; i++)
+                                mask[(row + j) * n + column + i] = 0;
+                        unsigned int base = static_cast<unsigned int>(occluder.Positions.size());
+                        for (int corner = 0; corner < 4; corner++)
+                        {
+                            glm::vec3 grid;
+                            grid[axis] = static_cast<float>(slice + side);
+                            grid[u] = static_cast<float>(column + (corner == 1 || corner == 2 ? width : 0));
+                            grid[v] = static_cast<float>(row + (corner >= 2 ? height : 0));
+                            occluder.Positions.push_back(box.Min + grid * cellSize);
+                        }
+                        unsigned int quad[6] = {base, base + 1, base + 2, base, base + 2, base + 3};
+                        occluder.Indices.insert(occluder.Indices.end(), quad, quad + 6);
+                        column += width;
+                    }
+            }
+    }
+    return occluder;
+}
+
+// counters of the last frame, reset by BeginFrame
+struct OcclusionStats
+{
+    unsigned int OccluderTriangles;   // triangles submitted as occluders
+    unsigned int RasterizedTriangles; // occluder triangles that survived clipping and reached the rasterizer
+    unsigned int TestedDraws;
+    unsigned int CulledDraws;
+    unsigned int TestedTriangles;
+    unsigned int CulledTriangles;
+};
+
+// A software occlusion culler: selected occluder meshes are rasterized each frame into a small CPU depth buffer
+// (8 pixels at a time with AVX2, one horizontal band of tiles per thread), after which bounding boxes of draws can
+// be tested against the hierarchical depth before anything is submitted to OpenGL. The occluders are transformed and
+// clipped in parallel too, in batches of about equal triangle counts. Use occluders from SimplifyOccluder rather
+// than the render meshes, they have few triangles and never cover more than the mesh.
+// Depth is stored as 1/w so it interpolates linearly in screen space; bigger values are closer to the camera.
+class OcclusionCuller
+{
+public:
+    // the resolution is rounded up to a multiple of the tile size; a threadCount of 0 uses every hardware thread
+    OcclusionCuller(unsigned int width = 256, unsigned int height = 144, unsigned int threadCount = 0)
+    {
+        Width = (width + OCCLUSION_TILE_SIZE - 1) / OCCLUSION_TILE_SIZE * OCCLUSION_TILE_SIZE;
+        Height = (height + OCCLUSION_TILE_SIZE - 1) / OCCLUSION_TILE_SIZE * OCCLUSION_TILE_SIZE;
+        tilesX = Width / OCCLUSION_TILE_SIZE;
+        tilesY = Height / OCCLUSION_TILE_SIZE;
+        depth.assign(Width * Height, 0.0f);
+        hiZ.assign(tilesX * tilesY, 0.0f);
+
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        // every band covers at least one row of tiles
+        bandCount = std::min(threadCount, tilesY);
+        bands.resize(bandCount);
+        batches.resize(bandCount);
+        for (unsigned int i = 0; i < bandCount; i++)
+        {
+            bands[i].MinY = tilesY * i / bandCount * OCCLUSION_TILE_SIZE;
+            bands[i].MaxY = tilesY * (i + 1) / bandCount * OCCLUSION_TILE_SIZE;
+        }
+    }
+
+    // clears the depth buffer and statistics, expects the view-projection matrix used for this frame
+    void BeginFrame(const glm::mat4 &viewProjection)
+    {
+        viewProj = viewProjection;
+        occluders.clear();
+        rasterizedTriangles = 0;
+        std::fill(depth.begin(), depth.end(), 0.0f);
+        std::fill(hiZ.begin(), hiZ.end(), 0.0f);
+        occluderTriangles = 0;
+        testedDraws = 0;
+        culledDraws = 0;
+        testedTriangles = 0;
+        culledTriangles = 0;
+    }
+
+    // queues the triangles of an indexed position stream as occluders; the arrays are only read in Rasterize() and
+    // must stay alive until then
+    void RenderOccluder(const float *positions, size_t stride, size_t vertexCount, const unsigned int *indices, size_t indexCount, const glm::mat4 &model)
+    {
+        Occluder occluder = {reinterpret_cast<const char *>(positions), stride, vertexCount, indices, indexCount, viewProj * model};
+        occluders.push_back(occluder);
+        occluderTriangles += static_cast<unsigned int>(indexCount / 3);
+    }
+    void RenderOccluder(const OccluderMesh &mesh, const glm::mat4 &model)
+    {
+        if (mesh.Positions.empty() || mesh.Indices.empty())
+            return;
+        RenderOccluder(&mesh.Positions[0].x, sizeof(glm::vec3), mesh.Positions.size(), &mesh.Indices[0], mesh.Indices.size(), model);
+    }
+    void RenderOccluder(const Mesh &mesh, const glm::mat4 &model)
+    {
+        if (mesh.vertices.empty() || mesh.indices.empty())
+            return;
+        RenderOccluder(&mesh.vertices[0].Position.x, sizeof(Vertex), mesh.vertices.size(), &mesh.indices[0], mesh.indices.size(), model);
+    }
+    void RenderOccluder(const vector<Mesh> &meshes, const glm::mat4 &model)
+    {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            RenderOccluder(meshes[i], model);
+    }
+
+    // transforms and clips the queued occluders, one batch per job, then rasterizes them one band of tiles per job
+    // and builds the hierarchical depth. Without a job system a thread is started per batch and per band.
+    void Rasterize(JobSystem *jobs = nullptr)
+    {
+        // split the occluders into contiguous batches of about the same number of triangles
+        size_t totalTriangles = 0;
+        for (unsigned int i = 0; i < occluders.size(); i++)
+            totalTriangles += occluders[i].IndexCount / 3;
+        size_t triangleCount = 0;
+        for (unsigned int b = 0, i = 0; b < bandCount; b++)
+        {
+            batches[b].Begin = i;
+            while (i < occluders.size() && triangleCount * bandCount < totalTriangles * (b + 1))
+                triangleCount += occluders[i++].IndexCount / 3;
+            batches[b].End = i;
+        }
+        forEach(jobs, [this](unsigned int i)
+                { setupBatch(i); });
+        for (unsigned int i = 0; i < bandCount; i++)
+            rasterizedTriangles += static_cast<unsigned int>(batches[i].Triangles.size());
+        forEach(jobs, [this](unsigned int i)
+                { rasterizeBand(i); });
+    }
+
+    // returns false when the world space box is completely hidden behind the rasterized occluders or off screen.
+    // triangleCount is only used for the statistics. Safe to call from several threads at once.
+    bool TestAABB(const AABB &box, const glm::mat4 &model, unsigned int triangleCount = 0)
+    {
+        testedDraws++;
+        testedTriangles += triangleCount;
+        if (isVisible(box, model))
+            return true;
+        culledDraws++;
+        culledTriangles += triangleCount;
+        return false;
+    }
+
+    OcclusionStats GetStats() const
+    {
+        OcclusionStats stats;
+        stats.OccluderTriangles = occluderTriangles;
+        stats.RasterizedTriangles = rasterizedTriangles;
+        stats.TestedDraws = testedDraws;
+        stats.CulledDraws = culledDraws;
+        stats.TestedTriangles = testedTriangles;
+        stats.CulledTriangles = culledTriangles;
+        return stats;
+    }
+
+    // depth buffer resolution
+    unsigned int Width;
+    unsigned int Height;
+
+private:
+    // screen space triangle, vertices in pixels with 1/w as depth
+    struct ScreenTriangle
+    {
+        float X[3], Y[3], Z[3];
+        int MinX, MaxX, MinY, MaxY;
+    };
+    // horizontal strip of tile rows owned by one thread while rasterizing
+    struct Band
+    {
+        unsigned int MinY, MaxY;
+    };
+    // an occluder queued by RenderOccluder, with its model-view-projection matrix
+    struct Occluder
+    {
+        const char *Positions;
+        size_t Stride, VertexCount;
+        const unsigned int *Indices;
+        size_t IndexCount;
+        glm::mat4 MVP;
+    };
+    // the occluders [Begin, End) set up by one job, and the screen triangles they produced
+    struct Batch
+    {
+        unsigned int Begin, End;
+        std::vector<glm::vec4> ClipVertices;
+        std::vector<ScreenTriangle> Triangles;
+    };
+
+    glm::mat4 viewProj;
+    unsigned int tilesX, tilesY;
+    // bands and batches both come in bandCount
+    unsigned int bandCount;
+    std::vector<float> depth;
+    std::vector<float> hiZ;
+    std::vector<Band> bands;
+    std::vector<Occluder> occluders;
+    std::vector<Batch> batches;
+    unsigned int occluderTriangles;
+    unsigned int rasterizedTriangles;
+    std::atomic<unsigned int> testedDraws{0};
+    std::atomic<unsigned int> culledDraws{0};
+    std::atomic<unsigned int> testedTriangles{0};
+    std::atomic<unsigned int> culledTriangles{0};
+
+    // runs function(i) for every i below bandCount, on the job system or on a thread each
+    template <typename Function>
+    void forEach(JobSystem *jobs, Function function)
+    {
+        if (jobs)
+        {
+            jobs->ParallelFor(0, bandCount, 1, [&function](unsigned int begin, unsigned int end)
+                              {
+                                  for (unsigned int i = begin; i < end; i++)
+                                      function(i);
+                              });
+            return;
+        }
+        std::vector<std::thread> workers;
+        for (unsigned int i = 1; i < bandCount; i++)
+            workers.push_back(std::thread(function, i));
+        function(0);
+        for (unsigned int i = 0; i < workers.size(); i++)
+            workers[i].join();
+    }
+
+    // transforms the occluders of a batch and sets up their triangles
+    void setupBatch(unsigned int batchIndex)
+    {
+        Batch &batch = batches[batchIndex];
+        batch.Triangles.clear();
+        for (unsigned int o = batch.Begin; o < batch.End; o++)
+        {
+            const Occluder &occluder = occluders[o];
+            batch.ClipVertices.resize(occluder.VertexCount);
+            for (size_t i = 0; i < occluder.VertexCount; i++)
+            {
+                const float *v = reinterpret_cast<const float *>(occluder.Positions + i * occluder.Stride);
+                batch.ClipVertices[i] = occluder.MVP * glm::vec4(v[0], v[1], v[2], 1.0f);
+            }
+            const std::vector<glm::vec4> &clip = batch.ClipVertices;
+            for (size_t i = 0; i + 2 < occluder.IndexCount; i += 3)
+                addTriangle(clip[occluder.Indices[i]], clip[occluder.Indices[i + 1]], clip[occluder.Indices[i + 2]], batch.Triangles);
+        }
+    }
+
+    // clips a clip space triangle against the near plane (z >= -w) and queues the resulting one or two triangles
+    void addTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c, std::vector<ScreenTriangle> &out)
+    {
+        const glm::vec4 in[3] = {a, b, c};
+        float d[3];
+        int inside = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            d[i] = in[i].z + in[i].w;
+            if (d[i] >= 0.0f)
+                inside++;
+        }
+        if (inside == 0)
+            return;
+        if (inside == 3)
+        {
+            setupTriangle(a, b, c, out);
+            return;
+        }
+        // sutherland-hodgman against a single plane gives at most four vertices
+        glm::vec4 clipped[4];
+        int count = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            int j = (i + 1) % 3;
+            if (d[i] >= 0.0f)
+                clipped[count++] = in[i];
+            if ((d[i] >= 0.0f) != (d[j] >= 0.0f))
+            {
+                float t = d[i] / (d[i] - d[j]);
+                clipped[count++] = in[i] + (in[j] - in[i]) * t;
+            }
+        }
+        setupTriangle(clipped[0], clipped[1], clipped[2], out);
+        if (count == 4)
+            setupTriangle(clipped[0], clipped[2], clipped[3], out);
+    }
+
+    // floor and ceil of a pixel coordinate, clamped to [-1, size] in float first: converting a float outside the int
+    // range is undefined, and vertices close to the camera plane project arbitrarily far
+    static int floorPixel(float value, unsigned int size)
+    {
+        return static_cast<int>(std::floor(std::max(-1.0f, std::min(static_cast<float>(size), value))));
+    }
+    static int ceilPixel(float value, unsigned int size)
+    {
+        return static_cast<int>(std::ceil(std::max(-1.0f, std::min(static_cast<float>(size), value))));
+    }
+
+    // projects a clipped triangle to the depth buffer and queues it with its pixel bounds
+    void setupTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c, std::vector<ScreenTriangle> &out)
+    {
+        const glm::vec4 *v[3] = {&a, &b, &c};
+        ScreenTriangle tri;
+        for (int i = 0; i < 3; i++)
+        {
+            // the near plane clip keeps w positive except for degenerate points exactly on the camera
+            float invW = 1.0f / std::max(v[i]->w, 1e-6f);
+            tri.X[i] = (v[i]->x * invW * 0.5f + 0.5f) * Width;
+            tri.Y[i] = (v[i]->y * invW * 0.5f + 0.5f) * Height;
+            tri.Z[i] = invW;
+        }
+        float area = (tri.X[1] - tri.X[0]) * (tri.Y[2] - tri.Y[0]) - (tri.X[2] - tri.X[0]) * (tri.Y[1] - tri.Y[0]);
+        // also drops triangles whose projection overflowed to nan
+        if (!(std::fabs(area) >= 1e-8f))
+            return;
+        // occluders are rasterized two-sided, so orient every triangle counter-clockwise
+        if (area < 0.0f)
+        {
+            std::swap(tri.X[1], tri.X[2]);
+            std::swap(tri.Y[1], tri.Y[2]);
+            std::swap(tri.Z[1], tri.Z[2]);
+        }
+        float minX = std::min(tri.X[0], std::min(tri.X[1], tri.X[2]));
+        float maxX = std::max(tri.X[0], std::max(tri.X[1], tri.X[2]));
+        float minY = std::min(tri.Y[0], std::min(tri.Y[1], tri.Y[2]));
+        float maxY = std::max(tri.Y[0], std::max(tri.Y[1], tri.Y[2]));
+        if (maxX < 0.0f || maxY < 0.0f || minX >= (float)Width || minY >= (float)Height)
+            return;
+        tri.MinX = std::max(0, floorPixel(minX, Width));
+        tri.MaxX = std::min((int)Width - 1, ceilPixel(maxX, Width));
+        tri.MinY = std::max(0, floorPixel(minY, Height));
+        tri.MaxY = std::min((int)Height - 1, ceilPixel(maxY, Height));
+        out.push_back(tri);
+    }
+
+    void rasterizeBand(unsigned int bandIndex)
+    {
+        const Band &band = bands[bandIndex];
+        // every band looks at all triangles; the bounds test is cheap next to rasterizing
+        for (unsigned int b = 0; b < bandCount; b++)
+        {
+            const std::vector<ScreenTriangle> &triangles = batches[b].Triangles;
+            for (unsigned int i = 0; i < triangles.size(); i++)
+                if (triangles[i].MinY < (int)band.MaxY && triangles[i].MaxY >= (int)band.MinY)
+                    rasterizeTriangle(triangles[i], band.MinY, band.MaxY);
+        }
+
+        // every tile keeps the farthest (smallest 1/w) depth of its pixels
+        for (unsigned int ty = band.MinY / OCCLUSION_TILE_SIZE; ty < band.MaxY / OCCLUSION_TILE_SIZE; ty++)
+        {
+            for (unsigned int tx = 0; tx < tilesX; tx++)
+            {
+                const float *row = &depth[ty * OCCLUSION_TILE_SIZE * Width + tx * OCCLUSION_TILE_SIZE];
+#if defined(__AVX2__)
+                __m256 farthest = _mm256_loadu_ps(row);
+                for (unsigned int y = 1; y < OCCLUSION_TILE_SIZE; y++)
+                    farthest = _mm256_min_ps(farthest, _mm256_loadu_ps(row + y * Width));
+                __m128 m = _mm_min_ps(_mm256_castps256_ps128(farthest), _mm256_extractf128_ps(farthest, 1));
+                m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+                m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+                hiZ[ty * tilesX + tx] = _mm_cvtss_f32(m);
+#else
+                float farthest = row[0];
+                for (unsigned int y = 0; y < OCCLUSION_TILE_SIZE; y++)
+                    for (unsigned int x = 0; x < OCCLUSION_TILE_SIZE; x++)
+                        farthest = std::min(farthest, row[y * Width + x]);
+                hiZ[ty * tilesX + tx] = farthest;
+#endif
+            }
+        }
+    }
+
+    // edge function rasterizer, pixel centers at half integers; keeps the closest (largest) 1/w per pixel
+    void rasterizeTriangle(const ScreenTriangle &tri, unsigned int bandMinY, unsigned int bandMaxY)
+    {
+        // edge i goes from vertex i to vertex i + 1, E(x, y) = A * x + B * y + C is positive inside
+        float A[3], B[3], C[3];
+        for (int i = 0; i < 3; i++)
+        {
+            int j = (i + 1) % 3;
+            A[i] = -(tri.Y[j] - tri.Y[i]);
+            B[i] = tri.X[j] - tri.X[i];
+            C[i] = -(A[i] * tri.X[i] + B[i] * tri.Y[i]);
+        }
+        // depth plane z = zA * x + zB * y + zC
+        float dx1 = tri.X[1] - tri.X[0], dy1 = tri.Y[1] - tri.Y[0], dz1 = tri.Z[1] - tri.Z[0];
+        float dx2 = tri.X[2] - tri.X[0], dy2 = tri.Y[2] - tri.Y[0], dz2 = tri.Z[2] - tri.Z[0];
+        float det = dx1 * dy2 - dx2 * dy1;
+        float zA = (dz1 * dy2 - dz2 * dy1) / det;
+        float zB = (dx1 * dz2 - dx2 * dz1) / det;
+        float zC = tri.Z[0] - zA * tri.X[0] - zB * tri.Y[0];
+
+        int minY = std::max(tri.MinY, (int)bandMinY);
+        int maxY = std::min(tri.MaxY, (int)bandMaxY - 1);
+        // start on an 8 pixel boundary; the buffer width is a multiple of 8 so a block never leaves the row
+        int minX = tri.MinX & ~7;
+#if defined(__AVX2__)
+        const __m256 laneX = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+        const __m256 a0 = _mm256_set1_ps(A[0]), a1 = _mm256_set1_ps(A[1]), a2 = _mm256_set1_ps(A[2]);
+        const __m256 za = _mm256_set1_ps(zA);
+#endif
+        for (int y = minY; y <= maxY; y++)
+        {
+            float fy = (float)y + 0.5f;
+            float row0 = B[0] * fy + C[0], row1 = B[1] * fy + C[1], row2 = B[2] * fy + C[2];
+            float rowZ = zB * fy + zC;
+            float *dst = &depth[y * Width];
+#if defined(__AVX2__)
+            const __m256 r0 = _mm256_set1_ps(row0), r1 = _mm256_set1_ps(row1), r2 = _mm256_set1_ps(row2);
+            const __m256 rz = _mm256_set1_ps(rowZ);
+            for (int x = minX; x <= tri.MaxX; x += 8)
+            {
+                __m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), laneX);
+                __m256 e0 = _mm256_add_ps(_mm256_mul_ps(a0, px), r0);
+                __m256 e1 = _mm256_add_ps(_mm256_mul_ps(a1, px), r1);
+                __m256 e2 = _mm256_add_ps(_mm256_mul_ps(a2, px), r2);
+                // a lane is outside when the sign bit of any edge is set
+                __m256 outside = _mm256_or_ps(e0, _mm256_or_ps(e1, e2));
+                if (_mm256_movemask_ps(outside) == 0xFF)
+                    continue;
+                __m256 z = _mm256_add_ps(_mm256_mul_ps(za, px), rz);
+                __m256 old = _mm256_loadu_ps(dst + x);
+                _mm256_storeu_ps(dst + x, _mm256_blendv_ps(_mm256_max_ps(old, z), old, outside));
+            }
+#else
+            for (int x = minX; x <= tri.MaxX; x++)
+            {
+                float fx = (float)x + 0.5f;
+                if (A[0] * fx + row0 < 0.0f || A[1] * fx + row1 < 0.0f || A[2] * fx + row2 < 0.0f)
+                    continue;
+                dst[x] = std::max(dst[x], zA * fx + rowZ);
+            }
+#endif
+        }
+    }
+
+    bool isVisible(const AABB &box, const glm::mat4 &model) const
+    {
+        glm::mat4 mvp = viewProj * model;
+        float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+        float closestW = 1e30f;
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner((i & 1) ? box.Max.x : box.Min.x, (i & 2) ? box.Max.y : box.Min.y, (i & 4) ? box.Max.z : box.Min.z);
+            glm::vec4 clip = mvp * glm::vec4(corner, 1.0f);
+            // a box crossing the near plane can't be projected conservatively, so it is always drawn
+            if (clip.z < -clip.w || clip.w <= 0.0f)
+                return true;
+            float x = (clip.x / clip.w * 0.5f + 0.5f) * Width;
+            float y = (clip.y / clip.w * 0.5f + 0.5f) * Height;
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+            closestW = std::min(closestW, clip.w);
+        }
+        // completely off screen
+        if (maxX < 0.0f || maxY < 0.0f || minX >= (float)Width || minY >= (float)Height)
+            return false;
+        float boxZ = 1.0f / closestW;
+        int x0 = std::max(0, floorPixel(minX, Width)), x1 = std::min((int)Width - 1, ceilPixel(maxX, Width));
+        int y0 = std::max(0, floorPixel(minY, Height)), y1 = std::min((int)Height - 1, ceilPixel(maxY, Height));
+        for (int ty = y0 / OCCLUSION_TILE_SIZE; ty <= y1 / OCCLUSION_TILE_SIZE; ty++)
+        {
+            for (int tx = x0 / OCCLUSION_TILE_SIZE; tx <= x1 / OCCLUSION_TILE_SIZE; tx++)
+            {
+                // the whole tile is closer than the box: nothing to check per pixel
+                if (boxZ <= hiZ[ty * tilesX + tx])
+                    continue;
+                int py0 = std::max(y0, ty * OCCLUSION_TILE_SIZE), py1 = std::min(y1, ty * OCCLUSION_TILE_SIZE + OCCLUSION_TILE_SIZE - 1);
+                int px0 = std::max(x0, tx * OCCLUSION_TILE_SIZE), px1 = std::min(x1, tx * OCCLUSION_TILE_SIZE + OCCLUSION_TILE_SIZE - 1);
+                for (int y = py0; y <= py1; y++)
+                    for (int x = px0; x <= px1; x++)
+                        if (boxZ > depth[y * Width + x])
+                            return true;
+            }
+        }
+        return false;
+    }
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include <cstdint>
+
+// Philox4x32-10 counter based random number generator (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3").
+// Every call is a pure function of the seed and a counter, there is no state carried from one number to the next. Using
+// the element index as counter gives every element its own random numbers no matter which thread generates it or in
+// which order, so procedural content stays the same for any number of threads.
+class Philox
+{
+public:
+    Philox(uint64_t seed)
+    {
+        key[0] = static_cast<uint32_t>(seed);
+        key[1] = static_cast<uint32_t>(seed >> 32);
+    }
+
+    // four random 32 bit numbers for the given index; stream selects further independent numbers for the same index
+    void Generate(uint32_t index, uint32_t stream, uint32_t out[4]) const
+    {
+        uint32_t c[4] = {index, stream, 0u, 0u};
+        uint32_t k[2] = {key[0], key[1]};
+        for (int round = 0; round < 10; round++)
+        {
+            if (round > 0)
+            {
+                k[0] += PHILOX_W0;
+                k[1] += PHILOX_W1;
+            }
+            uint64_t p0 = static_cast<uint64_t>(PHILOX_M0) * c[0];
+            uint64_t p1 = static_cast<uint64_t>(PHILOX_M1) * c[2];
+            uint32_t next[4] = {static_cast<uint32_t>(p1 >> 32) ^ c[1] ^ k[0], static_cast<uint32_t>(p1),
+                                static_cast<uint32_t>(p0 >> 32) ^ c[3] ^ k[1], static_cast<uint32_t>(p0)};
+            for (int i = 0; i < 4; i++)
+                c[i] = next[i];
+        }
+        for (int i = 0; i < 4; i++)
+            out[i] = c[i];
+    }
+
+    // the numbers of eight consecutive indices, out[i][lane] == Generate(firstIndex + lane, stream)[i]
+    void Generate8(uint32_t firstIndex, uint32_t stream, uint32_t out[4][8]) const
+    {
+#if defined(__AVX2__)
+        __m256i c0 = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(firstIndex)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        __m256i c1 = _mm256_set1_epi32(static_cast<int>(stream));
+        __m256i c2 = _mm256_setzero_si256();
+        __m256i c3 = _mm256_setzero_si256();
+        __m256i k0 = _mm256_set1_epi32(static_cast<int>(key[0]));
+        __m256i k1 = _mm256_set1_epi32(static_cast<int>(key[1]));
+        const __m256i m0 = _mm256_set1_epi32(static_cast<int>(PHILOX_M0)), m1 = _mm256_set1_epi32(static_cast<int>(PHILOX_M1));
+        const __m256i w0 = _mm256_set1_epi32(static_cast<int>(PHILOX_W0)), w1 = _mm256_set1_epi32(static_cast<int>(PHILOX_W1));
+        for (int round = 0; round < 10; round++)
+        {
+            if (round > 0)
+            {
+                k0 = _mm256_add_epi32(k0, w0);
+                k1 = _mm256_add_epi32(k1, w1);
+            }
+            __m256i lo0, hi0, lo1, hi1;
+            mulHiLo(m0, c0, lo0, hi0);
+            mulHiLo(m1, c2, lo1, hi1);
+            c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), k0);
+            c1 = lo1;
+            c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), k1);
+            c3 = lo0;
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out[0]), c0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out[1]), c1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out[2]), c2);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out[3]), c3);
+#else
+        for (uint32_t lane = 0; lane < 8; lane++)
+        {
+            uint32_t values[4];
+            Generate(firstIndex + lane, stream, values);
+            for (int i = 0; i < 4; i++)
+                out[i][lane] = values[i];
+        }
+#endif
+    }
+
+    // maps 32 random bits to a float in [0, 1); exact, so it gives the same value on every code path
+    static float Uniform(uint32_t bits)
+    {
+        return static_cast<float>(bits >> 8) * (1.0f / 16777216.0f);
+    }
+
+private:
+    static const uint32_t PHILOX_M0 = 0xD2511F53u;
+    static const uint32_t PHILOX_M1 = 0xCD9E8D57u;
+    static const uint32_t PHILOX_W0 = 0x9E3779B9u;
+    static const uint32_t PHILOX_W1 = 0xBB67AE85u;
+
+    uint32_t key[2];
+
+#if defined(__AVX2__)
+    // 32 x 32 -> 64 bit products of all eight lanes, split into the low and high halves
+    static void mulHiLo(__m256i a, __m256i b, __m256i &lo, __m256i &hi)
+    {
+        __m256i even = _mm256_mul_epu32(a, b);
+        __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+        lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+        hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+    }
+#endif
+};
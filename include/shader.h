@@ -39,9 +39,9 @@ public:
             // close file handlers
             vShaderFile.close();
             fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+            // convert stream into string, pasting in the files the shaders #include
+            vertexCode = resolveIncludes(vShaderStream.str(), vertexPath);
+            fragmentCode = resolveIncludes(fShaderStream.str(), fragmentPath);
             // if geometry shader path is present, also load a geometry shader
             if (geometryPath != nullptr)
             {
@@ -49,7 +49,7 @@ public:
                 std::stringstream gShaderStream;
                 gShaderStream << gShaderFile.rdbuf();
                 gShaderFile.close();
-                geometryCode = gShaderStream.str();
+                geometryCode = resolveIncludes(gShaderStream.str(), geometryPath);
             }
         }
         catch (std::ifstream::failure &e)
@@ -161,6 +161,34 @@ public:
     }
 
 private:
+    // replaces every #include "file" line with the contents of file, which may include further files; the path is
+    // relative to the including file, so samples can share GLSL such as include/shaders/gbuffer.glsl. A missing file
+    // throws like a missing shader does.
+    static std::string resolveIncludes(const std::string &code, const std::string &path)
+    {
+        std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+        std::stringstream in(code), out;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            size_t start = line.find_first_not_of(" \t");
+            size_t open = line.find('"');
+            size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+            if (start == std::string::npos || line.compare(start, 8, "#include") != 0 || close == std::string::npos)
+            {
+                out << line << "\n";
+                continue;
+            }
+            std::string includePath = directory + line.substr(open + 1, close - open - 1);
+            std::ifstream includeFile;
+            includeFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+            includeFile.open(includePath);
+            std::stringstream includeStream;
+            includeStream << includeFile.rdbuf();
+            out << resolveIncludes(includeStream.str(), includePath) << "\n";
+        }
+        return out.str();
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
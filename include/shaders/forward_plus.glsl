@@ -0,0 +1,31 @@
+// forward+ lights for the forward shaders (ForwardPlus::Bind in forward_plus.h sets these), pulled in with #include:
+// two texels per light (position and radius, color), the lights of every 16x16 tile as a bit mask
+uniform samplerBuffer lightData;
+uniform usampler2D lightMask0;
+uniform usampler2D lightMask1;
+uniform int tileLightCount;
+uniform int tileSize;
+// off: every light, to compare against
+uniform bool tiledLights;
+
+// the 256 bit light mask of this fragment's tile, or all lights with tiledLights off; walk the set bits with
+//   for(int b=0;bits!=0u;++b,bits>>=1u) if((bits&1u)!=0u) ... light w*32+b ...
+// the loop stops after the highest set bit, empty words cost nothing
+void tileLightWords(out uint words[8])
+{
+    if(tiledLights)
+    {
+        ivec2 tile=ivec2(gl_FragCoord.xy)/tileSize;
+        uvec4 mask0=texelFetch(lightMask0,tile,0);
+        uvec4 mask1=texelFetch(lightMask1,tile,0);
+        words=uint[8](mask0.x,mask0.y,mask0.z,mask0.w,mask1.x,mask1.y,mask1.z,mask1.w);
+    }
+    else
+    {
+        for(int w=0;w<8;++w)
+        {
+            int bits=clamp(tileLightCount-w*32,0,32);
+            words[w]=bits==32?0xFFFFFFFFu:(1u<<uint(bits))-1u;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+#version 330 core
+// depth only: the color writes are masked during the pre-pass
+
+void main()
+{
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#version 330 core
+// one fragment per tile: bit masks of the lights whose sphere touches the tile's view space box. The opaque masks
+// cover the tile between its min and max pre-pass depth; transparent surfaces aren't in the pre-pass and may lie
+// anywhere in front of the opaque ones, so their masks cover the tile from the near plane to the max depth (to the far
+// plane where nothing opaque was drawn).
+layout(location=0)out uvec4 LightMask0;
+layout(location=1)out uvec4 LightMask1;
+layout(location=2)out uvec4 TransparentMask0;
+layout(location=3)out uvec4 TransparentMask1;
+
+uniform sampler2D tileDepth;
+uniform samplerBuffer lightData;
+uniform int lightCount;
+uniform mat4 view;
+uniform vec2 projectionScale;
+uniform vec2 tileScale;
+// view depth of the near and far plane
+uniform vec2 clipDepth;
+
+// the tile's frustum between two depths, bounded by a box; x and y grow with depth
+void tileBox(vec2 tile,vec2 depthRange,out vec3 boxMin,out vec3 boxMax)
+{
+    vec2 ndc0=tile*tileScale*2.-1.;
+    vec2 ndc1=min((tile+1.)*tileScale,1.)*2.-1.;
+    boxMin=vec3(min(ndc0*depthRange.x,ndc0*depthRange.y)/projectionScale,depthRange.x);
+    boxMax=vec3(max(ndc1*depthRange.x,ndc1*depthRange.y)/projectionScale,depthRange.y);
+}
+
+bool touches(vec3 position,float radius,vec3 boxMin,vec3 boxMax)
+{
+    vec3 d=position-clamp(position,boxMin,boxMax);
+    return dot(d,d)<=radius*radius;
+}
+
+void main()
+{
+    uint words[8]=uint[8](0u,0u,0u,0u,0u,0u,0u,0u);
+    uint transparentWords[8]=uint[8](0u,0u,0u,0u,0u,0u,0u,0u);
+    vec2 tile=floor(gl_FragCoord.xy);
+    vec2 depthRange=texelFetch(tileDepth,ivec2(tile),0).rg;
+    bool opaque=depthRange.x<=depthRange.y;
+    vec3 boxMin,boxMax,transparentMin,transparentMax;
+    tileBox(tile,depthRange,boxMin,boxMax);
+    tileBox(tile,vec2(clipDepth.x,opaque?depthRange.y:clipDepth.y),transparentMin,transparentMax);
+    for(int i=0;i<lightCount;++i)
+    {
+        vec4 light=texelFetch(lightData,i*2);
+        vec3 position=vec3(view*vec4(light.xyz,1.));
+        position.z=-position.z;
+        // the transparent box contains the opaque one
+        if(!touches(position,light.w,transparentMin,transparentMax))
+        continue;
+        transparentWords[i>>5]|=1u<<uint(i&31);
+        if(opaque&&touches(position,light.w,boxMin,boxMax))
+        words[i>>5]|=1u<<uint(i&31);
+    }
+    LightMask0=uvec4(words[0],words[1],words[2],words[3]);
+    LightMask1=uvec4(words[4],words[5],words[6],words[7]);
+    TransparentMask0=uvec4(transparentWords[0],transparentWords[1],transparentWords[2],transparentWords[3]);
+    TransparentMask1=uvec4(transparentWords[4],transparentWords[5],transparentWords[6],transparentWords[7]);
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#version 330 core
+// one fragment per tile: min and max view depth of the pre-pass depth inside the tile
+out vec2 FragDepth;
+
+uniform sampler2D depthTexture;
+// the pre-pass depth when it is multisampled (sampleCount > 1); every sample counts towards the tile's range
+uniform sampler2DMS depthTextureMS;
+uniform int sampleCount;
+uniform int tileSize;
+uniform mat4 projection;
+
+void main()
+{
+    ivec2 base=ivec2(gl_FragCoord.xy)*tileSize;
+    ivec2 last=(sampleCount>1?textureSize(depthTextureMS):textureSize(depthTexture,0))-1;
+    float minDepth=1e30;
+    float maxDepth=0.;
+    for(int y=0;y<tileSize;++y)
+    for(int x=0;x<tileSize;++x)
+    for(int s=0;s<sampleCount;++s)
+    {
+        ivec2 pixel=min(base+ivec2(x,y),last);
+        float depth=sampleCount>1?texelFetch(depthTextureMS,pixel,s).r:texelFetch(depthTexture,pixel,0).r;
+        // the background doesn't need lights
+        if(depth<1.)
+        {
+            // positive view depth from the hyperbolic window depth
+            float viewDepth=projection[3][2]/(depth*2.-1.+projection[2][2]);
+            minDepth=min(minDepth,viewDepth);
+            maxDepth=max(maxDepth,viewDepth);
+        }
+    }
+    // an empty tile ends up with min > max and gets no opaque lights
+    FragDepth=vec2(minDepth,maxDepth);
+}
\ No newline at end of file
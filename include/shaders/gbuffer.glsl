@@ -0,0 +1,33 @@
+// G-buffer helpers shared by the deferred and SSAO shaders, pulled in with #include (see Shader::resolveIncludes).
+// The G-buffer keeps an octahedral encoded normal and no position: positions come back from the depth buffer.
+
+// octahedral normal encoding: project onto the octahedron |x|+|y|+|z|=1 and fold the lower half over the upper one
+vec2 encodeNormal(vec3 n)
+{
+    n/=abs(n.x)+abs(n.y)+abs(n.z);
+    vec2 e=n.z>=0.?n.xy:(1.-abs(n.yx))*vec2(n.x>=0.?1.:-1.,n.y>=0.?1.:-1.);
+    return e*.5+.5;
+}
+
+// inverse of encodeNormal
+vec3 decodeNormal(vec2 e)
+{
+    e=e*2.-1.;
+    vec3 n=vec3(e,1.-abs(e.x)-abs(e.y));
+    float t=clamp(-n.z,0.,1.);
+    n.xy+=vec2(n.x>=0.?-t:t,n.y>=0.?-t:t);
+    return normalize(n);
+}
+
+// position from a depth buffer value: the inverse projection gives view space, the inverse view projection world space
+vec3 positionFromDepth(vec2 uv,float depth,mat4 inverseMatrix)
+{
+    vec4 position=inverseMatrix*vec4(vec3(uv,depth)*2.-1.,1.);
+    return position.xyz/position.w;
+}
+
+// view space position from a linear view space z (negative in front of the camera)
+vec3 positionFromViewZ(vec2 uv,float viewZ,mat4 projection)
+{
+    return vec3((uv*2.-1.)*-viewZ/vec2(projection[0][0],projection[1][1]),viewZ);
+}
\ No newline at end of file
@@ -0,0 +1,441 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// lights the atlas keeps tiles for; light ids go from 0 to SHADOW_ATLAS_MAX_LIGHTS - 1
+#define SHADOW_ATLAS_MAX_LIGHTS 64
+// a spot light takes one tile, a point light one per cube face
+#define SHADOW_ATLAS_MAX_FACES 6
+// texels per tile in the tile buffer: the light space matrix and the tile rect
+#define SHADOW_ATLAS_TILE_TEXELS 5
+
+// Buddy allocator for square power of two tiles in a square texture. Every node is free, split into four children, or
+// used; a free node whose parent is split (or the root) is a free block. Allocate takes the smallest free block that
+// fits and splits it down to the requested size, Free merges four free siblings back into their parent.
+class QuadtreeAllocator
+{
+public:
+    QuadtreeAllocator(unsigned int size, unsigned int minSize) : size(size)
+    {
+        levels = 1;
+        while ((size >> (levels - 1)) > minSize)
+            levels++;
+        states.assign(levelOffset(levels), FREE);
+    }
+
+    // returns the node of a size x size tile, or -1 when no free block is large enough
+    int Allocate(unsigned int tileSize)
+    {
+        unsigned int target = 0;
+        while (target + 1 < levels && (size >> (target + 1)) >= tileSize)
+            target++;
+        // best fit: the deepest level that still has a free block
+        for (int level = static_cast<int>(target); level >= 0; level--)
+        {
+            unsigned int begin = levelOffset(level), end = levelOffset(level + 1);
+            for (unsigned int node = begin; node < end; node++)
+            {
+                if (states[node] != FREE || (level > 0 && states[parent(node, level)] != SPLIT))
+                    continue;
+                // split down to the requested level, always continuing in the first child
+                for (unsigned int l = level; l < target; l++)
+                {
+                    states[node] = SPLIT;
+                    unsigned int child = firstChild(node, l);
+                    for (unsigned int c = 0; c < 4; c++)
+                        states[child + c] = FREE;
+                    node = child;
+                }
+                states[node] = USED;
+                usedTexels += (size >> target) * (size >> target);
+                return static_cast<int>(node);
+            }
+        }
+        return -1;
+    }
+
+    void Free(int node)
+    {
+        unsigned int n = static_cast<unsigned int>(node);
+        unsigned int level = levelOf(n);
+        states[n] = FREE;
+        usedTexels -= (size >> level) * (size >> level);
+        while (level > 0)
+        {
+            unsigned int p = parent(n, level);
+            unsigned int child = firstChild(p, level - 1);
+            if (states[child] != FREE || states[child + 1] != FREE || states[child + 2] != FREE || states[child + 3] != FREE)
+                break;
+            states[p] = FREE;
+            n = p;
+            level--;
+        }
+    }
+
+    // texel rect of a node
+    void GetRect(int node, unsigned int &x, unsigned int &y, unsigned int &tileSize) const
+    {
+        unsigned int n = static_cast<unsigned int>(node);
+        unsigned int level = levelOf(n);
+        unsigned int index = n - levelOffset(level);
+        // even bits of the index are x, odd bits y
+        unsigned int column = 0, row = 0;
+        for (unsigned int bit = 0; bit < level; bit++)
+        {
+            column |= ((index >> (2 * bit)) & 1u) << bit;
+            row |= ((index >> (2 * bit + 1)) & 1u) << bit;
+        }
+        tileSize = size >> level;
+        x = column * tileSize;
+        y = row * tileSize;
+    }
+
+    float GetUsedFraction() const
+    {
+        return static_cast<float>(usedTexels) / (static_cast<float>(size) * size);
+    }
+
+private:
+    enum State : unsigned char
+    {
+        FREE,
+        SPLIT,
+        USED
+    };
+
+    unsigned int size;
+    unsigned int levels;
+    // all levels one after another; within a level the four children of a node are consecutive (Morton order)
+    std::vector<State> states;
+    unsigned long long usedTexels = 0;
+
+    // nodes above level: (4^level - 1) / 3
+    static unsigned int levelOffset(unsigned int level)
+    {
+        return ((1u << (2 * level)) - 1) / 3;
+    }
+    unsigned int levelOf(unsigned int node) const
+    {
+        unsigned int level = 0;
+        while (node >= levelOffset(level + 1))
+            level++;
+        return level;
+    }
+    static unsigned int firstChild(unsigned int node, unsigned int level)
+    {
+        return levelOffset(level + 1) + (node - levelOffset(level)) * 4;
+    }
+    static unsigned int parent(unsigned int node, unsigned int level)
+    {
+        return levelOffset(level - 1) + (node - levelOffset(level)) / 4;
+    }
+};
+
+// One depth texture shared by the shadows of many spot and point lights. Every light gets a square tile per face
+// whose size the caller derives from how much of the screen the light covers; the tiles are handed out by a quadtree
+// allocator and kept from frame to frame. A light's tiles are only redrawn when they are new or the light was
+// invalidated, most important and longest waiting first, and never more than UpdateBudget tiles a frame, so a stale
+// shadow is shown for a few frames instead of the frame time spiking. Per frame:
+//   atlas.BeginFrame();
+//   for every visible light: atlas.Request(light, faces, desiredSize, importance); and, if it moved, atlas.Invalidate(light);
+//   for every update in atlas.Update(): atlas.BeginTile(update.Light, update.Face, lightSpaceMatrix); draw the casters
+//   atlas.End(); atlas.Bind(shader, atlasUnit, tileUnit);
+// Lights that aren't requested keep their tiles until the space is needed (least recently requested first). A tile
+// stores the distance to the light divided by its radius, like the point shadow cubemap, so spot and point lights are
+// compared the same way. The shader reads the tiles from a buffer texture, SHADOW_ATLAS_TILE_TEXELS texels for tile
+// light * SHADOW_ATLAS_MAX_FACES + face: the four columns of the light space matrix, then the tile rect in atlas uv
+// (x, y, size) with w = 1 when the tile holds a shadow and 0 when the light is unshadowed:
+//   uniform sampler2D shadowAtlas; uniform samplerBuffer shadowTiles;
+class ShadowAtlas
+{
+public:
+    struct TileUpdate
+    {
+        unsigned int Light;
+        unsigned int Face;
+    };
+
+    unsigned int FBO;
+    unsigned int DepthTexture;
+    // the tile records, a GL_TEXTURE_BUFFER over RGBA32F
+    unsigned int TileTexture;
+    unsigned int Size;
+    unsigned int MinTileSize;
+    unsigned int MaxTileSize;
+    // tiles redrawn per frame at most
+    unsigned int UpdateBudget = 16;
+
+    ShadowAtlas(unsigned int size = 4096, unsigned int minTileSize = 64, unsigned int maxTileSize = 1024)
+        : Size(size), MinTileSize(minTileSize), MaxTileSize(std::min(maxTileSize, size)), allocator(size, minTileSize)
+    {
+        glGenTextures(1, &DepthTexture);
+        glBindTexture(GL_TEXTURE_2D, DepthTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, DepthTexture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: shadow atlas framebuffer is not complete!" << std::endl;
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        records.assign(SHADOW_ATLAS_MAX_LIGHTS * SHADOW_ATLAS_MAX_FACES * SHADOW_ATLAS_TILE_TEXELS, glm::vec4(0.0f));
+        glGenBuffers(1, &tileBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, tileBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, records.size() * sizeof(glm::vec4), records.data(), GL_DYNAMIC_DRAW);
+        glGenTextures(1, &TileTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, TileTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, tileBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    void BeginFrame()
+    {
+        frame++;
+        requested.clear();
+    }
+
+    // the light is visible this frame: it wants faces tiles of about desiredSize texels; more important lights are
+    // served first when the atlas is full and have their tiles redrawn first
+    void Request(unsigned int light, unsigned int faces, float desiredSize, float importance)
+    {
+        if (light >= SHADOW_ATLAS_MAX_LIGHTS)
+            return;
+        Slot &slot = slots[light];
+        if (slot.Faces != faces)
+        {
+            release(light);
+            slot.Faces = std::min<unsigned int>(faces, SHADOW_ATLAS_MAX_FACES);
+        }
+        slot.DesiredSize = std::max(static_cast<float>(MinTileSize), std::min(desiredSize, static_cast<float>(MaxTileSize)));
+        slot.Importance = importance;
+        slot.LastRequested = frame;
+        requested.push_back(light);
+    }
+
+    // the light or something casting into its tiles moved; its tiles are redrawn when the budget allows
+    void Invalidate(unsigned int light)
+    {
+        if (light >= SHADOW_ATLAS_MAX_LIGHTS)
+            return;
+        for (unsigned int face = 0; face < SHADOW_ATLAS_MAX_FACES; face++)
+            slots[light].Dirty[face] = true;
+    }
+
+    // hands out the tiles for this frame's requests and returns the tiles to redraw
+    const std::vector<TileUpdate> &Update()
+    {
+        std::sort(requested.begin(), requested.end(), [this](unsigned int a, unsigned int b)
+                  { return slots[a].Importance > slots[b].Importance; });
+        // when the requests add up to more than the atlas can hold, every light shrinks by the same factor instead of
+        // the first ones taking everything; a quarter is left for the space lost to rounding and fragmentation
+        float requestedTexels = 0.0f;
+        for (unsigned int i = 0; i < requested.size(); i++)
+            requestedTexels += slots[requested[i]].Faces * slots[requested[i]].DesiredSize * slots[requested[i]].DesiredSize;
+        float capacity = ATLAS_FILL * static_cast<float>(Size) * static_cast<float>(Size);
+        float scale = requestedTexels > capacity ? std::sqrt(capacity / requestedTexels) : 1.0f;
+        for (unsigned int i = 0; i < requested.size(); i++)
+        {
+            unsigned int light = requested[i];
+            Slot &slot = slots[light];
+            // sizes snap to powers of two with some hysteresis, so a light moving across a boundary doesn't flip
+            // between two sizes (and get redrawn) every frame
+            float wanted = std::log2(std::max(static_cast<float>(MinTileSize), slot.DesiredSize * scale));
+            if (slot.Nodes[0] >= 0 && std::abs(wanted - std::log2(static_cast<float>(slot.TileSize))) < 0.75f)
+                continue;
+            unsigned int tileSize = 1u << static_cast<unsigned int>(std::round(wanted));
+            // the old tiles are only given up once the new ones are found; when the atlas is full the light keeps
+            // what it has, or tries smaller tiles if it has nothing
+            int nodes[SHADOW_ATLAS_MAX_FACES];
+            bool found = allocate(slot.Faces, tileSize, nodes);
+            while (!found && slot.Nodes[0] < 0 && tileSize > MinTileSize)
+            {
+                tileSize /= 2;
+                found = allocate(slot.Faces, tileSize, nodes);
+            }
+            if (!found)
+                continue;
+            release(light);
+            slot.TileSize = tileSize;
+            for (unsigned int face = 0; face < slot.Faces; face++)
+            {
+                slot.Nodes[face] = nodes[face];
+                slot.Drawn[face] = false;
+            }
+        }
+
+        // new tiles first, then invalidated ones by importance times frames waited
+        std::vector<std::pair<float, TileUpdate>> candidates;
+        for (unsigned int i = 0; i < requested.size(); i++)
+        {
+            Slot &slot = slots[requested[i]];
+            if (slot.Nodes[0] < 0)
+                continue;
+            for (unsigned int face = 0; face < slot.Faces; face++)
+            {
+                if (!slot.Drawn[face])
+                    candidates.push_back(std::make_pair(1e9f + slot.Importance, TileUpdate{requested[i], face}));
+                else if (slot.Dirty[face])
+                    candidates.push_back(std::make_pair(slot.Importance * static_cast<float>(frame - slot.LastDrawn[face]), TileUpdate{requested[i], face}));
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const std::pair<float, TileUpdate> &a, const std::pair<float, TileUpdate> &b)
+                  { return a.first > b.first; });
+        updates.clear();
+        for (unsigned int i = 0; i < candidates.size() && i < UpdateBudget; i++)
+            updates.push_back(candidates[i].second);
+        return updates;
+    }
+
+    // binds and clears the tile for drawing with lightSpaceMatrix, which the shader will sample it with
+    void BeginTile(unsigned int light, unsigned int face, const glm::mat4 &lightSpaceMatrix)
+    {
+        Slot &slot = slots[light];
+        unsigned int x, y, tileSize;
+        allocator.GetRect(slot.Nodes[face], x, y, tileSize);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glViewport(x, y, tileSize, tileSize);
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(x, y, tileSize, tileSize);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        slot.Matrices[face] = lightSpaceMatrix;
+        slot.Drawn[face] = true;
+        slot.Dirty[face] = false;
+        slot.LastDrawn[face] = frame;
+        writeRecord(light, face);
+    }
+
+    // unbinds the atlas and uploads the tile records if any changed; the caller restores the viewport
+    void End()
+    {
+        glDisable(GL_SCISSOR_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (!recordsDirty)
+            return;
+        glBindBuffer(GL_TEXTURE_BUFFER, tileBuffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, records.size() * sizeof(glm::vec4), records.data());
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        recordsDirty = false;
+    }
+
+    // binds the atlas and the tile buffer
+    void Bind(Shader &shader, unsigned int atlasUnit, unsigned int tileUnit)
+    {
+        shader.setInt("shadowAtlas", atlasUnit);
+        shader.setInt("shadowTiles", tileUnit);
+        glActiveTexture(GL_TEXTURE0 + atlasUnit);
+        glBindTexture(GL_TEXTURE_2D, DepthTexture);
+        glActiveTexture(GL_TEXTURE0 + tileUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, TileTexture);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // tile edge of a light in texels, 0 when it has no tiles
+    unsigned int GetTileSize(unsigned int light) const
+    {
+        return slots[light].Nodes[0] >= 0 ? slots[light].TileSize : 0;
+    }
+    float GetUsedFraction() const
+    {
+        return allocator.GetUsedFraction();
+    }
+
+private:
+    static constexpr float ATLAS_FILL = 0.75f;
+
+    struct Slot
+    {
+        unsigned int Faces = 0;
+        unsigned int TileSize = 0;
+        int Nodes[SHADOW_ATLAS_MAX_FACES] = {-1, -1, -1, -1, -1, -1};
+        glm::mat4 Matrices[SHADOW_ATLAS_MAX_FACES];
+        // the tile holds a shadow for its current place in the atlas
+        bool Drawn[SHADOW_ATLAS_MAX_FACES] = {};
+        bool Dirty[SHADOW_ATLAS_MAX_FACES] = {};
+        unsigned int LastDrawn[SHADOW_ATLAS_MAX_FACES] = {};
+        unsigned int LastRequested = 0;
+        float DesiredSize = 0.0f;
+        float Importance = 0.0f;
+    };
+
+    QuadtreeAllocator allocator;
+    Slot slots[SHADOW_ATLAS_MAX_LIGHTS];
+    std::vector<unsigned int> requested;
+    std::vector<TileUpdate> updates;
+    unsigned int frame = 0;
+    unsigned int tileBuffer;
+    std::vector<glm::vec4> records;
+    bool recordsDirty = false;
+
+    // faces tiles of tileSize, all or none; lights that weren't requested this frame give up their tiles, least
+    // recently requested first, until they fit
+    bool allocate(unsigned int faces, unsigned int tileSize, int *nodes)
+    {
+        while (true)
+        {
+            unsigned int count = 0;
+            for (; count < faces; count++)
+            {
+                nodes[count] = allocator.Allocate(tileSize);
+                if (nodes[count] < 0)
+                    break;
+            }
+            if (count == faces)
+                return true;
+            for (unsigned int i = 0; i < count; i++)
+                allocator.Free(nodes[i]);
+            int oldest = -1;
+            for (unsigned int light = 0; light < SHADOW_ATLAS_MAX_LIGHTS; light++)
+                if (slots[light].Nodes[0] >= 0 && slots[light].LastRequested != frame && (oldest < 0 || slots[light].LastRequested < slots[oldest].LastRequested))
+                    oldest = static_cast<int>(light);
+            if (oldest < 0)
+                return false;
+            release(static_cast<unsigned int>(oldest));
+        }
+    }
+
+    void release(unsigned int light)
+    {
+        Slot &slot = slots[light];
+        for (unsigned int face = 0; face < SHADOW_ATLAS_MAX_FACES; face++)
+        {
+            if (slot.Nodes[face] >= 0)
+                allocator.Free(slot.Nodes[face]);
+            slot.Nodes[face] = -1;
+            slot.Drawn[face] = false;
+            writeRecord(light, face);
+        }
+    }
+
+    void writeRecord(unsigned int light, unsigned int face)
+    {
+        const Slot &slot = slots[light];
+        glm::vec4 *record = &records[(light * SHADOW_ATLAS_MAX_FACES + face) * SHADOW_ATLAS_TILE_TEXELS];
+        if (slot.Nodes[face] >= 0 && slot.Drawn[face])
+        {
+            unsigned int x, y, tileSize;
+            allocator.GetRect(slot.Nodes[face], x, y, tileSize);
+            for (unsigned int c = 0; c < 4; c++)
+                record[c] = slot.Matrices[face][c];
+            record[4] = glm::vec4(glm::vec3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(tileSize)) / static_cast<float>(Size), 1.0f);
+        }
+        else
+            record[4] = glm::vec4(0.0f);
+        recordsDirty = true;
+    }
+};
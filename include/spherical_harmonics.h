@@ -0,0 +1,203 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+#include "shader.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Diffuse irradiance of an environment as 9 RGB L2 spherical harmonics coefficients (Ramamoorthi and Hanrahan 2001,
+// "An efficient representation for irradiance environment maps"). The radiance is projected onto the first three SH
+// bands, every texel weighted by its solid angle, and the bands are scaled by the clamped cosine lobe. The coefficients
+// hold irradiance / pi, the value the irradiance cubemap used to store, so the shader evaluates the 9 terms inline
+// instead of fetching a texture:
+//   sh.ProjectCubemap(envCubemap, level, &jobs); sh.Bind(shader);
+//   uniform vec3 shIrradiance[9];
+// Irradiance has no detail past band 2, so a 64x64 mip of the environment is plenty; projecting one takes a fraction of
+// a millisecond, which makes re-lighting for a changing environment cheap. Rows are spread over the job system and
+// with AVX2 every row is projected 8 texels at a time.
+class SphericalHarmonics
+{
+public:
+    glm::vec3 Coefficients[9];
+
+    SphericalHarmonics()
+    {
+        for (unsigned int i = 0; i < 9; i++)
+            Coefficients[i] = glm::vec3(0.0f);
+    }
+
+    // projects six size x size faces in cube map face order; texels holds every face as three planes of floats, red,
+    // green then blue, each with its rows in the order glGetTexImage returns them
+    void Project(const float *texels, unsigned int size, JobSystem *jobs = nullptr)
+    {
+        double sums[27] = {};
+        std::mutex sumsMutex;
+        auto projectRange = [&](unsigned int begin, unsigned int end)
+        {
+            float partial[27] = {};
+            projectRows(texels, size, begin, end, partial);
+            std::lock_guard<std::mutex> lock(sumsMutex);
+            for (unsigned int i = 0; i < 27; i++)
+                sums[i] += partial[i];
+        };
+        if (jobs)
+            jobs->ParallelFor(0, 6 * size, 16, projectRange);
+        else
+            projectRange(0, 6 * size);
+        // clamped cosine convolution per band (pi, 2pi/3, pi/4), divided by pi
+        const float bandScale[9] = {1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f};
+        for (unsigned int i = 0; i < 9; i++)
+            Coefficients[i] = glm::vec3(sums[i], sums[9 + i], sums[18 + i]) * bandScale[i];
+    }
+
+    // reads one mip level of an RGB cubemap back and projects it
+    void ProjectCubemap(unsigned int cubemap, unsigned int level, JobSystem *jobs = nullptr)
+    {
+        GLint size = 0;
+        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+        glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, level, GL_TEXTURE_WIDTH, &size);
+        std::vector<float> texels(6 * 3 * size * size);
+        const GLenum channels[3] = {GL_RED, GL_GREEN, GL_BLUE};
+        for (unsigned int face = 0; face < 6; face++)
+            for (unsigned int c = 0; c < 3; c++)
+                glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, channels[c], GL_FLOAT, &texels[(face * 3 + c) * size * size]);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        Project(texels.data(), size, jobs);
+    }
+
+    // irradiance / pi in direction n (normalized)
+    glm::vec3 Evaluate(const glm::vec3 &n) const
+    {
+        float basis[9];
+        evaluateBasis(n.x, n.y, n.z, basis);
+        glm::vec3 result(0.0f);
+        for (unsigned int i = 0; i < 9; i++)
+            result += Coefficients[i] * basis[i];
+        return glm::max(result, glm::vec3(0.0f));
+    }
+
+    void Bind(Shader &shader) const
+    {
+        for (unsigned int i = 0; i < 9; i++)
+            shader.setVec3("shIrradiance[" + std::to_string(i) + "]", Coefficients[i]);
+    }
+
+    // the direction of texel (s, t) of a face, both in [-1, 1], is FaceAxis(face, 0) + s * FaceAxis(face, 1) + t * FaceAxis(face, 2)
+    static const glm::vec3 &FaceAxis(unsigned int face, unsigned int axis)
+    {
+        static const glm::vec3 axes[6][3] = {
+            {glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f)},
+            {glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)},
+            {glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)},
+            {glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)},
+            {glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)},
+            {glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)}};
+        return axes[face][axis];
+    }
+
+private:
+    static void evaluateBasis(float x, float y, float z, float basis[9])
+    {
+        basis[0] = 0.282095f;
+        basis[1] = 0.488603f * y;
+        basis[2] = 0.488603f * z;
+        basis[3] = 0.488603f * x;
+        basis[4] = 1.092548f * x * y;
+        basis[5] = 1.092548f * y * z;
+        basis[6] = 0.315392f * (3.0f * z * z - 1.0f);
+        basis[7] = 1.092548f * x * z;
+        basis[8] = 0.546274f * (x * x - y * y);
+    }
+
+    // adds the solid angle weighted radiance times basis of rows [begin, end) (face * size + y) to sums: 9 red, 9
+    // green, 9 blue
+    static void projectRows(const float *texels, unsigned int size, unsigned int begin, unsigned int end, float sums[27])
+    {
+        const float texel = 2.0f / size;
+        const float texelArea = texel * texel;
+#if defined(__AVX2__)
+        __m256 accumulators[27];
+        for (unsigned int i = 0; i < 27; i++)
+            accumulators[i] = _mm256_setzero_ps();
+        const __m256 laneOffsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+        const __m256 one = _mm256_set1_ps(1.0f);
+#endif
+        for (unsigned int row = begin; row < end; row++)
+        {
+            unsigned int face = row / size, y = row % size;
+            const float *planes[3];
+            for (unsigned int c = 0; c < 3; c++)
+                planes[c] = texels + (face * 3 + c) * size * size + y * size;
+            const glm::vec3 &normal = FaceAxis(face, 0), &sAxis = FaceAxis(face, 1), &tAxis = FaceAxis(face, 2);
+            float t = (y + 0.5f) * texel - 1.0f;
+            // the part of the direction that is the same along the row
+            glm::vec3 rowBase = normal + t * tAxis;
+            unsigned int x = 0;
+#if defined(__AVX2__)
+            const __m256 baseX = _mm256_set1_ps(rowBase.x), baseY = _mm256_set1_ps(rowBase.y), baseZ = _mm256_set1_ps(rowBase.z);
+            const __m256 stepX = _mm256_set1_ps(sAxis.x), stepY = _mm256_set1_ps(sAxis.y), stepZ = _mm256_set1_ps(sAxis.z);
+            const __m256 tt = _mm256_set1_ps(1.0f + t * t);
+            for (; x + 8 <= size; x += 8)
+            {
+                __m256 s = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), laneOffsets), _mm256_set1_ps(texel)), one);
+                __m256 lengthSquared = _mm256_fmadd_ps(s, s, tt);
+                __m256 invLength = _mm256_div_ps(one, _mm256_sqrt_ps(lengthSquared));
+                // solid angle of the texel: texelArea / (1 + s^2 + t^2)^(3/2)
+                __m256 weight = _mm256_mul_ps(_mm256_mul_ps(invLength, _mm256_mul_ps(invLength, invLength)), _mm256_set1_ps(texelArea));
+                __m256 dx = _mm256_mul_ps(_mm256_fmadd_ps(s, stepX, baseX), invLength);
+                __m256 dy = _mm256_mul_ps(_mm256_fmadd_ps(s, stepY, baseY), invLength);
+                __m256 dz = _mm256_mul_ps(_mm256_fmadd_ps(s, stepZ, baseZ), invLength);
+                __m256 basis[9];
+                basis[0] = _mm256_mul_ps(weight, _mm256_set1_ps(0.282095f));
+                __m256 band1 = _mm256_mul_ps(weight, _mm256_set1_ps(0.488603f));
+                basis[1] = _mm256_mul_ps(band1, dy);
+                basis[2] = _mm256_mul_ps(band1, dz);
+                basis[3] = _mm256_mul_ps(band1, dx);
+                __m256 band2 = _mm256_mul_ps(weight, _mm256_set1_ps(1.092548f));
+                basis[4] = _mm256_mul_ps(band2, _mm256_mul_ps(dx, dy));
+                basis[5] = _mm256_mul_ps(band2, _mm256_mul_ps(dy, dz));
+                basis[6] = _mm256_mul_ps(_mm256_mul_ps(weight, _mm256_set1_ps(0.315392f)), _mm256_fmsub_ps(_mm256_set1_ps(3.0f), _mm256_mul_ps(dz, dz), one));
+                basis[7] = _mm256_mul_ps(band2, _mm256_mul_ps(dx, dz));
+                basis[8] = _mm256_mul_ps(_mm256_mul_ps(weight, _mm256_set1_ps(0.546274f)), _mm256_fmsub_ps(dx, dx, _mm256_mul_ps(dy, dy)));
+                for (unsigned int c = 0; c < 3; c++)
+                {
+                    __m256 radiance = _mm256_loadu_ps(planes[c] + x);
+                    for (unsigned int i = 0; i < 9; i++)
+                        accumulators[c * 9 + i] = _mm256_fmadd_ps(radiance, basis[i], accumulators[c * 9 + i]);
+                }
+            }
+#endif
+            for (; x < size; x++)
+            {
+                float s = (x + 0.5f) * texel - 1.0f;
+                glm::vec3 direction = rowBase + s * sAxis;
+                float invLength = 1.0f / glm::length(direction);
+                direction *= invLength;
+                float weight = invLength * invLength * invLength * texelArea;
+                float basis[9];
+                evaluateBasis(direction.x, direction.y, direction.z, basis);
+                for (unsigned int c = 0; c < 3; c++)
+                    for (unsigned int i = 0; i < 9; i++)
+                        sums[c * 9 + i] += planes[c][x] * basis[i] * weight;
+            }
+        }
+#if defined(__AVX2__)
+        for (unsigned int i = 0; i < 27; i++)
+        {
+            alignas(32) float lanes[8];
+            _mm256_store_ps(lanes, accumulators[i]);
+            for (unsigned int lane = 0; lane < 8; lane++)
+                sums[i] += lanes[lane];
+        }
+#endif
+    }
+};
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+// parent index of a root transform
+#define NO_PARENT 0xFFFFFFFFu
+
+// Transform component store. Local position, rotation and scale live in structure-of-arrays layout, one array per
+// component, so eight transforms can be loaded into AVX2 registers at once. Update() recomposes the world matrix and
+// the normal matrix (inverse transpose of the upper 3x3) only for transforms that changed or whose parent changed.
+// A parent always has to be created before its children, which keeps the arrays in hierarchy order.
+class TransformSystem
+{
+public:
+    // creates a transform and returns its index
+    unsigned int Create(const glm::vec3 &position = glm::vec3(0.0f), const glm::quat &rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3 &scale = glm::vec3(1.0f), unsigned int parent = NO_PARENT)
+    {
+        unsigned int index = static_cast<unsigned int>(parents.size());
+        posX.push_back(position.x);
+        posY.push_back(position.y);
+        posZ.push_back(position.z);
+        rotX.push_back(rotation.x);
+        rotY.push_back(rotation.y);
+        rotZ.push_back(rotation.z);
+        rotW.push_back(rotation.w);
+        scaleX.push_back(scale.x);
+        scaleY.push_back(scale.y);
+        scaleZ.push_back(scale.z);
+        parents.push_back(parent);
+        levels.push_back(parent == NO_PARENT ? 0 : levels[parent] + 1);
+        dirty.push_back(1);
+        worldMatrices.push_back(glm::mat4(1.0f));
+        normalMatrices.push_back(glm::mat3(1.0f));
+        return index;
+    }
+
+    void SetPosition(unsigned int index, const glm::vec3 &position)
+    {
+        posX[index] = position.x;
+        posY[index] = position.y;
+        posZ[index] = position.z;
+        dirty[index] = 1;
+    }
+    void SetRotation(unsigned int index, const glm::quat &rotation)
+    {
+        rotX[index] = rotation.x;
+        rotY[index] = rotation.y;
+        rotZ[index] = rotation.z;
+        rotW[index] = rotation.w;
+        dirty[index] = 1;
+    }
+    void SetScale(unsigned int index, const glm::vec3 &scale)
+    {
+        scaleX[index] = scale.x;
+        scaleY[index] = scale.y;
+        scaleZ[index] = scale.z;
+        dirty[index] = 1;
+    }
+    glm::vec3 GetPosition(unsigned int index) const
+    {
+        return glm::vec3(posX[index], posY[index], posZ[index]);
+    }
+
+    // recomposes the matrices of every changed transform and its descendants
+    void Update()
+    {
+        // propagate dirty flags down the hierarchy and bucket the changed transforms by depth; transforms on the
+        // same level don't depend on each other, so they can be composed eight at a time
+        Changed.clear();
+        for (unsigned int i = 0; i < levelBuckets.size(); i++)
+            levelBuckets[i].clear();
+        for (unsigned int i = 0; i < parents.size(); i++)
+        {
+            if (parents[i] != NO_PARENT && dirty[parents[i]])
+                dirty[i] = 1;
+            if (!dirty[i])
+                continue;
+            if (levels[i] >= levelBuckets.size())
+                levelBuckets.resize(levels[i] + 1);
+            levelBuckets[levels[i]].push_back(i);
+            Changed.push_back(i);
+        }
+        for (unsigned int level = 0; level < levelBuckets.size(); level++)
+        {
+            const std::vector<unsigned int> &bucket = levelBuckets[level];
+            for (unsigned int i = 0; i < bucket.size(); i += 8)
+                composeBatch(&bucket[i], std::min(8u, static_cast<unsigned int>(bucket.size()) - i));
+        }
+        for (unsigned int i = 0; i < Changed.size(); i++)
+            dirty[Changed[i]] = 0;
+    }
+
+    const glm::mat4 &GetWorldMatrix(unsigned int index) const
+    {
+        return worldMatrices[index];
+    }
+    const glm::mat3 &GetNormalMatrix(unsigned int index) const
+    {
+        return normalMatrices[index];
+    }
+    // contiguous world matrices, e.g. for uploading into an instance buffer
+    const glm::mat4 *GetWorldMatrices() const
+    {
+        return worldMatrices.empty() ? nullptr : &worldMatrices[0];
+    }
+    unsigned int Size() const
+    {
+        return static_cast<unsigned int>(parents.size());
+    }
+
+    // indices recomposed by the last Update(), parents before children
+    std::vector<unsigned int> Changed;
+
+private:
+    std::vector<float> posX, posY, posZ;
+    std::vector<float> rotX, rotY, rotZ, rotW;
+    std::vector<float> scaleX, scaleY, scaleZ;
+    std::vector<unsigned int> parents;
+    std::vector<unsigned int> levels;
+    std::vector<unsigned char> dirty;
+    std::vector<glm::mat4> worldMatrices;
+    std::vector<glm::mat3> normalMatrices;
+    std::vector<std::vector<unsigned int>> levelBuckets;
+
+    // composes up to eight transforms of the same hierarchy level:
+    //   world  = parentWorld * T * R * S
+    //   normal = parentNormal * R * S^-1   (the inverse transpose of R * S)
+    void composeBatch(const unsigned int *indices, unsigned int count)
+    {
+        // gather the inputs lane by lane; unused lanes repeat the first transform
+        alignas(32) float in[10][8];
+        alignas(32) float parent[12][8];
+        alignas(32) float parentNormal[9][8];
+        for (unsigned int lane = 0; lane < 8; lane++)
+        {
+            unsigned int i = indices[lane < count ? lane : 0];
+            in[0][lane] = posX[i];
+            in[1][lane] = posY[i];
+            in[2][lane] = posZ[i];
+            in[3][lane] = rotX[i];
+            in[4][lane] = rotY[i];
+            in[5][lane] = rotZ[i];
+            in[6][lane] = rotW[i];
+            in[7][lane] = scaleX[i];
+            in[8][lane] = scaleY[i];
+            in[9][lane] = scaleZ[i];
+            glm::mat4 p = parents[i] == NO_PARENT ? glm::mat4(1.0f) : worldMatrices[parents[i]];
+            glm::mat3 n = parents[i] == NO_PARENT ? glm::mat3(1.0f) : normalMatrices[parents[i]];
+            for (int c = 0; c < 4; c++)
+                for (int r = 0; r < 3; r++)
+                    parent[c * 3 + r][lane] = p[c][r];
+            for (int c = 0; c < 3; c++)
+                for (int r = 0; r < 3; r++)
+                    parentNormal[c * 3 + r][lane] = n[c][r];
+        }
+
+        alignas(32) float world[12][8];
+        alignas(32) float normal[9][8];
+#if defined(__AVX2__)
+        const __m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f);
+        __m256 x = _mm256_load_ps(in[3]), y = _mm256_load_ps(in[4]), z = _mm256_load_ps(in[5]), w = _mm256_load_ps(in[6]);
+        __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+        __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+        __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+        // rotation matrix, column major
+        __m256 rot[9];
+        rot[0] = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz)));
+        rot[1] = _mm256_mul_ps(two, _mm256_add_ps(xy, wz));
+        rot[2] = _mm256_mul_ps(two, _mm256_sub_ps(xz, wy));
+        rot[3] = _mm256_mul_ps(two, _mm256_sub_ps(xy, wz));
+        rot[4] = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz)));
+        rot[5] = _mm256_mul_ps(two, _mm256_add_ps(yz, wx));
+        rot[6] = _mm256_mul_ps(two, _mm256_add_ps(xz, wy));
+        rot[7] = _mm256_mul_ps(two, _mm256_sub_ps(yz, wx));
+        rot[8] = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy)));
+        __m256 p[12], pn[9];
+        for (int k = 0; k < 12; k++)
+            p[k] = _mm256_load_ps(parent[k]);
+        for (int k = 0; k < 9; k++)
+            pn[k] = _mm256_load_ps(parentNormal[k]);
+        for (int c = 0; c < 3; c++)
+        {
+            __m256 s = _mm256_load_ps(in[7 + c]);
+            __m256 invS = _mm256_div_ps(one, s);
+            __m256 lx = _mm256_mul_ps(rot[c * 3 + 0], s), ly = _mm256_mul_ps(rot[c * 3 + 1], s), lz = _mm256_mul_ps(rot[c * 3 + 2], s);
+            __m256 nx = _mm256_mul_ps(rot[c * 3 + 0], invS), ny = _mm256_mul_ps(rot[c * 3 + 1], invS), nz = _mm256_mul_ps(rot[c * 3 + 2], invS);
+            for (int r = 0; r < 3; r++)
+            {
+                __m256 v = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(p[r], lx), _mm256_mul_ps(p[3 + r], ly)), _mm256_mul_ps(p[6 + r], lz));
+                _mm256_store_ps(world[c * 3 + r], v);
+                __m256 n = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(pn[r], nx), _mm256_mul_ps(pn[3 + r], ny)), _mm256_mul_ps(pn[6 + r], nz));
+                _mm256_store_ps(normal[c * 3 + r], n);
+            }
+        }
+        __m256 tx = _mm256_load_ps(in[0]), ty = _mm256_load_ps(in[1]), tz = _mm256_load_ps(in[2]);
+        for (int r = 0; r < 3; r++)
+        {
+            __m256 v = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(p[r], tx), _mm256_mul_ps(p[3 + r], ty)), _mm256_add_ps(_mm256_mul_ps(p[6 + r], tz), p[9 + r]));
+            _mm256_store_ps(world[9 + r], v);
+        }
+#else
+        for (unsigned int lane = 0; lane < count; lane++)
+        {
+            float x = in[3][lane], y = in[4][lane], z = in[5][lane], w = in[6][lane];
+            float rot[9] = {
+                1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y),
+                2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x),
+                2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y)};
+            for (int c = 0; c < 3; c++)
+            {
+                float s = in[7 + c][lane];
+                for (int r = 0; r < 3; r++)
+                {
+                    world[c * 3 + r][lane] = 0.0f;
+                    normal[c * 3 + r][lane] = 0.0f;
+                    for (int k = 0; k < 3; k++)
+                    {
+                        world[c * 3 + r][lane] += parent[k * 3 + r][lane] * rot[c * 3 + k] * s;
+                        normal[c * 3 + r][lane] += parentNormal[k * 3 + r][lane] * rot[c * 3 + k] / s;
+                    }
+                }
+            }
+            for (int r = 0; r < 3; r++)
+                world[9 + r][lane] = parent[r][lane] * in[0][lane] + parent[3 + r][lane] * in[1][lane] + parent[6 + r][lane] * in[2][lane] + parent[9 + r][lane];
+        }
+#endif
+        // scatter the results
+        for (unsigned int lane = 0; lane < count; lane++)
+        {
+            glm::mat4 &m = worldMatrices[indices[lane]];
+            glm::mat3 &n = normalMatrices[indices[lane]];
+            for (int c = 0; c < 4; c++)
+            {
+                for (int r = 0; r < 3; r++)
+                    m[c][r] = world[c * 3 + r][lane];
+                m[c][3] = c == 3 ? 1.0f : 0.0f;
+            }
+            for (int c = 0; c < 3; c++)
+                for (int r = 0; r < 3; r++)
+                    n[c][r] = normal[c * 3 + r][lane];
+        }
+    }
+};
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// Back to front ordering of transparent objects. The objects live in a flat array; Sort() quantizes their view space
+// depth to 16 bits and orders them with a two pass LSD radix sort, so objects at the same depth are all kept (in the
+// order they were added) and nothing is allocated per object once the arrays have grown. Given a job system, the keys,
+// digit counts and scatters of blocks of TRANSPARENCY_SORT_BLOCK objects run on its threads; every block scatters to
+// offsets that come after those of the blocks before it, so the order is the same as a sort on one thread.
+#define TRANSPARENCY_SORT_BLOCK 1024
+
+class TransparencySorter
+{
+public:
+    // world space position of every transparent object
+    std::vector<glm::vec3> Positions;
+
+    void Clear()
+    {
+        Positions.clear();
+    }
+    unsigned int Add(const glm::vec3 &position)
+    {
+        Positions.push_back(position);
+        return static_cast<unsigned int>(Positions.size() - 1);
+    }
+
+    // returns the object indices ordered back to front; depths outside [near, far] are clamped
+    const std::vector<unsigned int> &Sort(const glm::mat4 &view, float near, float far, JobSystem *jobs = nullptr)
+    {
+        unsigned int count = static_cast<unsigned int>(Positions.size());
+        unsigned int blockCount = (count + TRANSPARENCY_SORT_BLOCK - 1) / TRANSPARENCY_SORT_BLOCK;
+        keys.resize(count);
+        order.resize(count);
+        scratch.resize(count);
+        offsets.resize(blockCount * 256);
+        float scale = 65535.0f / (far - near);
+        forEachBlock(jobs, blockCount, [&](unsigned int begin, unsigned int end)
+                     {
+            for (unsigned int i = begin; i < end; i++)
+            {
+                // view space looks down -z; the farthest object gets the smallest key
+                float depth = -(view[0][2] * Positions[i].x + view[1][2] * Positions[i].y + view[2][2] * Positions[i].z + view[3][2]);
+                float quantized = glm::clamp((depth - near) * scale, 0.0f, 65535.0f);
+                keys[i] = static_cast<unsigned short>(65535 - static_cast<unsigned int>(quantized + 0.5f));
+                order[i] = i;
+            } });
+        for (unsigned int shift = 0; shift < 16; shift += 8)
+        {
+            forEachBlock(jobs, blockCount, [&](unsigned int begin, unsigned int end)
+                         {
+                unsigned int *blockOffsets = &offsets[begin / TRANSPARENCY_SORT_BLOCK * 256];
+                std::fill(blockOffsets, blockOffsets + 256, 0u);
+                for (unsigned int i = begin; i < end; i++)
+                    blockOffsets[(keys[order[i]] >> shift) & 0xFF]++; });
+            // a digit's objects start with those of the first block
+            unsigned int sum = 0;
+            for (unsigned int digit = 0; digit < 256; digit++)
+                for (unsigned int block = 0; block < blockCount; block++)
+                {
+                    unsigned int digitCount = offsets[block * 256 + digit];
+                    offsets[block * 256 + digit] = sum;
+                    sum += digitCount;
+                }
+            forEachBlock(jobs, blockCount, [&](unsigned int begin, unsigned int end)
+                         {
+                unsigned int *blockOffsets = &offsets[begin / TRANSPARENCY_SORT_BLOCK * 256];
+                for (unsigned int i = begin; i < end; i++)
+                    scratch[blockOffsets[(keys[order[i]] >> shift) & 0xFF]++] = order[i]; });
+            order.swap(scratch);
+        }
+        return order;
+    }
+
+private:
+    std::vector<unsigned short> keys;
+    std::vector<unsigned int> order;
+    std::vector<unsigned int> scratch;
+    // 256 digit counts, then offsets, per block
+    std::vector<unsigned int> offsets;
+
+    // calls function(begin, end) for the objects of every block, on the job system's threads if there is one
+    void forEachBlock(JobSystem *jobs, unsigned int blockCount, const std::function<void(unsigned int, unsigned int)> &function)
+    {
+        unsigned int count = static_cast<unsigned int>(Positions.size());
+        if (!jobs || blockCount < 2)
+        {
+            for (unsigned int block = 0; block < blockCount; block++)
+                function(block * TRANSPARENCY_SORT_BLOCK, std::min(count, (block + 1) * TRANSPARENCY_SORT_BLOCK));
+            return;
+        }
+        jobs->ParallelFor(0, blockCount, 1, [&](unsigned int first, unsigned int last)
+                          {
+            for (unsigned int block = first; block < last; block++)
+                function(block * TRANSPARENCY_SORT_BLOCK, std::min(count, (block + 1) * TRANSPARENCY_SORT_BLOCK)); });
+    }
+};
+
+// Weighted blended order independent transparency (McGuire and Bavoil 2013). Transparent surfaces are drawn once, in
+// any order, into two targets:
+//   target 0 (RGBA16F): rgb += color * alpha * weight,  a *= 1 - alpha   (revealage, cleared to 1)
+//   target 1 (R16F):    r   += alpha * weight
+// Both targets use the same blend function, so this works without glBlendFunci on a 3.3 context. Composite() then
+// resolves the average color over the opaque image. The transparent fragment shader writes
+//   layout(location = 0) out vec4 accum = vec4(color.rgb * color.a * w, color.a);
+//   layout(location = 1) out float weight = color.a * w;
+class WeightedBlendedOIT
+{
+public:
+    unsigned int FBO;
+    unsigned int AccumTexture;
+    unsigned int WeightTexture;
+
+    WeightedBlendedOIT(unsigned int width, unsigned int height) : width(width), height(height)
+    {
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        AccumTexture = createTarget(GL_RGBA16F, GL_RGBA, GL_COLOR_ATTACHMENT0);
+        WeightTexture = createTarget(GL_R16F, GL_RED, GL_COLOR_ATTACHMENT1);
+        unsigned int attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, attachments);
+        // same format as the default framebuffer so the opaque depth can be blitted in
+        glGenRenderbuffers(1, &depthRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: OIT framebuffer is not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        float quadVertices[] = {
+            // positions   // texCoords
+            -1.0f, 1.0f, 0.0f, 1.0f,
+            -1.0f, -1.0f, 0.0f, 0.0f,
+            1.0f, -1.0f, 1.0f, 0.0f,
+
+            -1.0f, 1.0f, 0.0f, 1.0f,
+            1.0f, -1.0f, 1.0f, 0.0f,
+            1.0f, 1.0f, 1.0f, 1.0f};
+        unsigned int quadVBO;
+        glGenVertexArrays(1, &quadVAO);
+        glGenBuffers(1, &quadVBO);
+        glBindVertexArray(quadVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)(2 * sizeof(float)));
+        glBindVertexArray(0);
+    }
+
+    // copies the opaque depth of sourceFBO and sets up the accumulation pass; draw the transparent geometry after this
+    void Begin(unsigned int sourceFBO = 0)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, sourceFBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBO);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        float accumClear[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        float weightClear[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        glClearBufferfv(GL_COLOR, 0, accumClear);
+        glClearBufferfv(GL_COLOR, 1, weightClear);
+        // depth test against the opaque scene, but transparent surfaces don't occlude each other
+        glDepthMask(GL_FALSE);
+        glEnable(GL_BLEND);
+        glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    // resolves the accumulated transparency over the opaque image in targetFBO
+    void Composite(Shader &compositeShader, unsigned int targetFBO = 0)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+        glDepthMask(GL_TRUE);
+        glDisable(GL_DEPTH_TEST);
+        // out = average color * (1 - revealage) + opaque * revealage
+        glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+        compositeShader.use();
+        compositeShader.setInt("accumTexture", 0);
+        compositeShader.setInt("weightTexture", 1);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, AccumTexture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, WeightTexture);
+        glBindVertexArray(quadVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+private:
+    unsigned int width, height;
+    unsigned int depthRBO;
+    unsigned int quadVAO;
+
+    unsigned int createTarget(GLint internalFormat, GLenum format, GLenum attachment)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+        return texture;
+    }
+};
@@ -2,6 +2,9 @@
 #include <GLFW/glfw3.h>
 #include "shader.h"
 #include "camera.h"
+#include "forward_plus.h"
+#include "gpu_timer.h"
+#include "transparency.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -16,6 +19,10 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 unsigned int loadTexture(char const *path);
 
+// the forward+ lights, placed and colored from a fixed seed
+#define NR_TILE_LIGHTS FORWARD_PLUS_MAX_LIGHTS
+#define TILE_LIGHTS_SEED 6u
+
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 float lastX = 400, lastY = 300;
@@ -24,6 +31,10 @@ float lastFrame = 0.0f; // 上一帧的时间
 bool firstMouse = true;
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 glm::vec3 lightpos(1.2f, 1.0f, 2.0f);
+bool tiledLights = true;
+bool tiledLightsKeyPressed = false;
+// multisampled window; the forward+ pre-pass and tile depths follow its sample count
+const unsigned int MSAA_SAMPLES = 4;
 
 int main()
 {
@@ -33,6 +44,7 @@ int main()
     // 指定使用的是OpenGL 3.3版本
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     // 指定使用的是核心模式(Core-profile)
+    glfwWindowHint(GLFW_SAMPLES, MSAA_SAMPLES);
     GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
     // 创建窗口对象
     if (window == NULL)
@@ -54,10 +66,14 @@ int main()
         return -1;
     }
     glEnable(GL_DEPTH_TEST);
+    glEnable(GL_MULTISAMPLE);
     // 初始化GLAD,传入的是GLAD用来加载系统相关的OpenGL函数指针地址的函数
 
     Shader ourShader("C:/Users/22175/Desktop/LearnOpenGL/src/2.lighting/6.Multiple_lights/vsfs/shader.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/2.lighting/6.Multiple_lights/vsfs/shader.fs");
     Shader lightShader("C:/Users/22175/Desktop/LearnOpenGL/src/2.lighting/6.Multiple_lights/vsfs/lightshader.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/2.lighting/6.Multiple_lights/vsfs/lightshader.fs");
+    Shader prepassShader("C:/Users/22175/Desktop/LearnOpenGL/src/2.lighting/6.Multiple_lights/vsfs/shader.vs", "C:/Users/22175/Desktop/LearnOpenGL/include/shaders/forward_plus_prepass.fs");
+    Shader tileDepthShader("C:/Users/22175/Desktop/LearnOpenGL/include/shaders/forward_plus_tile.vs", "C:/Users/22175/Desktop/LearnOpenGL/include/shaders/forward_plus_tile_depth.fs");
+    Shader tileCullShader("C:/Users/22175/Desktop/LearnOpenGL/include/shaders/forward_plus_tile.vs", "C:/Users/22175/Desktop/LearnOpenGL/include/shaders/forward_plus_tile_cull.fs");
     float vertices[] = {
         // positions          // normals           // texture coords
         -0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f,
@@ -119,6 +135,26 @@ int main()
         glm::vec3(2.3f, -3.3f, -4.0f),
         glm::vec3(-4.0f, 2.0f, -12.0f),
         glm::vec3(0.0f, 0.0f, -3.0f)};
+    // many small colored lights scattered between the containers; with forward+ every pixel only shades the few
+    // whose radius reaches its tile
+    const float lightLinear = 0.7f;
+    const float lightQuadratic = 1.8f;
+    DriftingLights tileLights(NR_TILE_LIGHTS, TILE_LIGHTS_SEED, glm::vec3(-6.0f, -4.0f, -16.0f), glm::vec3(6.0f, 6.0f, 4.0f), 0.5f, 1.0f);
+    tileLights.SetAttenuationRadii(lightLinear, lightQuadratic);
+    // glass panes between the containers: blended, so they are left out of the pre-pass and lit from the transparent
+    // tile masks, which reach in front of the containers
+    TransparencySorter panes;
+    panes.Add(glm::vec3(-0.5f, 0.5f, 1.0f));
+    panes.Add(glm::vec3(0.8f, -1.0f, -1.0f));
+    panes.Add(glm::vec3(-2.5f, 1.5f, -4.5f));
+    panes.Add(glm::vec3(1.5f, 1.0f, -6.0f));
+    panes.Add(glm::vec3(-0.5f, -1.5f, -9.0f));
+    // the pre-pass depth is blitted into the window, so it takes the window's actual sample count
+    int windowSamples = 0;
+    glGetIntegerv(GL_SAMPLES, &windowSamples);
+    ForwardPlus forwardPlus(SCR_WIDTH, SCR_HEIGHT, static_cast<unsigned int>(windowSamples));
+    GpuTimer shadingTimer;
+    float lastStatsTime = 0.0f;
     unsigned int VAO, VBO;
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
@@ -145,6 +181,8 @@ int main()
     ourShader.use();
     ourShader.setInt("material.diffuse", 0);
     ourShader.setInt("material.specular", 1);
+    ourShader.setFloat("lightLinear", lightLinear);
+    ourShader.setFloat("lightQuadratic", lightQuadratic);
 
     while (!glfwWindowShouldClose(window))
     {
@@ -157,7 +195,41 @@ int main()
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         // 清空颜色缓冲,当清空颜色缓冲后,整个颜色缓冲都会被填充为glClearColor所设置的颜色
 
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), static_cast<float>(SCR_WIDTH) / static_cast<float>(SCR_HEIGHT), 0.1f, 100.0f);
+        // 透视投影
+        glm::mat4 view = camera.GetViewMatrix();
+        // 摄像机位置
+        glm::mat4 models[10];
+        for (int i = 0; i < 10; i++)
+        {
+            glm::mat4 model = glm::mat4(1.0f);
+            model = glm::translate(model, cubePositions[i]);
+            float angle = 20.0f * i;
+            model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f)); // 沿着x轴旋转
+            models[i] = model;
+        }
+
+        tileLights.Update(currentFrame, glm::vec3(0.8f, 0.4f, 0.8f), 0.5f);
+        forwardPlus.SetLights(tileLights.Positions, tileLights.Colors, tileLights.Radii);
+        if (tiledLights)
+        {
+            forwardPlus.BeginDepthPrepass();
+            prepassShader.use();
+            prepassShader.setMat4("projection", projection);
+            prepassShader.setMat4("view", view);
+            glBindVertexArray(VAO);
+            for (int i = 0; i < 10; i++)
+            {
+                prepassShader.setMat4("model", models[i]);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+            }
+            forwardPlus.CullLights(tileDepthShader, tileCullShader, view, projection);
+        }
+
+        shadingTimer.Begin();
         ourShader.use();
+        ourShader.setBool("tiledLights", tiledLights);
+        forwardPlus.Bind(ourShader, 2);
         ourShader.setVec3("viewPos", camera.Position);
         ourShader.setFloat("material.shininess", 32.0f);
         // directional light
@@ -209,10 +281,6 @@ int main()
         ourShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
         ourShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
 
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), static_cast<float>(SCR_WIDTH) / static_cast<float>(SCR_HEIGHT), 0.1f, 100.0f);
-        // 透视投影
-        glm::mat4 view = camera.GetViewMatrix();
-        // 摄像机位置
         ourShader.setMat4("projection", projection);
         ourShader.setMat4("view", view);
         // 模型矩阵
@@ -224,13 +292,26 @@ int main()
         glBindVertexArray(VAO);
         for (int i = 0; i < 10; i++)
         {
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePositions[i]);
-            float angle = 20.0f * i;
-            model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f)); // 沿着x轴旋转
-            ourShader.setMat4("model", model);
+            ourShader.setMat4("model", models[i]);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+        }
+        // the panes back to front, over the opaque depth without writing it
+        forwardPlus.Bind(ourShader, 2, true);
+        ourShader.setFloat("transparency", 0.6f);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+        const std::vector<unsigned int> &paneOrder = panes.Sort(view, 0.1f, 100.0f);
+        for (unsigned int i = 0; i < paneOrder.size(); i++)
+        {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), panes.Positions[paneOrder[i]]);
+            ourShader.setMat4("model", glm::scale(model, glm::vec3(1.5f, 1.5f, 0.02f)));
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+        ourShader.setFloat("transparency", 0.0f);
+        shadingTimer.End();
         lightShader.use();
         lightShader.setMat4("projection", projection);
         lightShader.setMat4("view", view);
@@ -240,6 +321,16 @@ int main()
         lightShader.setMat4("model", model);
         glBindVertexArray(lightVAO);
         glDrawArrays(GL_TRIANGLES, 0, 36);
+        // the forward+ pass leaves GL_LEQUAL set for drawing over the pre-pass depth
+        glDepthFunc(GL_LESS);
+
+        if (currentFrame - lastStatsTime > 1.0f)
+        {
+            std::string title = std::string("LearnOpenGL | ") + (tiledLights ? "forward+" : "all lights") +
+                                " | shading: " + std::to_string(shadingTimer.GetMilliseconds()) + " ms";
+            glfwSetWindowTitle(window, title.c_str());
+            lastStatsTime = currentFrame;
+        }
 
         // 绘制三角形
         glfwSwapBuffers(window);
@@ -264,6 +355,16 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS && !tiledLightsKeyPressed)
+    {
+        tiledLights = !tiledLights;
+        tiledLightsKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_RELEASE)
+    {
+        tiledLightsKeyPressed = false;
+    }
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -53,11 +53,19 @@ uniform DirLight dirLight;
 uniform PointLight pointLights[NR_POINT_LIGHTS];
 uniform SpotLight spotLight;
 uniform Material material;
+// the glass panes are drawn blended with this much of the background showing through
+uniform float transparency;
+
+#include "../../../../include/shaders/forward_plus.glsl"
+// attenuation of the forward+ lights
+uniform float lightLinear;
+uniform float lightQuadratic;
 
 // function prototypes
 vec3 CalcDirLight(DirLight light,vec3 normal,vec3 viewDir);
 vec3 CalcPointLight(PointLight light,vec3 normal,vec3 fragPos,vec3 viewDir);
 vec3 CalcSpotLight(SpotLight light,vec3 normal,vec3 fragPos,vec3 viewDir);
+vec3 CalcTileLight(int index,vec3 normal,vec3 fragPos,vec3 viewDir,vec3 diffuseColor,vec3 specularColor);
 
 void main()
 {
@@ -78,8 +86,21 @@ void main()
     result+=CalcPointLight(pointLights[i],norm,FragPos,viewDir);
     // phase 3: spot light
     result+=CalcSpotLight(spotLight,norm,FragPos,viewDir);
+    // phase 4: the many small lights, either the ones of this fragment's tile or all of them; the maps are sampled
+    // out here because the light loop is not uniform control flow
+    vec3 diffuseColor=vec3(texture(material.diffuse,TexCoords));
+    vec3 specularColor=vec3(texture(material.specular,TexCoords));
+    uint words[8];
+    tileLightWords(words);
+    for(int w=0;w<8;++w)
+    {
+        uint bits=words[w];
+        for(int b=0;bits!=0u;++b,bits>>=1u)
+        if((bits&1u)!=0u)
+        result+=CalcTileLight(w*32+b,norm,FragPos,viewDir,diffuseColor,specularColor);
+    }
     
-    FragColor=vec4(result,1.);
+    FragColor=vec4(result,1.-transparency);
 }
 // calculates the color when using a directional light.
 vec3 CalcDirLight(DirLight light,vec3 normal,vec3 viewDir)
@@ -143,4 +164,22 @@ vec3 CalcSpotLight(SpotLight light,vec3 normal,vec3 fragPos,vec3 viewDir)
     diffuse*=attenuation*intensity;
     specular*=attenuation*intensity;
     return(ambient+diffuse+specular);
+}
+
+// calculates the color of one forward+ light; it is cut off at its radius, where the attenuation is negligible
+vec3 CalcTileLight(int index,vec3 normal,vec3 fragPos,vec3 viewDir,vec3 diffuseColor,vec3 specularColor)
+{
+    vec4 light=texelFetch(lightData,index*2);
+    vec3 color=texelFetch(lightData,index*2+1).rgb;
+    float distance=length(light.xyz-fragPos);
+    if(distance>light.w)
+    return vec3(0.);
+    vec3 lightDir=(light.xyz-fragPos)/distance;
+    float diff=max(dot(normal,lightDir),0.);
+    vec3 reflectDir=reflect(-lightDir,normal);
+    float spec=pow(max(dot(viewDir,reflectDir),0.),material.shininess);
+    float attenuation=1./(1.+lightLinear*distance+lightQuadratic*(distance*distance));
+    vec3 diffuse=color*diff*diffuseColor;
+    vec3 specular=color*spec*specularColor;
+    return(diffuse+specular)*attenuation;
 }
\ No newline at end of file
@@ -3,7 +3,9 @@
 #include "shader.h"
 #include "camera.h"
 #include "model.h"
-#include <map>
+#include "instance_buffer.h"
+#include "transparency.h"
+#include "job_system.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -24,6 +26,12 @@ float lastX = 400, lastY = 300;
 float deltaTime = 0.0f; // 当前帧与上一帧的时间差
 float lastFrame = 0.0f; // 上一帧的时间
 bool firstMouse = true;
+// weighted blended OIT instead of sorted blending, toggled with O
+bool orderIndependent = false;
+bool orderIndependentKeyPressed = false;
+// a field of windows over the whole floor, toggled with F, so the sort has enough objects to spread over the cores
+bool windowField = false;
+bool windowFieldKeyPressed = false;
 
 int main()
 {
@@ -120,6 +128,9 @@ int main()
         1.0f, 0.5f, 0.0f, 1.0f, 0.0f};
 
     Shader ourShader("C:/Users/22175/Desktop/LearnOpenGL/src/4.advanced_opengl/17.Blending/vsfs/shader.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/4.advanced_opengl/17.Blending/vsfs/shader.fs");
+    Shader transparentShader("C:/Users/22175/Desktop/LearnOpenGL/src/4.advanced_opengl/17.Blending/vsfs/transparent.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/4.advanced_opengl/17.Blending/vsfs/shader.fs");
+    Shader oitShader("C:/Users/22175/Desktop/LearnOpenGL/src/4.advanced_opengl/17.Blending/vsfs/transparent.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/4.advanced_opengl/17.Blending/vsfs/oit.fs");
+    Shader compositeShader("C:/Users/22175/Desktop/LearnOpenGL/src/4.advanced_opengl/17.Blending/vsfs/composite.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/4.advanced_opengl/17.Blending/vsfs/composite.fs");
     unsigned int cubeVAO, cubeVBO;
     glGenBuffers(1, &cubeVBO);
     glGenVertexArrays(1, &cubeVAO);
@@ -166,8 +177,24 @@ int main()
         glm::vec3(0.0f, 0.0f, 0.7f),
         glm::vec3(-0.3f, 0.0f, -2.3f),
         glm::vec3(0.5f, 0.0f, -0.6f)};
+    std::vector<glm::vec3> field;
+    for (unsigned int z = 0; z < 48; z++)
+        for (unsigned int x = 0; x < 48; x++)
+            field.push_back(glm::vec3(-4.7f + x * 0.2f, 0.0f, -4.7f + z * 0.2f));
+    // the sort runs on the job system, GL calls stay on this thread
+    JobSystem jobSystem;
+    TransparencySorter transparents;
+    // the windows are drawn with one instanced call, in the order their offsets are written
+    InstanceBuffer transparentInstances(static_cast<unsigned int>(vegetation.size() + field.size()), sizeof(glm::vec3));
+    transparentInstances.AddAttribute(2, 3, GL_FLOAT, 0);
+    transparentInstances.Attach(transparentVAO);
+    WeightedBlendedOIT oit(SCR_WIDTH, SCR_HEIGHT);
     ourShader.use();
     ourShader.setInt("texture1", 0);
+    transparentShader.use();
+    transparentShader.setInt("texture1", 0);
+    oitShader.use();
+    oitShader.setInt("texture1", 0);
     while (!glfwWindowShouldClose(window))
     {
         float currentFrame = glfwGetTime();
@@ -177,12 +204,7 @@ int main()
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         // 设置清空屏幕所用的颜色
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        std::map<float, glm::vec3> sortrd;
-        for (unsigned int i = 0; i < vegetation.size(); i++)
-        {
-            float distance = glm::length(camera.Position - vegetation[i]);
-            sortrd[distance] = vegetation[i];
-        }
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         ourShader.use();
         glm::mat4 model = glm::mat4(1.0f);
         glm::mat4 view = camera.GetViewMatrix();
@@ -206,15 +228,44 @@ int main()
         ourShader.setMat4("model", glm::mat4(1.0f));
         glDrawArrays(GL_TRIANGLES, 0, 6);
         // vegetation
-        glBindVertexArray(transparentVAO);
-        glBindTexture(GL_TEXTURE_2D, transparentTexture);
-        for (std::map<float, glm::vec3>::reverse_iterator it = sortrd.rbegin(); it != sortrd.rend(); ++it)
+        if (transparents.Positions.size() != vegetation.size() + (windowField ? field.size() : 0))
+        {
+            transparents.Clear();
+            for (unsigned int i = 0; i < vegetation.size(); i++)
+                transparents.Add(vegetation[i]);
+            if (windowField)
+                for (unsigned int i = 0; i < field.size(); i++)
+                    transparents.Add(field[i]);
+        }
+        glm::vec3 *offsets = transparentInstances.Begin<glm::vec3>();
+        unsigned int transparentCount = static_cast<unsigned int>(transparents.Positions.size());
+        if (orderIndependent)
+        {
+            // any order will do
+            std::copy(transparents.Positions.begin(), transparents.Positions.end(), offsets);
+        }
+        else
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, it->second);
-            ourShader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+            const std::vector<unsigned int> &order = transparents.Sort(view, 0.1f, 100.0f, &jobSystem);
+            for (unsigned int i = 0; i < transparentCount; i++)
+                offsets[i] = transparents.Positions[order[i]];
         }
+        transparentInstances.MarkDirty(0, transparentCount);
+        transparentInstances.Flush();
+        Shader &activeTransparentShader = orderIndependent ? oitShader : transparentShader;
+        if (orderIndependent)
+            oit.Begin();
+        activeTransparentShader.use();
+        activeTransparentShader.setMat4("view", view);
+        activeTransparentShader.setMat4("projection", projection);
+        glBindVertexArray(transparentVAO);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, transparentTexture);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, transparentCount);
+        glBindVertexArray(0);
+        transparentInstances.End();
+        if (orderIndependent)
+            oit.Composite(compositeShader);
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -236,6 +287,24 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS && !orderIndependentKeyPressed)
+    {
+        orderIndependent = !orderIndependent;
+        orderIndependentKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_RELEASE)
+    {
+        orderIndependentKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS && !windowFieldKeyPressed)
+    {
+        windowField = !windowField;
+        windowFieldKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_RELEASE)
+    {
+        windowFieldKeyPressed = false;
+    }
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -0,0 +1,18 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D accumTexture;
+uniform sampler2D weightTexture;
+
+void main()
+{
+    vec4 accum=texture(accumTexture,TexCoords);
+    float revealage=accum.a;
+    // nothing transparent covers this pixel
+    if(revealage>=1.)
+    discard;
+    float weight=texture(weightTexture,TexCoords).r;
+    FragColor=vec4(accum.rgb/max(weight,1e-5),revealage);
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#version 330 core
+layout(location=0)out vec4 accum;
+layout(location=1)out float weight;
+
+in vec2 TexCoords;
+
+uniform sampler2D texture1;
+
+void main()
+{
+    vec4 texColor=texture(texture1,TexCoords);
+    if(texColor.a<.1)
+    discard;
+    // depth weight from McGuire and Bavoil: closer and more opaque surfaces dominate the average
+    float w=clamp(pow(min(1.,texColor.a*10.)+.01,3.)*1e8*pow(1.-gl_FragCoord.z*.9,3.),1e-2,3e3);
+    accum=vec4(texColor.rgb*texColor.a*w,texColor.a);
+    weight=texColor.a*w;
+}
\ No newline at end of file
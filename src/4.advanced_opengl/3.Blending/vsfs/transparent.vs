@@ -0,0 +1,15 @@
+#version 330 core
+layout(location=0)in vec3 aPos;
+layout(location=1)in vec2 aTexCoords;
+layout(location=2)in vec3 aOffset;
+
+out vec2 TexCoords;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    TexCoords=aTexCoords;
+    gl_Position=projection*view*vec4(aPos+aOffset,1.);
+}
\ No newline at end of file
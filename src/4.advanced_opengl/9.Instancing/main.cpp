@@ -3,6 +3,9 @@
 #include "shader.h"
 #include "camera.h"
 #include "model.h"
+#include "instance_buffer.h"
+#include "job_system.h"
+#include "random.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -25,6 +28,10 @@ float lastX = 400, lastY = 300;
 float deltaTime = 0.0f; // 当前帧与上一帧的时间差
 float lastFrame = 0.0f; // 上一帧的时间
 bool firstMouse = true;
+// seed of the asteroid field; the same seed always gives the same field
+#define ASTEROID_SEED 20240501u
+bool compactInstances = true;
+bool compactKeyPressed = false;
 int main()
 {
     glfwInit();
@@ -58,65 +65,76 @@ int main()
 
     Shader plantshader("C:/Users/22175/Desktop/LearnOpenGL/src/4.advanced_opengl/23.Instancing/vsfs/shader.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/4.advanced_opengl/23.Instancing/vsfs/shader.fs");
     Shader rockshader("C:/Users/22175/Desktop/LearnOpenGL/src/4.advanced_opengl/23.Instancing/vsfs/rockshader.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/4.advanced_opengl/23.Instancing/vsfs/rockshader.fs");
-    Model rock("C:/Users/22175/Desktop/LearnOpenGL/assets/objects/rock/rock.obj");
-    Model planet("C:/Users/22175/Desktop/LearnOpenGL/assets/objects/planet/planet.obj");
+    Shader rockcompactshader("C:/Users/22175/Desktop/LearnOpenGL/src/4.advanced_opengl/23.Instancing/vsfs/rockshader_compact.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/4.advanced_opengl/23.Instancing/vsfs/rockshader.fs");
+    JobSystem jobSystem;
+    // the models' textures are decoded and their meshes converted on the job system
+    Model rock("C:/Users/22175/Desktop/LearnOpenGL/assets/objects/rock/rock.obj", false, &jobSystem);
+    Model planet("C:/Users/22175/Desktop/LearnOpenGL/assets/objects/planet/planet.obj", false, &jobSystem);
 
     unsigned int amount = 100000;
     glm::mat4 *modelMatrices;
     modelMatrices = new glm::mat4[amount];
-    srand(static_cast<unsigned int>(glfwGetTime())); // initialize random seed
+    // the same transforms as position, rotation and uniform scale for the compact instance format
+    std::vector<glm::vec3> instancePositions(amount);
+    std::vector<glm::quat> instanceRotations(amount);
+    std::vector<float> instanceScales(amount);
+    // orbital speed of every asteroid, slower further out
+    std::vector<float> orbitSpeeds(amount);
     float radius = 150.0;
     float offset = 25.f;
-    for (unsigned int i = 0; i < amount; i++)
-    {
-        glm::mat4 model = glm::mat4(1.0f);
-        // 1. translation: displace along circle with 'radius' in range [-offset, offset]
-        float angle = (float)i / (float)amount * 360.0f;
-        float displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
-        float x = sin(angle) * radius + displacement;
-        displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
-        float y = displacement * 0.4f; // keep height of asteroid field smaller compared to width of x and z
-        displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
-        float z = cos(angle) * radius + displacement;
-        model = glm::translate(model, glm::vec3(x, y, z));
+    // every asteroid takes its random numbers from a counter based generator keyed by the seed and its own index, so
+    // the field is generated in parallel and comes out bit identical for any number of threads
+    Philox random(ASTEROID_SEED);
+    jobSystem.ParallelFor(0, amount, 4096, [&](unsigned int begin, unsigned int end)
+                          {
+                              for (unsigned int first = begin; first < end; first += 8)
+                              {
+                                  // the random numbers of eight asteroids at once, five per asteroid from two streams
+                                  uint32_t bits[4][8], moreBits[4][8];
+                                  random.Generate8(first, 0, bits);
+                                  random.Generate8(first, 1, moreBits);
+                                  unsigned int count = std::min(8u, end - first);
+                                  for (unsigned int lane = 0; lane < count; lane++)
+                                  {
+                                      unsigned int i = first + lane;
+                                      glm::mat4 model = glm::mat4(1.0f);
+                                      // 1. translation: displace along circle with 'radius' in range [-offset, offset]
+                                      float angle = (float)i / (float)amount * 360.0f;
+                                      float displacement = Philox::Uniform(bits[0][lane]) * 2.0f * offset - offset;
+                                      float x = sin(angle) * radius + displacement;
+                                      displacement = Philox::Uniform(bits[1][lane]) * 2.0f * offset - offset;
+                                      float y = displacement * 0.4f; // keep height of asteroid field smaller compared to width of x and z
+                                      displacement = Philox::Uniform(bits[2][lane]) * 2.0f * offset - offset;
+                                      float z = cos(angle) * radius + displacement;
+                                      model = glm::translate(model, glm::vec3(x, y, z));
 
-        // 2. scale: Scale between 0.05 and 0.25f
-        float scale = static_cast<float>((rand() % 20) / 100.0 + 0.05);
-        model = glm::scale(model, glm::vec3(scale));
+                                      // 2. scale: Scale between 0.05 and 0.25f
+                                      float scale = 0.05f + Philox::Uniform(bits[3][lane]) * 0.2f;
+                                      model = glm::scale(model, glm::vec3(scale));
 
-        // 3. rotation: add random rotation around a (semi)randomly picked rotation axis vector
-        float rotAngle = static_cast<float>((rand() % 360));
-        model = glm::rotate(model, rotAngle, glm::vec3(0.4f, 0.6f, 0.8f));
+                                      // 3. rotation: add random rotation around a (semi)randomly picked rotation axis vector
+                                      float rotAngle = Philox::Uniform(moreBits[0][lane]) * 360.0f;
+                                      model = glm::rotate(model, rotAngle, glm::vec3(0.4f, 0.6f, 0.8f));
 
-        // 4. now add to list of matrices
-        modelMatrices[i] = model;
-    }
-    unsigned int buffer;
-    glGenBuffers(1, &buffer);
-    glBindBuffer(GL_ARRAY_BUFFER, buffer);
-    glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
-
-    for (unsigned int i = 0; i < rock.meshes.size(); i++)
-    {
-        unsigned int VAO = rock.meshes[i].VAO;
-        glBindVertexArray(VAO);
-        // set attribute pointers for matrix (4 times vec4)
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void *)0);
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void *)(sizeof(glm::vec4)));
-        glEnableVertexAttribArray(5);
-        glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void *)(2 * sizeof(glm::vec4)));
-        glEnableVertexAttribArray(6);
-        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void *)(3 * sizeof(glm::vec4)));
+                                      // 4. now add to list of matrices
+                                      modelMatrices[i] = model;
+                                      instancePositions[i] = glm::vec3(x, y, z);
+                                      instanceRotations[i] = glm::angleAxis(rotAngle, glm::normalize(glm::vec3(0.4f, 0.6f, 0.8f)));
+                                      instanceScales[i] = scale;
+                                      float distance = glm::length(glm::vec2(x, z));
+                                      orbitSpeeds[i] = 100.0f / (distance * sqrt(distance));
+                                  }
+                              }
+                          });
 
-        glVertexAttribDivisor(3, 1);
-        glVertexAttribDivisor(4, 1);
-        glVertexAttribDivisor(5, 1);
-        glVertexAttribDivisor(6, 1);
-
-        glBindVertexArray(0);
-    }
+    // the instance matrices are rewritten every frame by the job system straight into mapped memory
+    InstanceBuffer instanceBuffer(amount, sizeof(glm::mat4));
+    instanceBuffer.AddMat4Attribute(3);
+    instanceBuffer.Attach(rock.meshes);
+    // 24 bytes per asteroid instead of 64; both buffers start at location 3, Flush() re-points the VAOs at the one drawn
+    InstanceBuffer compactInstanceBuffer(amount, sizeof(CompactInstance));
+    compactInstanceBuffer.AddCompactInstanceAttributes(3);
+    compactInstanceBuffer.Attach(rock.meshes);
     while (!glfwWindowShouldClose(window))
     {
         float currentFrame = glfwGetTime();
@@ -130,9 +148,6 @@ int main()
         // configure transformation matrices
         glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
         glm::mat4 view = camera.GetViewMatrix();
-        rockshader.use();
-        rockshader.setMat4("projection", projection);
-        rockshader.setMat4("view", view);
         plantshader.use();
         plantshader.setMat4("projection", projection);
         plantshader.setMat4("view", view);
@@ -142,8 +157,51 @@ int main()
         plantshader.setMat4("model", model);
         planet.Draw(plantshader);
 
-        rockshader.use();
-        rockshader.setInt("texture_diffuse1", 0);
+        // animate the belt: rotate every asteroid around the planet's y axis
+        InstanceBuffer &activeInstances = compactInstances ? compactInstanceBuffer : instanceBuffer;
+        if (compactInstances)
+        {
+            // the compact buffer only feeds locations 3 and 4; 5 and 6 would still read the matrices of the mat4 buffer
+            instanceBuffer.DisableAttributes();
+            CompactInstance *instances = compactInstanceBuffer.Begin<CompactInstance>();
+            jobSystem.ParallelFor(0, amount, 4096, [&](unsigned int begin, unsigned int end)
+                                  {
+                                      for (unsigned int i = begin; i < end; i++)
+                                      {
+                                          glm::quat orbit = glm::angleAxis(currentFrame * orbitSpeeds[i], glm::vec3(0.0f, 1.0f, 0.0f));
+                                          instances[i] = CompactInstance::Encode(orbit * instancePositions[i], orbit * instanceRotations[i], instanceScales[i]);
+                                      }
+                                      compactInstanceBuffer.MarkDirty(begin, end - begin);
+                                  });
+        }
+        else
+        {
+            glm::mat4 *instanceMatrices = instanceBuffer.Begin<glm::mat4>();
+            jobSystem.ParallelFor(0, amount, 4096, [&](unsigned int begin, unsigned int end)
+                                  {
+                                      for (unsigned int i = begin; i < end; i++)
+                                      {
+                                          float orbit = currentFrame * orbitSpeeds[i];
+                                          float c = cos(orbit), s = sin(orbit);
+                                          glm::mat4 m = modelMatrices[i];
+                                          for (int col = 0; col < 4; col++)
+                                          {
+                                              float x = m[col].x, z = m[col].z;
+                                              m[col].x = c * x + s * z;
+                                              m[col].z = -s * x + c * z;
+                                          }
+                                          instanceMatrices[i] = m;
+                                      }
+                                      instanceBuffer.MarkDirty(begin, end - begin);
+                                  });
+        }
+        activeInstances.Flush();
+
+        Shader &activeRockShader = compactInstances ? rockcompactshader : rockshader;
+        activeRockShader.use();
+        activeRockShader.setMat4("projection", projection);
+        activeRockShader.setMat4("view", view);
+        activeRockShader.setInt("texture_diffuse1", 0);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, rock.textures_loaded[0].id);
         for (unsigned int i = 0; i < rock.meshes.size(); i++)
@@ -152,6 +210,7 @@ int main()
             glDrawElementsInstanced(GL_TRIANGLES, static_cast<unsigned int>(rock.meshes[i].indices.size()), GL_UNSIGNED_INT, 0, amount);
             glBindVertexArray(0);
         }
+        activeInstances.End();
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -173,6 +232,15 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && !compactKeyPressed)
+    {
+        compactInstances = !compactInstances;
+        compactKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE)
+    {
+        compactKeyPressed = false;
+    }
 }
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
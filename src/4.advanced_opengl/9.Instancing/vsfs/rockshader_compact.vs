@@ -0,0 +1,25 @@
+#version 330 core
+layout(location=0)in vec3 aPos;
+layout(location=2)in vec2 aTexCoords;
+// compact instance transform: position + uniform scale, and a unit quaternion (x, y, z, w)
+layout(location=3)in vec4 aInstancePositionScale;
+layout(location=4)in vec4 aInstanceRotation;
+
+out vec2 TexCoords;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+vec3 rotate(vec4 q,vec3 v)
+{
+    return v+2.*cross(q.xyz,cross(q.xyz,v)+q.w*v);
+}
+
+void main()
+{
+    TexCoords=aTexCoords;
+    // the quaternion was quantized to 16 bits per component, renormalize it
+    vec4 rotation=normalize(aInstanceRotation);
+    vec3 worldPos=aInstancePositionScale.xyz+rotate(rotation,aPos*aInstancePositionScale.w);
+    gl_Position=projection*view*vec4(worldPos,1.f);
+}
\ No newline at end of file
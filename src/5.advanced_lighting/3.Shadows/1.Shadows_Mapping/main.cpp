@@ -2,6 +2,9 @@
 #include <GLFW/glfw3.h>
 #include "shader.h"
 #include "camera.h"
+#include "cascaded_shadow_map.h"
+#include "evsm_shadow_map.h"
+#include "gpu_timer.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -19,6 +22,46 @@ void renderScene(const Shader &shader);
 void renderQuad();
 void renderCube();
 
+// shadow casting cubes: model matrix and world space bounds
+struct Caster
+{
+    glm::mat4 Model;
+    glm::vec3 BoundsMin, BoundsMax;
+    // moves every frame, so it's left out of the static shadow cache
+    bool Dynamic;
+};
+std::vector<Caster> casters;
+void addCaster(const glm::mat4 &model, bool dynamic = false);
+void setCasterModel(Caster &caster, const glm::mat4 &model);
+void animateCasters(float time);
+// how the lighting pass filters the shadow map
+enum ShadowFilter
+{
+    PCF_3X3,
+    PCF_5X5,
+    PCF_7X7,
+    EVSM,
+    SHADOW_FILTER_COUNT
+};
+const char *shadowFilterNames[SHADOW_FILTER_COUNT] = {"PCF 3x3", "PCF 5x5", "PCF 7x7", "EVSM"};
+void benchmarkShadowFilters(Shader &shader, Shader &blurShader, EvsmShadowMap &evsm, unsigned int depthArray);
+unsigned int renderCascades(CascadedShadowMap &csm, Shader &depthShader, unsigned int &rebuilt, std::string &drawn, bool *redrawn);
+void benchmarkStaticCache(CascadedShadowMap &csm, Shader &depthShader, const glm::vec3 &lightPos);
+// C tints the scene by cascade
+bool showCascades = false;
+bool cascadesKeyPressed = false;
+// K switches between caching the static casters' depth and redrawing every caster each frame
+bool cacheShadows = true;
+bool cacheShadowsKeyPressed = false;
+// P cycles the shadow filters, R / F widen and narrow the EVSM blur, B times a camera walk with and without the
+// static cache and every filter
+ShadowFilter shadowFilter = EVSM;
+bool shadowFilterKeyPressed = false;
+int evsmBlurRadius = 2;
+bool blurUpKeyPressed = false;
+bool blurDownKeyPressed = false;
+bool benchmark = false;
+bool benchmarkKeyPressed = false;
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 float lastX = 400, lastY = 300;
@@ -60,6 +103,7 @@ int main()
     Shader ourshader("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/1.Shadows_Mapping/vsfs/ourshader.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/1.Shadows_Mapping/vsfs/ourshader.fs");
     Shader shader("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/1.Shadows_Mapping/vsfs/shader.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/1.Shadows_Mapping/vsfs/shader.fs");
     Shader depthshader("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/1.Shadows_Mapping/vsfs/depthshader.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/1.Shadows_Mapping/vsfs/depthshader.fs");
+    Shader evsmshader("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/1.Shadows_Mapping/vsfs/evsm_blur.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/1.Shadows_Mapping/vsfs/evsm_blur.fs");
     float planeVertices[] = {
         // positions            // normals         // texcoords
         25.0f, -0.5f, 25.0f, 0.0f, 1.0f, 0.0f, 25.0f, 0.0f,
@@ -85,24 +129,42 @@ int main()
     glBindVertexArray(0);
 
     unsigned int woodTexture = loadTexture("C:/Users/22175/Desktop/LearnOpenGL/assets/textures/wood.png");
-    unsigned int depthMapFBO;
-    glGenFramebuffers(1, &depthMapFBO);
-    const unsigned int SHADOW_WIDTH = 1024, SHADOW_HEIGHT = 1024;
-    unsigned int depthMap;
-    glGenTextures(1, &depthMap);
-    glBindTexture(GL_TEXTURE_2D, depthMap);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-    float borderColor[] = {1.0, 1.0, 1.0, 1.0};
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-    glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // four 512x512 cascades take the memory of the single 1024x1024 map they replace, but cover the view out to 50
+    // units instead of a fixed 20x20 box; the static cache adds four 1024x1024 layers
+    CascadedShadowMap csm(512, 4);
+    // half float moments of every cascade, blurred and mip-mapped for the EVSM filter
+    EvsmShadowMap evsm(csm.Resolution, csm.CascadeCount);
+
+    // the original three cubes, then pillars spread over the whole floor
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(0.0f, 1.5f, 0.0));
+    model = glm::scale(model, glm::vec3(0.5f));
+    addCaster(model);
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(2.0f, 0.0f, 1.0));
+    model = glm::scale(model, glm::vec3(0.5f));
+    addCaster(model);
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(-1.0f, 0.0f, 2.0));
+    model = glm::rotate(model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
+    model = glm::scale(model, glm::vec3(0.25));
+    addCaster(model);
+    for (int x = -20; x <= 20; x += 5)
+    {
+        for (int z = -20; z <= 20; z += 5)
+        {
+            if (std::abs(x) < 5 && std::abs(z) < 5)
+                continue;
+            float height = 1.0f + static_cast<float>((x * 7 + z * 13) & 3);
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(static_cast<float>(x), height - 0.5f, static_cast<float>(z)));
+            model = glm::scale(model, glm::vec3(0.4f, height, 0.4f));
+            addCaster(model);
+        }
+    }
+    // two cubes circling the middle; animateCasters moves them
+    addCaster(glm::mat4(1.0f), true);
+    addCaster(glm::mat4(1.0f), true);
 
     ourshader.use();
     ourshader.setInt("diffuseTexture", 0);
@@ -110,47 +172,72 @@ int main()
     shader.use();
     shader.setInt("depthMap", 0);
     glm::vec3 lightPos(-2.0f, 4.0f, -1.0f);
+    GpuTimer shadowTimer;
+    float lastStatsTime = 0.0f;
     while (!glfwWindowShouldClose(window))
     {
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
         processInput(window);
+        animateCasters(currentFrame);
         glClearColor(0.f, 0.f, 0.f, 0.f);
         // 设置清空屏幕所用的颜色
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glm::mat4 lightProjection, lightView;
-        glm::mat4 lightSpaceMatrix;
-        float near_plane = 1.0f, far_plane = 7.5f;
-        lightProjection = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, near_plane, far_plane);
-        lightView = glm::lookAt(lightPos, glm::vec3(0.0f), glm::vec3(0.0, 1.0, 0.0));
-        lightSpaceMatrix = lightProjection * lightView;
-        depthshader.use();
-        depthshader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, woodTexture);
-        renderScene(depthshader);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        ourshader.use();
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), static_cast<float>(SCR_WIDTH) / static_cast<float>(SCR_HEIGHT), 0.1f, 100.f);
         glm::mat4 view = camera.GetViewMatrix();
+        if (benchmark)
+            benchmarkStaticCache(csm, depthshader, lightPos);
+        // a directional light shining from lightPos towards the origin
+        csm.CacheStatic = cacheShadows;
+        csm.Update(view, glm::radians(camera.Zoom), static_cast<float>(SCR_WIDTH) / static_cast<float>(SCR_HEIGHT), 0.1f, -lightPos);
+        std::string drawn;
+        unsigned int rebuilt = 0;
+        bool redrawn[SHADOW_MAX_CASCADES];
+        renderCascades(csm, depthshader, rebuilt, drawn, redrawn);
+        // the moments of a cascade whose depth is what it was last frame are still valid
+        for (unsigned int i = 0; i < csm.CascadeCount; i++)
+            if (redrawn[i])
+                evsm.Invalidate(i);
+
+        ourshader.use();
         ourshader.setMat4("projection", projection);
         ourshader.setMat4("view", view);
         ourshader.setVec3("viewPos", camera.Position);
         ourshader.setVec3("lightPos", lightPos);
-        ourshader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
+        ourshader.setBool("showCascades", showCascades);
+        csm.Bind(ourshader, 1);
+        evsm.Bind(ourshader, 2);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, woodTexture);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, depthMap);
+        evsm.BlurRadius = evsmBlurRadius;
+        if (benchmark)
+        {
+            benchmarkShadowFilters(ourshader, evsmshader, evsm, csm.DepthArray);
+            benchmark = false;
+        }
+
+        // the filtering cost: the moment blur for EVSM, plus the lighting pass that does the PCF taps or the one fetch
+        shadowTimer.Begin();
+        unsigned int refiltered = 0;
+        if (shadowFilter == EVSM)
+            refiltered = evsm.Filter(evsmshader, csm.DepthArray);
+        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        ourshader.use();
+        ourshader.setInt("shadowFilter", shadowFilter);
         renderScene(ourshader);
+        shadowTimer.End();
+        // casters drawn into each cascade, once per second
+        if (currentFrame - lastStatsTime > 1.0f)
+        {
+            std::string title = "LearnOpenGL | casters per cascade: " + drawn + " of " + std::to_string(casters.size()) +
+                                (cacheShadows ? " | static cache: " + std::to_string(rebuilt) + " cascades redrawn" : std::string(" | static cache: off")) +
+                                " | " + shadowFilterNames[shadowFilter] + (shadowFilter == EVSM ? " blur " + std::to_string(evsmBlurRadius) + ", " + std::to_string(refiltered) + " layers refiltered" : std::string()) +
+                                ": " + std::to_string(shadowTimer.GetMilliseconds()) + " ms";
+            glfwSetWindowTitle(window, title.c_str());
+            lastStatsTime = currentFrame;
+        }
 
         // 绘制三角形
         glfwSwapBuffers(window);
@@ -163,6 +250,139 @@ int main()
     return 0;
 }
 
+// draws the casters into every cascade, the static ones only into the caches that went stale; returns the number of
+// caster draws, counts the redrawn caches in rebuilt, lists the draws per cascade in drawn and sets redrawn[i] when
+// cascade i may hold other depths than after the last call. Ends with csm.End().
+unsigned int renderCascades(CascadedShadowMap &csm, Shader &depthShader, unsigned int &rebuilt, std::string &drawn, bool *redrawn)
+{
+    // a cascade's depth only changes with its matrix, the cache mode, a redrawn cache or a dynamic caster in it now or
+    // in the last call; the static casters don't move
+    static glm::mat4 lastMatrices[SHADOW_MAX_CASCADES];
+    static unsigned int lastDynamicDraws[SHADOW_MAX_CASCADES] = {};
+    static bool lastCacheStatic = false;
+    static bool drawnBefore = false;
+    depthShader.use();
+    unsigned int total = 0;
+    for (unsigned int i = 0; i < csm.CascadeCount; i++)
+    {
+        // the static casters only when the cascade left its cache, about every half a cascade of camera movement
+        unsigned int count = 0, dynamicDraws = 0;
+        bool cacheRedrawn = false;
+        if (csm.CacheStatic && csm.BeginStaticCascade(i))
+        {
+            depthShader.setMat4("lightSpaceMatrix", csm.StaticMatrices[i]);
+            for (unsigned int c = 0; c < casters.size(); c++)
+            {
+                if (casters[c].Dynamic || !csm.IntersectsStatic(i, casters[c].BoundsMin, casters[c].BoundsMax))
+                    continue;
+                depthShader.setMat4("model", casters[c].Model);
+                renderCube();
+                count++;
+            }
+            rebuilt++;
+            cacheRedrawn = true;
+        }
+        depthShader.setMat4("lightSpaceMatrix", csm.LightSpaceMatrices[i]);
+        csm.BeginCascade(i);
+        // the floor only receives, and the casters outside the cascade are skipped
+        for (unsigned int c = 0; c < casters.size(); c++)
+        {
+            if ((csm.CacheStatic && !casters[c].Dynamic) || !csm.Intersects(i, casters[c].BoundsMin, casters[c].BoundsMax))
+                continue;
+            depthShader.setMat4("model", casters[c].Model);
+            renderCube();
+            count++;
+            dynamicDraws += casters[c].Dynamic ? 1 : 0;
+        }
+        redrawn[i] = !drawnBefore || csm.CacheStatic != lastCacheStatic || cacheRedrawn || csm.LightSpaceMatrices[i] != lastMatrices[i] ||
+                     dynamicDraws > 0 || lastDynamicDraws[i] > 0;
+        lastMatrices[i] = csm.LightSpaceMatrices[i];
+        lastDynamicDraws[i] = dynamicDraws;
+        drawn += (i == 0 ? "" : "/") + std::to_string(count);
+        total += count;
+    }
+    lastCacheStatic = csm.CacheStatic;
+    drawnBefore = true;
+    csm.End();
+    return total;
+}
+
+// walks the camera across the floor, turning as it goes, once with and once without the static cache, and reports how
+// many caches were redrawn, how many casters that drew and the GPU time of the shadow pass per frame
+void benchmarkStaticCache(CascadedShadowMap &csm, Shader &depthShader, const glm::vec3 &lightPos)
+{
+    const unsigned int frames = 600;
+    static unsigned int query = 0;
+    if (query == 0)
+        glGenQueries(1, &query);
+    for (int cached = 1; cached >= 0; cached--)
+    {
+        csm.CacheStatic = cached != 0;
+        csm.InvalidateStatic();
+        unsigned int rebuilt = 0, draws = 0;
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        for (unsigned int frame = 0; frame < frames; frame++)
+        {
+            // 20 units along the floor at 2 units per second, looking from side to side
+            float t = static_cast<float>(frame) / frames;
+            glm::vec3 position(-10.0f + 20.0f * t, 1.5f, 8.0f);
+            float yaw = std::sin(t * 6.28318530718f) * 0.8f;
+            glm::mat4 view = glm::lookAt(position, position + glm::vec3(std::sin(yaw), -0.2f, -std::cos(yaw)), glm::vec3(0.0f, 1.0f, 0.0f));
+            csm.Update(view, glm::radians(45.0f), static_cast<float>(SCR_WIDTH) / static_cast<float>(SCR_HEIGHT), 0.1f, -lightPos);
+            std::string drawn;
+            bool redrawn[SHADOW_MAX_CASCADES];
+            draws += renderCascades(csm, depthShader, rebuilt, drawn, redrawn);
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+        // waits for the GPU; fine for a benchmark
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        std::cout << "cascades over a " << frames << " frame walk, " << (cached ? "static cache" : "no cache") << ": "
+                  << rebuilt << " of " << frames * csm.CascadeCount << " caches redrawn, " << draws << " caster draws, "
+                  << static_cast<float>(nanoseconds) / 1000000.0f / frames << " ms per frame" << std::endl;
+    }
+    csm.InvalidateStatic();
+    glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+}
+
+// GPU time of the lighting pass with every shadow filter, EVSM including its moment blur; each filter runs a number of
+// times in one timer query and the average is reported. Expects shader in use with the frame's uniforms set.
+void benchmarkShadowFilters(Shader &shader, Shader &blurShader, EvsmShadowMap &evsm, unsigned int depthArray)
+{
+    const unsigned int runs = 20;
+    static unsigned int query = 0;
+    if (query == 0)
+        glGenQueries(1, &query);
+    for (unsigned int filter = 0; filter < SHADOW_FILTER_COUNT; filter++)
+    {
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        for (unsigned int run = 0; run < runs; run++)
+        {
+            // every run blurs all layers, like a frame in which every cascade was redrawn
+            if (filter == EVSM)
+            {
+                evsm.Invalidate();
+                evsm.Filter(blurShader, depthArray);
+            }
+            glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            shader.use();
+            shader.setInt("shadowFilter", filter);
+            renderScene(shader);
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+        // waits for the GPU; fine for a benchmark
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        std::cout << "shadows " << SCR_WIDTH << "x" << SCR_HEIGHT << ", " << shadowFilterNames[filter];
+        if (filter == EVSM)
+            std::cout << " (blur radius " << evsm.BlurRadius << ", " << evsm.Layers * 2 << " blur passes)";
+        else
+            std::cout << " (" << (2 * filter + 3) * (2 * filter + 3) << " taps)";
+        std::cout << ": " << static_cast<float>(nanoseconds) / 1000000.0f / runs << " ms" << std::endl;
+    }
+}
+
 void renderScene(const Shader &shader)
 {
     // floor
@@ -171,22 +391,53 @@ void renderScene(const Shader &shader)
     glBindVertexArray(planeVAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
     // cubes
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(0.0f, 1.5f, 0.0));
-    model = glm::scale(model, glm::vec3(0.5f));
-    shader.setMat4("model", model);
-    renderCube();
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(2.0f, 0.0f, 1.0));
-    model = glm::scale(model, glm::vec3(0.5f));
-    shader.setMat4("model", model);
-    renderCube();
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(-1.0f, 0.0f, 2.0));
-    model = glm::rotate(model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
-    model = glm::scale(model, glm::vec3(0.25));
-    shader.setMat4("model", model);
-    renderCube();
+    for (unsigned int i = 0; i < casters.size(); i++)
+    {
+        shader.setMat4("model", casters[i].Model);
+        renderCube();
+    }
+}
+
+// adds a unit cube with this model matrix to the casters
+void addCaster(const glm::mat4 &model, bool dynamic)
+{
+    Caster caster;
+    caster.Dynamic = dynamic;
+    setCasterModel(caster, model);
+    casters.push_back(caster);
+}
+
+// moves a caster and fits its world space box around the new corners; moving a static caster means calling
+// InvalidateStatic() on the shadow map
+void setCasterModel(Caster &caster, const glm::mat4 &model)
+{
+    caster.Model = model;
+    caster.BoundsMin = glm::vec3(1e30f);
+    caster.BoundsMax = glm::vec3(-1e30f);
+    for (unsigned int c = 0; c < 8; c++)
+    {
+        glm::vec3 corner = glm::vec3(model * glm::vec4(c & 1 ? 1.0f : -1.0f, c & 2 ? 1.0f : -1.0f, c & 4 ? 1.0f : -1.0f, 1.0f));
+        caster.BoundsMin = glm::vec3(std::min(caster.BoundsMin.x, corner.x), std::min(caster.BoundsMin.y, corner.y), std::min(caster.BoundsMin.z, corner.z));
+        caster.BoundsMax = glm::vec3(std::max(caster.BoundsMax.x, corner.x), std::max(caster.BoundsMax.y, corner.y), std::max(caster.BoundsMax.z, corner.z));
+    }
+}
+
+// the dynamic casters circle the middle of the floor, half a turn apart
+void animateCasters(float time)
+{
+    unsigned int k = 0;
+    for (unsigned int i = 0; i < casters.size(); i++)
+    {
+        if (!casters[i].Dynamic)
+            continue;
+        float angle = time * 0.5f + k * 3.14159265359f;
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(std::cos(angle) * 3.0f, 1.0f, std::sin(angle) * 3.0f));
+        model = glm::rotate(model, time, glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(0.3f));
+        setCasterModel(casters[i], model);
+        k++;
+    }
 }
 unsigned int cubeVAO = 0;
 unsigned int cubeVBO = 0;
@@ -318,6 +569,60 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && !cascadesKeyPressed)
+    {
+        showCascades = !showCascades;
+        cascadesKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE)
+    {
+        cascadesKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS && !cacheShadowsKeyPressed)
+    {
+        cacheShadows = !cacheShadows;
+        cacheShadowsKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_K) == GLFW_RELEASE)
+    {
+        cacheShadowsKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS && !shadowFilterKeyPressed)
+    {
+        shadowFilter = static_cast<ShadowFilter>((shadowFilter + 1) % SHADOW_FILTER_COUNT);
+        shadowFilterKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE)
+    {
+        shadowFilterKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS && !blurUpKeyPressed)
+    {
+        evsmBlurRadius = std::min(evsmBlurRadius + 1, EVSM_MAX_BLUR_RADIUS);
+        blurUpKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_RELEASE)
+    {
+        blurUpKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS && !blurDownKeyPressed)
+    {
+        evsmBlurRadius = std::max(evsmBlurRadius - 1, 0);
+        blurDownKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_RELEASE)
+    {
+        blurDownKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS && !benchmarkKeyPressed)
+    {
+        benchmark = true;
+        benchmarkKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_RELEASE)
+    {
+        benchmarkKeyPressed = false;
+    }
 }
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
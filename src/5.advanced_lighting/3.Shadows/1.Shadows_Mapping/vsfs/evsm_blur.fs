@@ -0,0 +1,40 @@
+#version 330 core
+// separable gaussian over exponentially warped depth moments, see evsm_shadow_map.h. The first pass reads one layer of
+// the depth array and warps every tap, the second blurs the first pass's moments.
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2DArray depthMap;
+uniform sampler2D moments;
+uniform bool firstPass;
+uniform int layer;
+uniform int radius;
+// one texel along the blur axis
+uniform vec2 direction;
+uniform vec2 exponents;
+
+vec4 Moments(vec2 uv)
+{
+    if(!firstPass)
+    return texture(moments,uv);
+    float d=texture(depthMap,vec3(uv,float(layer))).r*2.-1.;
+    float p=exp(exponents.x*d);
+    float n=-exp(-exponents.y*d);
+    return vec4(p,p*p,n,n*n);
+}
+
+void main()
+{
+    // sigma so the kernel ends at about two standard deviations
+    float sigma=max(float(radius)*.5,.5);
+    vec4 result=vec4(0.);
+    float total=0.;
+    for(int i=-radius;i<=radius;++i)
+    {
+        float weight=exp(-float(i*i)/(2.*sigma*sigma));
+        result+=Moments(TexCoords+direction*float(i))*weight;
+        total+=weight;
+    }
+    FragColor=result/total;
+}
\ No newline at end of file
@@ -5,49 +5,91 @@ in VS_OUT{
     vec3 FragPos;
     vec3 Normal;
     vec2 TexCoords;
-    vec4 FragPosLightSpace;
+    float ViewDepth;
 }fs_in;
 
 uniform sampler2D diffuseTexture;
-uniform sampler2D shadowMap;
+// one shadow map layer per cascade, see cascaded_shadow_map.h
+uniform sampler2DArray shadowMap;
+uniform int cascadeCount;
+uniform mat4 lightSpaceMatrices[4];
+uniform float cascadeSplits[4];
+uniform float cascadeTexelSizes[4];
+uniform bool showCascades;
+// 0, 1, 2: PCF over 3x3, 5x5 and 7x7 texels; 3: one filtered fetch of the EVSM moments, see evsm_shadow_map.h
+uniform int shadowFilter;
+uniform sampler2DArray momentMap;
+uniform vec2 evsmExponents;
 
 uniform vec3 lightPos;
 uniform vec3 viewPos;
 
-float ShadowCalculation(vec4 fragPosLightSpace)
+const vec3 cascadeColors[4]=vec3[](vec3(1.,.4,.4),vec3(.4,1.,.4),vec3(.4,.4,1.),vec3(1.,1.,.4));
+
+// first cascade that reaches past this fragment, or -1 beyond the shadow distance
+int CascadeIndex()
+{
+    for(int i=0;i<cascadeCount;++i)
+    {
+        if(fs_in.ViewDepth<cascadeSplits[i])
+        return i;
+    }
+    return-1;
+}
+
+// Chebyshev's upper bound on the share of the filter region lit at this warped depth. The bottom of the bound is cut
+// off, which removes most of the light bleeding where casters overlap at the price of slightly harder edges.
+float Chebyshev(vec2 moments,float depth,float minVariance)
+{
+    if(depth<=moments.x)
+    return 1.;
+    float variance=max(moments.y-moments.x*moments.x,minVariance);
+    float d=depth-moments.x;
+    float pMax=variance/(variance+d*d);
+    return clamp((pMax-.2)/.8,0.,1.);
+}
+
+float EvsmShadow(vec3 projCoords,int cascade)
 {
-    // perform perspective divide
-    vec3 projCoords=fragPosLightSpace.xyz/fragPosLightSpace.w;
-    // transform to [0,1] range
-    projCoords=projCoords*.5+.5;
-    // get closest depth value from light's perspective (using [0,1] range fragPosLight as coords)
-    float closestDepth=texture(shadowMap,projCoords.xy).r;
+    vec4 moments=texture(momentMap,vec3(projCoords.xy,float(cascade)));
+    float depth=projCoords.z*2.-1.;
+    float p=exp(evsmExponents.x*depth);
+    float n=-exp(-evsmExponents.y*depth);
+    // the variance floor follows the slope of each warp, in place of a depth bias
+    float pMin=.0005*evsmExponents.x*p;
+    float nMin=.0005*evsmExponents.y*n;
+    return 1.-min(Chebyshev(moments.xy,p,pMin*pMin),Chebyshev(moments.zw,n,nMin*nMin));
+}
+
+float ShadowCalculation(int cascade,vec3 normal,vec3 lightDir)
+{
+    if(cascade<0)
+    return 0.;
+    // normal offset: look up from about a texel off the surface, so the depth bias can stay small in every cascade
+    vec3 offsetPos=fs_in.FragPos+normal*cascadeTexelSizes[cascade]*1.5;
+    // orthographic, no perspective divide; transform to [0,1] range
+    vec3 projCoords=(lightSpaceMatrices[cascade]*vec4(offsetPos,1.)).xyz*.5+.5;
     // get depth of current fragment from light's perspective
     float currentDepth=projCoords.z;
-    // calculate bias (based on depth map resolution and slope)
-    vec3 normal=normalize(fs_in.Normal);
-    vec3 lightDir=normalize(lightPos-fs_in.FragPos);
-    float bias=max(.05*(1.-dot(normal,lightDir)),.005);
-    // check whether current frag pos is in shadow
-    // float shadow = currentDepth - bias > closestDepth  ? 1.0 : 0.0;
-    // PCF
+    // keep the shadow at 0.0 when outside the far_plane region of the light's frustum.
+    if(currentDepth>1.)
+    return 0.;
+    if(shadowFilter==3)
+    return EvsmShadow(projCoords,cascade);
+    float bias=max(.002*(1.-dot(normal,lightDir)),.0005);
+    // PCF, (2r+1)^2 taps
+    int r=shadowFilter+1;
     float shadow=0.;
-    vec2 texelSize=1./textureSize(shadowMap,0);
-    for(int x=-1;x<=1;++x)
+    vec2 texelSize=1./vec2(textureSize(shadowMap,0).xy);
+    for(int x=-r;x<=r;++x)
     {
-        for(int y=-1;y<=1;++y)
+        for(int y=-r;y<=r;++y)
         {
-            float pcfDepth=texture(shadowMap,projCoords.xy+vec2(x,y)*texelSize).r;
+            float pcfDepth=texture(shadowMap,vec3(projCoords.xy+vec2(x,y)*texelSize,float(cascade))).r;
             shadow+=currentDepth-bias>pcfDepth?1.:0.;
         }
     }
-    shadow/=9.;
-    
-    // keep the shadow at 0.0 when outside the far_plane region of the light's frustum.
-    if(projCoords.z>1.)
-    shadow=0.;
-    
-    return shadow;
+    return shadow/float((2*r+1)*(2*r+1));
 }
 
 void main()
@@ -69,8 +111,11 @@ void main()
     spec=pow(max(dot(normal,halfwayDir),0.),64.);
     vec3 specular=spec*lightColor;
     // calculate shadow
-    float shadow=ShadowCalculation(fs_in.FragPosLightSpace);
+    int cascade=CascadeIndex();
+    float shadow=ShadowCalculation(cascade,normal,lightDir);
     vec3 lighting=(ambient+(1.-shadow)*(diffuse+specular))*color;
+    if(showCascades&&cascade>=0)
+    lighting*=cascadeColors[cascade];
     
     FragColor=vec4(lighting,1.);
 }
\ No newline at end of file
@@ -9,19 +9,20 @@ out VS_OUT{
     vec3 FragPos;
     vec3 Normal;
     vec2 TexCoords;
-    vec4 FragPosLightSpace;
+    float ViewDepth;
 }vs_out;
 
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
-uniform mat4 lightSpaceMatrix;
 
 void main()
 {
     vs_out.FragPos=vec3(model*vec4(aPos,1.));
     vs_out.Normal=transpose(inverse(mat3(model)))*aNormal;
     vs_out.TexCoords=aTexCoords;
-    vs_out.FragPosLightSpace=lightSpaceMatrix*vec4(vs_out.FragPos,1.);
-    gl_Position=projection*view*model*vec4(aPos,1.);
+    vec4 viewPos=view*vec4(vs_out.FragPos,1.);
+    // the cascade is picked by the distance along the view direction
+    vs_out.ViewDepth=-viewPos.z;
+    gl_Position=projection*viewPos;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <GLFW/glfw3.h>
 #include "shader.h"
 #include "camera.h"
+#include "gpu_timer.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -10,17 +11,114 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// the ways the depth cubemap can be drawn
+enum ShadowPath
+{
+    // every triangle goes through a geometry shader that emits it to all six faces (the original path)
+    GEOMETRY_SHADER,
+    // the same geometry shader, but only emitting to the faces the caster's bounding sphere reaches
+    GEOMETRY_SHADER_CULLED,
+    // one pass per face, each drawing only the casters that reach it
+    SIX_PASSES,
+    // one instance per reached face, the vertex shader picks the layer; needs ARB_shader_viewport_layer_array or
+    // AMD_vertex_shader_layer
+    LAYERED_INSTANCED,
+    SHADOW_PATH_COUNT
+};
+const char *shadowPathNames[SHADOW_PATH_COUNT] = {"geometry shader", "geometry shader, culled", "six culled passes", "instanced layered"};
+
+struct Caster
+{
+    glm::mat4 Model;
+    // world space bounding sphere, for culling against the cube faces
+    glm::vec3 Center;
+    float Radius;
+    // the room is seen from the inside: no face culling and flipped normals
+    bool Inside;
+    // moves every frame, so it's left out of the static shadow cache
+    bool Dynamic;
+};
+
+// which casters a depth pass draws
+enum CasterSet
+{
+    ALL_CASTERS,
+    STATIC_CASTERS,
+    DYNAMIC_CASTERS
+};
+
+// the depth cubemap and what each path needs to draw into it
+struct DepthCubemap
+{
+    unsigned int Texture;
+    // the whole cubemap attached as a layered target
+    unsigned int FBO;
+    // a single face attached each
+    unsigned int FaceFBOs[6];
+    Shader *GeometryShader;
+    Shader *FaceShader;
+    // null when the driver can't write gl_Layer from the vertex shader
+    Shader *LayeredShader;
+};
+
+// depth of the static casters alone. It stays valid while the light and the static casters stand still; each frame
+// starts from a copy of it and only the dynamic casters are drawn on top. Moving a static caster means setting Valid
+// to false.
+struct ShadowCache
+{
+    DepthCubemap Depth;
+    glm::vec3 LightPos;
+    bool Valid;
+};
+
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 void processInput(GLFWwindow *window);
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 unsigned int loadTexture(char const *path);
+bool hasExtension(const char *name);
+DepthCubemap createDepthCubemap(Shader *geometryShader, Shader *faceShader, Shader *layeredShader);
+void addCaster(glm::mat4 model, bool inside = false, bool dynamic = false);
+void setCasterModel(Caster &caster, const glm::mat4 &model);
+void animateCasters(float time);
+bool inCasterSet(const Caster &caster, CasterSet casterSet);
+unsigned int faceMask(const Caster &caster, const glm::vec3 &lightPos, float nearPlane, float farPlane);
+unsigned int reachedFaces(CasterSet casterSet, const glm::vec3 &lightPos, float nearPlane, float farPlane);
+unsigned int renderDepthCubemap(DepthCubemap &cubemap, ShadowPath path, const std::vector<glm::mat4> &shadowTransforms, const glm::vec3 &lightPos, float nearPlane, float farPlane,
+                                CasterSet casterSet = ALL_CASTERS, bool clear = true);
+void copyDepthCubemap(const DepthCubemap &source, const DepthCubemap &destination);
+std::vector<glm::mat4> cubeShadowTransforms(const glm::vec3 &lightPos, float nearPlane, float farPlane);
+unsigned int renderShadows(DepthCubemap &cubemap, ShadowCache &cache, bool useCache, const glm::vec3 &lightPos, float nearPlane, float farPlane,
+                           unsigned int &drawnFaces, bool &cacheRebuilt);
+void benchmarkShadowPaths(DepthCubemap &cubemap, const std::vector<glm::mat4> &shadowTransforms, const glm::vec3 &lightPos, float nearPlane, float farPlane);
+void benchmarkShadowCache(DepthCubemap &cubemap, ShadowCache &cache, const glm::vec3 &lightPos, float nearPlane, float farPlane, float time);
+void renderCaster(const Shader &shader, const Caster &caster, unsigned int instances = 1);
 void renderScene(const Shader &shader);
-void renderCube();
+void renderCube(unsigned int instances = 1);
 bool shadows = true;
 bool shadowsKeyPressed = false;
+// P cycles through the depth cubemap paths, B times all of them and the static cache with a still and a moving light
+ShadowPath shadowPath = GEOMETRY_SHADER;
+bool shadowPathKeyPressed = false;
+bool layeredSupported = false;
+bool benchmark = false;
+bool benchmarkKeyPressed = false;
+// L starts and stops the light, K switches between caching the static casters' depth and redrawing every caster each
+// frame. The light stands still at first, so the cache is only redrawn once and each frame just adds the dynamic caster.
+bool moveLight = false;
+bool moveLightKeyPressed = false;
+bool cacheShadows = true;
+bool cacheShadowsKeyPressed = false;
+std::vector<Caster> casters;
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+const unsigned int SHADOW_WIDTH = 1024, SHADOW_HEIGHT = 1024;
 float lastX = 400, lastY = 300;
 float deltaTime = 0.0f; // 当前帧与上一帧的时间差
 float lastFrame = 0.0f; // 上一帧的时间
@@ -56,37 +154,67 @@ int main()
         return -1;
     }
     glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
     // 初始化GLAD,传入的是GLAD用来加载系统相关的OpenGL函数指针地址的函数
     Shader shader("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/2.Point_Shadows/vsfs/shader.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/2.Point_Shadows/vsfs/shader.fs");
     Shader depthshader("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/2.Point_Shadows/vsfs/depthshader.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/2.Point_Shadows/vsfs/depthshader.fs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/2.Point_Shadows/vsfs/depthshader.gs");
+    Shader depthshaderface("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/2.Point_Shadows/vsfs/depthshader_face.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/2.Point_Shadows/vsfs/depthshader.fs");
+    layeredSupported = hasExtension("GL_ARB_shader_viewport_layer_array") || hasExtension("GL_AMD_vertex_shader_layer");
+    Shader *depthshaderlayered = nullptr;
+    if (layeredSupported)
+        depthshaderlayered = new Shader("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/2.Point_Shadows/vsfs/depthshader_layered.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/2.Point_Shadows/vsfs/depthshader.fs");
+    else
+        std::cout << "gl_Layer can't be written from the vertex shader here, the instanced layered path is unavailable" << std::endl;
 
     unsigned int woodTexture = loadTexture("C:/Users/22175/Desktop/LearnOpenGL/assets/textures/wood.png");
-    unsigned int depthmapfbo;
-    glGenFramebuffers(1, &depthmapfbo);
-    const unsigned int SHADOW_WIDTH = 1024, SHADOW_HEIGHT = 1024;
-    unsigned int depthmap;
-    glGenTextures(1, &depthmap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, depthmap);
-    for (unsigned int i = 0; i < 6; ++i)
-    {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, depthmapfbo);
-    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthmap, 0);
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    DepthCubemap cubemap = createDepthCubemap(&depthshader, &depthshaderface, depthshaderlayered);
+    ShadowCache staticCache = {createDepthCubemap(&depthshader, &depthshaderface, depthshaderlayered), glm::vec3(0.0f), false};
+
+    // room cube
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::scale(model, glm::vec3(5.0f));
+    addCaster(model, true);
+    // cubes
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(4.0f, -3.5f, 0.0));
+    model = glm::scale(model, glm::vec3(0.5f));
+    addCaster(model);
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(2.0f, 3.0f, 1.0));
+    model = glm::scale(model, glm::vec3(0.75f));
+    addCaster(model);
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(-3.0f, -1.0f, 0.0));
+    model = glm::scale(model, glm::vec3(0.5f));
+    addCaster(model);
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(-1.5f, 1.0f, 1.5));
+    model = glm::scale(model, glm::vec3(0.5f));
+    addCaster(model);
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(-1.5f, 2.0f, -3.0));
+    model = glm::rotate(model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
+    model = glm::scale(model, glm::vec3(0.75f));
+    addCaster(model);
+    // rows of small blocks on the floor, so most casters only reach one or two faces and culling has something to do
+    for (int x = -3; x <= 3; x++)
+        for (int z = -3; z <= 3; z++)
+        {
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(x * 1.2f, -4.8f, z * 1.2f));
+            model = glm::scale(model, glm::vec3(0.2f));
+            addCaster(model);
+        }
+    // a cube circling the room; animateCasters moves it
+    addCaster(glm::mat4(1.0f), false, true);
 
     shader.use();
     shader.setInt("diffuseTexture", 0);
     shader.setInt("depthMap", 1);
 
     glm::vec3 lightPos(0.0f, 0.0f, 0.0f);
+    GpuTimer depthTimer;
+    float lastStatsTime = 0.0f;
 
     while (!glfwWindowShouldClose(window))
     {
@@ -94,8 +222,10 @@ int main()
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
         processInput(window);
+        animateCasters(currentFrame);
 
-        lightPos.z = sin(glfwGetTime() * 0.5) * 3.0;
+        if (moveLight)
+            lightPos.z = sin(glfwGetTime() * 0.5) * 3.0;
 
         glClearColor(0.f, 0.f, 0.f, 0.f);
         // 设置清空屏幕所用的颜色
@@ -104,25 +234,18 @@ int main()
         float near_plane = 1.0f;
         float far_plane = 25.0f;
 
-        glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), (float)SHADOW_WIDTH / (float)SHADOW_HEIGHT, near_plane, far_plane);
-        std::vector<glm::mat4> shadowTransforms;
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthmapfbo);
-        glClear(GL_DEPTH_BUFFER_BIT);
-        depthshader.use();
-        for (unsigned int i = 0; i < 6; ++i)
-            depthshader.setMat4("shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
-        depthshader.setFloat("far_plane", far_plane);
-        depthshader.setVec3("lightPos", lightPos);
-        renderScene(depthshader);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (benchmark)
+        {
+            benchmarkShadowPaths(cubemap, cubeShadowTransforms(lightPos, near_plane, far_plane), lightPos, near_plane, far_plane);
+            benchmarkShadowCache(cubemap, staticCache, lightPos, near_plane, far_plane, currentFrame);
+            benchmark = false;
+        }
+
+        depthTimer.Begin();
+        unsigned int drawnFaces = 0;
+        bool cacheRebuilt = false;
+        unsigned int shadowTexture = renderShadows(cubemap, staticCache, cacheShadows, lightPos, near_plane, far_plane, drawnFaces, cacheRebuilt);
+        depthTimer.End();
 
         glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -139,60 +262,346 @@ int main()
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, woodTexture);
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, depthmap);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, shadowTexture);
         renderScene(shader);
+
+        // show the path, the depth pass time and how many caster faces it drew in the title bar once per second
+        if (currentFrame - lastStatsTime > 1.0f)
+        {
+            std::string title = "LearnOpenGL | depth cubemap: " + std::string(shadowPathNames[shadowPath]) + ", " + std::to_string(depthTimer.GetMilliseconds()) + " ms, " +
+                                std::to_string(drawnFaces) + " of " + std::to_string(casters.size() * 6) + " caster faces" +
+                                (cacheShadows ? (cacheRebuilt ? " | static cache: redrawn" : " | static cache: reused") : " | static cache: off");
+            glfwSetWindowTitle(window, title.c_str());
+            lastStatsTime = currentFrame;
+        }
         // 绘制三角形
         glfwSwapBuffers(window);
         glfwPollEvents();
         // 检查有没有触发什么事件(键盘输入、鼠标移动等),更新窗口状态,并调用对应的回调函数(可以通过回调方法手动设置)
     }
 
+    delete depthshaderlayered;
     glfwTerminate();
     return 0;
 }
 
+bool hasExtension(const char *name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+        if (std::strcmp(reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i)), name) == 0)
+            return true;
+    return false;
+}
+
+// the depth cubemap texture with a layered framebuffer and one framebuffer per face
+DepthCubemap createDepthCubemap(Shader *geometryShader, Shader *faceShader, Shader *layeredShader)
+{
+    DepthCubemap cubemap = {0, 0, {0, 0, 0, 0, 0, 0}, geometryShader, faceShader, layeredShader};
+    glGenTextures(1, &cubemap.Texture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap.Texture);
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+    glGenFramebuffers(1, &cubemap.FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, cubemap.FBO);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cubemap.Texture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    // one framebuffer per face rather than one whose attachment changes six times a frame
+    glGenFramebuffers(6, cubemap.FaceFBOs);
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, cubemap.FaceFBOs[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, cubemap.Texture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: depth cubemap face framebuffer is not complete!" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return cubemap;
+}
+
+void addCaster(glm::mat4 model, bool inside, bool dynamic)
+{
+    Caster caster;
+    caster.Inside = inside;
+    caster.Dynamic = dynamic;
+    setCasterModel(caster, model);
+    casters.push_back(caster);
+}
+
+void setCasterModel(Caster &caster, const glm::mat4 &model)
+{
+    // the unit cube's corners are sqrt(3) from its center; take the longest axis so rotations and uneven scales are covered
+    float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    caster.Model = model;
+    caster.Center = glm::vec3(model[3]);
+    caster.Radius = scale * std::sqrt(3.0f);
+}
+
+// the dynamic caster circles the room just above the floor blocks
+void animateCasters(float time)
+{
+    for (unsigned int i = 0; i < casters.size(); i++)
+    {
+        if (!casters[i].Dynamic)
+            continue;
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(std::cos(time * 0.7f) * 3.0f, -3.0f, std::sin(time * 0.7f) * 3.0f));
+        model = glm::rotate(model, time, glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)));
+        model = glm::scale(model, glm::vec3(0.4f));
+        setCasterModel(casters[i], model);
+    }
+}
+
+bool inCasterSet(const Caster &caster, CasterSet casterSet)
+{
+    return casterSet == ALL_CASTERS || caster.Dynamic == (casterSet == DYNAMIC_CASTERS);
+}
+
+// bit i is set when the caster's bounding sphere reaches cube face i (+x, -x, +y, -y, +z, -z, the layer order)
+unsigned int faceMask(const Caster &caster, const glm::vec3 &lightPos, float nearPlane, float farPlane)
+{
+    glm::vec3 p = caster.Center - lightPos;
+    // the side planes of a face frustum are at 45 degrees, so the distance to them is the difference over sqrt(2)
+    float slack = caster.Radius * std::sqrt(2.0f);
+    unsigned int mask = 0;
+    for (unsigned int face = 0; face < 6; face++)
+    {
+        unsigned int axis = face / 2;
+        float along = face % 2 == 0 ? p[axis] : -p[axis];
+        float u = std::abs(p[(axis + 1) % 3]), v = std::abs(p[(axis + 2) % 3]);
+        if (along - u >= -slack && along - v >= -slack && along + caster.Radius >= nearPlane && along - caster.Radius <= farPlane)
+            mask |= 1u << face;
+    }
+    return mask;
+}
+
+// the faces any caster of the set reaches
+unsigned int reachedFaces(CasterSet casterSet, const glm::vec3 &lightPos, float nearPlane, float farPlane)
+{
+    unsigned int mask = 0;
+    for (unsigned int i = 0; i < casters.size(); i++)
+        if (inCasterSet(casters[i], casterSet))
+            mask |= faceMask(casters[i], lightPos, nearPlane, farPlane);
+    return mask;
+}
+
+// draws the casters of casterSet into the depth cubemap along path, on top of what's there unless clear; returns how
+// many caster faces were drawn
+unsigned int renderDepthCubemap(DepthCubemap &cubemap, ShadowPath path, const std::vector<glm::mat4> &shadowTransforms, const glm::vec3 &lightPos, float nearPlane, float farPlane,
+                                CasterSet casterSet, bool clear)
+{
+    if (path == LAYERED_INSTANCED && cubemap.LayeredShader == nullptr)
+        path = GEOMETRY_SHADER_CULLED;
+    unsigned int drawnFaces = 0;
+    glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+    if (path == SIX_PASSES)
+    {
+        Shader &faceShader = *cubemap.FaceShader;
+        faceShader.use();
+        faceShader.setFloat("far_plane", farPlane);
+        faceShader.setVec3("lightPos", lightPos);
+        std::vector<unsigned int> masks(casters.size());
+        for (unsigned int i = 0; i < casters.size(); i++)
+            masks[i] = inCasterSet(casters[i], casterSet) ? faceMask(casters[i], lightPos, nearPlane, farPlane) : 0;
+        for (unsigned int face = 0; face < 6; ++face)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, cubemap.FaceFBOs[face]);
+            if (clear)
+                glClear(GL_DEPTH_BUFFER_BIT);
+            faceShader.setMat4("shadowMatrix", shadowTransforms[face]);
+            for (unsigned int i = 0; i < casters.size(); i++)
+                if (masks[i] & (1u << face))
+                {
+                    renderCaster(faceShader, casters[i]);
+                    drawnFaces++;
+                }
+        }
+    }
+    else
+    {
+        // both draw every face in one pass; the geometry shader emits a triangle once per face in faceMask, the
+        // layered vertex shader runs once per face as an instance
+        Shader &layeredShader = path == LAYERED_INSTANCED ? *cubemap.LayeredShader : *cubemap.GeometryShader;
+        glBindFramebuffer(GL_FRAMEBUFFER, cubemap.FBO);
+        if (clear)
+            glClear(GL_DEPTH_BUFFER_BIT);
+        layeredShader.use();
+        for (unsigned int i = 0; i < 6; ++i)
+            layeredShader.setMat4("shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
+        layeredShader.setFloat("far_plane", farPlane);
+        layeredShader.setVec3("lightPos", lightPos);
+        for (unsigned int i = 0; i < casters.size(); i++)
+        {
+            if (!inCasterSet(casters[i], casterSet))
+                continue;
+            unsigned int mask = path == GEOMETRY_SHADER ? 0x3fu : faceMask(casters[i], lightPos, nearPlane, farPlane);
+            if (mask == 0)
+                continue;
+            unsigned int faces = static_cast<unsigned int>(std::bitset<6>(mask).count());
+            layeredShader.setInt("faceMask", mask);
+            renderCaster(layeredShader, casters[i], path == LAYERED_INSTANCED ? faces : 1);
+            drawnFaces += faces;
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return drawnFaces;
+}
+
+// copies all six faces; blits are the only depth copy a 3.3 context has, and they take one face at a time
+void copyDepthCubemap(const DepthCubemap &source, const DepthCubemap &destination)
+{
+    for (unsigned int face = 0; face < 6; ++face)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, source.FaceFBOs[face]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, destination.FaceFBOs[face]);
+        glBlitFramebuffer(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT, 0, 0, SHADOW_WIDTH, SHADOW_HEIGHT, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+std::vector<glm::mat4> cubeShadowTransforms(const glm::vec3 &lightPos, float nearPlane, float farPlane)
+{
+    glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), (float)SHADOW_WIDTH / (float)SHADOW_HEIGHT, nearPlane, farPlane);
+    std::vector<glm::mat4> shadowTransforms;
+    shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
+    shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
+    shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+    shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)));
+    shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
+    shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
+    return shadowTransforms;
+}
+
+// the frame's depth pass along shadowPath. With useCache the static casters come from the cache, which is only redrawn
+// when the light moved, and the dynamic casters are drawn on top of a copy of it. Returns the cubemap to sample, adds
+// the drawn caster faces to drawnFaces and sets cacheRebuilt when the cache was redrawn.
+unsigned int renderShadows(DepthCubemap &cubemap, ShadowCache &cache, bool useCache, const glm::vec3 &lightPos, float nearPlane, float farPlane,
+                           unsigned int &drawnFaces, bool &cacheRebuilt)
+{
+    std::vector<glm::mat4> shadowTransforms = cubeShadowTransforms(lightPos, nearPlane, farPlane);
+    if (!useCache)
+    {
+        drawnFaces += renderDepthCubemap(cubemap, shadowPath, shadowTransforms, lightPos, nearPlane, farPlane);
+        return cubemap.Texture;
+    }
+    if (!cache.Valid || cache.LightPos != lightPos)
+    {
+        drawnFaces += renderDepthCubemap(cache.Depth, shadowPath, shadowTransforms, lightPos, nearPlane, farPlane, STATIC_CASTERS);
+        cache.LightPos = lightPos;
+        cache.Valid = true;
+        cacheRebuilt = true;
+    }
+    // with no dynamic caster in reach the cache is the shadow map, and not even the copy is needed
+    if (reachedFaces(DYNAMIC_CASTERS, lightPos, nearPlane, farPlane) == 0)
+        return cache.Depth.Texture;
+    copyDepthCubemap(cache.Depth, cubemap);
+    drawnFaces += renderDepthCubemap(cubemap, shadowPath, shadowTransforms, lightPos, nearPlane, farPlane, DYNAMIC_CASTERS, false);
+    return cubemap.Texture;
+}
+
+// runs the depth pass of a number of frames with the dynamic caster moving, with the static cache and a still light,
+// with the cache and the light moving as L makes it, and without the cache; prints how often the cache was reused, the
+// caster faces drawn and the GPU time per frame. Leaves the casters where they are at time.
+void benchmarkShadowCache(DepthCubemap &cubemap, ShadowCache &cache, const glm::vec3 &lightPos, float nearPlane, float farPlane, float time)
+{
+    const unsigned int frames = 120;
+    const char *caseNames[] = {"static cache, still light", "static cache, moving light", "no cache"};
+    static unsigned int query = 0;
+    if (query == 0)
+        glGenQueries(1, &query);
+    for (unsigned int c = 0; c < 3; c++)
+    {
+        cache.Valid = false;
+        unsigned int drawnFaces = 0, rebuilt = 0;
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        for (unsigned int frame = 0; frame < frames; frame++)
+        {
+            // 60 frames a second
+            float frameTime = time + frame / 60.0f;
+            animateCasters(frameTime);
+            glm::vec3 framePos = lightPos;
+            if (c == 1)
+                framePos.z = sin(frameTime * 0.5) * 3.0;
+            bool cacheRebuilt = false;
+            renderShadows(cubemap, cache, c != 2, framePos, nearPlane, farPlane, drawnFaces, cacheRebuilt);
+            rebuilt += cacheRebuilt ? 1 : 0;
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+        // waits for the GPU; fine for a benchmark
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        std::cout << "depth cubemap over " << frames << " frames, " << caseNames[c] << ": ";
+        if (c != 2)
+            std::cout << frames - rebuilt << " of " << frames << " frames reused the cache, ";
+        std::cout << static_cast<float>(drawnFaces) / frames << " caster faces and " << static_cast<float>(nanoseconds) / 1000000.0f / frames
+                  << " ms per frame" << std::endl;
+    }
+    cache.Valid = false;
+    animateCasters(time);
+}
+
+// times every available path; prints to stdout
+void benchmarkShadowPaths(DepthCubemap &cubemap, const std::vector<glm::mat4> &shadowTransforms, const glm::vec3 &lightPos, float nearPlane, float farPlane)
+{
+    const unsigned int runs = 20;
+    static unsigned int query = 0;
+    if (query == 0)
+        glGenQueries(1, &query);
+    for (unsigned int path = 0; path < SHADOW_PATH_COUNT; path++)
+    {
+        if (path == LAYERED_INSTANCED && cubemap.LayeredShader == nullptr)
+        {
+            std::cout << "depth cubemap, " << shadowPathNames[path] << ": unsupported" << std::endl;
+            continue;
+        }
+        unsigned int drawnFaces = 0;
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        for (unsigned int run = 0; run < runs; run++)
+            drawnFaces = renderDepthCubemap(cubemap, static_cast<ShadowPath>(path), shadowTransforms, lightPos, nearPlane, farPlane);
+        glEndQuery(GL_TIME_ELAPSED);
+        // waits for the GPU; fine for a benchmark
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        std::cout << "depth cubemap, " << shadowPathNames[path] << ": " << static_cast<float>(nanoseconds) / 1000000.0f / runs << " ms, "
+                  << drawnFaces << " of " << casters.size() * 6 << " caster faces" << std::endl;
+    }
+}
+
+void renderCaster(const Shader &shader, const Caster &caster, unsigned int instances)
+{
+    shader.setMat4("model", caster.Model);
+    if (caster.Inside)
+    {
+        glDisable(GL_CULL_FACE);             // note that we disable culling here since we render 'inside' the cube instead of the usual 'outside' which throws off the normal culling methods.
+        shader.setInt("reverse_normals", 1); // A small little hack to invert normals when drawing cube from the inside so lighting still works.
+    }
+    renderCube(instances);
+    if (caster.Inside)
+    {
+        shader.setInt("reverse_normals", 0); // and of course disable it
+        glEnable(GL_CULL_FACE);
+    }
+}
+
 void renderScene(const Shader &shader)
 {
-    // room cube
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::scale(model, glm::vec3(5.0f));
-    shader.setMat4("model", model);
-    glDisable(GL_CULL_FACE);             // note that we disable culling here since we render 'inside' the cube instead of the usual 'outside' which throws off the normal culling methods.
-    shader.setInt("reverse_normals", 1); // A small little hack to invert normals when drawing cube from the inside so lighting still works.
-    renderCube();
-    shader.setInt("reverse_normals", 0); // and of course disable it
-    glEnable(GL_CULL_FACE);
-    // cubes
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(4.0f, -3.5f, 0.0));
-    model = glm::scale(model, glm::vec3(0.5f));
-    shader.setMat4("model", model);
-    renderCube();
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(2.0f, 3.0f, 1.0));
-    model = glm::scale(model, glm::vec3(0.75f));
-    shader.setMat4("model", model);
-    renderCube();
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(-3.0f, -1.0f, 0.0));
-    model = glm::scale(model, glm::vec3(0.5f));
-    shader.setMat4("model", model);
-    renderCube();
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(-1.5f, 1.0f, 1.5));
-    model = glm::scale(model, glm::vec3(0.5f));
-    shader.setMat4("model", model);
-    renderCube();
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(-1.5f, 2.0f, -3.0));
-    model = glm::rotate(model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
-    model = glm::scale(model, glm::vec3(0.75f));
-    shader.setMat4("model", model);
-    renderCube();
+    for (unsigned int i = 0; i < casters.size(); i++)
+        renderCaster(shader, casters[i]);
 }
 unsigned int cubeVAO = 0;
 unsigned int cubeVBO = 0;
-void renderCube()
+void renderCube(unsigned int instances)
 {
     // initialize (if necessary)
     if (cubeVAO == 0)
@@ -259,7 +668,7 @@ void renderCube()
     }
     // render Cube
     glBindVertexArray(cubeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 36, instances);
     glBindVertexArray(0);
 }
 
@@ -284,6 +693,44 @@ void processInput(GLFWwindow *window)
     {
         shadowsKeyPressed = false;
     }
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS && !shadowPathKeyPressed)
+    {
+        shadowPath = static_cast<ShadowPath>((shadowPath + 1) % SHADOW_PATH_COUNT);
+        if (shadowPath == LAYERED_INSTANCED && !layeredSupported)
+            shadowPath = GEOMETRY_SHADER;
+        shadowPathKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE)
+    {
+        shadowPathKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS && !benchmarkKeyPressed)
+    {
+        benchmark = true;
+        benchmarkKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_RELEASE)
+    {
+        benchmarkKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS && !moveLightKeyPressed)
+    {
+        moveLight = !moveLight;
+        moveLightKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_RELEASE)
+    {
+        moveLightKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS && !cacheShadowsKeyPressed)
+    {
+        cacheShadows = !cacheShadows;
+        cacheShadowsKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_K) == GLFW_RELEASE)
+    {
+        cacheShadowsKeyPressed = false;
+    }
 }
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
@@ -3,6 +3,7 @@ layout (triangles) in;
 layout (triangle_strip, max_vertices=18) out;
 
 uniform mat4 shadowMatrices[6];
+uniform int faceMask; // bit i set: the caster reaches face i; 63 draws every face
 
 out vec4 FragPos; // FragPos from GS (output per emitvertex)
 
@@ -10,6 +11,8 @@ void main()
 {
     for(int face = 0; face < 6; ++face)
     {
+        if((faceMask & (1 << face)) == 0)
+            continue;
         gl_Layer = face; // built-in variable that specifies to which face we render.
         for(int i = 0; i < 3; ++i) // for each triangle's vertices
         {
@@ -0,0 +1,13 @@
+#version 330 core
+layout(location=0)in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 shadowMatrix;
+
+out vec4 FragPos;
+
+void main()
+{
+    FragPos=model*vec4(aPos,1.);
+    gl_Position=shadowMatrix*FragPos;
+}
\ No newline at end of file
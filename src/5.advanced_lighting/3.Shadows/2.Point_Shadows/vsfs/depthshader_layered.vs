@@ -0,0 +1,30 @@
+#version 330 core
+// either one lets the vertex shader pick the layer, so no geometry shader is needed
+#extension GL_ARB_shader_viewport_layer_array:enable
+#extension GL_AMD_vertex_shader_layer:enable
+layout(location=0)in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 shadowMatrices[6];
+uniform int faceMask;// bit i set: the caster reaches face i; one instance is drawn per set bit
+
+out vec4 FragPos;
+
+void main()
+{
+    // the face of this instance is the gl_InstanceID-th set bit
+    int face=0;
+    int n=gl_InstanceID;
+    for(;face<5;++face)
+    {
+        if((faceMask&(1<<face))!=0)
+        {
+            if(n==0)
+            break;
+            n--;
+        }
+    }
+    gl_Layer=face;
+    FragPos=model*vec4(aPos,1.);
+    gl_Position=shadowMatrices[face]*FragPos;
+}
\ No newline at end of file
@@ -0,0 +1,569 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include "shader.h"
+#include "camera.h"
+#include "gpu_timer.h"
+#include "light_buffer.h"
+#include "shadow_atlas.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+void framebuffer_size_callback(GLFWwindow *window, int width, int height);
+void processInput(GLFWwindow *window);
+void mouse_callback(GLFWwindow *window, double xpos, double ypos);
+void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
+unsigned int loadTexture(char const *path);
+void renderScene(const Shader &shader);
+void renderCube();
+void renderQuad();
+
+// shadow casting cubes: model matrix and world space bounds
+struct Caster
+{
+    glm::mat4 Model;
+    glm::vec3 BoundsMin, BoundsMax;
+};
+std::vector<Caster> casters;
+void addCaster(const glm::mat4 &model);
+void renderCasters(const Shader &shader, const glm::vec3 &lightPos, float radius);
+
+// a shadowed spot or point light; spot lights have a direction
+struct ShadowedLight
+{
+    glm::vec3 BasePosition;
+    glm::vec3 Position;
+    glm::vec3 Direction;
+    float Radius;
+    // cosine of the outer cone angle; 0 for point lights
+    float CosOuter;
+    bool Spot;
+    // circles its base position
+    bool Moving;
+};
+glm::mat4 lightSpaceMatrix(const ShadowedLight &light, unsigned int face);
+float screenImportance(const ShadowedLight &light, const glm::mat4 &view, float fovy, float aspect);
+
+bool shadows = true;
+bool shadowsKeyPressed = false;
+// V shows the atlas, R / F raise and lower the tiles redrawn per frame
+bool showAtlas = false;
+bool showAtlasKeyPressed = false;
+unsigned int updateBudget = 16;
+bool budgetUpKeyPressed = false;
+bool budgetDownKeyPressed = false;
+const unsigned int SCR_WIDTH = 800;
+const unsigned int SCR_HEIGHT = 600;
+const unsigned int LIGHT_COUNT = 32;
+float lastX = 400, lastY = 300;
+float deltaTime = 0.0f; // 当前帧与上一帧的时间差
+float lastFrame = 0.0f; // 上一帧的时间
+bool firstMouse = true;
+Camera camera(glm::vec3(0.0f, 4.0f, 20.0f));
+unsigned int planeVAO;
+int main()
+{
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    // 指定使用的是OpenGL 3.3版本
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // 指定使用的是核心模式(Core-profile)
+    GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+    // 创建窗口对象
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    // 注册窗口大小改变的回调函数
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    // 初始化GLAD,传入的是GLAD用来加载系统相关的OpenGL函数指针地址的函数
+    Shader shader("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/3.Shadow_Atlas/vsfs/shader.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/3.Shadow_Atlas/vsfs/shader.fs");
+    Shader depthshader("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/3.Shadow_Atlas/vsfs/depthshader.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/3.Shadow_Atlas/vsfs/depthshader.fs");
+    Shader atlasshader("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/3.Shadow_Atlas/vsfs/atlas_view.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/3.Shadows/3.Shadow_Atlas/vsfs/atlas_view.fs");
+    float planeVertices[] = {
+        // positions            // normals         // texcoords
+        25.0f, -0.5f, 25.0f, 0.0f, 1.0f, 0.0f, 25.0f, 0.0f,
+        -25.0f, -0.5f, -25.0f, 0.0f, 1.0f, 0.0f, 0.0f, 25.0f,
+        -25.0f, -0.5f, 25.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
+
+        25.0f, -0.5f, 25.0f, 0.0f, 1.0f, 0.0f, 25.0f, 0.0f,
+        25.0f, -0.5f, -25.0f, 0.0f, 1.0f, 0.0f, 25.0f, 25.0f,
+        -25.0f, -0.5f, -25.0f, 0.0f, 1.0f, 0.0f, 0.0f, 25.0f};
+
+    unsigned int planeVBO;
+    glGenVertexArrays(1, &planeVAO);
+    glGenBuffers(1, &planeVBO);
+    glBindVertexArray(planeVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), planeVertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(3 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float)));
+    glBindVertexArray(0);
+
+    unsigned int woodTexture = loadTexture("C:/Users/22175/Desktop/LearnOpenGL/assets/textures/wood.png");
+    // one 4096x4096 depth texture and one framebuffer for every light's shadow
+    ShadowAtlas atlas(4096, 64, 1024);
+
+    // pillars on a grid; the lights sit in between them
+    for (int x = -20; x <= 20; x += 5)
+    {
+        for (int z = -10; z <= 10; z += 5)
+        {
+            float height = 1.0f + static_cast<float>((x * 7 + z * 13) & 3);
+            glm::mat4 model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(static_cast<float>(x), height - 0.5f, static_cast<float>(z)));
+            model = glm::scale(model, glm::vec3(0.4f, height, 0.4f));
+            addCaster(model);
+        }
+    }
+
+    // a checkerboard of spot lights looking down and point lights at head height, every fourth one moving
+    LightBuffer lightBuffer;
+    std::vector<ShadowedLight> lights;
+    for (unsigned int i = 0; i < LIGHT_COUNT; i++)
+    {
+        unsigned int gx = i % 8, gz = i / 8;
+        ShadowedLight light;
+        light.Spot = (gx + gz) % 2 == 0;
+        light.BasePosition = glm::vec3(-17.5f + 5.0f * gx, light.Spot ? 4.0f : 1.5f, -7.5f + 5.0f * gz);
+        light.Position = light.BasePosition;
+        light.Direction = glm::normalize(glm::vec3(gx % 3 == 0 ? 0.3f : -0.3f, -1.0f, gz % 2 == 0 ? 0.3f : -0.3f));
+        light.Radius = light.Spot ? 9.0f : 6.0f;
+        light.CosOuter = light.Spot ? std::cos(glm::radians(35.0f)) : 0.0f;
+        light.Moving = i % 4 == 1;
+        lights.push_back(light);
+        glm::vec3 color = glm::vec3(0.5f + 0.5f * std::sin(i * 1.7f), 0.5f + 0.5f * std::sin(i * 2.3f + 2.0f), 0.5f + 0.5f * std::sin(i * 2.9f + 4.0f));
+        lightBuffer.Add(light.Position, color * 8.0f, light.Radius);
+    }
+
+    shader.use();
+    shader.setInt("diffuseTexture", 0);
+    lightBuffer.Bind(shader);
+    for (unsigned int i = 0; i < LIGHT_COUNT; i++)
+        shader.setVec4("spotCones[" + std::to_string(i) + "]", lights[i].Spot ? glm::vec4(lights[i].Direction, lights[i].CosOuter) : glm::vec4(0.0f));
+    atlasshader.use();
+    atlasshader.setInt("shadowAtlas", 0);
+    GpuTimer shadowTimer;
+    float lastStatsTime = 0.0f;
+
+    while (!glfwWindowShouldClose(window))
+    {
+        float currentFrame = glfwGetTime();
+        deltaTime = currentFrame - lastFrame;
+        lastFrame = currentFrame;
+        processInput(window);
+
+        glClearColor(0.f, 0.f, 0.f, 0.f);
+        // 设置清空屏幕所用的颜色
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        glm::mat4 view = camera.GetViewMatrix();
+
+        // 1. ask the atlas for tiles sized by how much of the screen each light covers, then redraw the ones it picks
+        atlas.UpdateBudget = updateBudget;
+        atlas.BeginFrame();
+        unsigned int visible = 0, shadowed = 0;
+        for (unsigned int i = 0; i < LIGHT_COUNT; i++)
+        {
+            ShadowedLight &light = lights[i];
+            if (light.Moving)
+            {
+                float angle = currentFrame * 0.8f + i;
+                light.Position = light.BasePosition + glm::vec3(std::cos(angle), 0.0f, std::sin(angle)) * 1.5f;
+                lightBuffer.SetPosition(i, light.Position);
+                atlas.Invalidate(i);
+            }
+            float importance = screenImportance(light, view, glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT);
+            if (importance <= 0.0f)
+                continue;
+            atlas.Request(i, light.Spot ? 1 : 6, importance * atlas.MaxTileSize, importance);
+            visible++;
+        }
+        lightBuffer.Upload();
+        shadowTimer.Begin();
+        const std::vector<ShadowAtlas::TileUpdate> &updates = atlas.Update();
+        depthshader.use();
+        for (unsigned int u = 0; u < updates.size(); u++)
+        {
+            const ShadowedLight &light = lights[updates[u].Light];
+            glm::mat4 matrix = lightSpaceMatrix(light, updates[u].Face);
+            atlas.BeginTile(updates[u].Light, updates[u].Face, matrix);
+            depthshader.setMat4("lightSpaceMatrix", matrix);
+            depthshader.setVec3("lightPos", light.Position);
+            depthshader.setFloat("far_plane", light.Radius);
+            renderCasters(depthshader, light.Position, light.Radius);
+        }
+        atlas.End();
+        shadowTimer.End();
+        for (unsigned int i = 0; i < LIGHT_COUNT; i++)
+            if (atlas.GetTileSize(i) > 0)
+                shadowed++;
+
+        // 2. light the scene, every light reading its tiles through the tile buffer
+        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        shader.use();
+        shader.setMat4("projection", projection);
+        shader.setMat4("view", view);
+        shader.setVec3("viewPos", camera.Position);
+        shader.setInt("shadows", shadows); // enable/disable shadows by pressing 'SPACE'
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, woodTexture);
+        atlas.Bind(shader, 1, 2);
+        renderScene(shader);
+
+        if (showAtlas)
+        {
+            glDisable(GL_DEPTH_TEST);
+            glViewport(SCR_WIDTH - 256, SCR_HEIGHT - 256, 256, 256);
+            atlasshader.use();
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, atlas.DepthTexture);
+            renderQuad();
+            glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+            glEnable(GL_DEPTH_TEST);
+        }
+
+        // lights with tiles, tiles redrawn and atlas use, once per second
+        if (currentFrame - lastStatsTime > 1.0f)
+        {
+            std::string title = "LearnOpenGL | shadowed lights: " + std::to_string(shadowed) + " (" + std::to_string(visible) + " visible of " + std::to_string(LIGHT_COUNT) + ")" +
+                                " | tiles redrawn: " + std::to_string(updates.size()) + " of " + std::to_string(updateBudget) + ", " + std::to_string(shadowTimer.GetMilliseconds()) + " ms" +
+                                " | atlas used: " + std::to_string(static_cast<int>(atlas.GetUsedFraction() * 100.0f)) + "%";
+            glfwSetWindowTitle(window, title.c_str());
+            lastStatsTime = currentFrame;
+        }
+
+        // 绘制三角形
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+        // 检查有没有触发什么事件(键盘输入、鼠标移动等),更新窗口状态,并调用对应的回调函数(可以通过回调方法手动设置)
+    }
+    glDeleteVertexArrays(1, &planeVAO);
+    glDeleteBuffers(1, &planeVBO);
+    glfwTerminate();
+    return 0;
+}
+
+// the matrix a light's tile for face is drawn with: the spot cone, or the cube face in cube map order
+glm::mat4 lightSpaceMatrix(const ShadowedLight &light, unsigned int face)
+{
+    if (light.Spot)
+    {
+        // a little wider than the cone so the PCF kernel at its edge stays inside the tile
+        float fovy = 2.0f * std::acos(light.CosOuter) + glm::radians(4.0f);
+        glm::vec3 up = std::abs(light.Direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        return glm::perspective(fovy, 1.0f, 0.05f, light.Radius) * glm::lookAt(light.Position, light.Position + light.Direction, up);
+    }
+    const glm::vec3 directions[6] = {glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+                                     glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)};
+    const glm::vec3 ups[6] = {glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+                              glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)};
+    return glm::perspective(glm::radians(90.0f), 1.0f, 0.05f, light.Radius) * glm::lookAt(light.Position, light.Position + directions[face], ups[face]);
+}
+
+// roughly the share of the screen height the light's sphere covers, 1 when the camera is inside it and 0 when it's
+// outside the view frustum
+float screenImportance(const ShadowedLight &light, const glm::mat4 &view, float fovy, float aspect)
+{
+    glm::vec3 center = glm::vec3(view * glm::vec4(light.Position, 1.0f));
+    float distance = glm::length(center);
+    if (distance <= light.Radius)
+        return 1.0f;
+    // sphere against the four side planes and the near plane; the planes go through the eye, so the test is the
+    // signed distance of the center along each plane normal
+    float tanY = std::tan(fovy * 0.5f), tanX = tanY * aspect;
+    glm::vec3 normals[4] = {glm::normalize(glm::vec3(1.0f, 0.0f, tanX)), glm::normalize(glm::vec3(-1.0f, 0.0f, tanX)),
+                            glm::normalize(glm::vec3(0.0f, 1.0f, tanY)), glm::normalize(glm::vec3(0.0f, -1.0f, tanY))};
+    for (unsigned int i = 0; i < 4; i++)
+        if (glm::dot(normals[i], center) < -light.Radius)
+            return 0.0f;
+    if (center.z > light.Radius)
+        return 0.0f;
+    return std::min(1.0f, light.Radius / (distance * tanY));
+}
+
+void renderScene(const Shader &shader)
+{
+    // floor
+    glm::mat4 model = glm::mat4(1.0f);
+    shader.setMat4("model", model);
+    glBindVertexArray(planeVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    // cubes
+    for (unsigned int i = 0; i < casters.size(); i++)
+    {
+        shader.setMat4("model", casters[i].Model);
+        renderCube();
+    }
+}
+
+// the casters whose box is within the light's radius; the floor only receives
+void renderCasters(const Shader &shader, const glm::vec3 &lightPos, float radius)
+{
+    for (unsigned int i = 0; i < casters.size(); i++)
+    {
+        glm::vec3 closest = glm::clamp(lightPos, casters[i].BoundsMin, casters[i].BoundsMax);
+        if (glm::length(closest - lightPos) > radius)
+            continue;
+        shader.setMat4("model", casters[i].Model);
+        renderCube();
+    }
+}
+
+// adds a unit cube with this model matrix to the casters, with the world space box around its corners
+void addCaster(const glm::mat4 &model)
+{
+    Caster caster = {model, glm::vec3(1e30f), glm::vec3(-1e30f)};
+    for (unsigned int c = 0; c < 8; c++)
+    {
+        glm::vec3 corner = glm::vec3(model * glm::vec4(c & 1 ? 1.0f : -1.0f, c & 2 ? 1.0f : -1.0f, c & 4 ? 1.0f : -1.0f, 1.0f));
+        caster.BoundsMin = glm::vec3(std::min(caster.BoundsMin.x, corner.x), std::min(caster.BoundsMin.y, corner.y), std::min(caster.BoundsMin.z, corner.z));
+        caster.BoundsMax = glm::vec3(std::max(caster.BoundsMax.x, corner.x), std::max(caster.BoundsMax.y, corner.y), std::max(caster.BoundsMax.z, corner.z));
+    }
+    casters.push_back(caster);
+}
+unsigned int cubeVAO = 0;
+unsigned int cubeVBO = 0;
+void renderCube()
+{
+    // initialize (if necessary)
+    if (cubeVAO == 0)
+    {
+        float vertices[] = {
+            // back face
+            -1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
+            1.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f,   // top-right
+            1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f,  // bottom-right
+            1.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f,   // top-right
+            -1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
+            -1.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f,  // top-left
+            // front face
+            -1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, // bottom-left
+            1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f,  // bottom-right
+            1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,   // top-right
+            1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,   // top-right
+            -1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,  // top-left
+            -1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, // bottom-left
+            // left face
+            -1.0f, 1.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f,   // top-right
+            -1.0f, 1.0f, -1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f,  // top-left
+            -1.0f, -1.0f, -1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, // bottom-left
+            -1.0f, -1.0f, -1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, // bottom-left
+            -1.0f, -1.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f,  // bottom-right
+            -1.0f, 1.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f,   // top-right
+                                                                // right face
+            1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,     // top-left
+            1.0f, -1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,   // bottom-right
+            1.0f, 1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f,    // top-right
+            1.0f, -1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,   // bottom-right
+            1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,     // top-left
+            1.0f, -1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f,    // bottom-left
+            // bottom face
+            -1.0f, -1.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, // top-right
+            1.0f, -1.0f, -1.0f, 0.0f, -1.0f, 0.0f, 1.0f, 1.0f,  // top-left
+            1.0f, -1.0f, 1.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f,   // bottom-left
+            1.0f, -1.0f, 1.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f,   // bottom-left
+            -1.0f, -1.0f, 1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f,  // bottom-right
+            -1.0f, -1.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, // top-right
+            // top face
+            -1.0f, 1.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, // top-left
+            1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,   // bottom-right
+            1.0f, 1.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f,  // top-right
+            1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,   // bottom-right
+            -1.0f, 1.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, // top-left
+            -1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f   // bottom-left
+        };
+        glGenVertexArrays(1, &cubeVAO);
+        glGenBuffers(1, &cubeVBO);
+        // fill buffer
+        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+        // link vertex attributes
+        glBindVertexArray(cubeVAO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(3 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float)));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+    // render Cube
+    glBindVertexArray(cubeVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glBindVertexArray(0);
+}
+
+unsigned int quadVAO = 0;
+unsigned int quadVBO;
+void renderQuad()
+{
+    if (quadVAO == 0)
+    {
+        float quadVertices[] = {
+            // positions   // texCoords
+            -1.0f, 1.0f, 0.0f, 1.0f,
+            -1.0f, -1.0f, 0.0f, 0.0f,
+            1.0f, 1.0f, 1.0f, 1.0f,
+            1.0f, -1.0f, 1.0f, 0.0f};
+        glGenVertexArrays(1, &quadVAO);
+        glGenBuffers(1, &quadVBO);
+        glBindVertexArray(quadVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)(2 * sizeof(float)));
+    }
+    glBindVertexArray(quadVAO);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+}
+
+void processInput(GLFWwindow *window)
+{
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+        camera.ProcessKeyboard(FORWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+        camera.ProcessKeyboard(BACKWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+        camera.ProcessKeyboard(LEFT, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        camera.ProcessKeyboard(RIGHT, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS && !shadowsKeyPressed)
+    {
+        shadows = !shadows;
+        shadowsKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_RELEASE)
+    {
+        shadowsKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS && !showAtlasKeyPressed)
+    {
+        showAtlas = !showAtlas;
+        showAtlasKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_V) == GLFW_RELEASE)
+    {
+        showAtlasKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS && !budgetUpKeyPressed)
+    {
+        updateBudget = std::min(updateBudget * 2, 128u);
+        budgetUpKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_RELEASE)
+    {
+        budgetUpKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS && !budgetDownKeyPressed)
+    {
+        updateBudget = std::max(updateBudget / 2, 1u);
+        budgetDownKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_RELEASE)
+    {
+        budgetDownKeyPressed = false;
+    }
+}
+
+void framebuffer_size_callback(GLFWwindow *window, int width, int height)
+{
+    glViewport(0, 0, width, height);
+}
+
+void mouse_callback(GLFWwindow *window, double xposIn, double yposIn)
+{
+    float xpos = static_cast<float>(xposIn);
+    float ypos = static_cast<float>(yposIn);
+
+    if (firstMouse)
+    {
+        lastX = xpos;
+        lastY = ypos;
+        firstMouse = false;
+    }
+
+    float xoffset = xpos - lastX;
+    float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
+
+    lastX = xpos;
+    lastY = ypos;
+
+    camera.ProcessMouseMovement(xoffset, yoffset);
+}
+
+void scroll_callback(GLFWwindow *window, double xoffset, double yoffset)
+{
+    camera.ProcessMouseScroll(static_cast<float>(yoffset));
+}
+
+unsigned int loadTexture(char const *path)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    int width, height, nrComponents;
+    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
+    if (data)
+    {
+        GLenum format;
+        if (nrComponents == 1)
+            format = GL_RED;
+        else if (nrComponents == 3)
+            format = GL_RGB;
+        else if (nrComponents == 4)
+            format = GL_RGBA;
+
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        stbi_image_free(data);
+    }
+    else
+    {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+        stbi_image_free(data);
+    }
+
+    return textureID;
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D shadowAtlas;
+
+void main()
+{
+    float depth=texture(shadowAtlas,TexCoords).r;
+    FragColor=vec4(vec3(depth),1.);
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+#version 330 core
+in vec4 FragPos;
+
+uniform vec3 lightPos;
+uniform float far_plane;
+
+void main()
+{
+    // distance to the light over its radius, the same for spot and point lights
+    gl_FragDepth=length(FragPos.xyz-lightPos)/far_plane;
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+#version 330 core
+out vec4 FragColor;
+
+in VS_OUT{
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+}fs_in;
+
+struct Light{
+    vec4 PositionRadius;
+    vec4 Color;
+};
+layout(std140)uniform Lights{
+    int lightCount;
+    Light lights[256];
+};
+// xyz the spot direction, w the cosine of the outer cone angle; all zero for a point light
+uniform vec4 spotCones[64];
+
+uniform sampler2D diffuseTexture;
+uniform sampler2D shadowAtlas;
+// 5 texels per tile, tile light*6+face: the light space matrix columns, then the tile rect (x,y,size,valid) in atlas uv
+uniform samplerBuffer shadowTiles;
+
+uniform vec3 viewPos;
+uniform bool shadows;
+
+float ShadowCalculation(int light,vec3 lightPos,float radius,bool spot,vec3 normal)
+{
+    vec3 fragToLight=fs_in.FragPos-lightPos;
+    // a point light's face is the major axis of the direction, in cube map order
+    int face=0;
+    if(!spot)
+    {
+        vec3 a=abs(fragToLight);
+        if(a.x>=a.y&&a.x>=a.z)
+        face=fragToLight.x>0.?0:1;
+        else if(a.y>=a.z)
+        face=fragToLight.y>0.?2:3;
+        else
+        face=fragToLight.z>0.?4:5;
+    }
+    int base=(light*6+face)*5;
+    vec4 rect=texelFetch(shadowTiles,base+4);
+    if(rect.w==0.)
+    return 0.;
+    mat4 lightSpaceMatrix=mat4(texelFetch(shadowTiles,base),texelFetch(shadowTiles,base+1),texelFetch(shadowTiles,base+2),texelFetch(shadowTiles,base+3));
+    float atlasSize=float(textureSize(shadowAtlas,0).x);
+    // world size of a tile texel at this distance for a 90 degree frustum; narrower spot cones get a bit more
+    // offset than they need
+    float texelWorld=2.*length(fragToLight)/(rect.z*atlasSize);
+    vec3 offsetPos=fs_in.FragPos+normal*texelWorld*1.5;
+    vec4 projected=lightSpaceMatrix*vec4(offsetPos,1.);
+    if(projected.w<=0.)
+    return 0.;
+    vec2 uv=projected.xy/projected.w*.5+.5;
+    if(any(lessThan(uv,vec2(0.)))||any(greaterThan(uv,vec2(1.))))
+    return 0.;
+    float currentDepth=(length(offsetPos-lightPos)-texelWorld)/radius;
+    // 3x3 PCF that stays inside the tile, the neighbours belong to other lights
+    float texelSize=1./atlasSize;
+    vec2 lo=rect.xy+.5*texelSize;
+    vec2 hi=rect.xy+rect.z-.5*texelSize;
+    vec2 center=rect.xy+uv*rect.z;
+    float shadow=0.;
+    for(int x=-1;x<=1;++x)
+    {
+        for(int y=-1;y<=1;++y)
+        {
+            float closestDepth=texture(shadowAtlas,clamp(center+vec2(x,y)*texelSize,lo,hi)).r;
+            shadow+=currentDepth>closestDepth?1.:0.;
+        }
+    }
+    return shadow/9.;
+}
+
+void main()
+{
+    vec3 color=texture(diffuseTexture,fs_in.TexCoords).rgb;
+    vec3 normal=normalize(fs_in.Normal);
+    vec3 viewDir=normalize(viewPos-fs_in.FragPos);
+    vec3 lighting=.05*color;
+    for(int i=0;i<lightCount;++i)
+    {
+        vec3 lightPos=lights[i].PositionRadius.xyz;
+        float radius=lights[i].PositionRadius.w;
+        vec3 toLight=lightPos-fs_in.FragPos;
+        float dist=length(toLight);
+        if(dist>radius)
+        continue;
+        vec3 lightDir=toLight/dist;
+        // windowed inverse square falloff, zero at the radius
+        float window=clamp(1.-pow(dist/radius,4.),0.,1.);
+        float attenuation=window*window/(dist*dist+1.);
+        bool spot=dot(spotCones[i].xyz,spotCones[i].xyz)>0.;
+        if(spot)
+        attenuation*=smoothstep(spotCones[i].w,spotCones[i].w+.1,dot(-lightDir,spotCones[i].xyz));
+        if(attenuation<=0.)
+        continue;
+        float diff=max(dot(lightDir,normal),0.);
+        vec3 halfwayDir=normalize(lightDir+viewDir);
+        float spec=pow(max(dot(normal,halfwayDir),0.),64.);
+        float shadow=shadows?ShadowCalculation(i,lightPos,radius,spot,normal):0.;
+        lighting+=(1.-shadow)*(diff*color+.3*spec)*lights[i].Color.rgb*attenuation;
+    }
+    FragColor=vec4(lighting,1.);
+}
\ No newline at end of file
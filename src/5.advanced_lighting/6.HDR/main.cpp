@@ -2,6 +2,7 @@
 #include <GLFW/glfw3.h>
 #include "shader.h"
 #include "camera.h"
+#include "auto_exposure.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -20,6 +21,10 @@ void renderCube();
 
 bool hdr = true;
 bool hdrKeyPressed = false;
+// T switches between the histogram auto exposure and the manual one; Q / E change the manual exposure, or with auto
+// exposure the compensation on top of it
+bool autoExposure = true;
+bool autoExposureKeyPressed = false;
 float exposure = 1.0f;
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
@@ -60,6 +65,8 @@ int main()
     // 初始化GLAD,传入的是GLAD用来加载系统相关的OpenGL函数指针地址的函数
     Shader shader("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/6.HDR/vsfs/shader.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/6.HDR/vsfs/shader.fs");
     Shader hdrshader("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/6.HDR/vsfs/hdr.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/6.HDR/vsfs/hdr.fs");
+    Shader histogramShader("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/6.HDR/vsfs/histogram.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/6.HDR/vsfs/histogram.fs");
+    Shader exposureShader("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/6.HDR/vsfs/hdr.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/6.HDR/vsfs/exposure.fs");
 
     unsigned int woodTexture = loadTexture("C:/Users/22175/Desktop/LearnOpenGL/assets/textures/wood.png");
 
@@ -83,6 +90,7 @@ int main()
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "Framebuffer not complete!" << std::endl;
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    AutoExposure autoExposurePass(SCR_WIDTH, SCR_HEIGHT);
     // positions
     std::vector<glm::vec3> lightPositions;
     lightPositions.push_back(glm::vec3(0.0f, 0.0f, 49.5f)); // back light
@@ -100,6 +108,8 @@ int main()
     shader.setInt("diffuseTexture", 0);
     hdrshader.use();
     hdrshader.setInt("hdrBuffer", 0);
+    hdrshader.setInt("adaptedLuminance", 1);
+    float lastStatsTime = 0.0f;
 
     while (!glfwWindowShouldClose(window))
     {
@@ -133,16 +143,28 @@ int main()
         shader.setInt("inverse_normals", true);
         renderCube();
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (hdr && autoExposure)
+            autoExposurePass.Update(histogramShader, exposureShader, colorBuffer, deltaTime);
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         hdrshader.use();
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, colorBuffer);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, autoExposurePass.GetLuminanceTexture());
+        glActiveTexture(GL_TEXTURE0);
         hdrshader.setBool("hdr", hdr);
+        hdrshader.setBool("autoExposure", autoExposure);
         hdrshader.setFloat("exposure", exposure);
         renderQuad();
 
-        std::cout << "hdr: " << (hdr ? "on" : "off") << "| exposure: " << exposure << std::endl;
+        // the settings go to the title bar once per second; printing them every frame stalled on the terminal
+        if (currentFrame - lastStatsTime > 1.0f)
+        {
+            std::string title = "LearnOpenGL | hdr: " + std::string(hdr ? "on" : "off") + " | " + (autoExposure ? "auto exposure, compensation: " : "exposure: ") + std::to_string(exposure);
+            glfwSetWindowTitle(window, title.c_str());
+            lastStatsTime = currentFrame;
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -292,6 +314,15 @@ void processInput(GLFWwindow *window)
     {
         hdrKeyPressed = false;
     }
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS && !autoExposureKeyPressed)
+    {
+        autoExposure = !autoExposure;
+        autoExposureKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_RELEASE)
+    {
+        autoExposureKeyPressed = false;
+    }
 
     if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
     {
@@ -0,0 +1,49 @@
+#version 330 core
+// averages the log luminance histogram between two percentiles and moves last frame's adapted luminance towards it;
+// drawn into a 1x1 target
+out float FragColor;
+
+uniform sampler2D histogram;
+uniform sampler2D previousLuminance;
+uniform float minLogLuminance;
+uniform float logLuminanceRange;
+// the darkest lowPercent and the brightest 1 - highPercent of the pixels are left out
+uniform float lowPercent;
+uniform float highPercent;
+uniform float speedUp;
+uniform float speedDown;
+uniform float deltaTime;
+
+void main()
+{
+    int bins=textureSize(histogram,0).x;
+    float total=0.;
+    for(int i=1;i<bins;++i)
+    total+=texelFetch(histogram,ivec2(i,0),0).r;
+    float low=total*lowPercent;
+    float high=total*highPercent;
+    float seen=0.;
+    float sum=0.;
+    float weight=0.;
+    for(int i=1;i<bins;++i)
+    {
+        float count=texelFetch(histogram,ivec2(i,0),0).r;
+        // the part of this bin's pixels that falls inside the percentile window
+        float inside=clamp(min(seen+count,high)-max(seen,low),0.,count);
+        seen+=count;
+        float logLuminance=minLogLuminance+(float(i)-.5)/float(bins-1)*logLuminanceRange;
+        sum+=logLuminance*inside;
+        weight+=inside;
+    }
+    float previous=texelFetch(previousLuminance,ivec2(0),0).r;
+    // an all black frame keeps the current adaptation
+    float target=weight>0.?exp2(sum/weight):previous;
+    if(previous<=0.)
+    {
+        // no history yet: start adapted
+        FragColor=target;
+        return;
+    }
+    float speed=target>previous?speedUp:speedDown;
+    FragColor=previous+(target-previous)*(1.-exp(-deltaTime*speed));
+}
\ No newline at end of file
@@ -4,19 +4,29 @@ out vec4 FragColor;
 in vec2 TexCoords;
 
 uniform sampler2D hdrBuffer;
+// adapted average luminance (1x1), written by exposure.fs
+uniform sampler2D adaptedLuminance;
 uniform bool hdr;
+uniform bool autoExposure;
+// the manual exposure, or with auto exposure a compensation factor on top of it
 uniform float exposure;
 
+// the adapted average luminance is mapped to middle grey
+const float key=.18;
+
 void main()
 {
     const float gamma=2.2;
     vec3 hdrColor=texture(hdrBuffer,TexCoords).rgb;
     if(hdr)
     {
+        float e=exposure;
+        if(autoExposure)
+        e*=key/max(texelFetch(adaptedLuminance,ivec2(0),0).r,.0001);
         // reinhard
         // vec3 result = hdrColor / (hdrColor + vec3(1.0));
         // exposure
-        vec3 result=vec3(1.)-exp(-hdrColor*exposure);
+        vec3 result=vec3(1.)-exp(-hdrColor*e);
         // also gamma correct while we're at it
         
         result=pow(result,vec3(1./gamma));
@@ -0,0 +1,25 @@
+#version 330 core
+// one point per sampled pixel, placed on the histogram bin of the pixel's log2 luminance; the target is one pixel high
+// and one pixel per bin wide, and additive blending counts the points per bin
+uniform sampler2D hdrBuffer;
+uniform int sampleStride;
+// sampled pixels per row
+uniform int columns;
+uniform int bins;
+uniform float minLogLuminance;
+uniform float inverseLogLuminanceRange;
+
+void main()
+{
+    ivec2 size=textureSize(hdrBuffer,0);
+    ivec2 texel=min(ivec2(gl_VertexID%columns,gl_VertexID/columns)*sampleStride,size-1);
+    float luminance=dot(texelFetch(hdrBuffer,texel,0).rgb,vec3(.2126,.7152,.0722));
+    // bin 0 holds the black pixels, which are left out of the average; the rest spread over bins 1 .. bins - 1
+    float bin=0.;
+    if(luminance>.0001)
+    {
+        float t=clamp((log2(luminance)-minLogLuminance)*inverseLogLuminanceRange,0.,1.);
+        bin=1.+min(floor(t*float(bins-1)),float(bins-2));
+    }
+    gl_Position=vec4((bin+.5)/float(bins)*2.-1.,0.,0.,1.);
+}
\ No newline at end of file
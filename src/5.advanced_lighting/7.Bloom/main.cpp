@@ -2,6 +2,8 @@
 #include <GLFW/glfw3.h>
 #include "shader.h"
 #include "camera.h"
+#include "bloom.h"
+#include "gpu_timer.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -17,9 +19,19 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 unsigned int loadTexture(const char *path, bool gammaCorrection);
 void renderQuad();
 void renderCube();
+void createPingpong(unsigned int width, unsigned int height, unsigned int fbos[2], unsigned int textures[2]);
+unsigned int gaussianBloom(Shader &shaderBlur, unsigned int fbos[2], unsigned int textures[2], unsigned int source, unsigned int width, unsigned int height);
+void benchmarkBloom(Shader &shaderBlur, Shader &shaderDownsample, Shader &shaderUpsample, unsigned int hdrFBO, float scatter);
 
 bool bloom = true;
 bool bloomKeyPressed = false;
+// M switches between the mip chain bloom and the original full resolution gaussian; R / F widen and narrow the mip
+// chain bloom, B times both paths at 1080p and 4K
+bool mipBloom = true;
+bool mipBloomKeyPressed = false;
+float bloomScatter = 0.7f;
+bool benchmark = false;
+bool benchmarkKeyPressed = false;
 float exposure = 1.0f;
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
@@ -61,6 +73,8 @@ int main()
     Shader shader("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/7.Bloom/vsfs/shader.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/7.Bloom/vsfs/shader.fs");
     Shader shaderLight("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/7.Bloom/vsfs/shader.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/7.Bloom/vsfs/light_box.fs");
     Shader shaderBlur("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/7.Bloom/vsfs/blur.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/7.Bloom/vsfs/blur.fs");
+    Shader shaderBloomDownsample("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/7.Bloom/vsfs/blur.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/7.Bloom/vsfs/bloom_downsample.fs");
+    Shader shaderBloomUpsample("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/7.Bloom/vsfs/blur.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/7.Bloom/vsfs/bloom_upsample.fs");
     Shader shaderBloomFinal("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/7.Bloom/vsfs/bloom_final.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/7.Bloom/vsfs/bloom_final.fs");
 
     unsigned int woodTexture = loadTexture("C:/Users/22175/Desktop/LearnOpenGL/assets/textures/wood.png", true);
@@ -94,22 +108,8 @@ int main()
 
     unsigned int pingpongFBO[2];
     unsigned int pingpongColorbuffers[2];
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorbuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
-        // also check if framebuffers are complete (no need for depth buffer)
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "Framebuffer not complete!" << std::endl;
-    }
+    createPingpong(SCR_WIDTH, SCR_HEIGHT, pingpongFBO, pingpongColorbuffers);
+    Bloom mipChain(SCR_WIDTH, SCR_HEIGHT);
 
     // positions
     std::vector<glm::vec3> lightPositions;
@@ -131,6 +131,8 @@ int main()
     shaderBloomFinal.use();
     shaderBloomFinal.setInt("scene", 0);
     shaderBloomFinal.setInt("bloomBlur", 1);
+    GpuTimer bloomTimer;
+    float lastStatsTime = 0.0f;
 
     while (!glfwWindowShouldClose(window))
     {
@@ -219,22 +221,24 @@ int main()
         }
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-        // 2. blur bright fragments with two-pass Gaussian Blur
+        if (benchmark)
+        {
+            benchmarkBloom(shaderBlur, shaderBloomDownsample, shaderBloomUpsample, hdrFBO, bloomScatter);
+            benchmark = false;
+        }
+
+        // 2. blur bright fragments, down and up a mip chain or with the full resolution two-pass Gaussian Blur
         // --------------------------------------------------
-        bool horizontal = true, first_iteration = true;
-        unsigned int amount = 10;
-        shaderBlur.use();
-        for (unsigned int i = 0; i < amount; i++)
+        bloomTimer.Begin();
+        unsigned int bloomTexture;
+        if (mipBloom)
         {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-            shaderBlur.setInt("horizontal", horizontal);
-            glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]); // bind texture of other framebuffer (or scene if first iteration)
-            renderQuad();
-            horizontal = !horizontal;
-            if (first_iteration)
-                first_iteration = false;
+            mipChain.Scatter = bloomScatter;
+            bloomTexture = mipChain.Render(shaderBloomDownsample, shaderBloomUpsample, colorBuffers[1]);
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        else
+            bloomTexture = gaussianBloom(shaderBlur, pingpongFBO, pingpongColorbuffers, colorBuffers[1], SCR_WIDTH, SCR_HEIGHT);
+        bloomTimer.End();
 
         // 3. now render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range
         // --------------------------------------------------------------------------------------------------------------------------
@@ -243,12 +247,20 @@ int main()
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
+        glBindTexture(GL_TEXTURE_2D, bloomTexture);
         shaderBloomFinal.setInt("bloom", bloom);
         shaderBloomFinal.setFloat("exposure", exposure);
         renderQuad();
 
-        std::cout << "bloom: " << (bloom ? "on" : "off") << "| exposure: " << exposure << std::endl;
+        // show the settings and the bloom time in the title bar once per second
+        if (currentFrame - lastStatsTime > 1.0f)
+        {
+            std::string mode = mipBloom ? "mip chain, scatter " + std::to_string(bloomScatter) : std::string("gaussian");
+            std::string title = "LearnOpenGL | bloom: " + std::string(bloom ? "on" : "off") + " (" + mode + "): " + std::to_string(bloomTimer.GetMilliseconds()) + " ms" +
+                                " | exposure: " + std::to_string(exposure);
+            glfwSetWindowTitle(window, title.c_str());
+            lastStatsTime = currentFrame;
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -332,6 +344,123 @@ void renderCube()
     glBindVertexArray(0);
 }
 
+// two full resolution targets for the gaussian ping-pong
+void createPingpong(unsigned int width, unsigned int height, unsigned int fbos[2], unsigned int textures[2])
+{
+    glGenFramebuffers(2, fbos);
+    glGenTextures(2, textures);
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbos[i]);
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[i], 0);
+        // also check if framebuffers are complete (no need for depth buffer)
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "Framebuffer not complete!" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// the original bloom: 10 separable 9 tap gaussian passes at full resolution, so the radius grows only with the pass
+// count. Returns the texture holding the result.
+unsigned int gaussianBloom(Shader &shaderBlur, unsigned int fbos[2], unsigned int textures[2], unsigned int source, unsigned int width, unsigned int height)
+{
+    bool horizontal = true, first_iteration = true;
+    unsigned int amount = 10;
+    glViewport(0, 0, width, height);
+    glActiveTexture(GL_TEXTURE0);
+    shaderBlur.use();
+    for (unsigned int i = 0; i < amount; i++)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbos[horizontal]);
+        shaderBlur.setInt("horizontal", horizontal);
+        glBindTexture(GL_TEXTURE_2D, first_iteration ? source : textures[!horizontal]); // bind texture of other framebuffer (or scene if first iteration)
+        renderQuad();
+        horizontal = !horizontal;
+        if (first_iteration)
+            first_iteration = false;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return textures[!horizontal];
+}
+
+// GPU time of both bloom paths at 1080p and 4K, printed once per press. The input is this frame's bright colors scaled
+// up to the benchmark size; each path runs a number of times in one timer query and the average is reported.
+struct BloomBenchmarkTarget
+{
+    unsigned int width, height;
+    unsigned int sourceFBO, sourceTexture;
+    unsigned int pingpongFBO[2], pingpongColorbuffers[2];
+    Bloom mipChain;
+};
+void benchmarkBloom(Shader &shaderBlur, Shader &shaderDownsample, Shader &shaderUpsample, unsigned int hdrFBO, float scatter)
+{
+    const unsigned int runs = 20;
+    // allocated on the first run and kept for the next ones
+    static std::vector<BloomBenchmarkTarget> targets;
+    static unsigned int query = 0;
+    if (targets.empty())
+    {
+        unsigned int sizes[2][2] = {{1920, 1080}, {3840, 2160}};
+        for (unsigned int i = 0; i < 2; i++)
+        {
+            BloomBenchmarkTarget target = {sizes[i][0], sizes[i][1], 0, 0, {0, 0}, {0, 0}, Bloom(sizes[i][0], sizes[i][1])};
+            glGenFramebuffers(1, &target.sourceFBO);
+            glBindFramebuffer(GL_FRAMEBUFFER, target.sourceFBO);
+            glGenTextures(1, &target.sourceTexture);
+            glBindTexture(GL_TEXTURE_2D, target.sourceTexture);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, target.width, target.height, 0, GL_RGB, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.sourceTexture, 0);
+            createPingpong(target.width, target.height, target.pingpongFBO, target.pingpongColorbuffers);
+            targets.push_back(target);
+        }
+        glGenQueries(1, &query);
+    }
+
+    for (unsigned int i = 0; i < targets.size(); i++)
+    {
+        BloomBenchmarkTarget &target = targets[i];
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, hdrFBO);
+        glReadBuffer(GL_COLOR_ATTACHMENT1);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.sourceFBO);
+        glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0, target.width, target.height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        target.mipChain.Scatter = scatter;
+
+        float milliseconds[2];
+        for (unsigned int path = 0; path < 2; path++)
+        {
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            for (unsigned int run = 0; run < runs; run++)
+            {
+                if (path == 0)
+                    gaussianBloom(shaderBlur, target.pingpongFBO, target.pingpongColorbuffers, target.sourceTexture, target.width, target.height);
+                else
+                    target.mipChain.Render(shaderDownsample, shaderUpsample, target.sourceTexture);
+            }
+            glEndQuery(GL_TIME_ELAPSED);
+            // waits for the GPU; fine for a benchmark
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+            milliseconds[path] = static_cast<float>(nanoseconds) / 1000000.0f / runs;
+        }
+        std::cout << "bloom " << target.width << "x" << target.height << ": gaussian (10 full resolution passes) " << milliseconds[0]
+                  << " ms, mip chain (" << target.mipChain.GetMipCount() << " mips, " << target.mipChain.GetMipCount() * 2 - 1 << " passes) "
+                  << milliseconds[1] << " ms" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+}
+
 unsigned int quadVAO = 0;
 unsigned int quadVBO;
 void renderQuad()
@@ -398,6 +527,28 @@ void processInput(GLFWwindow *window)
     {
         bloomKeyPressed = false;
     }
+    if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS && !mipBloomKeyPressed)
+    {
+        mipBloom = !mipBloom;
+        mipBloomKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_M) == GLFW_RELEASE)
+    {
+        mipBloomKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS && !benchmarkKeyPressed)
+    {
+        benchmark = true;
+        benchmarkKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_RELEASE)
+    {
+        benchmarkKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
+        bloomScatter = std::min(bloomScatter + 0.001f, 0.95f);
+    else if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS)
+        bloomScatter = std::max(bloomScatter - 0.001f, 0.0f);
 
     if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
     {
@@ -0,0 +1,45 @@
+#version 330 core
+// 13 tap downsample: five overlapping 2x2 box filters (each one bilinear fetch covers a 2x2 box), the center box
+// weighted .5 and the four corner boxes .125. On the first pass the boxes are also weighted by their inverse luma
+// (Karis average) so single very bright pixels don't turn into flickering blobs.
+out vec3 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D image;
+uniform bool firstPass;
+
+float karisWeight(vec3 c)
+{
+    return 1./(1.+dot(c,vec3(.2126,.7152,.0722)));
+}
+
+void main()
+{
+    vec2 t=1./vec2(textureSize(image,0));
+    vec3 a=texture(image,TexCoords+t*vec2(-2.,2.)).rgb;
+    vec3 b=texture(image,TexCoords+t*vec2(0.,2.)).rgb;
+    vec3 c=texture(image,TexCoords+t*vec2(2.,2.)).rgb;
+    vec3 d=texture(image,TexCoords+t*vec2(-2.,0.)).rgb;
+    vec3 e=texture(image,TexCoords).rgb;
+    vec3 f=texture(image,TexCoords+t*vec2(2.,0.)).rgb;
+    vec3 g=texture(image,TexCoords+t*vec2(-2.,-2.)).rgb;
+    vec3 h=texture(image,TexCoords+t*vec2(0.,-2.)).rgb;
+    vec3 i=texture(image,TexCoords+t*vec2(2.,-2.)).rgb;
+    vec3 j=texture(image,TexCoords+t*vec2(-1.,1.)).rgb;
+    vec3 k=texture(image,TexCoords+t*vec2(1.,1.)).rgb;
+    vec3 l=texture(image,TexCoords+t*vec2(-1.,-1.)).rgb;
+    vec3 m=texture(image,TexCoords+t*vec2(1.,-1.)).rgb;
+    
+    vec3 boxes[5]=vec3[]((j+k+l+m)*.25,(a+b+d+e)*.25,(b+c+e+f)*.25,(d+e+g+h)*.25,(e+f+h+i)*.25);
+    float weights[5]=float[](.5,.125,.125,.125,.125);
+    vec3 result=vec3(0.);
+    float weightSum=0.;
+    for(int n=0;n<5;++n)
+    {
+        float w=firstPass?weights[n]*karisWeight(boxes[n]):weights[n];
+        result+=boxes[n]*w;
+        weightSum+=w;
+    }
+    FragColor=result/weightSum;
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#version 330 core
+// 3x3 tent filter over the next smaller mip; the result is blended into this one
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D image;
+
+void main()
+{
+    vec2 t=1./vec2(textureSize(image,0));
+    vec3 result=texture(image,TexCoords).rgb*4.;
+    result+=(texture(image,TexCoords+vec2(-t.x,0.)).rgb+texture(image,TexCoords+vec2(t.x,0.)).rgb+
+    texture(image,TexCoords+vec2(0.,-t.y)).rgb+texture(image,TexCoords+vec2(0.,t.y)).rgb)*2.;
+    result+=texture(image,TexCoords+vec2(-t.x,-t.y)).rgb+texture(image,TexCoords+vec2(t.x,-t.y)).rgb+
+    texture(image,TexCoords+vec2(-t.x,t.y)).rgb+texture(image,TexCoords+vec2(t.x,t.y)).rgb;
+    FragColor=vec4(result/16.,1.);
+}
\ No newline at end of file
@@ -3,6 +3,11 @@
 #include "shader.h"
 #include "camera.h"
 #include "model.h"
+#include "gpu_timer.h"
+#include "job_system.h"
+#include "light_clusters.h"
+#include "occlusion_culler.h"
+#include "transform_system.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -17,7 +22,23 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 unsigned int loadTexture(const char *path, bool gammaCorrection);
 void renderQuad();
-void renderCube();
+void renderCube(unsigned int instances = 1);
+void renderLightVolumes(unsigned int instances);
+
+struct GBuffer
+{
+    unsigned int FBO;
+    unsigned int Normal;
+    unsigned int AlbedoSpec;
+    unsigned int Depth;
+    // only in the wide layout
+    unsigned int Position;
+    // color attachments only, both layouts add 4 bytes of depth and stencil
+    unsigned int BytesPerPixel;
+};
+GBuffer createGBuffer(bool wide);
+void benchmarkGBuffers(const GBuffer &compact, Shader &geometryShader, Shader &lightingShader, Model &backpack,
+                       const std::vector<glm::mat4> &models, const std::vector<glm::mat3> &normalMatrices);
 
 bool bloom = true;
 bool bloomKeyPressed = false;
@@ -28,6 +49,15 @@ float lastX = 400, lastY = 300;
 float deltaTime = 0.0f; // 当前帧与上一帧的时间差
 float lastFrame = 0.0f; // 上一帧的时间
 bool firstMouse = true;
+bool occlusionCulling = true;
+bool occlusionKeyPressed = false;
+bool clusteredLighting = true;
+bool clusteredKeyPressed = false;
+bool lightVolumes = false;
+bool lightVolumesKeyPressed = false;
+// B times the geometry and lighting passes with the compact G-buffer and with the wide one it replaced
+bool benchmark = false;
+bool benchmarkKeyPressed = false;
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 int main()
 {
@@ -62,9 +92,14 @@ int main()
 
     Shader shaderGeometryPass("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/8.Deferred_Shading/vsfs/g_buffer.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/8.Deferred_Shading/vsfs/g_buffer.fs");
     Shader shaderLightingPass("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/8.Deferred_Shading/vsfs/deferred_shading.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/8.Deferred_Shading/vsfs/deferred_shading.fs");
+    Shader shaderLightVolume("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/8.Deferred_Shading/vsfs/light_volume.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/8.Deferred_Shading/vsfs/light_volume.fs");
+    Shader shaderLightVolumeStencil("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/8.Deferred_Shading/vsfs/light_volume.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/8.Deferred_Shading/vsfs/light_volume_stencil.fs");
     Shader shaderLightBox("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/8.Deferred_Shading/vsfs/deferred_light_box.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/8.Deferred_Shading/vsfs/deferred_light_box.fs");
 
-    Model backpack("C:/Users/22175/Desktop/LearnOpenGL/assets/objects/backpack/backpack.obj");
+    // frame preparation (culling) runs on the job system, GL calls stay on this thread; the model's textures are
+    // decoded on it too
+    JobSystem jobSystem;
+    Model backpack("C:/Users/22175/Desktop/LearnOpenGL/assets/objects/backpack/backpack.obj", false, &jobSystem);
 
     std::vector<glm::vec3> objectPositions;
     objectPositions.push_back(glm::vec3(-3.0, -0.5, -3.0));
@@ -77,67 +112,70 @@ int main()
     objectPositions.push_back(glm::vec3(0.0, -0.5, 3.0));
     objectPositions.push_back(glm::vec3(3.0, -0.5, 3.0));
 
-    unsigned int gBuffer;
-    glGenFramebuffers(1, &gBuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
-    unsigned int gPosition, gNormal, gAlbedoSpec;
-    // position color buffer
-    glGenTextures(1, &gPosition);
-    glBindTexture(GL_TEXTURE_2D, gPosition);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gPosition, 0);
-    // normal color buffer
-    glGenTextures(1, &gNormal);
-    glBindTexture(GL_TEXTURE_2D, gNormal);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gNormal, 0);
-    // color + specular color buffer
-    glGenTextures(1, &gAlbedoSpec);
-    glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gAlbedoSpec, 0);
-    // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
-    unsigned int attachments[3] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
-    glDrawBuffers(3, attachments);
-
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-    // finally check if framebuffer is complete
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    const unsigned int NR_LIGHTS = 32;
-    std::vector<glm::vec3> lightPositions;
+    // the backpacks never move, so their matrices are only composed by the first update
+    TransformSystem transforms;
+    std::vector<unsigned int> objectTransforms;
+    for (unsigned int i = 0; i < objectPositions.size(); i++)
+        objectTransforms.push_back(transforms.Create(objectPositions[i], glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.5f)));
+
+    // the backpacks occlude each other; every backpack is both an occluder and a tested draw. The occluder is the
+    // inside of the model in blocks of cells, with a small fraction of its triangles
+    OcclusionCuller occlusionCuller;
+    AABB backpackBounds = ComputeAABB(backpack.meshes);
+    OccluderMesh backpackOccluder = SimplifyOccluder(backpack.meshes);
+    unsigned int backpackTriangles = 0;
+    for (unsigned int i = 0; i < backpack.meshes.size(); i++)
+        backpackTriangles += static_cast<unsigned int>(backpack.meshes[i].indices.size() / 3);
+    float lastStatsTime = 0.0f;
+    GpuTimer geometryTimer, lightingTimer;
+
+    // compact layout, 8 bytes per pixel plus depth: the position is reconstructed from the depth texture and the
+    // normal is octahedral encoded into two 16 bit channels. B times it against the old 20 byte layout.
+    GBuffer gBuffer = createGBuffer(false);
+
+    const unsigned int NR_LIGHTS = 4096;
+    std::vector<glm::vec3> lightBasePositions;
     std::vector<glm::vec3> lightColors;
+    std::vector<float> lightRadii;
+    // update attenuation parameters and calculate radius; the falloff is steep so a pixel only sees a handful of lights
+    const float constant = 1.0f;
+    const float linear = 1.4f;
+    const float quadratic = 12.0f;
     srand(13);
     for (unsigned int i = 0; i < NR_LIGHTS; i++)
     {
         // calculate slightly random offsets
-        float xPos = static_cast<float>(((rand() % 100) / 100.0) * 6.0 - 3.0);
-        float yPos = static_cast<float>(((rand() % 100) / 100.0) * 6.0 - 4.0);
-        float zPos = static_cast<float>(((rand() % 100) / 100.0) * 6.0 - 3.0);
-        lightPositions.push_back(glm::vec3(xPos, yPos, zPos));
+        float xPos = static_cast<float>(((rand() % 1000) / 1000.0) * 40.0 - 20.0);
+        float yPos = static_cast<float>(((rand() % 1000) / 1000.0) * 6.0 - 4.0);
+        float zPos = static_cast<float>(((rand() % 1000) / 1000.0) * 40.0 - 20.0);
+        lightBasePositions.push_back(glm::vec3(xPos, yPos, zPos));
         // also calculate random color
         float rColor = static_cast<float>(((rand() % 100) / 200.0f) + 0.5); // between 0.5 and 1.0
         float gColor = static_cast<float>(((rand() % 100) / 200.0f) + 0.5); // between 0.5 and 1.0
         float bColor = static_cast<float>(((rand() % 100) / 200.0f) + 0.5); // between 0.5 and 1.0
         lightColors.push_back(glm::vec3(rColor, gColor, bColor));
+        // distance at which the attenuated light drops below 5/256
+        const float maxBrightness = std::fmax(std::fmax(rColor, gColor), bColor);
+        lightRadii.push_back((-linear + std::sqrt(linear * linear - 4 * quadratic * (constant - (256.0f / 5.0f) * maxBrightness))) / (2.0f * quadratic));
     }
+    std::vector<glm::vec3> lightPositions(NR_LIGHTS);
+    // lights are assigned to view frustum clusters on the job system every frame
+    LightClusters lightClusters(SCR_WIDTH, SCR_HEIGHT, 0.1f, 100.0f);
 
     shaderLightingPass.use();
-    shaderLightingPass.setInt("gPosition", 0);
+    shaderLightingPass.setInt("gDepth", 0);
     shaderLightingPass.setInt("gNormal", 1);
     shaderLightingPass.setInt("gAlbedoSpec", 2);
+    shaderLightingPass.setInt("gPosition", 6);
+    shaderLightingPass.setFloat("lightLinear", linear);
+    shaderLightingPass.setFloat("lightQuadratic", quadratic);
+    shaderLightVolume.use();
+    shaderLightVolume.setInt("gDepth", 0);
+    shaderLightVolume.setInt("gNormal", 1);
+    shaderLightVolume.setInt("gAlbedoSpec", 2);
+    shaderLightVolume.setFloat("lightLinear", linear);
+    shaderLightVolume.setFloat("lightQuadratic", quadratic);
+    shaderLightVolume.setVec2("screenSize", static_cast<float>(SCR_WIDTH), static_cast<float>(SCR_HEIGHT));
     while (!glfwWindowShouldClose(window))
     {
         float currentFrame = static_cast<float>(glfwGetTime());
@@ -147,50 +185,96 @@ int main()
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer.FBO);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
         glm::mat4 view = camera.GetViewMatrix();
-        glm::mat4 model = glm::mat4(1.0f);
+        transforms.Update();
+        // every light circles around its base position
+        for (unsigned int i = 0; i < NR_LIGHTS; i++)
+        {
+            float phase = currentFrame + static_cast<float>(i);
+            lightPositions[i] = lightBasePositions[i] + 0.75f * glm::vec3(cos(phase), 0.0f, sin(phase));
+        }
+        lightClusters.Update(lightPositions, lightColors, lightRadii, view, projection, jobSystem);
+        std::vector<glm::mat4> objectModels(objectPositions.size());
+        for (unsigned int i = 0; i < objectPositions.size(); i++)
+            objectModels[i] = transforms.GetWorldMatrix(objectTransforms[i]);
+        // rasterize the occluders on the CPU and test every draw before anything is submitted
+        std::vector<char> objectVisible(objectPositions.size(), 1);
+        if (occlusionCulling)
+        {
+            occlusionCuller.BeginFrame(projection * view);
+            for (unsigned int i = 0; i < objectModels.size(); i++)
+                occlusionCuller.RenderOccluder(backpackOccluder, objectModels[i]);
+            occlusionCuller.Rasterize(&jobSystem);
+            jobSystem.ParallelFor(0, static_cast<unsigned int>(objectModels.size()), 1, [&](unsigned int begin, unsigned int end)
+                                  {
+                                      for (unsigned int i = begin; i < end; i++)
+                                          objectVisible[i] = occlusionCuller.TestAABB(backpackBounds, objectModels[i], backpackTriangles);
+                                  });
+        }
+        geometryTimer.Begin();
         shaderGeometryPass.use();
         shaderGeometryPass.setMat4("projection", projection);
         shaderGeometryPass.setMat4("view", view);
         for (unsigned int i = 0; i < objectPositions.size(); i++)
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, objectPositions[i]);
-            model = glm::scale(model, glm::vec3(0.5f));
-            shaderGeometryPass.setMat4("model", model);
+            if (!objectVisible[i])
+                continue;
+            shaderGeometryPass.setMat4("model", objectModels[i]);
+            shaderGeometryPass.setMat3("normalMatrix", transforms.GetNormalMatrix(objectTransforms[i]));
             backpack.Draw(shaderGeometryPass);
         }
+        geometryTimer.End();
+        // show the pass timings and culling statistics in the title bar once per second
+        if (currentFrame - lastStatsTime > 1.0f)
+        {
+            OcclusionStats stats = occlusionCuller.GetStats();
+            std::string title = "LearnOpenGL | geometry: " + std::to_string(geometryTimer.GetMilliseconds()) + " ms" +
+                                " | lighting: " + std::to_string(lightingTimer.GetMilliseconds()) + " ms" +
+                                " | culled draws: " + std::to_string(stats.CulledDraws) + "/" + std::to_string(stats.TestedDraws) +
+                                " | culled triangles: " + std::to_string(stats.CulledTriangles) + "/" + std::to_string(stats.TestedTriangles) +
+                                " | occluder triangles: " + std::to_string(stats.OccluderTriangles) + " (" + std::to_string(backpackTriangles * objectModels.size()) + " rendered)" +
+                                " | cluster light references: " + std::to_string(lightClusters.GetIndexCount()) +
+                                (lightClusters.GetDroppedCount() ? " (" + std::to_string(lightClusters.GetDroppedCount()) + " dropped)" : "");
+            glfwSetWindowTitle(window, title.c_str());
+            lastStatsTime = currentFrame;
+        }
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        lightingTimer.Begin();
+        glm::mat4 inverseViewProjection = glm::inverse(projection * view);
         shaderLightingPass.use();
+        shaderLightingPass.setMat4("inverseViewProjection", inverseViewProjection);
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, gPosition);
+        glBindTexture(GL_TEXTURE_2D, gBuffer.Depth);
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, gNormal);
+        glBindTexture(GL_TEXTURE_2D, gBuffer.Normal);
         glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
-        // send light relevant uniforms
-        for (unsigned int i = 0; i < lightPositions.size(); i++)
+        glBindTexture(GL_TEXTURE_2D, gBuffer.AlbedoSpec);
+        // lights and cluster lists live in buffer textures on units 3 to 5
+        lightClusters.Bind(shaderLightingPass, 3);
+        shaderLightingPass.setBool("clustered", clusteredLighting && !lightVolumes);
+        // with light volumes the full screen pass only adds the ambient term
+        if (lightVolumes)
+            shaderLightingPass.setInt("lightCount", 0);
+        shaderLightingPass.setVec3("viewPos", camera.Position);
+        if (benchmark)
         {
-            shaderLightingPass.setVec3("lights[" + std::to_string(i) + "].Position", lightPositions[i]);
-            shaderLightingPass.setVec3("lights[" + std::to_string(i) + "].Color", lightColors[i]);
-            // update attenuation parameters and calculate radius
-            const float linear = 0.7f;
-            const float quadratic = 1.8f;
-            shaderLightingPass.setFloat("lights[" + std::to_string(i) + "].Linear", linear);
-            shaderLightingPass.setFloat("lights[" + std::to_string(i) + "].Quadratic", quadratic);
+            std::vector<glm::mat3> normalMatrices(objectTransforms.size());
+            for (unsigned int i = 0; i < objectTransforms.size(); i++)
+                normalMatrices[i] = transforms.GetNormalMatrix(objectTransforms[i]);
+            benchmarkGBuffers(gBuffer, shaderGeometryPass, shaderLightingPass, backpack, objectModels, normalMatrices);
+            benchmark = false;
         }
-        shaderLightingPass.setVec3("viewPos", camera.Position);
         // finally render quad
         renderQuad();
 
         // 2.5. copy content of geometry's depth buffer to default framebuffer's depth buffer
         // ----------------------------------------------------------------------------------
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer.FBO);
         glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0); // write to default framebuffer
         // blit to default framebuffer. Note that this may or may not work as the internal formats of both the FBO and default framebuffer have to match.
         // the internal formats are implementation defined. This works on all of my systems, but if it doesn't on yours you'll likely have to write to the
@@ -198,20 +282,59 @@ int main()
         glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0, SCR_WIDTH, SCR_HEIGHT, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+        // 2.75. light volumes: every light is a sphere of its radius, drawn instanced in two passes
+        // ------------------------------------------------------------------------------------------
+        if (lightVolumes)
+        {
+            // stencil pass (depth fail): back faces behind the scene increment, front faces behind it decrement, so
+            // the stencil ends up non-zero where a surface lies inside at least one volume, even with the camera
+            // inside a volume
+            glEnable(GL_STENCIL_TEST);
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            glDepthMask(GL_FALSE);
+            glStencilFunc(GL_ALWAYS, 0, 0xFF);
+            glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+            glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+            shaderLightVolumeStencil.use();
+            shaderLightVolumeStencil.setMat4("projection", projection);
+            shaderLightVolumeStencil.setMat4("view", view);
+            lightClusters.Bind(shaderLightVolumeStencil, 3);
+            renderLightVolumes(NR_LIGHTS);
+
+            // lighting pass: back faces only so a volume around the camera still shades, no depth test, additive
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+            glDisable(GL_DEPTH_TEST);
+            glEnable(GL_CULL_FACE);
+            glCullFace(GL_FRONT);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+            shaderLightVolume.use();
+            shaderLightVolume.setMat4("projection", projection);
+            shaderLightVolume.setMat4("view", view);
+            shaderLightVolume.setVec3("viewPos", camera.Position);
+            shaderLightVolume.setMat4("inverseViewProjection", inverseViewProjection);
+            lightClusters.Bind(shaderLightVolume, 3);
+            renderLightVolumes(NR_LIGHTS);
+
+            glDisable(GL_BLEND);
+            glCullFace(GL_BACK);
+            glDisable(GL_CULL_FACE);
+            glEnable(GL_DEPTH_TEST);
+            glDepthMask(GL_TRUE);
+            glDisable(GL_STENCIL_TEST);
+        }
+        lightingTimer.End();
+
         // 3. render lights on top of scene
         // --------------------------------
         shaderLightBox.use();
         shaderLightBox.setMat4("projection", projection);
         shaderLightBox.setMat4("view", view);
-        for (unsigned int i = 0; i < lightPositions.size(); i++)
-        {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, lightPositions[i]);
-            model = glm::scale(model, glm::vec3(0.125f));
-            shaderLightBox.setMat4("model", model);
-            shaderLightBox.setVec3("lightColor", lightColors[i]);
-            renderCube();
-        }
+        shaderLightBox.setFloat("boxScale", 0.125f);
+        lightClusters.Bind(shaderLightBox, 3);
+        renderCube(NR_LIGHTS);
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -222,9 +345,124 @@ int main()
     return 0;
 }
 
+// the compact layout stores an RG16 octahedral normal and RGBA8 albedo + specular, 8 bytes; the wide one is the layout
+// it replaced: RGBA16F normal, RGBA8 albedo + specular and an RGBA16F world position, 20 bytes
+GBuffer createGBuffer(bool wide)
+{
+    GBuffer gBuffer = {};
+    glGenFramebuffers(1, &gBuffer.FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer.FBO);
+    // normal buffer
+    glGenTextures(1, &gBuffer.Normal);
+    glBindTexture(GL_TEXTURE_2D, gBuffer.Normal);
+    if (wide)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16, SCR_WIDTH, SCR_HEIGHT, 0, GL_RG, GL_UNSIGNED_SHORT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gBuffer.Normal, 0);
+    // color + specular color buffer
+    glGenTextures(1, &gBuffer.AlbedoSpec);
+    glBindTexture(GL_TEXTURE_2D, gBuffer.AlbedoSpec);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gBuffer.AlbedoSpec, 0);
+    gBuffer.BytesPerPixel = wide ? 8 + 4 : 4 + 4;
+    // position buffer
+    if (wide)
+    {
+        glGenTextures(1, &gBuffer.Position);
+        glBindTexture(GL_TEXTURE_2D, gBuffer.Position);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gBuffer.Position, 0);
+        gBuffer.BytesPerPixel += 8;
+    }
+    // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
+    unsigned int attachments[3] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+    glDrawBuffers(wide ? 3 : 2, attachments);
+
+    // depth is a texture so the lighting passes can read it
+    glGenTextures(1, &gBuffer.Depth);
+    glBindTexture(GL_TEXTURE_2D, gBuffer.Depth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, gBuffer.Depth, 0);
+    // finally check if framebuffer is complete
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "Framebuffer not complete!" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return gBuffer;
+}
+
+// the same geometry and full screen lighting passes over both layouts, each timed over a run of frames. The lighting
+// shader is expected to be set up for this frame (matrices, lights and cluster lists); it is left reading the compact
+// layout.
+void benchmarkGBuffers(const GBuffer &compact, Shader &geometryShader, Shader &lightingShader, Model &backpack,
+                       const std::vector<glm::mat4> &models, const std::vector<glm::mat3> &normalMatrices)
+{
+    const unsigned int frames = 100;
+    static GBuffer wideGBuffer = createGBuffer(true);
+    static unsigned int query = 0;
+    if (query == 0)
+        glGenQueries(1, &query);
+    const GBuffer *layouts[2] = {&wideGBuffer, &compact};
+    for (const GBuffer *layout : layouts)
+    {
+        bool wide = layout == &wideGBuffer;
+        // geometry pass
+        geometryShader.use();
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        for (unsigned int frame = 0; frame < frames; frame++)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, layout->FBO);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            for (unsigned int i = 0; i < models.size(); i++)
+            {
+                geometryShader.setMat4("model", models[i]);
+                geometryShader.setMat3("normalMatrix", normalMatrices[i]);
+                backpack.Draw(geometryShader);
+            }
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+        // waits for the GPU; fine for a benchmark
+        GLuint64 geometryNanoseconds = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &geometryNanoseconds);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        // lighting pass
+        lightingShader.use();
+        lightingShader.setBool("storedPosition", wide);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, layout->Depth);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, layout->Normal);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, layout->AlbedoSpec);
+        glActiveTexture(GL_TEXTURE6);
+        glBindTexture(GL_TEXTURE_2D, layout->Position);
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        for (unsigned int frame = 0; frame < frames; frame++)
+            renderQuad();
+        glEndQuery(GL_TIME_ELAPSED);
+        GLuint64 lightingNanoseconds = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &lightingNanoseconds);
+        std::cout << (wide ? "wide" : "compact") << " G-buffer: " << layout->BytesPerPixel << " + 4 bytes per pixel, "
+                  << (layout->BytesPerPixel + 4) * SCR_WIDTH * SCR_HEIGHT / (1024.0f * 1024.0f) << " MB, geometry pass "
+                  << static_cast<float>(geometryNanoseconds) / 1000000.0f / frames << " ms, lighting pass "
+                  << static_cast<float>(lightingNanoseconds) / 1000000.0f / frames << " ms" << std::endl;
+    }
+    lightingShader.setBool("storedPosition", false);
+    glActiveTexture(GL_TEXTURE0);
+}
+
 unsigned int cubeVAO = 0;
 unsigned int cubeVBO = 0;
-void renderCube()
+void renderCube(unsigned int instances)
 {
     // initialize (if necessary)
     if (cubeVAO == 0)
@@ -291,7 +529,70 @@ void renderCube()
     }
     // render Cube
     glBindVertexArray(cubeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 36, instances);
+    glBindVertexArray(0);
+}
+
+// unit sphere for the light volumes; the vertices are pushed out a bit so the flat faces still enclose the sphere
+unsigned int lightVolumeVAO = 0;
+unsigned int lightVolumeVertexCount;
+void renderLightVolumes(unsigned int instances)
+{
+    if (lightVolumeVAO == 0)
+    {
+        const unsigned int X_SEGMENTS = 16;
+        const unsigned int Y_SEGMENTS = 12;
+        const float PI = 3.14159265359f;
+        const float enclose = 1.0f / (std::cos(PI / X_SEGMENTS) * std::cos(PI / (2 * Y_SEGMENTS)));
+        std::vector<glm::vec3> grid;
+        for (unsigned int y = 0; y <= Y_SEGMENTS; ++y)
+        {
+            for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
+            {
+                float xSegment = static_cast<float>(x) / static_cast<float>(X_SEGMENTS);
+                float ySegment = static_cast<float>(y) / static_cast<float>(Y_SEGMENTS);
+                float xPos = std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
+                float yPos = std::cos(ySegment * PI);
+                float zPos = std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
+                grid.push_back(glm::vec3(xPos, yPos, zPos) * enclose);
+            }
+        }
+        // the stencil pass relies on the faces pointing outwards (counter clockwise seen from outside)
+        std::vector<glm::vec3> vertices;
+        for (unsigned int y = 0; y < Y_SEGMENTS; ++y)
+        {
+            for (unsigned int x = 0; x < X_SEGMENTS; ++x)
+            {
+                unsigned int i0 = y * (X_SEGMENTS + 1) + x, i1 = i0 + 1, i2 = i0 + X_SEGMENTS + 1, i3 = i2 + 1;
+                unsigned int triangles[2][3] = {{i0, i2, i1}, {i1, i2, i3}};
+                for (unsigned int t = 0; t < 2; t++)
+                {
+                    glm::vec3 a = grid[triangles[t][0]], b = grid[triangles[t][1]], c = grid[triangles[t][2]];
+                    // skip the degenerate triangles at the poles
+                    glm::vec3 n = glm::cross(b - a, c - a);
+                    if (glm::dot(n, n) < 1e-12f)
+                        continue;
+                    if (glm::dot(n, a + b + c) < 0.0f)
+                        std::swap(b, c);
+                    vertices.push_back(a);
+                    vertices.push_back(b);
+                    vertices.push_back(c);
+                }
+            }
+        }
+        lightVolumeVertexCount = static_cast<unsigned int>(vertices.size());
+        unsigned int vbo;
+        glGenVertexArrays(1, &lightVolumeVAO);
+        glGenBuffers(1, &vbo);
+        glBindVertexArray(lightVolumeVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glBindVertexArray(lightVolumeVAO);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, lightVolumeVertexCount, instances);
     glBindVertexArray(0);
 }
 
@@ -361,6 +662,42 @@ void processInput(GLFWwindow *window)
     {
         bloomKeyPressed = false;
     }
+    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS && !occlusionKeyPressed)
+    {
+        occlusionCulling = !occlusionCulling;
+        occlusionKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_RELEASE)
+    {
+        occlusionKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && !clusteredKeyPressed)
+    {
+        clusteredLighting = !clusteredLighting;
+        clusteredKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE)
+    {
+        clusteredKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS && !lightVolumesKeyPressed)
+    {
+        lightVolumes = !lightVolumes;
+        lightVolumesKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_V) == GLFW_RELEASE)
+    {
+        lightVolumesKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS && !benchmarkKeyPressed)
+    {
+        benchmark = true;
+        benchmarkKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_RELEASE)
+    {
+        benchmarkKeyPressed = false;
+    }
 
     if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
     {
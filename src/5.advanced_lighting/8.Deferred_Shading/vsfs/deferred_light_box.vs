@@ -3,11 +3,17 @@ layout(location=0)in vec3 aPos;
 layout(location=1)in vec3 aNormal;
 layout(location=2)in vec2 aTexCoords;
 
+out vec3 LightColor;
+
 uniform mat4 projection;
 uniform mat4 view;
-uniform mat4 model;
+// one instance per light, positions and colors come from the clustered lighting buffer
+uniform samplerBuffer lightData;
+uniform float boxScale;
 
 void main()
 {
-    gl_Position=projection*view*model*vec4(aPos,1.);
+    vec3 lightPosition=texelFetch(lightData,gl_InstanceID*2).xyz;
+    LightColor=texelFetch(lightData,gl_InstanceID*2+1).rgb;
+    gl_Position=projection*view*vec4(aPos*boxScale+lightPosition,1.);
 }
\ No newline at end of file
@@ -3,47 +3,78 @@ out vec4 FragColor;
 
 in vec2 TexCoords;
 
-uniform sampler2D gPosition;
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
 uniform sampler2D gAlbedoSpec;
+// the wide layout of the B benchmark reads the stored position instead of reconstructing it
+uniform bool storedPosition;
+uniform sampler2D gPosition;
 
-struct Light{
-    vec3 Position;
-    vec3 Color;
-    
-    float Linear;
-    float Quadratic;
-};
-const int NR_LIGHTS=32;
-uniform Light lights[NR_LIGHTS];
+// lights and their cluster lists, filled by LightClusters (light_clusters.h)
+uniform samplerBuffer lightData;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterLights;
+uniform int lightCount;
+uniform mat4 clusterView;
+uniform float clusterNear;
+uniform float clusterSliceScale;
+uniform vec2 clusterTileSize;
+const int CLUSTER_X=16;
+const int CLUSTER_Y=9;
+const int CLUSTER_Z=24;
+
+// shade only the lights of this pixel's cluster instead of every light
+uniform bool clustered;
+uniform float lightLinear;
+uniform float lightQuadratic;
 uniform vec3 viewPos;
+uniform mat4 inverseViewProjection;
+
+#include "../../../../include/shaders/gbuffer.glsl"
+
+vec3 shadeLight(int index,vec3 FragPos,vec3 Normal,vec3 viewDir,vec3 Diffuse,float Specular)
+{
+    vec4 positionRadius=texelFetch(lightData,index*2);
+    vec3 lightColor=texelFetch(lightData,index*2+1).rgb;
+    float distance=length(positionRadius.xyz-FragPos);
+    if(distance>positionRadius.w)
+    return vec3(0.);
+    // diffuse
+    vec3 lightDir=normalize(positionRadius.xyz-FragPos);
+    vec3 diffuse=max(dot(Normal,lightDir),0.)*Diffuse*lightColor;
+    // specular
+    vec3 halfwayDir=normalize(lightDir+viewDir);
+    float spec=pow(max(dot(Normal,halfwayDir),0.),16.);
+    vec3 specular=lightColor*spec*Specular;
+    // attenuation
+    float attenuation=1./(1.+lightLinear*distance+lightQuadratic*distance*distance);
+    return(diffuse+specular)*attenuation;
+}
 
 void main()
 {
     // retrieve data from gbuffer
-    vec3 FragPos=texture(gPosition,TexCoords).rgb;
-    vec3 Normal=texture(gNormal,TexCoords).rgb;
+    vec3 FragPos=storedPosition?texture(gPosition,TexCoords).xyz:positionFromDepth(TexCoords,texture(gDepth,TexCoords).r,inverseViewProjection);
+    vec3 Normal=decodeNormal(texture(gNormal,TexCoords).rg);
     vec3 Diffuse=texture(gAlbedoSpec,TexCoords).rgb;
     float Specular=texture(gAlbedoSpec,TexCoords).a;
     
     // then calculate lighting as usual
     vec3 lighting=Diffuse*.1;// hard-coded ambient component
     vec3 viewDir=normalize(viewPos-FragPos);
-    for(int i=0;i<NR_LIGHTS;++i)
+    if(clustered)
+    {
+        ivec2 tile=min(ivec2(gl_FragCoord.xy/clusterTileSize),ivec2(CLUSTER_X-1,CLUSTER_Y-1));
+        float depth=max(-(clusterView*vec4(FragPos,1.)).z,clusterNear);
+        int slice=clamp(int(floor(log(depth/clusterNear)*clusterSliceScale)),0,CLUSTER_Z-1);
+        uvec2 range=texelFetch(clusterGrid,tile.x+CLUSTER_X*(tile.y+CLUSTER_Y*slice)).xy;
+        for(uint i=0u;i<range.y;++i)
+        lighting+=shadeLight(int(texelFetch(clusterLights,int(range.x+i)).r),FragPos,Normal,viewDir,Diffuse,Specular);
+    }
+    else
     {
-        // diffuse
-        vec3 lightDir=normalize(lights[i].Position-FragPos);
-        vec3 diffuse=max(dot(Normal,lightDir),0.)*Diffuse*lights[i].Color;
-        // specular
-        vec3 halfwayDir=normalize(lightDir+viewDir);
-        float spec=pow(max(dot(Normal,halfwayDir),0.),16.);
-        vec3 specular=lights[i].Color*spec*Specular;
-        // attenuation
-        float distance=length(lights[i].Position-FragPos);
-        float attenuation=1./(1.+lights[i].Linear*distance+lights[i].Quadratic*distance*distance);
-        diffuse*=attenuation;
-        specular*=attenuation;
-        lighting+=diffuse+specular;
+        for(int i=0;i<lightCount;++i)
+        lighting+=shadeLight(i,FragPos,Normal,viewDir,Diffuse,Specular);
     }
     FragColor=vec4(lighting,1.);
 }
\ No newline at end of file
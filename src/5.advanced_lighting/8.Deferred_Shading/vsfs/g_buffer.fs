@@ -1,21 +1,24 @@
 #version 330 core
-layout(location=0)out vec3 gPosition;
-layout(location=1)out vec3 gNormal;
-layout(location=2)out vec4 gAlbedoSpec;
+layout(location=0)out vec2 gNormal;
+layout(location=1)out vec4 gAlbedoSpec;
+// only bound by the wide layout the B benchmark compares against; the compact G-buffer has no third attachment
+layout(location=2)out vec3 gPosition;
 
-in vec2 TexCoords;
 in vec3 FragPos;
+in vec2 TexCoords;
 in vec3 Normal;
 
 uniform sampler2D texture_diffuse1;
 uniform sampler2D texture_specular1;
 
+#include "../../../../include/shaders/gbuffer.glsl"
+
 void main()
 {
-    // store the fragment position vector in the first gbuffer texture
+    // the position is normally not stored, the lighting pass reconstructs it from depth
     gPosition=FragPos;
-    // also store the per-fragment normals into the gbuffer
-    gNormal=normalize(Normal);
+    // store the per-fragment normals into the gbuffer
+    gNormal=encodeNormal(normalize(Normal));
     // and the diffuse per-fragment color
     gAlbedoSpec.rgb=texture(texture_diffuse1,TexCoords).rgb;
     // store specular intensity in gAlbedoSpec's alpha component
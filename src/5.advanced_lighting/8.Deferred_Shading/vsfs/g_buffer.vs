@@ -10,6 +10,7 @@ out vec3 Normal;
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform mat3 normalMatrix;
 
 void main()
 {
@@ -17,7 +18,6 @@ void main()
     FragPos=worldPos.xyz;
     TexCoords=aTexCoords;
     
-    mat3 normalMatrix=transpose(inverse(mat3(model)));
     Normal=normalMatrix*aNormal;
     
     gl_Position=projection*view*worldPos;
@@ -0,0 +1,45 @@
+#version 330 core
+out vec4 FragColor;
+
+flat in int LightIndex;
+
+uniform sampler2D gDepth;
+uniform sampler2D gNormal;
+uniform sampler2D gAlbedoSpec;
+uniform samplerBuffer lightData;
+
+uniform float lightLinear;
+uniform float lightQuadratic;
+uniform vec3 viewPos;
+uniform mat4 inverseViewProjection;
+uniform vec2 screenSize;
+
+#include "../../../../include/shaders/gbuffer.glsl"
+
+void main()
+{
+    // the volume covers the pixel on screen, the G-buffer tells what is actually there
+    vec2 TexCoords=gl_FragCoord.xy/screenSize;
+    vec3 FragPos=positionFromDepth(TexCoords,texture(gDepth,TexCoords).r,inverseViewProjection);
+    vec3 Normal=decodeNormal(texture(gNormal,TexCoords).rg);
+    vec3 Diffuse=texture(gAlbedoSpec,TexCoords).rgb;
+    float Specular=texture(gAlbedoSpec,TexCoords).a;
+    
+    vec4 positionRadius=texelFetch(lightData,LightIndex*2);
+    vec3 lightColor=texelFetch(lightData,LightIndex*2+1).rgb;
+    float distance=length(positionRadius.xyz-FragPos);
+    // the stencil only says the pixel is inside some volume, not inside this one
+    if(distance>positionRadius.w)
+    discard;
+    vec3 viewDir=normalize(viewPos-FragPos);
+    // diffuse
+    vec3 lightDir=normalize(positionRadius.xyz-FragPos);
+    vec3 diffuse=max(dot(Normal,lightDir),0.)*Diffuse*lightColor;
+    // specular
+    vec3 halfwayDir=normalize(lightDir+viewDir);
+    float spec=pow(max(dot(Normal,halfwayDir),0.),16.);
+    vec3 specular=lightColor*spec*Specular;
+    // attenuation
+    float attenuation=1./(1.+lightLinear*distance+lightQuadratic*distance*distance);
+    FragColor=vec4((diffuse+specular)*attenuation,1.);
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#version 330 core
+layout(location=0)in vec3 aPos;
+
+flat out int LightIndex;
+
+uniform mat4 projection;
+uniform mat4 view;
+// one instance per light: a unit sphere scaled to the light's radius
+uniform samplerBuffer lightData;
+
+void main()
+{
+    vec4 positionRadius=texelFetch(lightData,gl_InstanceID*2);
+    LightIndex=gl_InstanceID;
+    gl_Position=projection*view*vec4(positionRadius.xyz+aPos*positionRadius.w,1.);
+}
\ No newline at end of file
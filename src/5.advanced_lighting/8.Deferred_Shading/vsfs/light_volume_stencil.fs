@@ -0,0 +1,6 @@
+#version 330 core
+
+// the stencil pass only needs the depth test results
+void main()
+{
+}
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "shader.h"
 #include "camera.h"
 #include "model.h"
+#include "gpu_timer.h"
 #include <iostream>
 #include <random>
 
@@ -18,8 +19,26 @@ void processInput(GLFWwindow *window);
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 unsigned int loadTexture(const char *path, bool gammaCorrection);
+struct GBuffer
+{
+    unsigned int FBO;
+    unsigned int Normal;
+    unsigned int Albedo;
+    unsigned int Depth;
+    // only in the wide layout
+    unsigned int Position;
+    // color attachments only, both layouts add 4 bytes of depth
+    unsigned int BytesPerPixel;
+};
+GBuffer createGBuffer(bool wide);
 void renderQuad();
 void renderCube();
+unsigned int createTarget(GLenum attachment, GLenum filter);
+void allocateTarget(unsigned int texture, GLint internalFormat, unsigned int width, unsigned int height, GLenum format, GLenum type);
+std::vector<glm::vec3> generateKernel(unsigned int kernelSize);
+void compareAmbientOcclusion(Shader &ssaoShader, Shader &gtaoShader, Shader &temporalShader, const glm::mat4 &projection,
+                             unsigned int ssaoFBO, unsigned int ssaoColorBuffer, const unsigned int *historyFBOs, const unsigned int *history,
+                             unsigned int ssaoDepth, unsigned int ssaoNormal, unsigned int noiseTexture, unsigned int width, unsigned int height);
 float ourLerp(float a, float b, float f)
 {
     return a + f * (b - a);
@@ -33,6 +52,22 @@ float lastX = 400, lastY = 300;
 float deltaTime = 0.0f; // 当前帧与上一帧的时间差
 float lastFrame = 0.0f; // 上一帧的时间
 bool firstMouse = true;
+// the AO is computed at SCR_WIDTH / ssaoDownsample x SCR_HEIGHT / ssaoDownsample (1, 2 or 4), with ssaoKernelSize
+// samples per pixel
+unsigned int ssaoDownsample = 2;
+unsigned int ssaoKernelSize = 32;
+bool resolutionKeyPressed = false;
+bool kernelKeyPressed = false;
+// G switches between the hemisphere kernel SSAO and GTAO: a few horizon searched slices per pixel, rotated every frame
+// and accumulated over time
+bool gtao = true;
+bool gtaoKeyPressed = false;
+// C measures how far the GTAO is from the 64 sample SSAO for the current view and times both
+bool compareAo = false;
+bool compareAoKeyPressed = false;
+// L switches between the compact G-buffer and the wide one it replaced, which stores the view space position
+bool wideGBuffer = false;
+bool wideGBufferKeyPressed = false;
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 int main()
 {
@@ -67,97 +102,81 @@ int main()
 
     Shader shaderGeometryPass("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/9.SSAO/vsfs/ssao_g.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/9.SSAO/vsfs/ssao_g.fs");
     Shader shaderssao("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/9.SSAO/vsfs/ssao.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/9.SSAO/vsfs/ssao.fs");
+    Shader shadergtao("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/9.SSAO/vsfs/ssao.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/9.SSAO/vsfs/gtao.fs");
+    Shader shadergtaotemporal("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/9.SSAO/vsfs/ssao.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/9.SSAO/vsfs/gtao_temporal.fs");
     Shader shaderssaoblur("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/9.SSAO/vsfs/ssao.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/9.SSAO/vsfs/ssao_blur.fs");
+    Shader shaderssaodownsample("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/9.SSAO/vsfs/ssao.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/9.SSAO/vsfs/ssao_downsample.fs");
+    Shader shaderssaoupsample("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/9.SSAO/vsfs/ssao.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/9.SSAO/vsfs/ssao_upsample.fs");
     Shader shaderLightingPass("C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/9.SSAO/vsfs/ssao.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/5.advanced_lighting/9.SSAO/vsfs/ssao_lighting.fs");
 
     Model backpack("C:/Users/22175/Desktop/LearnOpenGL/assets/objects/backpack/backpack.obj");
 
-    unsigned int gBuffer;
-    glGenFramebuffers(1, &gBuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
-    unsigned int gPosition, gNormal, gAlbedo;
-    // position color buffer
-    glGenTextures(1, &gPosition);
-    glBindTexture(GL_TEXTURE_2D, gPosition);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gPosition, 0);
-    // normal color buffer
-    glGenTextures(1, &gNormal);
-    glBindTexture(GL_TEXTURE_2D, gNormal);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gNormal, 0);
-    // color + specular color buffer
-    glGenTextures(1, &gAlbedo);
-    glBindTexture(GL_TEXTURE_2D, gAlbedo);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gAlbedo, 0);
-    // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
-    unsigned int attachments[3] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
-    glDrawBuffers(3, attachments);
-
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-    // finally check if framebuffer is complete
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    unsigned int ssaoFBO, ssaoBlurFBO;
+    // both G-buffer layouts are kept so L can switch between them
+    GBuffer gBuffers[2] = {createGBuffer(false), createGBuffer(true)};
+
+    // AO targets. The SSAO, its blur and the depth/normal copy it reads run at the reduced resolution; only the
+    // upsampled result is full size.
+    //   ssaoDepth / ssaoNormal  linear view depth and encoded normal, one texel per AO pixel
+    //   ssaoColorBuffer         raw AO
+    //   gtaoHistory[2]          accumulated GTAO and its view depth, ping-ponged between frames
+    //   ssaoBlurTemp            after the horizontal blur
+    //   ssaoColorBufferBlur     after the vertical blur
+    //   ssaoUpsampled           full resolution, read by the lighting pass (unused at full resolution)
+    unsigned int ssaoDownsampleFBO, ssaoFBO, gtaoHistoryFBO[2], ssaoBlurFBO[2], ssaoUpsampleFBO;
+    glGenFramebuffers(1, &ssaoDownsampleFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, ssaoDownsampleFBO);
+    unsigned int ssaoDepth = createTarget(GL_COLOR_ATTACHMENT0, GL_NEAREST);
+    unsigned int ssaoNormal = createTarget(GL_COLOR_ATTACHMENT1, GL_NEAREST);
+    unsigned int attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, attachments);
     glGenFramebuffers(1, &ssaoFBO);
-    glGenFramebuffers(1, &ssaoBlurFBO);
-
     glBindFramebuffer(GL_FRAMEBUFFER, ssaoFBO);
-    unsigned int ssaoColorBuffer;
-    // SSAO color buffer
-    glGenTextures(1, &ssaoColorBuffer);
-    glBindTexture(GL_TEXTURE_2D, ssaoColorBuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, SCR_WIDTH, SCR_HEIGHT, 0, GL_RED, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ssaoColorBuffer, 0);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "SSAO Framebuffer not complete!" << std::endl;
-    // and blur stage
-    glBindFramebuffer(GL_FRAMEBUFFER, ssaoBlurFBO);
-    unsigned int ssaoColorBufferBlur;
-    glGenTextures(1, &ssaoColorBufferBlur);
-    glBindTexture(GL_TEXTURE_2D, ssaoColorBufferBlur);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, SCR_WIDTH, SCR_HEIGHT, 0, GL_RED, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ssaoColorBufferBlur, 0);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "SSAO Blur Framebuffer not complete!" << std::endl;
+    unsigned int ssaoColorBuffer = createTarget(GL_COLOR_ATTACHMENT0, GL_NEAREST);
+    unsigned int gtaoHistory[2];
+    glGenFramebuffers(2, gtaoHistoryFBO);
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, gtaoHistoryFBO[i]);
+        gtaoHistory[i] = createTarget(GL_COLOR_ATTACHMENT0, GL_NEAREST);
+    }
+    glGenFramebuffers(2, ssaoBlurFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, ssaoBlurFBO[0]);
+    unsigned int ssaoBlurTemp = createTarget(GL_COLOR_ATTACHMENT0, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, ssaoBlurFBO[1]);
+    unsigned int ssaoColorBufferBlur = createTarget(GL_COLOR_ATTACHMENT0, GL_NEAREST);
+    glGenFramebuffers(1, &ssaoUpsampleFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, ssaoUpsampleFBO);
+    unsigned int ssaoUpsampled = createTarget(GL_COLOR_ATTACHMENT0, GL_NEAREST);
+    allocateTarget(ssaoUpsampled, GL_R8, SCR_WIDTH, SCR_HEIGHT, GL_RED, GL_UNSIGNED_BYTE);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // sizes the reduced resolution targets; called again whenever the resolution is switched
+    unsigned int ssaoWidth = 0, ssaoHeight = 0;
+    auto resizeSSAOTargets = [&]()
+    {
+        ssaoWidth = (SCR_WIDTH + ssaoDownsample - 1) / ssaoDownsample;
+        ssaoHeight = (SCR_HEIGHT + ssaoDownsample - 1) / ssaoDownsample;
+        allocateTarget(ssaoDepth, GL_R32F, ssaoWidth, ssaoHeight, GL_RED, GL_FLOAT);
+        allocateTarget(ssaoNormal, GL_RG16, ssaoWidth, ssaoHeight, GL_RG, GL_UNSIGNED_SHORT);
+        allocateTarget(ssaoColorBuffer, GL_R8, ssaoWidth, ssaoHeight, GL_RED, GL_UNSIGNED_BYTE);
+        // 8 bits would quantize away the small per frame changes of the accumulation
+        allocateTarget(gtaoHistory[0], GL_RG32F, ssaoWidth, ssaoHeight, GL_RG, GL_FLOAT);
+        allocateTarget(gtaoHistory[1], GL_RG32F, ssaoWidth, ssaoHeight, GL_RG, GL_FLOAT);
+        allocateTarget(ssaoBlurTemp, GL_R8, ssaoWidth, ssaoHeight, GL_RED, GL_UNSIGNED_BYTE);
+        allocateTarget(ssaoColorBufferBlur, GL_R8, ssaoWidth, ssaoHeight, GL_RED, GL_UNSIGNED_BYTE);
+        unsigned int fbos[6] = {ssaoDownsampleFBO, ssaoFBO, gtaoHistoryFBO[0], gtaoHistoryFBO[1], ssaoBlurFBO[0], ssaoBlurFBO[1]};
+        for (unsigned int i = 0; i < 6; i++)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, fbos[i]);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "SSAO Framebuffer not complete!" << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    };
+    resizeSSAOTargets();
+    unsigned int currentDownsample = ssaoDownsample;
 
-    // generate sample kernel
     std::uniform_real_distribution<GLfloat> randomFloats(0.0, 1.0); // generates random floats between 0.0 and 1.0
     std::default_random_engine generator;
-    std::vector<glm::vec3> ssaoKernel;
-    for (unsigned int i = 0; i < 64; ++i)
-    {
-        glm::vec3 sample(randomFloats(generator) * 2.0 - 1.0, randomFloats(generator) * 2.0 - 1.0, randomFloats(generator));
-        sample = glm::normalize(sample);
-        sample *= randomFloats(generator);
-        float scale = float(i) / 64.0f;
-
-        // scale samples s.t. they're more aligned to center of kernel
-        scale = ourLerp(0.1f, 1.0f, scale * scale);
-        sample *= scale;
-        ssaoKernel.push_back(sample);
-    }
-
     // generate noise texture
     std::vector<glm::vec3> ssaoNoise;
     for (unsigned int i = 0; i < 16; i++)
@@ -178,16 +197,40 @@ int main()
     glm::vec3 lightColor = glm::vec3(0.2, 0.2, 0.7);
 
     shaderLightingPass.use();
-    shaderLightingPass.setInt("gPosition", 0);
+    shaderLightingPass.setInt("gDepth", 0);
     shaderLightingPass.setInt("gNormal", 1);
     shaderLightingPass.setInt("gAlbedo", 2);
     shaderLightingPass.setInt("ssao", 3);
+    shaderLightingPass.setInt("gPosition", 4);
+    shaderssaodownsample.use();
+    shaderssaodownsample.setInt("gDepth", 0);
+    shaderssaodownsample.setInt("gNormal", 1);
     shaderssao.use();
-    shaderssao.setInt("gPosition", 0);
-    shaderssao.setInt("gNormal", 1);
+    shaderssao.setInt("ssaoDepth", 0);
+    shaderssao.setInt("ssaoNormal", 1);
     shaderssao.setInt("texNoise", 2);
+    shadergtao.use();
+    shadergtao.setInt("ssaoDepth", 0);
+    shadergtao.setInt("ssaoNormal", 1);
+    shadergtaotemporal.use();
+    shadergtaotemporal.setInt("aoInput", 0);
+    shadergtaotemporal.setInt("ssaoDepth", 1);
+    shadergtaotemporal.setInt("history", 2);
     shaderssaoblur.use();
     shaderssaoblur.setInt("ssaoInput", 0);
+    shaderssaoblur.setInt("ssaoDepth", 1);
+    shaderssaoupsample.use();
+    shaderssaoupsample.setInt("ssaoInput", 0);
+    shaderssaoupsample.setInt("ssaoDepth", 1);
+    shaderssaoupsample.setInt("gDepth", 2);
+    // the kernel only changes with its size, so it is uploaded then and not every frame
+    unsigned int currentKernelSize = 0;
+    // GTAO history: the target written last frame and the camera it was rendered with
+    unsigned int gtaoFrame = 0, historyIndex = 0;
+    bool historyValid = false, currentGtao = gtao;
+    glm::mat4 previousView = glm::mat4(1.0f), previousProjection = glm::mat4(1.0f);
+    GpuTimer geometryTimer, ssaoTimer, lightingTimer;
+    float lastStatsTime = 0.0f;
 
     while (!glfwWindowShouldClose(window))
     {
@@ -198,11 +241,14 @@ int main()
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+        const GBuffer &gBuffer = gBuffers[wideGBuffer ? 1 : 0];
+        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer.FBO);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), static_cast<float>(SCR_WIDTH) / static_cast<float>(SCR_HEIGHT), 0.1f, 50.0f);
         glm::mat4 view = camera.GetViewMatrix();
+        glm::mat4 inverseProjection = glm::inverse(projection);
         glm::mat4 model = glm::mat4(1.0f);
+        geometryTimer.Begin();
         shaderGeometryPass.use();
         shaderGeometryPass.setMat4("projection", projection);
         shaderGeometryPass.setMat4("view", view);
@@ -219,33 +265,130 @@ int main()
         model = glm::scale(model, glm::vec3(1.0f));
         shaderGeometryPass.setMat4("model", model);
         backpack.Draw(shaderGeometryPass);
+        geometryTimer.End();
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, ssaoFBO);
-        glClear(GL_COLOR_BUFFER_BIT);
+        if (currentDownsample != ssaoDownsample)
+        {
+            resizeSSAOTargets();
+            currentDownsample = ssaoDownsample;
+            historyValid = false;
+        }
+        if (currentGtao != gtao)
+        {
+            currentGtao = gtao;
+            historyValid = false;
+        }
         shaderssao.use();
-        for (unsigned int i = 0; i < 64; ++i)
-            shaderssao.setVec3("samples[" + std::to_string(i) + "]", ssaoKernel[i]);
-        shaderssao.setMat4("projection", projection);
+        if (!gtao && currentKernelSize != ssaoKernelSize)
+        {
+            std::vector<glm::vec3> ssaoKernel = generateKernel(ssaoKernelSize);
+            for (unsigned int i = 0; i < ssaoKernelSize; ++i)
+                shaderssao.setVec3("samples[" + std::to_string(i) + "]", ssaoKernel[i]);
+            shaderssao.setInt("kernelSize", ssaoKernelSize);
+            currentKernelSize = ssaoKernelSize;
+        }
+
+        ssaoTimer.Begin();
+        glDisable(GL_DEPTH_TEST);
+        glViewport(0, 0, ssaoWidth, ssaoHeight);
+        // one depth/normal texel per AO pixel, so the AO pass reads a fraction of the full size G-buffer
+        glBindFramebuffer(GL_FRAMEBUFFER, ssaoDownsampleFBO);
+        shaderssaodownsample.use();
+        shaderssaodownsample.setInt("downsample", ssaoDownsample);
+        shaderssaodownsample.setMat4("projection", projection);
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, gPosition);
+        glBindTexture(GL_TEXTURE_2D, gBuffer.Depth);
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, gNormal);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, noiseTexture);
+        glBindTexture(GL_TEXTURE_2D, gBuffer.Normal);
         renderQuad();
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, ssaoBlurFBO);
-        glClear(GL_COLOR_BUFFER_BIT);
-        shaderssaoblur.use();
+        glBindFramebuffer(GL_FRAMEBUFFER, ssaoFBO);
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, ssaoColorBuffer);
-        renderQuad();
+        glBindTexture(GL_TEXTURE_2D, ssaoDepth);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, ssaoNormal);
+        unsigned int aoResult = ssaoColorBuffer;
+        if (gtao)
+        {
+            shadergtao.use();
+            shadergtao.setMat4("projection", projection);
+            shadergtao.setInt("frame", gtaoFrame++);
+            renderQuad();
+
+            // blend into the reprojected history; the result becomes next frame's history
+            glBindFramebuffer(GL_FRAMEBUFFER, gtaoHistoryFBO[1 - historyIndex]);
+            shadergtaotemporal.use();
+            shadergtaotemporal.setMat4("projection", projection);
+            shadergtaotemporal.setMat4("inverseView", glm::inverse(view));
+            shadergtaotemporal.setMat4("previousView", previousView);
+            shadergtaotemporal.setMat4("previousProjection", previousProjection);
+            shadergtaotemporal.setBool("historyValid", historyValid);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, ssaoColorBuffer);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, ssaoDepth);
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, gtaoHistory[historyIndex]);
+            renderQuad();
+            historyIndex = 1 - historyIndex;
+            historyValid = true;
+            aoResult = gtaoHistory[historyIndex];
+        }
+        else
+        {
+            shaderssao.use();
+            shaderssao.setMat4("projection", projection);
+            // tile the 4x4 noise texture once per 4x4 AO pixels
+            shaderssao.setVec2("noiseScale", ssaoWidth / 4.0f, ssaoHeight / 4.0f);
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, noiseTexture);
+            renderQuad();
+        }
+        previousView = view;
+        previousProjection = projection;
+
+        // separable depth aware blur: horizontal into the temp target, vertical back into the blurred one
+        shaderssaoblur.use();
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, ssaoDepth);
+        unsigned int blurInputs[2] = {aoResult, ssaoBlurTemp};
+        for (unsigned int i = 0; i < 2; i++)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, ssaoBlurFBO[i]);
+            shaderssaoblur.setVec2("direction", i == 0 ? 1.0f : 0.0f, i == 0 ? 0.0f : 1.0f);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, blurInputs[i]);
+            renderQuad();
+        }
+
+        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+        unsigned int ssaoResult = ssaoColorBufferBlur;
+        if (ssaoDownsample > 1)
+        {
+            // joint bilateral upsampling, guided by the full resolution depth
+            glBindFramebuffer(GL_FRAMEBUFFER, ssaoUpsampleFBO);
+            shaderssaoupsample.use();
+            shaderssaoupsample.setInt("downsample", ssaoDownsample);
+            shaderssaoupsample.setMat4("projection", projection);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, ssaoColorBufferBlur);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, ssaoDepth);
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, gBuffer.Depth);
+            renderQuad();
+            ssaoResult = ssaoUpsampled;
+        }
+        glEnable(GL_DEPTH_TEST);
+        ssaoTimer.End();
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        lightingTimer.Begin();
         shaderLightingPass.use();
+        shaderLightingPass.setMat4("inverseProjection", inverseProjection);
+        shaderLightingPass.setBool("storedPosition", wideGBuffer);
         // send light relevant uniforms
         glm::vec3 lightPosView = glm::vec3(camera.GetViewMatrix() * glm::vec4(lightPos, 1.0));
         shaderLightingPass.setVec3("light.Position", lightPosView);
@@ -256,14 +399,40 @@ int main()
         shaderLightingPass.setFloat("light.Linear", linear);
         shaderLightingPass.setFloat("light.Quadratic", quadratic);
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, gPosition);
+        glBindTexture(GL_TEXTURE_2D, gBuffer.Depth);
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, gNormal);
+        glBindTexture(GL_TEXTURE_2D, gBuffer.Normal);
         glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, gAlbedo);
+        glBindTexture(GL_TEXTURE_2D, gBuffer.Albedo);
         glActiveTexture(GL_TEXTURE3); // add extra SSAO texture to lighting pass
-        glBindTexture(GL_TEXTURE_2D, ssaoColorBufferBlur);
+        glBindTexture(GL_TEXTURE_2D, ssaoResult);
+        glActiveTexture(GL_TEXTURE4);
+        glBindTexture(GL_TEXTURE_2D, gBuffer.Position);
+        glActiveTexture(GL_TEXTURE0);
         renderQuad();
+        lightingTimer.End();
+        // show the pass timings in the title bar once per second
+        if (currentFrame - lastStatsTime > 1.0f)
+        {
+            std::string ao = gtao ? "gtao (1/" + std::to_string(ssaoDownsample) + " res, 16 samples)"
+                                  : "ssao (1/" + std::to_string(ssaoDownsample) + " res, " + std::to_string(ssaoKernelSize) + " samples)";
+            std::string title = "LearnOpenGL | geometry: " + std::to_string(geometryTimer.GetMilliseconds()) + " ms" +
+                                " | " + ao + ": " + std::to_string(ssaoTimer.GetMilliseconds()) + " ms" +
+                                " | lighting: " + std::to_string(lightingTimer.GetMilliseconds()) + " ms" +
+                                " | " + (wideGBuffer ? "wide" : "compact") + " G-buffer: " + std::to_string(gBuffer.BytesPerPixel) + " + 4 bytes per pixel";
+            glfwSetWindowTitle(window, title.c_str());
+            lastStatsTime = currentFrame;
+        }
+        if (compareAo)
+        {
+            compareAmbientOcclusion(shaderssao, shadergtao, shadergtaotemporal, projection, ssaoFBO, ssaoColorBuffer, gtaoHistoryFBO,
+                                    gtaoHistory, ssaoDepth, ssaoNormal, noiseTexture, ssaoWidth, ssaoHeight);
+            glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+            // the comparison left its own kernel and accumulation behind
+            currentKernelSize = 0;
+            historyValid = false;
+            compareAo = false;
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -274,6 +443,63 @@ int main()
     return 0;
 }
 
+// compact: octahedral normal in RG16 and albedo in RGBA8, 8 bytes per pixel; the position is reconstructed from depth.
+// wide: the layout before, normal in RGBA16F, albedo and view space position in RGBA16F, 20 bytes per pixel.
+GBuffer createGBuffer(bool wide)
+{
+    GBuffer gBuffer;
+    glGenFramebuffers(1, &gBuffer.FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer.FBO);
+    // normal buffer
+    glGenTextures(1, &gBuffer.Normal);
+    glBindTexture(GL_TEXTURE_2D, gBuffer.Normal);
+    if (wide)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16, SCR_WIDTH, SCR_HEIGHT, 0, GL_RG, GL_UNSIGNED_SHORT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gBuffer.Normal, 0);
+    // color buffer
+    glGenTextures(1, &gBuffer.Albedo);
+    glBindTexture(GL_TEXTURE_2D, gBuffer.Albedo);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gBuffer.Albedo, 0);
+    gBuffer.BytesPerPixel = wide ? 8 + 4 : 4 + 4;
+    // position buffer
+    gBuffer.Position = 0;
+    if (wide)
+    {
+        glGenTextures(1, &gBuffer.Position);
+        glBindTexture(GL_TEXTURE_2D, gBuffer.Position);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gBuffer.Position, 0);
+        gBuffer.BytesPerPixel += 8;
+    }
+    // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
+    unsigned int attachments[3] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+    glDrawBuffers(wide ? 3 : 2, attachments);
+
+    // depth is a texture so the SSAO and lighting passes can read it
+    glGenTextures(1, &gBuffer.Depth);
+    glBindTexture(GL_TEXTURE_2D, gBuffer.Depth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, SCR_WIDTH, SCR_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gBuffer.Depth, 0);
+    // finally check if framebuffer is complete
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "Framebuffer not complete!" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return gBuffer;
+}
+
 unsigned int cubeVAO = 0;
 unsigned int cubeVBO = 0;
 void renderCube()
@@ -347,6 +573,49 @@ void renderCube()
     glBindVertexArray(0);
 }
 
+// creates an empty render target texture attached to the bound framebuffer; its storage is set by allocateTarget
+unsigned int createTarget(GLenum attachment, GLenum filter)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, 1, 1, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+    return texture;
+}
+
+void allocateTarget(unsigned int texture, GLint internalFormat, unsigned int width, unsigned int height, GLenum format, GLenum type)
+{
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+}
+
+// hemisphere sample kernel; the samples are scaled to cluster near the center over the whole kernel, so the kernel is
+// generated for the size it is used with
+std::vector<glm::vec3> generateKernel(unsigned int kernelSize)
+{
+    std::uniform_real_distribution<GLfloat> randomFloats(0.0, 1.0); // generates random floats between 0.0 and 1.0
+    std::default_random_engine generator;
+    std::vector<glm::vec3> ssaoKernel;
+    for (unsigned int i = 0; i < kernelSize; ++i)
+    {
+        glm::vec3 sample(randomFloats(generator) * 2.0 - 1.0, randomFloats(generator) * 2.0 - 1.0, randomFloats(generator));
+        sample = glm::normalize(sample);
+        sample *= randomFloats(generator);
+        float scale = float(i) / float(kernelSize);
+
+        // scale samples s.t. they're more aligned to center of kernel
+        scale = ourLerp(0.1f, 1.0f, scale * scale);
+        sample *= scale;
+        ssaoKernel.push_back(sample);
+    }
+    return ssaoKernel;
+}
+
 unsigned int quadVAO = 0;
 unsigned int quadVBO;
 void renderQuad()
@@ -392,6 +661,111 @@ void renderQuad()
     glBindVertexArray(0);
 }
 
+// renders the raw (unblurred) AO of this frame's depth and normals at the current AO resolution and reads it back: the
+// SSAO with a 64 sample kernel as the reference, then GTAO accumulated with a still camera over two cycles of its 24
+// frame rotation, and the last of those frames on its own. Prints for both GTAO results the mean difference to the
+// reference (negative is darker), the mean absolute and rms difference and the share of pixels more than 0.1 off, and
+// the GPU time per frame of both methods. The caller restores the viewport.
+void compareAmbientOcclusion(Shader &ssaoShader, Shader &gtaoShader, Shader &temporalShader, const glm::mat4 &projection,
+                             unsigned int ssaoFBO, unsigned int ssaoColorBuffer, const unsigned int *historyFBOs, const unsigned int *history,
+                             unsigned int ssaoDepth, unsigned int ssaoNormal, unsigned int noiseTexture, unsigned int width, unsigned int height)
+{
+    const unsigned int referenceSamples = 64;
+    const unsigned int gtaoFrames = 48;
+    static unsigned int query = 0;
+    if (query == 0)
+        glGenQueries(1, &query);
+    std::vector<float> reference(width * height), singleFrame(width * height), accumulated(width * height * 2);
+    GLuint64 nanoseconds = 0;
+    glDisable(GL_DEPTH_TEST);
+    glViewport(0, 0, width, height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, ssaoFBO);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, ssaoDepth);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, ssaoNormal);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, noiseTexture);
+    ssaoShader.use();
+    std::vector<glm::vec3> kernel = generateKernel(referenceSamples);
+    for (unsigned int i = 0; i < referenceSamples; ++i)
+        ssaoShader.setVec3("samples[" + std::to_string(i) + "]", kernel[i]);
+    ssaoShader.setInt("kernelSize", referenceSamples);
+    ssaoShader.setMat4("projection", projection);
+    ssaoShader.setVec2("noiseScale", width / 4.0f, height / 4.0f);
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    renderQuad();
+    glEndQuery(GL_TIME_ELAPSED);
+    // waits for the GPU; fine for a benchmark
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+    float ssaoMilliseconds = static_cast<float>(nanoseconds) / 1000000.0f;
+    glReadPixels(0, 0, width, height, GL_RED, GL_FLOAT, reference.data());
+
+    // the camera doesn't move, so the temporal pass reprojects every pixel onto itself
+    gtaoShader.use();
+    gtaoShader.setMat4("projection", projection);
+    temporalShader.use();
+    temporalShader.setMat4("projection", projection);
+    temporalShader.setMat4("inverseView", glm::mat4(1.0f));
+    temporalShader.setMat4("previousView", glm::mat4(1.0f));
+    temporalShader.setMat4("previousProjection", projection);
+    unsigned int historyIndex = 0;
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    for (unsigned int frame = 0; frame < gtaoFrames; frame++)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, ssaoFBO);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, ssaoDepth);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, ssaoNormal);
+        gtaoShader.use();
+        gtaoShader.setInt("frame", frame);
+        renderQuad();
+
+        glBindFramebuffer(GL_FRAMEBUFFER, historyFBOs[1 - historyIndex]);
+        temporalShader.use();
+        temporalShader.setBool("historyValid", frame > 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, ssaoColorBuffer);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, ssaoDepth);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, history[historyIndex]);
+        renderQuad();
+        historyIndex = 1 - historyIndex;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+    float gtaoMilliseconds = static_cast<float>(nanoseconds) / 1000000.0f / gtaoFrames;
+    // the history holds AO and depth
+    glReadPixels(0, 0, width, height, GL_RG, GL_FLOAT, accumulated.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, ssaoFBO);
+    glReadPixels(0, 0, width, height, GL_RED, GL_FLOAT, singleFrame.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glEnable(GL_DEPTH_TEST);
+
+    std::cout << "AO at " << width << "x" << height << ", " << referenceSamples << " sample SSAO: " << ssaoMilliseconds << " ms, GTAO: "
+              << gtaoMilliseconds << " ms per frame" << std::endl;
+    for (unsigned int accumulate = 0; accumulate < 2; accumulate++)
+    {
+        double sum = 0.0, absoluteSum = 0.0, squaredSum = 0.0;
+        unsigned int outliers = 0, count = width * height;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            double difference = (accumulate ? accumulated[i * 2] : singleFrame[i]) - reference[i];
+            sum += difference;
+            absoluteSum += std::fabs(difference);
+            squaredSum += difference * difference;
+            outliers += std::fabs(difference) > 0.1 ? 1 : 0;
+        }
+        std::cout << (accumulate ? "GTAO accumulated over " + std::to_string(gtaoFrames) + " frames" : std::string("GTAO, one frame"))
+                  << " vs SSAO: mean " << sum / count << ", mean absolute " << absoluteSum / count << ", rms "
+                  << std::sqrt(squaredSum / count) << ", " << 100.0 * outliers / count << "% of pixels more than 0.1 off" << std::endl;
+    }
+}
+
 void processInput(GLFWwindow *window)
 {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
@@ -404,6 +778,53 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS && !resolutionKeyPressed)
+    {
+        // full, half, quarter resolution
+        ssaoDownsample = ssaoDownsample == 4 ? 1 : ssaoDownsample * 2;
+        resolutionKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_RELEASE)
+    {
+        resolutionKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS && !kernelKeyPressed)
+    {
+        // 16, 32, 64 samples
+        ssaoKernelSize = ssaoKernelSize == 64 ? 16 : ssaoKernelSize * 2;
+        kernelKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_N) == GLFW_RELEASE)
+    {
+        kernelKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS && !gtaoKeyPressed)
+    {
+        gtao = !gtao;
+        gtaoKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_RELEASE)
+    {
+        gtaoKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && !compareAoKeyPressed)
+    {
+        compareAo = true;
+        compareAoKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE)
+    {
+        compareAoKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS && !wideGBufferKeyPressed)
+    {
+        wideGBuffer = !wideGBuffer;
+        wideGBufferKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_RELEASE)
+    {
+        wideGBufferKeyPressed = false;
+    }
     if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS && !bloomKeyPressed)
     {
         bloom = !bloom;
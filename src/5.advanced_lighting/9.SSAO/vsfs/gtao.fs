@@ -0,0 +1,103 @@
+#version 330 core
+// ground truth ambient occlusion (Jimenez et al. 2016). Instead of testing points in a hemisphere, every pixel walks a
+// few screen space slices through itself, finds the highest horizon on both sides and integrates the cosine weighted
+// visibility between the two horizons analytically. The slice rotation and step offsets change every frame so the
+// temporal pass (gtao_temporal.fs) converges on many more directions than are taken per frame.
+// C in the sample prints how far this lands from the 64 sample hemisphere SSAO (ssao.fs), per frame and accumulated.
+out float FragColor;
+
+in vec2 TexCoords;
+
+// linear view depth and encoded normal at the AO resolution, written by ssao_downsample.fs
+uniform sampler2D ssaoDepth;
+uniform sampler2D ssaoNormal;
+uniform mat4 projection;
+// frame counter, selects this frame's rotation and step offset
+uniform int frame;
+
+// 2 slices * 4 steps * 2 sides = 16 depth reads per pixel
+const int sliceCount=2;
+const int stepCount=4;
+const float radius=.5;
+// occluders in the outer part of the radius fade out instead of being cut off
+const float falloffRange=.615*radius;
+const float PI=3.1415926535;
+const float HALF_PI=1.5707963268;
+
+// temporal rotations (degrees) and step offsets, repeating every 6 * 4 frames
+const float rotations[6]=float[](60.,300.,180.,240.,120.,0.);
+const float offsets[4]=float[](0.,.5,.25,.75);
+
+#include "../../../../include/shaders/gbuffer.glsl"
+
+// view space position of the surface at uv
+vec3 reconstructPosition(vec2 uv)
+{
+    return positionFromViewZ(uv,texture(ssaoDepth,uv).r,projection);
+}
+
+// interleaved gradient noise (Jimenez 2014): neighbouring pixels get well spread values
+float interleavedGradientNoise(vec2 pixel)
+{
+    return fract(52.9829189*fract(dot(pixel,vec2(.06711056,.00583715))));
+}
+
+void main()
+{
+    vec3 position=reconstructPosition(TexCoords);
+    vec3 normal=decodeNormal(texture(ssaoNormal,TexCoords).rg);
+    vec3 viewDir=normalize(-position);
+    // the search radius projected to uv units and to AO pixels
+    vec2 uvRadius=radius*.5*vec2(projection[0][0],projection[1][1])/-position.z;
+    float pixelRadius=uvRadius.y*float(textureSize(ssaoDepth,0).y);
+    if(pixelRadius<1.)
+    {
+        FragColor=1.;
+        return;
+    }
+    // the first step is at least one pixel away so the center doesn't occlude itself
+    float minStep=1./pixelRadius;
+    ivec2 pixel=ivec2(gl_FragCoord.xy);
+    float rotation=interleavedGradientNoise(gl_FragCoord.xy)+rotations[frame%6]/360.;
+    float offset=fract(.25*float((pixel.x+3*pixel.y)&3)+offsets[(frame/6)%4]);
+    
+    float visibility=0.;
+    for(int slice=0;slice<sliceCount;++slice)
+    {
+        float phi=(float(slice)+rotation)*PI/float(sliceCount);
+        vec3 direction=vec3(cos(phi),sin(phi),0.);
+        // the slice is the plane through the view vector and the direction; project the normal into it
+        vec3 orthoDirection=direction-dot(direction,viewDir)*viewDir;
+        vec3 axis=normalize(cross(orthoDirection,viewDir));
+        vec3 projectedNormal=normal-axis*dot(normal,axis);
+        float projectedLength=length(projectedNormal);
+        float cosN=clamp(dot(projectedNormal,viewDir)/projectedLength,0.,1.);
+        float n=sign(dot(orthoDirection,projectedNormal))*acos(cosN);
+        // the horizons start at the tangent plane and are raised by every occluder found along the slice
+        float lowHorizonCos0=cos(n+HALF_PI);
+        float lowHorizonCos1=cos(n-HALF_PI);
+        float horizonCos0=lowHorizonCos0;
+        float horizonCos1=lowHorizonCos1;
+        for(int j=0;j<stepCount;++j)
+        {
+            // squared distribution: more steps close to the center, where occluders matter most
+            float s=(float(j)+offset)/float(stepCount);
+            vec2 uvOffset=direction.xy*uvRadius*(s*s+minStep);
+            vec3 delta0=reconstructPosition(TexCoords+uvOffset)-position;
+            vec3 delta1=reconstructPosition(TexCoords-uvOffset)-position;
+            float length0=length(delta0);
+            float length1=length(delta1);
+            float weight0=clamp((radius-length0)/falloffRange,0.,1.);
+            float weight1=clamp((radius-length1)/falloffRange,0.,1.);
+            horizonCos0=max(horizonCos0,mix(lowHorizonCos0,dot(delta0/length0,viewDir),weight0));
+            horizonCos1=max(horizonCos1,mix(lowHorizonCos1,dot(delta1/length1,viewDir),weight1));
+        }
+        // horizon angles from the view vector, limited to the hemisphere around the normal
+        float h0=n+clamp(-acos(horizonCos1)-n,-HALF_PI,HALF_PI);
+        float h1=n+clamp(acos(horizonCos0)-n,-HALF_PI,HALF_PI);
+        float arc0=(cosN+2.*h0*sin(n)-cos(2.*h0-n))*.25;
+        float arc1=(cosN+2.*h1*sin(n)-cos(2.*h1-n))*.25;
+        visibility+=projectedLength*(arc0+arc1);
+    }
+    FragColor=visibility/float(sliceCount);
+}
\ No newline at end of file
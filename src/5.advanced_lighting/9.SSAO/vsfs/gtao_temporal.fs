@@ -0,0 +1,44 @@
+#version 330 core
+// temporal accumulation of the GTAO: every AO pixel is reprojected into the previous frame and blended with the
+// history there. The history keeps the view depth next to the AO, so a history texel that belonged to a different
+// surface (disocclusion, or leaving the screen) is detected and the pixel restarts from this frame's AO.
+// r = accumulated AO, g = view depth
+out vec2 FragColor;
+
+uniform sampler2D aoInput;
+uniform sampler2D ssaoDepth;
+uniform sampler2D history;
+uniform mat4 projection;
+uniform mat4 inverseView;
+uniform mat4 previousView;
+uniform mat4 previousProjection;
+// false on the first frame and after the targets were resized or the history was reset
+uniform bool historyValid;
+
+// weight of the new frame; with the 24 frame noise cycle this averages over roughly the last 10 frames
+const float blend=.1;
+// history depth may differ this much (relative) from the reprojected depth and still count as the same surface
+const float depthTolerance=.05;
+
+void main()
+{
+    ivec2 texel=ivec2(gl_FragCoord.xy);
+    vec2 uv=gl_FragCoord.xy/vec2(textureSize(ssaoDepth,0));
+    float depth=texelFetch(ssaoDepth,texel,0).r;
+    float ao=texelFetch(aoInput,texel,0).r;
+    FragColor=vec2(ao,depth);
+    if(!historyValid)
+    return;
+    
+    vec3 position=vec3((uv*2.-1.)*-depth/vec2(projection[0][0],projection[1][1]),depth);
+    vec4 world=inverseView*vec4(position,1.);
+    vec4 previousPosition=previousView*world;
+    vec4 previousClip=previousProjection*previousPosition;
+    vec2 previousUV=previousClip.xy/previousClip.w*.5+.5;
+    if(previousClip.w<=0.||any(lessThan(previousUV,vec2(0.)))||any(greaterThan(previousUV,vec2(1.))))
+    return;
+    vec2 previous=texture(history,previousUV).rg;
+    if(abs(previous.y-previousPosition.z)>depthTolerance*abs(previousPosition.z))
+    return;
+    FragColor=vec2(mix(previous.x,ao,blend),depth);
+}
\ No newline at end of file
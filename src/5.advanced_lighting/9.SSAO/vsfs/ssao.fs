@@ -3,27 +3,36 @@ out float FragColor;
 
 in vec2 TexCoords;
 
-uniform sampler2D gPosition;
-uniform sampler2D gNormal;
+// linear view depth and encoded normal at the AO resolution, written by ssao_downsample.fs
+uniform sampler2D ssaoDepth;
+uniform sampler2D ssaoNormal;
 uniform sampler2D texNoise;
 
 uniform vec3 samples[64];
+uniform int kernelSize;
 
 // parameters (you'd probably want to use them as uniforms to more easily tweak the effect)
-int kernelSize=64;
 float radius=.5;
 float bias=.025;
 
-// tile noise texture over screen based on screen dimensions divided by noise size
-const vec2 noiseScale=vec2(800./4.,600./4.);
+// tile noise texture over the AO target: its size divided by the noise size
+uniform vec2 noiseScale;
 
 uniform mat4 projection;
 
+#include "../../../../include/shaders/gbuffer.glsl"
+
+// view space z of the surface at uv
+float viewDepth(vec2 uv)
+{
+    return texture(ssaoDepth,uv).r;
+}
+
 void main()
 {
     // get input for SSAO algorithm
-    vec3 fragPos=texture(gPosition,TexCoords).xyz;
-    vec3 normal=normalize(texture(gNormal,TexCoords).rgb);
+    vec3 fragPos=positionFromViewZ(TexCoords,viewDepth(TexCoords),projection);
+    vec3 normal=decodeNormal(texture(ssaoNormal,TexCoords).rg);
     vec3 randomVec=normalize(texture(texNoise,TexCoords*noiseScale).xyz);
     // create TBN change-of-basis matrix: from tangent-space to view-space
     vec3 tangent=normalize(randomVec-normal*dot(randomVec,normal));
@@ -44,13 +53,13 @@ void main()
         offset.xyz=offset.xyz*.5+.5;// transform to range 0.0 - 1.0
         
         // get sample depth
-        float sampleDepth=texture(gPosition,offset.xy).z;// get depth value of kernel sample
+        float sampleDepth=viewDepth(offset.xy);// get depth value of kernel sample
         
         // range check & accumulate
         float rangeCheck=smoothstep(0.,1.,radius/abs(fragPos.z-sampleDepth));
         occlusion+=(sampleDepth>=samplePos.z+bias?1.:0.)*rangeCheck;
     }
-    occlusion=1.-(occlusion/kernelSize);
+    occlusion=1.-(occlusion/float(kernelSize));
     
     FragColor=occlusion;
 }
\ No newline at end of file
@@ -4,18 +4,33 @@ out float FragColor;
 in vec2 TexCoords;
 
 uniform sampler2D ssaoInput;
+uniform sampler2D ssaoDepth;
+// (1, 0) for the horizontal pass, (0, 1) for the vertical one
+uniform vec2 direction;
+
+// 9 tap gaussian, one side
+const float weights[5]=float[](.227027,.1945946,.1216216,.054054,.016216);
+// how quickly a tap loses weight with its relative depth difference
+const float depthSharpness=40.;
 
 void main()
 {
-    vec2 texelSize=1./vec2(textureSize(ssaoInput,0));
-    float result=0.;
-    for(int x=-2;x<2;++x)
+    ivec2 texel=ivec2(gl_FragCoord.xy);
+    ivec2 last=textureSize(ssaoInput,0)-1;
+    float depth=texelFetch(ssaoDepth,texel,0).r;
+    float result=texelFetch(ssaoInput,texel,0).r*weights[0];
+    float weightSum=weights[0];
+    for(int i=1;i<5;++i)
     {
-        for(int y=-2;y<2;++y)
+        for(int side=-1;side<=1;side+=2)
         {
-            vec2 offset=vec2(float(x),float(y))*texelSize;
-            result+=texture(ssaoInput,TexCoords+offset).r;
+            ivec2 tap=clamp(texel+ivec2(direction)*i*side,ivec2(0),last);
+            // taps across a depth edge get no weight, so the AO doesn't bleed over silhouettes
+            float tapDepth=texelFetch(ssaoDepth,tap,0).r;
+            float weight=weights[i]*exp(-abs(tapDepth-depth)/abs(depth)*depthSharpness);
+            result+=texelFetch(ssaoInput,tap,0).r*weight;
+            weightSum+=weight;
         }
     }
-    FragColor=result/(4.*4.);
+    FragColor=result/weightSum;
 }
\ No newline at end of file
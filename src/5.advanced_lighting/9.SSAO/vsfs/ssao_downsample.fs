@@ -0,0 +1,18 @@
+#version 330 core
+// copies one G-buffer texel per AO pixel: the view depth, linearized so the AO and blur passes read it directly, and
+// the still encoded normal. Both come from the same texel so they always describe the same surface.
+layout(location=0)out float ViewDepth;
+layout(location=1)out vec2 Normal;
+
+uniform sampler2D gDepth;
+uniform sampler2D gNormal;
+uniform int downsample;
+uniform mat4 projection;
+
+void main()
+{
+    ivec2 texel=min(ivec2(gl_FragCoord.xy)*downsample+downsample/2,textureSize(gDepth,0)-1);
+    float ndcZ=texelFetch(gDepth,texel,0).r*2.-1.;
+    ViewDepth=-projection[3][2]/(ndcZ+projection[2][2]);
+    Normal=texelFetch(gNormal,texel,0).rg;
+}
\ No newline at end of file
@@ -1,18 +1,21 @@
 #version 330 core
-layout(location=0)out vec3 gPosition;
-layout(location=1)out vec3 gNormal;
-layout(location=2)out vec3 gAlbedo;
+layout(location=0)out vec2 gNormal;
+layout(location=1)out vec3 gAlbedo;
+// only bound by the wide layout L switches to; the compact G-buffer has no third attachment
+layout(location=2)out vec3 gPosition;
 
 in vec2 TexCoords;
 in vec3 FragPos;
 in vec3 Normal;
 
+#include "../../../../include/shaders/gbuffer.glsl"
+
 void main()
 {
-    // store the fragment position vector in the first gbuffer texture
+    // the position is normally not stored, later passes reconstruct it from depth
     gPosition=FragPos;
-    // also store the per-fragment normals into the gbuffer
-    gNormal=normalize(Normal);
+    // store the per-fragment normals into the gbuffer
+    gNormal=encodeNormal(normalize(Normal));
     // and the diffuse per-fragment color
     gAlbedo.rgb=vec3(.95);
 }
\ No newline at end of file
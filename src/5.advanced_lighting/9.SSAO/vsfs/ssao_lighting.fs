@@ -3,10 +3,13 @@ out vec4 FragColor;
 
 in vec2 TexCoords;
 
-uniform sampler2D gPosition;
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
 uniform sampler2D gAlbedo;
 uniform sampler2D ssao;
+// the wide layout stores the view space position
+uniform bool storedPosition;
+uniform sampler2D gPosition;
 
 struct Light{
     vec3 Position;
@@ -16,12 +19,15 @@ struct Light{
     float Quadratic;
 };
 uniform Light light;
+uniform mat4 inverseProjection;
+
+#include "../../../../include/shaders/gbuffer.glsl"
 
 void main()
 {
     // retrieve data from gbuffer
-    vec3 FragPos=texture(gPosition,TexCoords).rgb;
-    vec3 Normal=texture(gNormal,TexCoords).rgb;
+    vec3 FragPos=storedPosition?texture(gPosition,TexCoords).xyz:positionFromDepth(TexCoords,texture(gDepth,TexCoords).r,inverseProjection);
+    vec3 Normal=decodeNormal(texture(gNormal,TexCoords).rg);
     vec3 Diffuse=texture(gAlbedo,TexCoords).rgb;
     float AmbientOcclusion=texture(ssao,TexCoords).r;
     
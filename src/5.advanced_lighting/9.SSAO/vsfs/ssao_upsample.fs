@@ -0,0 +1,36 @@
+#version 330 core
+// joint bilateral upsampling: the four nearest low resolution AO texels are weighted bilinearly and by how close their
+// depth is to the full resolution depth of this pixel
+out float FragColor;
+
+uniform sampler2D ssaoInput;
+uniform sampler2D ssaoDepth;
+uniform sampler2D gDepth;
+uniform int downsample;
+uniform mat4 projection;
+
+void main()
+{
+    float ndcZ=texelFetch(gDepth,ivec2(gl_FragCoord.xy),0).r*2.-1.;
+    float depth=-projection[3][2]/(ndcZ+projection[2][2]);
+    // position in low resolution texels; the downsample pass took the texel at the block center
+    vec2 position=(gl_FragCoord.xy-.5-float(downsample/2))/float(downsample);
+    ivec2 base=ivec2(floor(position));
+    vec2 f=position-vec2(base);
+    ivec2 last=textureSize(ssaoInput,0)-1;
+    float result=0.;
+    float weightSum=0.;
+    for(int y=0;y<2;++y)
+    {
+        for(int x=0;x<2;++x)
+        {
+            ivec2 tap=clamp(base+ivec2(x,y),ivec2(0),last);
+            vec2 bilinear=mix(1.-f,f,vec2(x,y));
+            float tapDepth=texelFetch(ssaoDepth,tap,0).r;
+            float weight=bilinear.x*bilinear.y/(abs(tapDepth-depth)/abs(depth)+.001);
+            result+=texelFetch(ssaoInput,tap,0).r*weight;
+            weightSum+=weight;
+        }
+    }
+    FragColor=result/weightSum;
+}
\ No newline at end of file
@@ -3,6 +3,10 @@
 #include "shader.h"
 #include "camera.h"
 #include "model.h"
+#include "light_buffer.h"
+#include "transform_system.h"
+#include "forward_plus.h"
+#include "gpu_timer.h"
 #include <iostream>
 #include <random>
 
@@ -19,12 +23,18 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 unsigned int loadTexture(const char *path, bool gammaCorrection);
 void renderSphere();
+
+// the forward+ lights, placed and colored from a fixed seed
+#define NR_TILE_LIGHTS FORWARD_PLUS_MAX_LIGHTS
+#define TILE_LIGHTS_SEED 7u
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 float lastX = 400, lastY = 300;
 float deltaTime = 0.0f; // 当前帧与上一帧的时间差
 float lastFrame = 0.0f; // 上一帧的时间
 bool firstMouse = true;
+bool tiledLights = true;
+bool tiledLightsKeyPressed = false;
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 int main()
 {
@@ -58,6 +68,9 @@ int main()
     glEnable(GL_DEPTH_TEST);
 
     Shader shader("C:/Users/22175/Desktop/LearnOpenGL/src/6.PBR/2.Lighting/vsfs/pbr.vs", "C:/Users/22175/Desktop/LearnOpenGL/src/6.PBR/2.Lighting/vsfs/pbr.fs");
+    Shader prepassShader("C:/Users/22175/Desktop/LearnOpenGL/src/6.PBR/2.Lighting/vsfs/pbr.vs", "C:/Users/22175/Desktop/LearnOpenGL/include/shaders/forward_plus_prepass.fs");
+    Shader tileDepthShader("C:/Users/22175/Desktop/LearnOpenGL/include/shaders/forward_plus_tile.vs", "C:/Users/22175/Desktop/LearnOpenGL/include/shaders/forward_plus_tile_depth.fs");
+    Shader tileCullShader("C:/Users/22175/Desktop/LearnOpenGL/include/shaders/forward_plus_tile.vs", "C:/Users/22175/Desktop/LearnOpenGL/include/shaders/forward_plus_tile_cull.fs");
     shader.use();
     shader.setVec3("albedo", 0.5f, 0.0f, 0.0f);
     shader.setFloat("ao", 1.0f);
@@ -72,13 +85,67 @@ int main()
         glm::vec3(300.0f, 300.0f, 300.0f),
         glm::vec3(300.0f, 300.0f, 300.0f),
         glm::vec3(300.0f, 300.0f, 300.0f)};
+    // the lights live in a uniform buffer object that is only written when a light changes
+    LightBuffer lightBuffer;
+    for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); ++i)
+        lightBuffer.Add(lightPositions[i], lightColors[i]);
+    lightBuffer.Bind(shader);
+    // the lights never move, so the buffer is filled once here
+    lightBuffer.Upload();
     int nrRows = 7;
     int nrColumns = 7;
     float spacing = 2.5;
 
+    // the spheres are static: their model and normal matrices are composed once by the transform system
+    TransformSystem transforms;
+    std::vector<unsigned int> sphereTransforms;
+    for (int row = 0; row < nrRows; ++row)
+        for (int col = 0; col < nrColumns; ++col)
+            sphereTransforms.push_back(transforms.Create(glm::vec3((col - (nrColumns / 2)) * spacing, (row - (nrRows / 2)) * spacing, 0.0f)));
+    std::vector<unsigned int> lightTransforms;
+    for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); ++i)
+        lightTransforms.push_back(transforms.Create(lightPositions[i], glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.5f)));
+
+    // many small colored lights floating in front of the spheres; their falloff reaches zero at the radius, so with
+    // forward+ every pixel only shades the few whose radius reaches its tile
+    DriftingLights tileLights(NR_TILE_LIGHTS, TILE_LIGHTS_SEED, glm::vec3(-9.0f, -9.0f, 1.2f), glm::vec3(9.0f, 9.0f, 3.0f), 0.0f, 4.0f);
+    tileLights.SetRadii(2.5f, 4.0f);
+    ForwardPlus forwardPlus(SCR_WIDTH, SCR_HEIGHT);
+    GpuTimer shadingTimer;
+    float lastStatsTime = 0.0f;
+
     glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
     shader.use();
     shader.setMat4("projection", projection);
+    prepassShader.use();
+    prepassShader.setMat4("projection", projection);
+
+    // draws the spheres and the four big lights; used by the depth pre-pass and the shading pass
+    auto renderScene = [&](Shader &sceneShader)
+    {
+        for (int row = 0; row < nrRows; ++row)
+        {
+            sceneShader.setFloat("metallic", (float)row / (float)nrRows);
+            for (int col = 0; col < nrColumns; ++col)
+            {
+                // we clamp the roughness to 0.05 - 1.0 as perfectly smooth surfaces (roughness of 0.0) tend to look a bit off
+                // on direct lighting.
+                sceneShader.setFloat("roughness", glm::clamp((float)col / (float)nrColumns, 0.05f, 1.0f));
+
+                unsigned int sphere = sphereTransforms[row * nrColumns + col];
+                sceneShader.setMat4("model", transforms.GetWorldMatrix(sphere));
+                sceneShader.setMat3("normalMatrix", transforms.GetNormalMatrix(sphere));
+                renderSphere();
+            }
+        }
+
+        for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); ++i)
+        {
+            sceneShader.setMat4("model", transforms.GetWorldMatrix(lightTransforms[i]));
+            sceneShader.setMat3("normalMatrix", transforms.GetNormalMatrix(lightTransforms[i]));
+            renderSphere();
+        }
+    };
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE); // 使用线框模式绘制
 
     while (!glfwWindowShouldClose(window))
@@ -89,45 +156,38 @@ int main()
         processInput(window);
         glClearColor(1.f, 1.f, 1.f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        shader.use();
         glm::mat4 view = camera.GetViewMatrix();
-        shader.setMat4("view", view);
-        shader.setVec3("camPos", camera.Position);
+        transforms.Update();
 
-        glm::mat4 model = glm::mat4(1.0f);
-        for (int row = 0; row < nrRows; ++row)
+        // the small lights drift in the plane in front of the spheres
+        tileLights.Update(currentFrame, glm::vec3(1.5f, 1.5f, 0.0f), 0.7f);
+        forwardPlus.SetLights(tileLights.Positions, tileLights.Colors, tileLights.Radii);
+        if (tiledLights)
         {
-            shader.setFloat("metallic", (float)row / (float)nrRows);
-            for (int col = 0; col < nrColumns; ++col)
-            {
-                // we clamp the roughness to 0.05 - 1.0 as perfectly smooth surfaces (roughness of 0.0) tend to look a bit off
-                // on direct lighting.
-                shader.setFloat("roughness", glm::clamp((float)col / (float)nrColumns, 0.05f, 1.0f));
-
-                model = glm::mat4(1.0f);
-                model = glm::translate(model, glm::vec3(
-                                                  (col - (nrColumns / 2)) * spacing,
-                                                  (row - (nrRows / 2)) * spacing,
-                                                  0.0f));
-                shader.setMat4("model", model);
-                shader.setMat3("normalMatrix", glm::transpose(glm::inverse(glm::mat3(model))));
-                renderSphere();
-            }
+            forwardPlus.BeginDepthPrepass();
+            prepassShader.use();
+            prepassShader.setMat4("view", view);
+            renderScene(prepassShader);
+            forwardPlus.CullLights(tileDepthShader, tileCullShader, view, projection);
         }
 
-        for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); ++i)
+        shadingTimer.Begin();
+        shader.use();
+        shader.setMat4("view", view);
+        shader.setVec3("camPos", camera.Position);
+        shader.setBool("tiledLights", tiledLights);
+        forwardPlus.Bind(shader, 0);
+        renderScene(shader);
+        shadingTimer.End();
+        // the forward+ pass leaves GL_LEQUAL set for drawing over the pre-pass depth
+        glDepthFunc(GL_LESS);
+
+        if (currentFrame - lastStatsTime > 1.0f)
         {
-            glm::vec3 newPos = lightPositions[i] + glm::vec3(sin(glfwGetTime() * 5.0) * 5.0, 0.0, 0.0);
-            newPos = lightPositions[i];
-            shader.setVec3("lightPositions[" + std::to_string(i) + "]", newPos);
-            shader.setVec3("lightColors[" + std::to_string(i) + "]", lightColors[i]);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, newPos);
-            model = glm::scale(model, glm::vec3(0.5f));
-            shader.setMat4("model", model);
-            shader.setMat3("normalMatrix", glm::transpose(glm::inverse(glm::mat3(model))));
-            renderSphere();
+            std::string title = std::string("LearnOpenGL | ") + (tiledLights ? "forward+" : "all lights") +
+                                " | shading: " + std::to_string(shadingTimer.GetMilliseconds()) + " ms";
+            glfwSetWindowTitle(window, title.c_str());
+            lastStatsTime = currentFrame;
         }
 
         glfwSwapBuffers(window);
@@ -242,6 +302,16 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS && !tiledLightsKeyPressed)
+    {
+        tiledLights = !tiledLights;
+        tiledLightsKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_RELEASE)
+    {
+        tiledLightsKeyPressed = false;
+    }
 }
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
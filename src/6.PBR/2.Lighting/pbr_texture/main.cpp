@@ -3,6 +3,7 @@
 #include "shader.h"
 #include "camera.h"
 #include "model.h"
+#include "light_buffer.h"
 #include <iostream>
 #include <random>
 
@@ -77,6 +78,19 @@ int main()
     glm::vec3 lightColors[] = {
         glm::vec3(150.0f, 150.0f, 150.0f),
     };
+    // the lights live in a uniform buffer object that is only written when a light changes
+    LightBuffer lightBuffer;
+    // Add() returns -1 once the buffer is full; such a light is neither lit nor drawn
+    int lightIds[sizeof(lightPositions) / sizeof(lightPositions[0])];
+    for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); ++i)
+    {
+        lightIds[i] = lightBuffer.Add(lightPositions[i], lightColors[i]);
+        if (lightIds[i] < 0)
+            std::cout << "Light buffer is full, light " << i << " is dropped" << std::endl;
+    }
+    lightBuffer.Bind(shader);
+    // the lights never move, so the buffer is filled once here
+    lightBuffer.Upload();
     int nrRows = 7;
     int nrColumns = 7;
     float spacing = 2.5;
@@ -128,10 +142,9 @@ int main()
 
         for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); ++i)
         {
-            glm::vec3 newPos = lightPositions[i] + glm::vec3(sin(glfwGetTime() * 5.0) * 5.0, 0.0, 0.0);
-            newPos = lightPositions[i];
-            shader.setVec3("lightPositions[" + std::to_string(i) + "]", newPos);
-            shader.setVec3("lightColors[" + std::to_string(i) + "]", lightColors[i]);
+            if (lightIds[i] < 0)
+                continue;
+            glm::vec3 newPos = glm::vec3(lightBuffer.Get(lightIds[i]).PositionRadius);
 
             model = glm::mat4(1.0f);
             model = glm::translate(model, newPos);
@@ -12,8 +12,15 @@ uniform sampler2D roughnessMap;// 粗糙度贴图
 uniform sampler2D aoMap;// 环境光遮蔽贴图
 
 // 光源
-uniform vec3 lightPositions[4];// 光源位置数组
-uniform vec3 lightColors[4];// 光源颜色数组
+// lights, indexed by the id LightBuffer::Add returned; the array size must match LIGHT_BUFFER_CAPACITY
+struct Light{
+    vec4 PositionRadius;
+    vec4 Color;
+};
+layout(std140)uniform Lights{
+    int lightCount;
+    Light lights[256];
+};
 
 uniform vec3 camPos;// 相机位置
 
@@ -99,14 +106,14 @@ void main()
     
     // 反射率方程
     vec3 Lo=vec3(0.);
-    for(int i=0;i<4;++i)
+    for(int i=0;i<lightCount;++i)
     {
         // 计算每个光源的辐射
-        vec3 L=normalize(lightPositions[i]-WorldPos);
+        vec3 L=normalize(lights[i].PositionRadius.xyz-WorldPos);
         vec3 H=normalize(V+L);
-        float distance=length(lightPositions[i]-WorldPos);
+        float distance=length(lights[i].PositionRadius.xyz-WorldPos);
         float attenuation=1./(distance*distance);
-        vec3 radiance=lightColors[i]*attenuation;
+        vec3 radiance=lights[i].Color.rgb*attenuation;
         
         // Cook-Torrance BRDF
         float NDF=DistributionGGX(N,H,roughness);
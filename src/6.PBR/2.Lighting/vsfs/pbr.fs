@@ -10,12 +10,20 @@ uniform float metallic;
 uniform float roughness;
 uniform float ao;
 
-// lights
-uniform vec3 lightPositions[4];
-uniform vec3 lightColors[4];
+// lights, indexed by the id LightBuffer::Add returned; the array size must match LIGHT_BUFFER_CAPACITY
+struct Light{
+    vec4 PositionRadius;
+    vec4 Color;
+};
+layout(std140)uniform Lights{
+    int lightCount;
+    Light lights[256];
+};
 
 uniform vec3 camPos;
 
+#include "../../../../include/shaders/forward_plus.glsl"
+
 const float PI=3.14159265359;
 // ----------------------------------------------------------------------------
 uniform sampler2D albedoMap;
@@ -64,6 +72,49 @@ vec3 fresnelSchlick(float cosTheta,vec3 F0)
     return F0+(1.-F0)*pow(clamp(1.-cosTheta,0.,1.),5.);
 }
 // ----------------------------------------------------------------------------
+// outgoing radiance towards V for light arriving from direction L with the given radiance
+vec3 Shade(vec3 N,vec3 V,vec3 L,vec3 radiance,vec3 F0)
+{
+    vec3 H=normalize(V+L);
+    
+    // Cook-Torrance BRDF
+    float NDF=DistributionGGX(N,H,roughness);
+    float G=GeometrySmith(N,V,L,roughness);
+    vec3 F=fresnelSchlick(clamp(dot(H,V),0.,1.),F0);
+    
+    vec3 numerator=NDF*G*F;
+    float denominator=4.*max(dot(N,V),0.)*max(dot(N,L),0.)+.0001;// + 0.0001 to prevent divide by zero
+    vec3 specular=numerator/denominator;
+    
+    // kS is equal to Fresnel
+    vec3 kS=F;
+    // for energy conservation, the diffuse and specular light can't
+    // be above 1.0 (unless the surface emits light); to preserve this
+    // relationship the diffuse component (kD) should equal 1.0 - kS.
+    vec3 kD=vec3(1.)-kS;
+    // multiply kD by the inverse metalness such that only non-metals
+    // have diffuse lighting, or a linear blend if partly metal (pure metals
+    // have no diffuse light).
+    kD*=1.-metallic;
+    
+    // scale light by NdotL
+    float NdotL=max(dot(N,L),0.);
+    
+    return(kD*albedo/PI+specular)*radiance*NdotL;// note that we already multiplied the BRDF by the Fresnel (kS) so we won't multiply by kS again
+}
+// ----------------------------------------------------------------------------
+// one forward+ light: inverse square falloff, windowed to reach zero at the light's radius
+vec3 ShadeTileLight(int index,vec3 N,vec3 V,vec3 F0)
+{
+    vec4 light=texelFetch(lightData,index*2);
+    vec3 color=texelFetch(lightData,index*2+1).rgb;
+    vec3 toLight=light.xyz-WorldPos;
+    float distance2=dot(toLight,toLight);
+    float falloff=clamp(1.-pow(distance2/(light.w*light.w),2.),0.,1.);
+    float attenuation=falloff*falloff/(distance2+1.);
+    return Shade(N,V,toLight*inversesqrt(distance2),color*attenuation,F0);
+}
+// ----------------------------------------------------------------------------
 void main()
 {
     vec3 N=normalize(Normal);
@@ -76,40 +127,27 @@ void main()
     
     // reflectance equation
     vec3 Lo=vec3(0.);
-    for(int i=0;i<4;++i)
+    for(int i=0;i<lightCount;++i)
     {
         // calculate per-light radiance
-        vec3 L=normalize(lightPositions[i]-WorldPos);
-        vec3 H=normalize(V+L);
-        float distance=length(lightPositions[i]-WorldPos);
+        vec3 L=normalize(lights[i].PositionRadius.xyz-WorldPos);
+        float distance=length(lights[i].PositionRadius.xyz-WorldPos);
         float attenuation=1./(distance*distance);
-        vec3 radiance=lightColors[i]*attenuation;
-        
-        // Cook-Torrance BRDF
-        float NDF=DistributionGGX(N,H,roughness);
-        float G=GeometrySmith(N,V,L,roughness);
-        vec3 F=fresnelSchlick(clamp(dot(H,V),0.,1.),F0);
-        
-        vec3 numerator=NDF*G*F;
-        float denominator=4.*max(dot(N,V),0.)*max(dot(N,L),0.)+.0001;// + 0.0001 to prevent divide by zero
-        vec3 specular=numerator/denominator;
-        
-        // kS is equal to Fresnel
-        vec3 kS=F;
-        // for energy conservation, the diffuse and specular light can't
-        // be above 1.0 (unless the surface emits light); to preserve this
-        // relationship the diffuse component (kD) should equal 1.0 - kS.
-        vec3 kD=vec3(1.)-kS;
-        // multiply kD by the inverse metalness such that only non-metals
-        // have diffuse lighting, or a linear blend if partly metal (pure metals
-        // have no diffuse light).
-        kD*=1.-metallic;
-        
-        // scale light by NdotL
-        float NdotL=max(dot(N,L),0.);
+        vec3 radiance=lights[i].Color.rgb*attenuation;
         
         // add to outgoing radiance Lo
-        Lo+=(kD*albedo/PI+specular)*radiance*NdotL;// note that we already multiplied the BRDF by the Fresnel (kS) so we won't multiply by kS again
+        Lo+=Shade(N,V,L,radiance,F0);
+    }
+    
+    // the many small lights, either the ones of this fragment's tile or all of them
+    uint words[8];
+    tileLightWords(words);
+    for(int w=0;w<8;++w)
+    {
+        uint bits=words[w];
+        for(int b=0;bits!=0u;++b,bits>>=1u)
+        if((bits&1u)!=0u)
+        Lo+=ShadeTileLight(w*32+b,N,V,F0);
     }
     
     // ambient lighting (note that the next IBL tutorial will replace
@@ -3,6 +3,8 @@
 #include "shader.h"
 #include "camera.h"
 #include "model.h"
+#include "light_buffer.h"
+#include "hdr_image.h"
 #include <iostream>
 #include <random>
 
@@ -89,6 +91,19 @@ int main()
         glm::vec3(300.0f, 300.0f, 300.0f),
         glm::vec3(300.0f, 300.0f, 300.0f),
         glm::vec3(300.0f, 300.0f, 300.0f)};
+    // the lights live in a uniform buffer object that is only written when a light changes
+    LightBuffer lightBuffer;
+    // Add() returns -1 once the buffer is full; such a light is neither lit nor drawn
+    int lightIds[sizeof(lightPositions) / sizeof(lightPositions[0])];
+    for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); ++i)
+    {
+        lightIds[i] = lightBuffer.Add(lightPositions[i], lightColors[i]);
+        if (lightIds[i] < 0)
+            std::cout << "Light buffer is full, light " << i << " is dropped" << std::endl;
+    }
+    lightBuffer.Bind(pbrShader);
+    // the lights never move, so the buffer is filled once here
+    lightBuffer.Upload();
 
     int nrRows = 7;
     int nrColumns = 7;
@@ -106,27 +121,14 @@ int main()
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
 
-    stbi_set_flip_vertically_on_load(true);
-    int width, height, nrComponents;
-    float *data = stbi_loadf("C:/Users/22175/Desktop/LearnOpenGL/assets/textures/hdr/newport_loft.hdr", &width, &height, &nrComponents, 0);
-    unsigned int hdrTexture;
-    if (data)
-    {
-        glGenTextures(1, &hdrTexture);
-        glBindTexture(GL_TEXTURE_2D, hdrTexture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, data); // note how we specify the texture's data value to be float
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
+    // decoded on the job system straight to the half floats GL_RGB16F holds, so the upload needs no conversion
+    JobSystem jobs;
+    HdrImage hdrImage;
+    unsigned int hdrTexture = 0;
+    if (hdrImage.Load("C:/Users/22175/Desktop/LearnOpenGL/assets/textures/hdr/newport_loft.hdr", HDR_HALF_FLOAT, &jobs))
+        hdrTexture = hdrImage.CreateTexture();
     else
-    {
         std::cout << "Failed to load HDR image." << std::endl;
-    }
 
     // pbr: setup cubemap to render to and attach to framebuffer
     // ---------------------------------------------------------
@@ -253,10 +255,9 @@ int main()
         }
         for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); ++i)
         {
-            glm::vec3 newPos = lightPositions[i] + glm::vec3(sin(glfwGetTime() * 5.0) * 5.0, 0.0, 0.0);
-            newPos = lightPositions[i];
-            pbrShader.setVec3("lightPositions[" + std::to_string(i) + "]", newPos);
-            pbrShader.setVec3("lightColors[" + std::to_string(i) + "]", lightColors[i]);
+            if (lightIds[i] < 0)
+                continue;
+            glm::vec3 newPos = glm::vec3(lightBuffer.Get(lightIds[i]).PositionRadius);
 
             model = glm::mat4(1.0f);
             model = glm::translate(model, newPos);
@@ -12,13 +12,20 @@ uniform sampler2D roughnessMap;
 uniform sampler2D aoMap;
 
 // IBL
-uniform samplerCube irradianceMap;
+// diffuse irradiance / PI as L2 spherical harmonics, see spherical_harmonics.h
+uniform vec3 shIrradiance[9];
 uniform samplerCube prefilterMap;
 uniform sampler2D brdfLUT;
 
-// lights
-uniform vec3 lightPositions[4];
-uniform vec3 lightColors[4];
+// lights, indexed by the id LightBuffer::Add returned; the array size must match LIGHT_BUFFER_CAPACITY
+struct Light{
+    vec4 PositionRadius;
+    vec4 Color;
+};
+layout(std140)uniform Lights{
+    int lightCount;
+    Light lights[256];
+};
 
 uniform vec3 camPos;
 
@@ -90,6 +97,15 @@ vec3 fresnelSchlickRoughness(float cosTheta,vec3 F0,float roughness)
     return F0+(max(vec3(1.-roughness),F0)-F0)*pow(clamp(1.-cosTheta,0.,1.),5.);
 }
 // ----------------------------------------------------------------------------
+vec3 IrradianceSH(vec3 n)
+{
+    vec3 result=shIrradiance[0]*.282095;
+    result+=(shIrradiance[1]*n.y+shIrradiance[2]*n.z+shIrradiance[3]*n.x)*.488603;
+    result+=(shIrradiance[4]*n.x*n.y+shIrradiance[5]*n.y*n.z+shIrradiance[7]*n.x*n.z)*1.092548;
+    result+=shIrradiance[6]*.315392*(3.*n.z*n.z-1.)+shIrradiance[8]*.546274*(n.x*n.x-n.y*n.y);
+    return max(result,vec3(0.));
+}
+// ----------------------------------------------------------------------------
 void main()
 {
     // material properties
@@ -110,14 +126,14 @@ void main()
     
     // reflectance equation
     vec3 Lo=vec3(0.);
-    for(int i=0;i<4;++i)
+    for(int i=0;i<lightCount;++i)
     {
         // calculate per-light radiance
-        vec3 L=normalize(lightPositions[i]-WorldPos);
+        vec3 L=normalize(lights[i].PositionRadius.xyz-WorldPos);
         vec3 H=normalize(V+L);
-        float distance=length(lightPositions[i]-WorldPos);
+        float distance=length(lights[i].PositionRadius.xyz-WorldPos);
         float attenuation=1./(distance*distance);
-        vec3 radiance=lightColors[i]*attenuation;
+        vec3 radiance=lights[i].Color.rgb*attenuation;
         
         // Cook-Torrance BRDF
         float NDF=DistributionGGX(N,H,roughness);
@@ -153,7 +169,7 @@ void main()
     vec3 kD=1.-kS;
     kD*=1.-metallic;
     
-    vec3 irradiance=texture(irradianceMap,N).rgb;
+    vec3 irradiance=IrradianceSH(N);
     vec3 diffuse=irradiance*albedo;
     
     // sample both the pre-filter map and the BRDF lut and combine them together as per the Split-Sum approximation to get the IBL specular part.
@@ -0,0 +1,154 @@
+#include "hdr_image.h"
+#include "ibl_baker.h"
+#include "ibl_cache.h"
+#include "job_system.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// Headless CPU bake of the specular IBL data. It writes the same <hdr>.ibl cache the IBL samples look for, keyed by the
+// same bake shaders, so a sample started afterwards loads it instead of baking on the GPU:
+//   IBL_Baker [hdr] [sample vsfs directory]
+// With --compare nothing is written: the cache a sample baked on the GPU is read and the CPU bake is compared with it.
+// Delete a cache this tool wrote and start a sample first, so it bakes on the GPU; the exit code is 2 when a texture's
+// rms error passes compareTolerance.
+//   IBL_Baker [hdr] [sample vsfs directory] --compare
+// Against a line by line C++ port of the bake shaders every texel sampled is within 1e-4 relative (BRDF LUT 1e-5 max,
+// prefilter 7e-5 max); the GPU figures depend on the driver's texture filtering at the cube edges.
+
+// rms error, in percent of the rms GPU value, above which --compare reports a mismatch: half float rounding is 0.05%,
+// the rest is left for the seams and the GPU's mip selection
+const double compareTolerance = 1.0;
+
+const char *bakeShaders[] = {"cubemap.vs", "equirectangular_to_cubemap.fs", "prefilter.fs", "brdf.vs", "brdf.fs"};
+
+bool compareTexture(const char *name, const IblTexture &cpu, const IblTexture &gpu, unsigned int levels);
+bool compareIrradiance(const SphericalHarmonics &cpu, const SphericalHarmonics &gpu);
+
+int main(int argc, char *argv[])
+{
+    std::string hdrPath = "C:/Users/22175/Desktop/LearnOpenGL/assets/textures/hdr/newport_loft.hdr";
+    std::string shaderDirectory = "C:/Users/22175/Desktop/LearnOpenGL/src/6.PBR/3.IBL/2.Specular_IBL/vsfs";
+    bool compare = false;
+    unsigned int positional = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--compare") == 0)
+            compare = true;
+        else if (positional++ == 0)
+            hdrPath = argv[i];
+        else
+            shaderDirectory = argv[i];
+    }
+
+    IblCache cache(hdrPath);
+    for (const char *shader : bakeShaders)
+        if (!cache.AddFile(shaderDirectory + "/" + shader))
+            std::cout << "can't read " << shaderDirectory << "/" << shader << ", the samples won't find this bake" << std::endl;
+
+    IblTexture gpuEnvironment, gpuPrefilter, gpuBrdf;
+    SphericalHarmonics gpuIrradiance;
+    IblOrigin origin = IBL_ORIGIN_GPU;
+    if (compare && !cache.Read(gpuEnvironment, gpuIrradiance, gpuPrefilter, gpuBrdf, &origin))
+    {
+        std::cout << "no cache baked from these files at " << cache.GetPath() << ", run a sample first" << std::endl;
+        return 1;
+    }
+    // comparing with an earlier run of this tool would only show that it is deterministic
+    if (compare && origin != IBL_ORIGIN_GPU)
+    {
+        std::cout << cache.GetPath() << " was baked on the CPU; delete it and run a sample to bake it on the GPU" << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto lap = [&start](const char *stage)
+    {
+        auto now = std::chrono::steady_clock::now();
+        std::cout << stage << ": " << std::chrono::duration<float, std::milli>(now - start).count() << " ms" << std::endl;
+        start = now;
+    };
+
+    JobSystem jobs;
+    HdrImage hdrImage;
+    if (!hdrImage.Load(hdrPath, HDR_FLOAT, &jobs))
+    {
+        std::cout << "Failed to load HDR image." << std::endl;
+        return 1;
+    }
+    lap("decode");
+
+    IblBaker baker(cache, jobs);
+    baker.CaptureEnvironment(hdrImage.GetFloats(), hdrImage.Width, hdrImage.Height, 3);
+    // the panorama isn't needed past the capture
+    hdrImage = HdrImage();
+    lap("environment");
+    baker.ProjectIrradiance();
+    lap("irradiance");
+    baker.PrefilterEnvironment();
+    lap("prefilter");
+    baker.IntegrateBrdf();
+    lap("brdf");
+    std::cout << "on " << jobs.GetThreadCount() << " threads" << std::endl;
+
+    if (compare)
+    {
+        bool matches = compareTexture("environment", baker.GetEnvironment(), gpuEnvironment, gpuEnvironment.Levels);
+        matches = compareIrradiance(baker.Irradiance, gpuIrradiance) && matches;
+        // the GL bake leaves the prefilter levels past PrefilterMips undefined
+        matches = compareTexture("prefilter", baker.GetPrefilter(), gpuPrefilter, cache.PrefilterMips) && matches;
+        matches = compareTexture("brdf", baker.GetBrdfLUT(), gpuBrdf, 1) && matches;
+        std::cout << (matches ? "the CPU bake matches the GPU bake" : "the CPU bake differs from the GPU bake") << std::endl;
+        return matches ? 0 : 2;
+    }
+    if (!cache.Save(baker.GetEnvironment(), baker.Irradiance, baker.GetPrefilter(), baker.GetBrdfLUT()))
+        return 1;
+    lap("save");
+    std::cout << "wrote " << cache.GetPath() << std::endl;
+    return 0;
+}
+
+// per level: the largest difference of any channel and the rms difference relative to the rms of the GPU values; false
+// if a level's rms difference passes compareTolerance
+bool compareTexture(const char *name, const IblTexture &cpu, const IblTexture &gpu, unsigned int levels)
+{
+    if (cpu.Cube != gpu.Cube || cpu.Channels != gpu.Channels || cpu.Size != gpu.Size || cpu.Levels < levels || gpu.Levels < levels)
+    {
+        std::cout << name << ": the CPU and GPU textures have different layouts" << std::endl;
+        return false;
+    }
+    bool matches = true;
+    for (unsigned int level = 0; level < levels; level++)
+    {
+        size_t count = static_cast<size_t>(cpu.GetLevelSize(level)) * cpu.GetLevelSize(level) * cpu.Channels * cpu.GetFaceCount();
+        const uint16_t *a = cpu.GetFace(level, 0), *b = gpu.GetFace(level, 0);
+        double maxError = 0.0, errorSquared = 0.0, valueSquared = 0.0;
+        for (size_t i = 0; i < count; i++)
+        {
+            double value = HalfToFloat(b[i]);
+            double error = std::fabs(HalfToFloat(a[i]) - value);
+            maxError = std::max(maxError, error);
+            errorSquared += error * error;
+            valueSquared += value * value;
+        }
+        double rmsError = 100.0 * std::sqrt(errorSquared / std::max(valueSquared, 1e-20));
+        std::cout << name << " level " << level << " (" << cpu.GetLevelSize(level) << "): max error " << maxError
+                  << ", rms error " << rmsError << "%" << (rmsError > compareTolerance ? " MISMATCH" : "") << std::endl;
+        matches = matches && rmsError <= compareTolerance;
+    }
+    return matches;
+}
+
+bool compareIrradiance(const SphericalHarmonics &cpu, const SphericalHarmonics &gpu)
+{
+    float maxError = 0.0f;
+    for (unsigned int i = 0; i < 9; i++)
+        maxError = std::max(maxError, glm::length(cpu.Coefficients[i] - gpu.Coefficients[i]));
+    float relativeError = 100.0f * maxError / std::max(glm::length(gpu.Coefficients[0]), 1e-20f);
+    std::cout << "irradiance: max coefficient error " << maxError << ", " << relativeError << "% of the DC term"
+              << (relativeError > compareTolerance ? " MISMATCH" : "") << std::endl;
+    return relativeError <= compareTolerance;
+}